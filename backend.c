@@ -0,0 +1,248 @@
+/*
+ * This selects which implementation of the low level hash primitives
+ * (SHA-256 compress, SHA-512 compress, Keccak permutation) we use
+ *
+ * If TS_BACKEND_DISPATCH is set, we probe the CPU (once) and bind the
+ * fastest implementation it supports into the ts_hash_backend table.
+ * That's meant for hosts, where several threads may get here at once (say,
+ * each calling ts_init_sign), so the probe is done under pthread_once.
+ * If it isn't set, the hash code calls the scalar implementations directly,
+ * and these routines are just stubs
+ */
+#include "tiny_sphincs.h"
+#include "backend.h"
+
+#if TS_BACKEND_DISPATCH
+
+#include <pthread.h>
+#if TS_HAVE_SHA_NI || TS_HAVE_AVX2
+#include <cpuid.h>
+#endif
+
+/*
+ * We start off with the scalar implementations; that way, everything
+ * works even if the application never calls ts_init_backends
+ */
+struct ts_hash_backend ts_hash_backend = {
+    ts_SHA256_compress_scalar,
+    ts_SHA512_compress_scalar,
+    ts_keccak_permute_scalar,
+#if TS_MULTI_LANE
+#if TS_HAVE_VECTOR
+    ts_SHA256_compress_x4_vector,
+    ts_keccak_permute_x4_vector,
+#else
+    ts_SHA256_compress_x4_scalar,
+    ts_keccak_permute_x4_scalar,
+#endif
+#endif
+};
+
+static pthread_once_t backends_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Does this CPU support the SHA extensions?  The SHA-NI code also uses
+ * SSSE3 and SSE4.1 instructions; any CPU with SHA-NI has those, but we
+ * check anyways
+ */
+static int cpu_has_sha_ni(void) {
+#if TS_HAVE_SHA_NI
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) return 0;
+    if (!(c & bit_SSSE3) || !(c & bit_SSE4_1)) return 0;
+    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d)) return 0;
+    return (b & bit_SHA) != 0;
+#else
+    return 0;
+#endif
+}
+
+#if TS_HAVE_AVX2
+/*
+ * Does this CPU (and OS) support AVX2?  The OS needs to save the YMM
+ * registers on a context switch; XGETBV tells us if it does
+ */
+static int cpu_has_avx2(void) {
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) return 0;
+    if (!(c & bit_OSXSAVE) || !(c & bit_AVX)) return 0;
+    unsigned xcr0_lo, xcr0_hi;
+    __asm__( "xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0) );
+    if ((xcr0_lo & 6) != 6) return 0;
+    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d)) return 0;
+    return (b & bit_AVX2) != 0;
+}
+#endif
+
+/*
+ * This binds the fastest implementations.  We do this only once (the
+ * first time ts_init_backends or ts_set_backend is called); after that, a
+ * choice the application made with ts_set_backend is never undone
+ */
+static void probe_backends(void) {
+#if TS_HAVE_SHA_NI
+    if (cpu_has_sha_ni()) {
+	ts_hash_backend.sha256_compress = ts_SHA256_compress_sha_ni;
+#if TS_MULTI_LANE
+	/* SHA-NI one lane at a time beats four lanes of vector code */
+	ts_hash_backend.sha256_compress_x4 = ts_SHA256_compress_x4_scalar;
+#endif
+    }
+#endif
+#if TS_HAVE_AVX2
+    if (cpu_has_avx2()) {
+	ts_hash_backend.keccak_permute_x4 = ts_keccak_permute_x4_avx2;
+	if (ts_hash_backend.sha256_compress_x4 ==
+				         ts_SHA256_compress_x4_vector) {
+	    ts_hash_backend.sha256_compress_x4 = ts_SHA256_compress_x4_avx2;
+	}
+    }
+#endif
+}
+
+void ts_init_backends(void) {
+    pthread_once( &backends_once, probe_backends );
+}
+
+int ts_set_backend(int primitive, int backend) {
+    ts_init_backends();  /* Probe now, so a later ts_init_backends */
+                         /* doesn't override this */
+    switch (primitive) {
+    case TS_PRIM_SHA256:
+	switch (backend) {
+	case TS_BACKEND_SCALAR:
+	    ts_hash_backend.sha256_compress = ts_SHA256_compress_scalar;
+	    return 1;
+#if TS_HAVE_SHA_NI
+	case TS_BACKEND_SHA_NI:
+	    if (!cpu_has_sha_ni()) return 0;
+	    ts_hash_backend.sha256_compress = ts_SHA256_compress_sha_ni;
+	    return 1;
+#endif
+	}
+	return 0;
+    case TS_PRIM_SHA512:
+	if (backend != TS_BACKEND_SCALAR) return 0;
+	ts_hash_backend.sha512_compress = ts_SHA512_compress_scalar;
+	return 1;
+    case TS_PRIM_KECCAK:
+	if (backend != TS_BACKEND_SCALAR) return 0;
+	ts_hash_backend.keccak_permute = ts_keccak_permute_scalar;
+	return 1;
+#if TS_MULTI_LANE
+    case TS_PRIM_SHA256_X4:
+	switch (backend) {
+	case TS_BACKEND_SCALAR:
+	    ts_hash_backend.sha256_compress_x4 = ts_SHA256_compress_x4_scalar;
+	    return 1;
+#if TS_HAVE_VECTOR
+	case TS_BACKEND_VECTOR:
+	    ts_hash_backend.sha256_compress_x4 = ts_SHA256_compress_x4_vector;
+	    return 1;
+#endif
+#if TS_HAVE_AVX2
+	case TS_BACKEND_AVX2:
+	    if (!cpu_has_avx2()) return 0;
+	    ts_hash_backend.sha256_compress_x4 = ts_SHA256_compress_x4_avx2;
+	    return 1;
+#endif
+	}
+	return 0;
+    case TS_PRIM_KECCAK_X4:
+	switch (backend) {
+	case TS_BACKEND_SCALAR:
+	    ts_hash_backend.keccak_permute_x4 = ts_keccak_permute_x4_scalar;
+	    return 1;
+#if TS_HAVE_VECTOR
+	case TS_BACKEND_VECTOR:
+	    ts_hash_backend.keccak_permute_x4 = ts_keccak_permute_x4_vector;
+	    return 1;
+#endif
+#if TS_HAVE_AVX2
+	case TS_BACKEND_AVX2:
+	    if (!cpu_has_avx2()) return 0;
+	    ts_hash_backend.keccak_permute_x4 = ts_keccak_permute_x4_avx2;
+	    return 1;
+#endif
+	}
+	return 0;
+#endif
+    }
+    return 0;
+}
+
+int ts_get_backend(int primitive) {
+    switch (primitive) {
+    case TS_PRIM_SHA256:
+#if TS_HAVE_SHA_NI
+	if (ts_hash_backend.sha256_compress == ts_SHA256_compress_sha_ni) {
+	    return TS_BACKEND_SHA_NI;
+	}
+#endif
+	return TS_BACKEND_SCALAR;
+    case TS_PRIM_SHA512:
+    case TS_PRIM_KECCAK:
+	return TS_BACKEND_SCALAR;
+#if TS_MULTI_LANE
+    case TS_PRIM_SHA256_X4:
+#if TS_HAVE_AVX2
+	if (ts_hash_backend.sha256_compress_x4 == ts_SHA256_compress_x4_avx2) {
+	    return TS_BACKEND_AVX2;
+	}
+#endif
+#if TS_HAVE_VECTOR
+	if (ts_hash_backend.sha256_compress_x4 ==
+				           ts_SHA256_compress_x4_vector) {
+	    return TS_BACKEND_VECTOR;
+	}
+#endif
+	return TS_BACKEND_SCALAR;
+    case TS_PRIM_KECCAK_X4:
+#if TS_HAVE_AVX2
+	if (ts_hash_backend.keccak_permute_x4 == ts_keccak_permute_x4_avx2) {
+	    return TS_BACKEND_AVX2;
+	}
+#endif
+#if TS_HAVE_VECTOR
+	if (ts_hash_backend.keccak_permute_x4 == ts_keccak_permute_x4_vector) {
+	    return TS_BACKEND_VECTOR;
+	}
+#endif
+	return TS_BACKEND_SCALAR;
+#endif
+    }
+    return -1;
+}
+
+#else /* !TS_BACKEND_DISPATCH */
+
+/* No dispatch; we always use the scalar implementations (and the */
+/* four lane ones always use the vector code, if we have it) */
+#if TS_MULTI_LANE && TS_HAVE_VECTOR
+#define LANE_BACKEND TS_BACKEND_VECTOR
+#else
+#define LANE_BACKEND TS_BACKEND_SCALAR
+#endif
+
+void ts_init_backends(void) {
+    ;
+}
+
+int ts_set_backend(int primitive, int backend) {
+    int current = ts_get_backend(primitive);
+    return current >= 0 && backend == current;
+}
+
+int ts_get_backend(int primitive) {
+    if (primitive >= TS_PRIM_SHA256 && primitive <= TS_PRIM_KECCAK) {
+	return TS_BACKEND_SCALAR;
+    }
+#if TS_MULTI_LANE
+    if (primitive == TS_PRIM_SHA256_X4 || primitive == TS_PRIM_KECCAK_X4) {
+	return LANE_BACKEND;
+    }
+#endif
+    return -1;
+}
+
+#endif
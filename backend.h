@@ -0,0 +1,105 @@
+#if !defined( BACKEND_H_ )
+#define BACKEND_H_
+
+/*
+ * This is the table of hash backends (the low level compression functions
+ * that the SHA-256, SHA-512 and SHAKE-256 implementations call).  If
+ * TS_BACKEND_DISPATCH is set, these go through function pointers that
+ * ts_init_backends() sets to the fastest implementation this CPU supports;
+ * otherwise, the hash implementations call the scalar versions directly
+ *
+ * This is internal; the external API (ts_init_backends, ts_set_backend,
+ * ts_get_backend) is in tiny_sphincs.h
+ */
+
+#include <stdint.h>
+#include "tune.h"
+#include "sha2.h"
+
+/* The scalar (portable C) implementations; these are always present */
+void ts_SHA256_compress_scalar( SHA256_CTX *ctx, const void *buf );
+void ts_SHA512_compress_scalar( SHA512_CTX *ctx, const void *buf );
+void ts_keccak_permute_scalar( uint64_t *state );
+
+#if TS_MULTI_LANE
+/*
+ * The four lane versions (see hash_x4.c); these compute the first
+ * num_lanes of four independent compressions/permutations.  The state is
+ * interleaved (word i of lane j is at state[i][j]).  The _scalar versions
+ * just call the single lane backend once per lane; the _vector ones use
+ * the compiler's vector extensions (if it has them)
+ */
+#if defined( __GNUC__ )
+#define TS_HAVE_VECTOR 1
+#else
+#define TS_HAVE_VECTOR 0
+#endif
+void ts_SHA256_compress_x4_scalar( uint32_t state[8][4],
+		const unsigned char block[4][64], unsigned num_lanes );
+void ts_keccak_permute_x4_scalar( uint64_t state[25][4], unsigned num_lanes );
+#if TS_HAVE_VECTOR
+void ts_SHA256_compress_x4_vector( uint32_t state[8][4],
+		const unsigned char block[4][64], unsigned num_lanes );
+void ts_keccak_permute_x4_vector( uint64_t state[25][4], unsigned num_lanes );
+#endif
+#endif
+
+#if TS_BACKEND_DISPATCH
+
+/* The accelerated implementations; which ones exist depend on the platform */
+/* and compiler (see the TS_HAVE_xxx settings below) */
+#if defined( __x86_64__ ) && defined( __GNUC__ )
+#define TS_HAVE_SHA_NI 1
+void ts_SHA256_compress_sha_ni( SHA256_CTX *ctx, const void *buf );
+#else
+#define TS_HAVE_SHA_NI 0
+#endif
+#if TS_MULTI_LANE && TS_HAVE_VECTOR && defined( __x86_64__ )
+#define TS_HAVE_AVX2 1
+void ts_SHA256_compress_x4_avx2( uint32_t state[8][4],
+		const unsigned char block[4][64], unsigned num_lanes );
+void ts_keccak_permute_x4_avx2( uint64_t state[25][4], unsigned num_lanes );
+#else
+#define TS_HAVE_AVX2 0
+#endif
+
+struct ts_hash_backend {
+    void (*sha256_compress)( SHA256_CTX *ctx, const void *buf );
+    void (*sha512_compress)( SHA512_CTX *ctx, const void *buf );
+    void (*keccak_permute)( uint64_t *state );
+#if TS_MULTI_LANE
+    void (*sha256_compress_x4)( uint32_t state[8][4],
+		const unsigned char block[4][64], unsigned num_lanes );
+    void (*keccak_permute_x4)( uint64_t state[25][4], unsigned num_lanes );
+#endif
+};
+extern struct ts_hash_backend ts_hash_backend;
+
+#define TS_SHA256_COMPRESS(ctx, buf) ts_hash_backend.sha256_compress(ctx, buf)
+#define TS_SHA512_COMPRESS(ctx, buf) ts_hash_backend.sha512_compress(ctx, buf)
+#define TS_KECCAK_PERMUTE(state)     ts_hash_backend.keccak_permute(state)
+#define TS_SHA256_COMPRESS_X4(state, block, num) \
+                      ts_hash_backend.sha256_compress_x4(state, block, num)
+#define TS_KECCAK_PERMUTE_X4(state, num) \
+                      ts_hash_backend.keccak_permute_x4(state, num)
+
+#else
+
+#define TS_SHA256_COMPRESS(ctx, buf) ts_SHA256_compress_scalar(ctx, buf)
+#define TS_SHA512_COMPRESS(ctx, buf) ts_SHA512_compress_scalar(ctx, buf)
+#define TS_KECCAK_PERMUTE(state)     ts_keccak_permute_scalar(state)
+#if TS_HAVE_VECTOR
+#define TS_SHA256_COMPRESS_X4(state, block, num) \
+                      ts_SHA256_compress_x4_vector(state, block, num)
+#define TS_KECCAK_PERMUTE_X4(state, num) \
+                      ts_keccak_permute_x4_vector(state, num)
+#else
+#define TS_SHA256_COMPRESS_X4(state, block, num) \
+                      ts_SHA256_compress_x4_scalar(state, block, num)
+#define TS_KECCAK_PERMUTE_X4(state, num) \
+                      ts_keccak_permute_x4_scalar(state, num)
+#endif
+
+#endif
+
+#endif /* BACKEND_H_ */
@@ -0,0 +1,203 @@
+/*
+ * Batch verification of files; see batch_verify.h
+ *
+ * We sort the items by artifact size, and deal them out (largest first)
+ * to per-thread queues.  Each thread works through its own queue from the
+ * front (so it does its biggest items first); once that's empty, it steals
+ * from the back of someone else's.  Nothing adds work once we've started,
+ * so a thread that finds every queue empty is done
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "batch_verify.h"
+
+#define MAX_THREADS 64
+#define CHUNK (64*1024)     /* How much signature we read at a time */
+
+struct queue {
+    pthread_mutex_t lock;       /* Protects head and tail */
+    unsigned *order;            /* The item indices this queue owns */
+    unsigned head, tail;        /* The ones in [head, tail) are left */
+};
+
+struct batch_job {
+    struct ts_batch_item *items;
+    struct queue queue[ MAX_THREADS ];
+    unsigned num_threads;
+    unsigned next_thread;       /* Which queue the next thread owns */
+    unsigned num_valid;
+    pthread_mutex_t lock;       /* Protects next_thread and num_valid */
+};
+
+static enum ts_batch_result verify_item( struct ts_batch_item *item,
+			    struct ts_context *ctx, unsigned char *buffer ) {
+    int fd = open( item->artifact, O_RDONLY );
+    struct stat st;
+    if (fd < 0) return ts_batch_error;
+    if (0 != fstat( fd, &st )) {
+	close( fd );
+	return ts_batch_error;
+    }
+    size_t len = st.st_size;
+    const unsigned char *message = (const unsigned char *)"";
+    if (len > 0) {      /* mmap won't map nothing */
+	void *p = mmap( 0, len, PROT_READ, MAP_PRIVATE, fd, 0 );
+	if (p == MAP_FAILED) {
+	    close( fd );
+	    return ts_batch_error;
+	}
+	madvise( p, len, MADV_SEQUENTIAL );
+	message = p;
+    }
+    close( fd );
+    item->size = len;
+
+    enum ts_batch_result result = ts_batch_error;
+    FILE *f = fopen( item->signature, "rb" );
+    if (f) {
+	ts_init_verify( ctx, message, len, item->ps, item->public_key );
+	for (;;) {
+	    size_t n = fread( buffer, 1, CHUNK, f );
+	    if (n == 0 || !ts_update_verify( buffer, n, ctx )) break;
+	}
+	if (!ferror( f )) {
+	    result = ts_verify( ctx ) ? ts_batch_valid : ts_batch_invalid;
+	}
+	fclose( f );
+    }
+    if (len > 0) munmap( (void *)message, len );
+    return result;
+}
+
+/*
+ * Get the next item for thread self: the front of its own queue, or else
+ * the back of the first nonempty queue after it.  Returns 0 if there's
+ * nothing left
+ */
+static int next_item( struct batch_job *job, unsigned self,
+		      unsigned *index ) {
+    for (unsigned i = 0; i < job->num_threads; i++) {
+	struct queue *q = &job->queue[ (self + i) % job->num_threads ];
+	int found = 0;
+	pthread_mutex_lock( &q->lock );
+	if (q->head < q->tail) {
+	    *index = (i == 0) ? q->order[ q->head++ ] : q->order[ --q->tail ];
+	    found = 1;
+	}
+	pthread_mutex_unlock( &q->lock );
+	if (found) return 1;
+    }
+    return 0;
+}
+
+static void *batch_worker( void *arg ) {
+    struct batch_job *job = arg;
+    struct ts_context ctx;
+    unsigned char *buffer = malloc( CHUNK );
+
+    pthread_mutex_lock( &job->lock );
+    unsigned self = job->next_thread++;
+    pthread_mutex_unlock( &job->lock );
+
+    unsigned num_valid = 0;
+    unsigned i;
+    while (next_item( job, self, &i )) {
+	struct ts_batch_item *item = &job->items[i];
+	item->result = buffer ? verify_item( item, &ctx, buffer ) :
+				ts_batch_error;
+	if (item->result == ts_batch_valid) num_valid++;
+    }
+
+    pthread_mutex_lock( &job->lock );
+    job->num_valid += num_valid;
+    pthread_mutex_unlock( &job->lock );
+    free( buffer );
+    return 0;
+}
+
+static struct ts_batch_item *sort_items;
+static int by_size( const void *a, const void *b ) {
+    unsigned long long x = sort_items[ *(const unsigned *)a ].size;
+    unsigned long long y = sort_items[ *(const unsigned *)b ].size;
+    return (x < y) - (x > y);    /* Largest first */
+}
+
+unsigned ts_verify_batch( struct ts_batch_item *items, unsigned count,
+			  unsigned num_threads ) {
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS;
+    if (num_threads > count) num_threads = count;
+    if (count == 0) return 0;
+
+    /* Find out how big everything is, and put the biggest first */
+    unsigned *sorted = malloc( count * sizeof *sorted );
+    unsigned *order = malloc( count * sizeof *order );
+    if (!sorted || !order) {
+	free( sorted );
+	free( order );
+	for (unsigned i = 0; i < count; i++) items[i].result = ts_batch_error;
+	return 0;
+    }
+    for (unsigned i = 0; i < count; i++) {
+	struct stat st;
+	items[i].size = (0 == stat( items[i].artifact, &st )) ? st.st_size : 0;
+	items[i].result = ts_batch_error;
+	sorted[i] = i;
+    }
+    static pthread_mutex_t sort_lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_mutex_lock( &sort_lock );   /* qsort has no context argument */
+    sort_items = items;
+    qsort( sorted, count, sizeof *sorted, by_size );
+    pthread_mutex_unlock( &sort_lock );
+
+    /* Deal them out; queue t gets the t-th, (t+num_threads)-th, ... */
+    /* biggest items, in that order */
+    struct batch_job job;
+    job.items = items;
+    job.num_threads = num_threads;
+    job.next_thread = 0;
+    job.num_valid = 0;
+    pthread_mutex_init( &job.lock, 0 );
+    unsigned next = 0;
+    for (unsigned t = 0; t < num_threads; t++) {
+	struct queue *q = &job.queue[t];
+	pthread_mutex_init( &q->lock, 0 );
+	q->order = &order[next];
+	q->head = 0;
+	for (unsigned i = t; i < count; i += num_threads) {
+	    order[next++] = sorted[i];
+	}
+	q->tail = &order[next] - q->order;
+    }
+    free( sorted );
+
+    /* Once, from this thread; see ts_init_backends */
+    ts_init_backends();
+
+    /* If we can't start a thread, its queue just gets stolen from */
+    pthread_t threads[ MAX_THREADS ];
+    unsigned started = 0;
+    for (unsigned i = 1; i < num_threads; i++) {
+	if (0 != pthread_create( &threads[started], 0, batch_worker, &job )) {
+	    break;
+	}
+	started++;
+    }
+    batch_worker( &job );
+    for (unsigned i = 0; i < started; i++) {
+	pthread_join( threads[i], 0 );
+    }
+
+    for (unsigned t = 0; t < num_threads; t++) {
+	pthread_mutex_destroy( &job.queue[t].lock );
+    }
+    pthread_mutex_destroy( &job.lock );
+    free( order );
+    return job.num_valid;
+}
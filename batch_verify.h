@@ -0,0 +1,43 @@
+#if !defined( BATCH_VERIFY_H_ )
+#define BATCH_VERIFY_H_
+
+/*
+ * Verification of a large number of (file, detached signature file) pairs,
+ * e.g. the artifacts of a release.  As with verify_mt.h, this is meant for
+ * hosts; it uses POSIX threads and the file system, and so isn't part of
+ * the core package
+ */
+
+#include "tiny_sphincs.h"
+
+enum ts_batch_result {
+    ts_batch_valid,             /* The signature verified */
+    ts_batch_invalid,           /* It didn't */
+    ts_batch_error,             /* We couldn't read one of the files */
+};
+
+struct ts_batch_item {
+    /* Set by the caller */
+    const char *artifact;       /* The file that was signed */
+    const char *signature;      /* The file that holds its signature */
+    const struct ts_parameter_set *ps;
+    const unsigned char *public_key;
+
+    /* Filled in by ts_verify_batch */
+    enum ts_batch_result result;
+    unsigned long long size;    /* The size of the artifact */
+};
+
+/*
+ * This verifies count items, spread across num_threads threads (including
+ * the calling one; at most 64), each with its own ts_context.  Artifacts
+ * are memory mapped, and signatures are read in (and passed to
+ * ts_update_verify) in large chunks.
+ * The largest artifacts are started first, so that they don't hold things
+ * up at the end; threads that run out of work steal it from the others.
+ * This returns the number of items that verified
+ */
+unsigned ts_verify_batch( struct ts_batch_item *items, unsigned count,
+			  unsigned num_threads );
+
+#endif /* BATCH_VERIFY_H_ */
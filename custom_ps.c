@@ -0,0 +1,90 @@
+/*
+ * Building parameter sets at runtime; see ts_make_parameter_set in
+ * tiny_sphincs.h
+ *
+ * The hash functions depend only on the hash family and n (they get
+ * everything else, such as the length of H_msg, from the context), so we
+ * borrow them from a built in parameter set with the same family and n,
+ * and fill in the rest.  What we do check is that the context (whose
+ * arrays tune.h sizes) has room for what the parameter set needs
+ */
+#include <string.h>
+#include <stdint.h>
+#include "tiny_sphincs.h"
+#include "internal.h"
+
+size_t ts_parameter_set_size(void) {
+    return sizeof(struct ts_parameter_set);
+}
+
+#if TS_CUSTOM_PS
+/* The number of base w digits in the value */
+static unsigned num_digits( unsigned value, unsigned log_w ) {
+    unsigned count = 0;
+    for (; value > 0; value >>= log_w) count++;
+    return count;
+}
+
+/* A built in parameter set with this family and n */
+static const struct ts_parameter_set *find_base( unsigned n, int sha2 ) {
+    for (unsigned id = 1; id <= 12; id++) {
+	const struct ts_parameter_set *ps = ts_id_to_ps( id );
+	if (ps && PS_N(ps) == n && !PS_SHA2(ps) == !sha2) return ps;
+    }
+    return 0;
+}
+#endif
+
+const struct ts_parameter_set *ts_make_parameter_set(
+                   void *buffer, size_t len_buffer,
+                   unsigned n, unsigned h, unsigned d, unsigned k,
+                   unsigned t, unsigned w, int hash_family ) {
+#if TS_CUSTOM_PS
+    if (!buffer || len_buffer < sizeof(struct ts_parameter_set) ||
+	    (uintptr_t)buffer % TS_CONTEXT_ALIGN != 0) {
+	return 0;
+    }
+    if (hash_family != TS_HASH_SHAKE && hash_family != TS_HASH_SHA2) {
+	return 0;
+    }
+    const struct ts_parameter_set *base =
+	                find_base( n, hash_family == TS_HASH_SHA2 );
+    if (!base) return 0;   /* Unsupported n, or hash family */
+
+    unsigned log_w;
+    switch (w) {
+    case 4:   log_w = 2; break;
+    case 16:  log_w = 4; break;
+    case 256: log_w = 8; break;
+    default: return 0;
+    }
+    unsigned len_1 = 8*n / log_w;
+    unsigned wots_len = len_1 + num_digits( len_1 * (w-1), log_w );
+
+    /* Does this fit into the context, and the address structure? */
+    if (d < 1 || h % d != 0 || h / d < 1 || h / d > TS_MAX_MERKLE_H) {
+	return 0;
+    }
+    if (h - h/d > 64) return 0;       /* The tree address is 64 bits */
+    if (k < 1 || k > TS_MAX_FORS || t < 1 || t > TS_MAX_T) return 0;
+    if (wots_len > TS_MAX_WOTS_DIGITS) return 0;
+    if ((k*t + 7)/8 + (h - h/d + 7)/8 + (h/d + 7)/8 > MAX_MESSAGE_HASH) {
+	return 0;
+    }
+
+    struct ts_parameter_set *ps = buffer;
+    *ps = *base;
+    ps->k = k;
+    ps->t = t;
+    ps->h = h;
+    ps->d = d;
+    ps->merkle_h = h / d;
+    ps->log_w = log_w;
+    ps->wots_len = wots_len;
+    return ps;
+#else
+    (void)buffer; (void)len_buffer; (void)n; (void)h; (void)d; (void)k;
+    (void)t; (void)w; (void)hash_family;
+    return 0;
+#endif
+}
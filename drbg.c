@@ -0,0 +1,202 @@
+/*
+ * The DRBG that serves OptRand; see drbg.h
+ */
+#include <string.h>
+#include "drbg.h"
+#include "sha2.h"
+#include "fips202.h"
+
+/*
+ * Zeroize something that held key material; use a volatile pointer, so
+ * this isn't optimized away
+ */
+static void zeroize( void *p, size_t len ) {
+    volatile unsigned char *q = p;
+    while (len--) *q++ = 0;
+}
+
+#if TS_SUPPORT_SHA2
+/*
+ * HMAC_DRBG (SP 800-90A, section 10.1.2) with SHA-256
+ */
+
+/* Start HMAC(key, ...); the key is always 32 bytes */
+static void hmac_start( SHA256_CTX *ctx, const unsigned char *key ) {
+    unsigned char pad[ sha256_block_size ];
+    memset( pad, 0x36, sizeof pad );
+    for (int i=0; i<32; i++) pad[i] ^= key[i];
+    ts_SHA256_init( ctx );
+    ts_SHA256_update( ctx, pad, sizeof pad );
+    zeroize( pad, sizeof pad );
+}
+
+/* Finish it; output may be the key */
+static void hmac_finish( unsigned char *output, SHA256_CTX *ctx,
+			 const unsigned char *key ) {
+    unsigned char pad[ sha256_block_size ], inner[32];
+    memset( pad, 0x5c, sizeof pad );
+    for (int i=0; i<32; i++) pad[i] ^= key[i];
+    ts_SHA256_final( inner, ctx );
+    ts_SHA256_init( ctx );
+    ts_SHA256_update( ctx, pad, sizeof pad );
+    ts_SHA256_update( ctx, inner, sizeof inner );
+    ts_SHA256_final( output, ctx );
+    zeroize( pad, sizeof pad );
+    zeroize( inner, sizeof inner );
+}
+
+/* V = HMAC(K, V) */
+static void next_v( struct ts_drbg *drbg ) {
+    SHA256_CTX ctx;
+    hmac_start( &ctx, drbg->key );
+    ts_SHA256_update( &ctx, drbg->v, 32 );
+    hmac_finish( drbg->v, &ctx, drbg->key );
+    zeroize( &ctx, sizeof ctx );
+}
+
+/*
+ * HMAC_DRBG_Update, with the provided data given in two parts (either of
+ * which may be empty)
+ */
+static void update( struct ts_drbg *drbg,
+		    const unsigned char *a, size_t len_a,
+		    const unsigned char *b, size_t len_b ) {
+    for (unsigned char round = 0; round < 2; round++) {
+	SHA256_CTX ctx;
+	hmac_start( &ctx, drbg->key );
+	ts_SHA256_update( &ctx, drbg->v, 32 );
+	ts_SHA256_update( &ctx, &round, 1 );
+	ts_SHA256_update( &ctx, a, len_a );
+	ts_SHA256_update( &ctx, b, len_b );
+	hmac_finish( drbg->key, &ctx, drbg->key );
+	zeroize( &ctx, sizeof ctx );
+	next_v( drbg );
+	if (len_a + len_b == 0) break;
+    }
+}
+
+static void instantiate( struct ts_drbg *drbg, const unsigned char *seed,
+			 const void *personalization, size_t len ) {
+    memset( drbg->key, 0x00, 32 );
+    memset( drbg->v, 0x01, 32 );
+    update( drbg, seed, TS_DRBG_SEED_LEN, personalization, len );
+}
+
+static void reseed( struct ts_drbg *drbg, const unsigned char *seed,
+		    size_t len_seed ) {
+    update( drbg, seed, len_seed, 0, 0 );
+}
+
+static void generate( struct ts_drbg *drbg, unsigned char *output,
+		      size_t len ) {
+    while (len > 0) {
+	size_t this_len = len < 32 ? len : 32;
+	next_v( drbg );
+	memcpy( output, drbg->v, this_len );
+	output += this_len;
+	len -= this_len;
+    }
+    update( drbg, 0, 0, 0, 0 );
+}
+
+#else
+/*
+ * The SHAKE256 version; the state is key || v
+ */
+
+/* Replace the state with SHAKE256( tag || state? || data ), and */
+/* squeeze len bytes of output after it */
+static void absorb_state( struct ts_drbg *drbg, unsigned char tag,
+			  int include_state,
+			  const unsigned char *a, size_t len_a,
+			  const unsigned char *b, size_t len_b,
+			  unsigned char *output, size_t len ) {
+    SHAKE256_CTX ctx;
+    ts_shake256_inc_init( &ctx );
+    ts_shake256_inc_absorb( &ctx, &tag, 1 );
+    if (include_state) {
+	ts_shake256_inc_absorb( &ctx, drbg->key, 32 );
+	ts_shake256_inc_absorb( &ctx, drbg->v, 32 );
+    }
+    if (len_a) ts_shake256_inc_absorb( &ctx, a, len_a );
+    if (len_b) ts_shake256_inc_absorb( &ctx, b, len_b );
+    ts_shake256_inc_finalize( &ctx );
+    ts_shake256_inc_squeeze( drbg->key, 32, &ctx );
+    ts_shake256_inc_squeeze( drbg->v, 32, &ctx );
+    if (len) ts_shake256_inc_squeeze( output, len, &ctx );
+    zeroize( &ctx, sizeof ctx );
+}
+
+static void instantiate( struct ts_drbg *drbg, const unsigned char *seed,
+			 const void *personalization, size_t len ) {
+    absorb_state( drbg, 0x00, 0, seed, TS_DRBG_SEED_LEN,
+		  personalization, len, 0, 0 );
+}
+
+static void reseed( struct ts_drbg *drbg, const unsigned char *seed,
+		    size_t len_seed ) {
+    absorb_state( drbg, 0x01, 1, seed, len_seed, 0, 0, 0, 0 );
+}
+
+static void generate( struct ts_drbg *drbg, unsigned char *output,
+		      size_t len ) {
+    absorb_state( drbg, 0x02, 1, 0, 0, 0, 0, output, len );
+}
+#endif
+
+int ts_drbg_init( struct ts_drbg *drbg,
+	          int (*random_function)(unsigned char *, size_t),
+		  unsigned long reseed_interval,
+		  const void *personalization, size_t len_personalization ) {
+    unsigned char seed[ TS_DRBG_SEED_LEN ];
+    memset( drbg, 0, sizeof *drbg );
+    if (!random_function || !random_function( seed, sizeof seed )) {
+	return 0;
+    }
+    if (!personalization) len_personalization = 0;
+    instantiate( drbg, seed, personalization, len_personalization );
+    zeroize( seed, sizeof seed );
+    drbg->random_function = random_function;
+    drbg->reseed_interval = reseed_interval ? reseed_interval :
+			                      TS_DRBG_DEFAULT_RESEED;
+    drbg->seeded = 1;
+    return 1;
+}
+
+int ts_drbg_reseed( struct ts_drbg *drbg,
+		    const unsigned char *seed, size_t len_seed ) {
+    unsigned char buffer[ TS_DRBG_SEED_LEN ];
+    if (!drbg->seeded) return 0;
+    if (!seed) {
+	if (!drbg->random_function ||
+	    !drbg->random_function( buffer, sizeof buffer )) {
+	    return 0;
+	}
+	seed = buffer;
+	len_seed = sizeof buffer;
+    }
+    reseed( drbg, seed, len_seed );
+    zeroize( buffer, sizeof buffer );
+    drbg->requests = 0;
+    drbg->reseeds++;
+    return 1;
+}
+
+int ts_drbg_reseed_due( const struct ts_drbg *drbg ) {
+    return drbg->requests >= drbg->reseed_interval;
+}
+
+int ts_drbg_generate( struct ts_drbg *drbg, unsigned char *output,
+		      size_t len ) {
+    if (!drbg->seeded || len > TS_DRBG_MAX_REQUEST) return 0;
+    if (ts_drbg_reseed_due( drbg ) && !ts_drbg_reseed( drbg, 0, 0 )) {
+	return 0;
+    }
+    generate( drbg, output, len );
+    drbg->requests++;
+    return 1;
+}
+
+void ts_drbg_clear( struct ts_drbg *drbg ) {
+    zeroize( drbg, sizeof *drbg );
+}
@@ -0,0 +1,97 @@
+#if !defined( DRBG_H_ )
+#define DRBG_H_
+
+/*
+ * A deterministic random bit generator, for the random_function that
+ * ts_init_sign uses to get OptRand.
+ *
+ * A randomized signature asks the random_function for n bytes each time;
+ * if that's a read from a slow hardware TRNG, it can be a good part of the
+ * time it takes to sign a short message.  This instead takes a seed from
+ * the random_function (TS_DRBG_SEED_LEN bytes in one call) when it's set
+ * up, and then again every reseed_interval requests, and serves the
+ * requests in between from that.  If the package supports SHA-2 parameter
+ * sets, this is HMAC_DRBG with SHA-256 (SP 800-90A; the seed is the entropy
+ * input and the nonce), otherwise it's built on SHAKE256 (the state is 64
+ * bytes; instantiating hashes 0x00 || seed || personalization into it,
+ * reseeding hashes 0x01 || state || seed, and a request hashes
+ * 0x02 || state, and squeezes the new state, and then the output).
+ *
+ * This is meant to be used this way:
+ *
+ * static struct ts_drbg drbg;
+ * static int drbg_random( unsigned char *p, size_t len ) {
+ *     return ts_drbg_generate( &drbg, p, len );
+ * }
+ * ...
+ * ts_drbg_init( &drbg, trng_read, 0, "my hsm", 6 );
+ * ...
+ * ts_init_sign( &ctx, message, len_message, ps, private_key, drbg_random );
+ *
+ * A struct ts_drbg is not safe to share between threads; a host with
+ * several signing threads should use drbg_async.h instead (which also
+ * fetches the next seed in the background).  If the random_function fails
+ * when a reseed is due, ts_drbg_generate fails (and so ts_init_sign falls
+ * back to the deterministic signature, as it does when the random_function
+ * itself fails), and tries again on the next request.
+ *
+ * SECURITY NOTE: the state determines every output until the next reseed;
+ * it should be as well protected as the private key (and cleared with
+ * ts_drbg_clear when you're done).  And if the process forks, the child
+ * gets a copy of the state; reseed it (with ts_drbg_reseed) before use.
+ */
+
+#include <stddef.h>
+#include "tiny_sphincs.h"
+
+#define TS_DRBG_SEED_LEN        48   /* What we ask the random_function */
+                                     /* for, each (re)seed */
+#define TS_DRBG_DEFAULT_RESEED  1024 /* Requests between reseeds, if the */
+                                     /* reseed_interval is 0 */
+#define TS_DRBG_MAX_REQUEST     65536 /* Most bytes per ts_drbg_generate */
+
+struct ts_drbg {
+    unsigned char key[32], v[32];    /* The state (K and V for HMAC_DRBG) */
+    unsigned long requests;          /* Requests since the last reseed */
+    unsigned long reseed_interval;
+    int (*random_function)(unsigned char *, size_t);
+    int seeded;
+    unsigned long reseeds;           /* Statistics */
+};
+
+/*
+ * Set up the DRBG, with an initial seed from the random_function (which
+ * is also where the reseeds come from), and an optional personalization
+ * string (which may be NULL; e.g. something that distinguishes this
+ * device).  A reseed_interval of 0 means TS_DRBG_DEFAULT_RESEED.
+ * This returns 1 on success, 0 if the random_function failed
+ */
+int ts_drbg_init( struct ts_drbg *drbg,
+	          int (*random_function)(unsigned char *, size_t),
+		  unsigned long reseed_interval,
+		  const void *personalization, size_t len_personalization );
+
+/*
+ * Fill the buffer with len bytes (at most TS_DRBG_MAX_REQUEST), reseeding
+ * first if it's due.  This has the same return value as a random_function
+ * (1 on success, 0 on failure), so a one line wrapper (see above) can be
+ * passed to ts_init_sign
+ */
+int ts_drbg_generate( struct ts_drbg *drbg, unsigned char *output,
+		      size_t len );
+
+/*
+ * Reseed now.  If seed is NULL, this takes TS_DRBG_SEED_LEN bytes from
+ * the random_function; otherwise it uses the len_seed bytes given (which
+ * should come from a source at least as good).  This returns 1 on success
+ */
+int ts_drbg_reseed( struct ts_drbg *drbg,
+		    const unsigned char *seed, size_t len_seed );
+
+/* Is the next ts_drbg_generate going to reseed? */
+int ts_drbg_reseed_due( const struct ts_drbg *drbg );
+
+/* Zeroize the DRBG */
+void ts_drbg_clear( struct ts_drbg *drbg );
+
+#endif /* DRBG_H_ */
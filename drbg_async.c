@@ -0,0 +1,115 @@
+/*
+ * A DRBG shared between threads, reseeded in the background; see
+ * drbg_async.h
+ *
+ * The thread sleeps until the seed it fetched has been used (or we're
+ * stopping), and then fetches the next one, without holding the lock (the
+ * random_function may take a while).  A caller that finds a reseed due
+ * uses that seed if it's there; otherwise it fetches one itself, also
+ * without holding the lock (so the other callers aren't stuck behind it),
+ * and then looks again: another caller (or the thread) may have reseeded
+ * in the meantime, in which case the seed it fetched goes unused
+ */
+#include <string.h>
+#include "drbg_async.h"
+
+/* Use a volatile pointer, so this isn't optimized away */
+static void zeroize( void *p, size_t len ) {
+    volatile unsigned char *q = p;
+    while (len--) *q++ = 0;
+}
+
+static void *seed_thread( void *arg ) {
+    struct ts_drbg_async *a = arg;
+    unsigned char seed[ TS_DRBG_SEED_LEN ];
+
+    pthread_mutex_lock( &a->lock );
+    while (!a->stop) {
+	if (a->have_seed) {
+	    pthread_cond_wait( &a->cond, &a->lock );
+	    continue;
+	}
+	pthread_mutex_unlock( &a->lock );
+	int ok = a->drbg.random_function( seed, sizeof seed );
+	pthread_mutex_lock( &a->lock );
+	if (!ok) {
+	    /* Leave it to the callers (which'll fail until it recovers), */
+	    /* and try again when the next seed is used */
+	    pthread_cond_wait( &a->cond, &a->lock );
+	    continue;
+	}
+	memcpy( a->seed, seed, sizeof seed );
+	a->have_seed = 1;
+    }
+    pthread_mutex_unlock( &a->lock );
+    zeroize( seed, sizeof seed );
+    return 0;
+}
+
+int ts_drbg_async_init( struct ts_drbg_async *a,
+	          int (*random_function)(unsigned char *, size_t),
+		  unsigned long reseed_interval,
+		  const void *personalization, size_t len_personalization ) {
+    memset( a, 0, sizeof *a );
+    pthread_mutex_init( &a->lock, 0 );
+    pthread_cond_init( &a->cond, 0 );
+    if (!ts_drbg_init( &a->drbg, random_function, reseed_interval,
+		       personalization, len_personalization )) {
+	return 0;
+    }
+    a->have_thread = (0 == pthread_create( &a->thread, 0, seed_thread, a ));
+    return 1;
+}
+
+int ts_drbg_async_generate( struct ts_drbg_async *a,
+			    unsigned char *output, size_t len ) {
+    unsigned char seed[ TS_DRBG_SEED_LEN ];
+    int fetched = 0, ok = 0;
+    pthread_mutex_lock( &a->lock );
+    if (!a->drbg.seeded) goto done;
+    while (ts_drbg_reseed_due( &a->drbg )) {
+	if (a->have_seed) {
+	    if (!ts_drbg_reseed( &a->drbg, a->seed, sizeof a->seed )) {
+		goto done;
+	    }
+	    zeroize( a->seed, sizeof a->seed );
+	    a->have_seed = 0;
+	    a->prefetched++;
+	    pthread_cond_signal( &a->cond );  /* Go get the next one */
+	    break;
+	}
+	if (fetched) {
+	    if (!ts_drbg_reseed( &a->drbg, seed, sizeof seed )) goto done;
+	    break;
+	}
+
+	/* The thread may have given up on a failure; have it try again, */
+	/* and fetch one ourselves in the meantime (without the lock) */
+	pthread_cond_signal( &a->cond );
+	pthread_mutex_unlock( &a->lock );
+	fetched = a->drbg.random_function( seed, sizeof seed );
+	pthread_mutex_lock( &a->lock );
+	if (!fetched) goto done;
+    }
+    ok = ts_drbg_generate( &a->drbg, output, len );
+done:
+    pthread_mutex_unlock( &a->lock );
+    zeroize( seed, sizeof seed );
+    return ok;
+}
+
+void ts_drbg_async_stop( struct ts_drbg_async *a ) {
+    if (a->have_thread) {
+	pthread_mutex_lock( &a->lock );
+	a->stop = 1;
+	pthread_cond_signal( &a->cond );
+	pthread_mutex_unlock( &a->lock );
+	pthread_join( a->thread, 0 );
+    }
+    pthread_mutex_destroy( &a->lock );
+    pthread_cond_destroy( &a->cond );
+    ts_drbg_clear( &a->drbg );
+    zeroize( a->seed, sizeof a->seed );
+    a->have_seed = 0;
+    a->have_thread = 0;
+}
@@ -0,0 +1,72 @@
+#if !defined( DRBG_ASYNC_H_ )
+#define DRBG_ASYNC_H_
+
+/*
+ * The DRBG of drbg.h, shared between threads, with the reseeds fetched in
+ * the background.
+ *
+ * Even with a DRBG, every reseed_interval'th signature waits for the
+ * random_function.  This has a thread that fetches the next seed ahead of
+ * time (as soon as the last one has been used), so that when a reseed is
+ * due, the seed is already there; only if it isn't (the random_function
+ * is slower than the signers) does the caller fetch one itself (without
+ * holding the lock, so the other callers carry on meanwhile).  The DRBG
+ * is behind a lock, so any number of threads can use it at once:
+ *
+ * static struct ts_drbg_async drbg;
+ * static int drbg_random( unsigned char *p, size_t len ) {
+ *     return ts_drbg_async_generate( &drbg, p, len );
+ * }
+ * ...
+ * ts_drbg_async_init( &drbg, getentropy_wrapper, 0, 0, 0 );
+ * ...
+ * ts_init_sign( &ctx, message, len_message, ps, private_key, drbg_random );
+ * ...
+ * ts_drbg_async_stop( &drbg );
+ *
+ * The random_function may be called from the background thread and a
+ * signing thread at the same time, so it has to be thread safe.  As with
+ * verify_async.h, this uses POSIX threads, and so is host only
+ */
+
+#include <stddef.h>
+#include <pthread.h>
+#include "drbg.h"
+
+struct ts_drbg_async {
+    /* All of this is private */
+    struct ts_drbg drbg;
+    unsigned char seed[ TS_DRBG_SEED_LEN ];  /* The next seed */
+    int have_seed;             /* Set if seed is ready for use */
+    int stop;                  /* Tells the thread to exit */
+    int have_thread;           /* Clear if the thread couldn't be started */
+                               /* (then we just reseed in the caller) */
+    pthread_t thread;
+    pthread_mutex_t lock;      /* Protects all the above */
+    pthread_cond_t cond;       /* Signaled when the seed has been used */
+    unsigned long prefetched;  /* Statistics: reseeds that used a seed */
+                               /* the thread fetched */
+};
+
+/*
+ * Set up the DRBG (taking its initial seed from the random_function, in
+ * the calling thread) and start the background thread.  The parameters
+ * are as for ts_drbg_init; this returns 1 on success, 0 if the
+ * random_function failed
+ */
+int ts_drbg_async_init( struct ts_drbg_async *drbg,
+	          int (*random_function)(unsigned char *, size_t),
+		  unsigned long reseed_interval,
+		  const void *personalization, size_t len_personalization );
+
+/* ts_drbg_generate, for any thread */
+int ts_drbg_async_generate( struct ts_drbg_async *drbg,
+			    unsigned char *output, size_t len );
+
+/*
+ * Stop the background thread, and zeroize the DRBG.  This must be called
+ * (once no thread is using the DRBG), even if ts_drbg_async_init failed
+ */
+void ts_drbg_async_stop( struct ts_drbg_async *drbg );
+
+#endif /* DRBG_ASYNC_H_ */
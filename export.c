@@ -0,0 +1,493 @@
+/*
+ * Exporting a context to a blob, and importing it back in, and forking a
+ * context in memory; see ts_context_export and ts_context_fork in
+ * tiny_sphincs.h
+ *
+ * The blob is:
+ *   0  - 3   "TSCX"
+ *   4        Version (2)
+ *   5        The parameter set (TS_PS_xxx)
+ *   6        Flags (HAD_WOTS_BUFFER, NEEDS_MESSAGE, SIGNER)
+ *   7        Zero
+ *   8  - 11  sizeof(struct ts_context), big endian
+ *   12 - 15  ts_context_size(ps), big endian
+ *   16 - 19  0x01020304, in our byte order
+ *   20 - 23  Zero
+ *   24 - 31  The length of the message, big endian (if the verifier
+ *            still needs it, that is, NEEDS_MESSAGE is set; 0 otherwise)
+ *   32 -     The public key (2n bytes)
+ *   And then the context (ts_context_size(ps) bytes), with the pointers
+ *   zeroed out, followed by the WOTS digits the verifier had collected
+ *   in its WOTS buffer (n bytes each), if HAD_WOTS_BUFFER is set and it's
+ *   in the middle of a WOTS signature.  A signer has no digits; instead,
+ *   its blob ends with a MAC (n bytes) over everything before it
+ *
+ * The MAC is PRF_msg (keyed with SK.prf), with an all zero opt_rand, just
+ * as the MAC on the roots we hand the node cache; the "TSCX" that starts
+ * the blob keeps the two apart.  Without it, whoever could modify a blob
+ * could have the signer resume at some other state or address, and sign
+ * with a one-time key it had already used.  Verifier blobs have no secret
+ * to key a MAC with, and so nothing stops a modified one from making the
+ * verifier accept a signature it shouldn't (once it has R, the blob holds
+ * the message digest rather than the message, and the running hashes
+ * could be anything).  What the import does check is that every index and
+ * counter in the state is in range for the parameter set, so that even a
+ * modified blob can't have the verifier read or write outside the
+ * context; and it refuses a verifier that has already finished.  Beyond
+ * that, verifier blobs have to be kept in storage you trust
+ *
+ * The sizes and the byte order marker are there so that a build that
+ * would lay out the context differently refuses the blob, rather than
+ * misreading it.  The context is otherwise copied as is (including the
+ * hash states in the iterators), as that's what it'll be resumed from
+ */
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "tiny_sphincs.h"
+#include "internal.h"
+#include "endian.h"
+
+#define HEADER_SIZE       32
+#define VERSION           2
+#define HAD_WOTS_BUFFER   0x01  /* The verifier had a WOTS buffer */
+#define NEEDS_MESSAGE     0x02  /* The verifier hasn't hashed the */
+                                /* message yet */
+#define SIGNER            0x04  /* It's a signer (and so has a MAC) */
+
+/*
+ * The parameter sets we know, by number (a parameter set built at runtime
+ * doesn't have one)
+ */
+#define ENTRY(id, name) { id, &ts_ps_##name }
+static const struct {
+    unsigned char id;
+    const struct ts_parameter_set *ps;
+} parameter_sets[] = {
+#if TS_SUPPORT_SHAKE && TS_PS_ENABLED(TS_PS_SHAKE_128F_SIMPLE)
+    ENTRY(TS_PS_SHAKE_128F_SIMPLE, shake_128f_simple),
+#endif
+#if TS_SUPPORT_SHAKE && TS_SUPPORT_S && TS_PS_ENABLED(TS_PS_SHAKE_128S_SIMPLE)
+    ENTRY(TS_PS_SHAKE_128S_SIMPLE, shake_128s_simple),
+#endif
+#if TS_SUPPORT_SHAKE && (TS_SUPPORT_L3 || TS_SUPPORT_L5) && \
+    TS_PS_ENABLED(TS_PS_SHAKE_192F_SIMPLE)
+    ENTRY(TS_PS_SHAKE_192F_SIMPLE, shake_192f_simple),
+#endif
+#if TS_SUPPORT_SHAKE && TS_SUPPORT_S && (TS_SUPPORT_L3 || TS_SUPPORT_L5) && \
+    TS_PS_ENABLED(TS_PS_SHAKE_192S_SIMPLE)
+    ENTRY(TS_PS_SHAKE_192S_SIMPLE, shake_192s_simple),
+#endif
+#if TS_SUPPORT_SHAKE && TS_SUPPORT_L5 && TS_PS_ENABLED(TS_PS_SHAKE_256F_SIMPLE)
+    ENTRY(TS_PS_SHAKE_256F_SIMPLE, shake_256f_simple),
+#endif
+#if TS_SUPPORT_SHAKE && TS_SUPPORT_S && TS_SUPPORT_L5 && \
+    TS_PS_ENABLED(TS_PS_SHAKE_256S_SIMPLE)
+    ENTRY(TS_PS_SHAKE_256S_SIMPLE, shake_256s_simple),
+#endif
+#if TS_SUPPORT_SHA2 && TS_PS_ENABLED(TS_PS_SHA2_128F_SIMPLE)
+    ENTRY(TS_PS_SHA2_128F_SIMPLE, sha2_128f_simple),
+#endif
+#if TS_SUPPORT_SHA2 && TS_SUPPORT_S && TS_PS_ENABLED(TS_PS_SHA2_128S_SIMPLE)
+    ENTRY(TS_PS_SHA2_128S_SIMPLE, sha2_128s_simple),
+#endif
+#if TS_SUPPORT_SHA2 && (TS_SUPPORT_L5 || TS_SUPPORT_L3) && \
+    TS_PS_ENABLED(TS_PS_SHA2_192F_SIMPLE)
+    ENTRY(TS_PS_SHA2_192F_SIMPLE, sha2_192f_simple),
+#endif
+#if TS_SUPPORT_SHA2 && (TS_SUPPORT_L5 || TS_SUPPORT_L3) && TS_SUPPORT_S && \
+    TS_PS_ENABLED(TS_PS_SHA2_192S_SIMPLE)
+    ENTRY(TS_PS_SHA2_192S_SIMPLE, sha2_192s_simple),
+#endif
+#if TS_SUPPORT_SHA2 && TS_SUPPORT_L5 && TS_PS_ENABLED(TS_PS_SHA2_256F_SIMPLE)
+    ENTRY(TS_PS_SHA2_256F_SIMPLE, sha2_256f_simple),
+#endif
+#if TS_SUPPORT_SHA2 && TS_SUPPORT_L5 && TS_SUPPORT_S && \
+    TS_PS_ENABLED(TS_PS_SHA2_256S_SIMPLE)
+    ENTRY(TS_PS_SHA2_256S_SIMPLE, sha2_256s_simple),
+#endif
+    { 0, 0 }
+};
+
+unsigned ts_ps_to_id( const struct ts_parameter_set *ps ) {
+    for (unsigned i = 0; parameter_sets[i].ps; i++) {
+	if (parameter_sets[i].ps == ps) return parameter_sets[i].id;
+    }
+    return 0;
+}
+
+const struct ts_parameter_set *ts_id_to_ps( unsigned id ) {
+    for (unsigned i = 0; parameter_sets[i].ps; i++) {
+	if (parameter_sets[i].id == id) return parameter_sets[i].ps;
+    }
+    return 0;
+}
+
+static int is_signer( const struct ts_context *ctx ) {
+    return ctx->state > ts_sign_state && ctx->state < ts_verify_state;
+}
+
+static int has_wots_buffer( const struct ts_context *ctx ) {
+#if TS_MULTI_LANE
+    return ctx->wots_buffer != 0;
+#else
+    (void)ctx;
+    return 0;
+#endif
+}
+
+/*
+ * Check that a hash iterator is one we could have left there (the count
+ * of buffered bytes is less than the block); the hash code trusts it
+ */
+#define SHAKE256_RATE 136
+static int valid_iter( const union t_iterator *t,
+		       const struct ts_parameter_set *ps ) {
+#if TS_SUPPORT_SHA2
+    if (PS_SHA2(ps)) {
+#if TS_SUPPORT_L3 || TS_SUPPORT_L5
+	if (PS_N(ps) > 16) {
+	    return t->sha2_L35_simple.in_buffer < sha512_block_size;
+	}
+#endif
+	return t->sha2_L1_simple.num < sha256_block_size;
+    }
+#endif
+#if TS_SUPPORT_SHAKE
+    return t->shake256_simple.s[25] < SHAKE256_RATE;
+#else
+    (void)t;
+    return 0;
+#endif
+}
+
+/*
+ * Check the state of a verifier that we've been handed (in a blob, or to
+ * fork): it has to be one that still has work to do, and every index and
+ * counter the verifier relies on has to be in range for the parameter
+ * set.  This doesn't (and can't) check the hashes; see above
+ */
+static int valid_verifier( const struct ts_context *ctx ) {
+    const struct ts_parameter_set *ps = ctx->ps;
+    unsigned k = PS_K(ps), t = PS_T(ps);
+    unsigned merkle_h = PS_MERKLE_H(ps);
+    const union ts_state_storage *x = TS_X(ctx);
+
+    if (ctx->buffer_offset >= PS_N(ps)) return 0;
+    switch (ctx->state) {
+    case ts_verify_init:
+	return 1;
+    case ts_verify_fors_leaf:
+    case ts_verify_fors:
+	if (ctx->fors_tree >= k || ctx->hypertree_level != 0 ||
+		ctx->fors_keypair_addr >> merkle_h != 0 ||
+		!valid_iter( &ctx->big_iter, ps )) {
+	    return 0;
+	}
+	for (unsigned i = 0; i < k; i++) {
+	    if (x->fors.fors_node[i] >> t != 0) return 0;
+	}
+	if (ctx->state == ts_verify_fors_leaf) return ctx->merkle_level <= t;
+	return ctx->merkle_level < t && ctx->auth_path_node >> t == 0;
+    case ts_verify_wots:
+	if (x->wots.digit >= PS_WOTS_LEN(ps) ||
+		!valid_iter( &ctx->big_iter, ps )) {
+	    return 0;
+	}
+	for (unsigned i = 0; i < (unsigned)PS_WOTS_LEN(ps); i++) {
+	    if (x->wots.digits[i] > PS_WOTS_MAX(ps)) return 0;
+	}
+	/* FALLTHROUGH */
+    case ts_verify_merkle:
+	return ctx->fors_tree == 0 && ctx->hypertree_level < PS_D(ps) &&
+	       ctx->merkle_level < merkle_h &&
+	       ctx->auth_path_node >> merkle_h == 0;
+    default:
+	return 0;     /* Not a verifier, or one that's done */
+    }
+}
+
+/* The number of WOTS digits the verifier has collected in its buffer */
+static unsigned wots_digits( const struct ts_context *ctx ) {
+    if (has_wots_buffer( ctx ) && ctx->state == ts_verify_wots) {
+	return TS_X(ctx)->wots.digit;
+    }
+    return 0;
+}
+
+/*
+ * Compute the MAC over the first len bytes of the blob.  ctx needs only
+ * the parameter set and the key; PRF_msg uses its small iterator as
+ * scratch
+ */
+static void blob_mac( unsigned char *mac, const unsigned char *blob,
+		      size_t len, struct ts_context *ctx ) {
+    unsigned char opt_rand[TS_MAX_HASH];
+    memset( opt_rand, 0, PS_N(ctx->ps) );
+    PS_PRF_MSG(ctx->ps)( mac, opt_rand, blob, len, ctx );
+}
+
+/*
+ * Compare two buffers, without stopping at the first difference (this is
+ * used to check MACs).  Returns nonzero if they differ
+ */
+static int differ( const unsigned char *a, const unsigned char *b,
+		   unsigned n ) {
+    unsigned char diff = 0;
+    while (n--) {
+	diff |= *a++ ^ *b++;
+    }
+    return diff;
+}
+
+/* Pointers mean nothing once the blob's been moved; zero them out */
+static void zero_field( unsigned char *p, size_t offset, size_t len ) {
+    memset( p + offset, 0, len );
+}
+
+/* The WOTS digits are never fewer than the n bytes of a signer's MAC */
+size_t ts_context_export_size( const struct ts_parameter_set *ps ) {
+    return HEADER_SIZE + 2*PS_N(ps) + ts_context_size( ps ) +
+	   ts_wots_buffer_size( ps );
+}
+
+size_t ts_context_export( unsigned char *blob, size_t len_blob,
+                   const struct ts_context *ctx ) {
+    const struct ts_parameter_set *ps = ctx->ps;
+    unsigned id = ts_ps_to_id( ps );
+    if (!id) return 0;
+    unsigned n = PS_N(ps);
+    size_t len_ctx = ts_context_size( ps );
+    unsigned num_digits = wots_digits( ctx );
+    int signer = is_signer( ctx );
+    size_t len = HEADER_SIZE + 2*n + len_ctx + num_digits * n;
+    if (len_blob < len + (signer ? n : 0)) return 0;
+
+    uint32_t order = 0x01020304;
+    int need_message = ctx->state == ts_verify_init;
+    memset( blob, 0, HEADER_SIZE );
+    memcpy( &blob[0], "TSCX", 4 );
+    blob[4] = VERSION;
+    blob[5] = id;
+    blob[6] = (has_wots_buffer( ctx ) ? HAD_WOTS_BUFFER : 0) |
+	      (need_message ? NEEDS_MESSAGE : 0) |
+	      (signer ? SIGNER : 0);
+    ts_ull_to_bytes( &blob[8], sizeof(struct ts_context), 4 );
+    ts_ull_to_bytes( &blob[12], len_ctx, 4 );
+    memcpy( &blob[16], &order, 4 );
+    ts_ull_to_bytes( &blob[24],
+		     need_message ? TS_X(ctx)->verify.len_message : 0, 8 );
+    memcpy( &blob[HEADER_SIZE], ctx->public_key, 2*n );
+
+    /* The context, minus the pointers */
+    unsigned char *p = &blob[HEADER_SIZE + 2*n];
+    memcpy( p, ctx, len_ctx );
+    zero_field( p, offsetof(struct ts_context, ps), sizeof ctx->ps );
+    zero_field( p, offsetof(struct ts_context, public_key),
+	        sizeof ctx->public_key );
+#if TS_MULTI_LANE
+    zero_field( p, offsetof(struct ts_context, wots_buffer),
+	        sizeof ctx->wots_buffer );
+#endif
+#if TS_NODE_CACHE
+    zero_field( p, offsetof(struct ts_context, node_cache),
+	        sizeof ctx->node_cache );
+#endif
+#if TS_WOTS_CACHE
+    zero_field( p, offsetof(struct ts_context, wots_cache),
+	        sizeof ctx->wots_cache );
+#endif
+    if (need_message) {
+	size_t where = (const unsigned char *)&TS_X(ctx)->verify.message -
+		       (const unsigned char *)ctx;
+	zero_field( p, where, sizeof TS_X(ctx)->verify.message );
+    }
+
+#if TS_MULTI_LANE
+    /* And the digits the verifier has collected */
+    if (num_digits) {
+	memcpy( p + len_ctx, ctx->wots_buffer, num_digits * n );
+    }
+#endif
+
+    /* A signer's blob gets its MAC.  PRF_msg scribbles on the small */
+    /* iterator (which we've already copied out); we put it back */
+    if (signer) {
+	struct ts_context *sc = (struct ts_context *)ctx;
+	unsigned char saved[sizeof(union t_iterator)];
+	size_t len_iter = TS_ITER_SIZE(ps);
+	memcpy( saved, TS_SMALL_ITER(sc), len_iter );
+	blob_mac( &blob[len], blob, len, sc );
+	memcpy( TS_SMALL_ITER(sc), saved, len_iter );
+	memset( saved, 0, len_iter );
+	len += n;
+    }
+    return len;
+}
+
+/* Check the header; returns the parameter set, or NULL if it's bad */
+static const struct ts_parameter_set *check_header(
+	           const unsigned char *blob, size_t len_blob ) {
+    uint32_t order = 0x01020304;
+    if (len_blob < HEADER_SIZE ||
+	    0 != memcmp( &blob[0], "TSCX", 4 ) || blob[4] != VERSION ||
+	    (blob[6] & ~(HAD_WOTS_BUFFER | NEEDS_MESSAGE | SIGNER)) != 0 ||
+	    blob[7] != 0 ||
+	    ts_bytes_to_ull( &blob[8], 4 ) != sizeof(struct ts_context) ||
+	    0 != memcmp( &blob[16], &order, 4 )) {
+	return 0;
+    }
+    const struct ts_parameter_set *ps = ts_id_to_ps( blob[5] );
+    if (!ps || ts_bytes_to_ull( &blob[12], 4 ) != ts_context_size( ps ) ||
+	    len_blob < HEADER_SIZE + 2*PS_N(ps) + ts_context_size( ps )) {
+	return 0;
+    }
+    return ps;
+}
+
+const struct ts_parameter_set *ts_context_blob_ps( const unsigned char *blob,
+                   size_t len_blob ) {
+    return check_header( blob, len_blob );
+}
+
+int ts_context_blob_needs_message( const unsigned char *blob,
+                   size_t len_blob ) {
+    return check_header( blob, len_blob ) && (blob[6] & NEEDS_MESSAGE);
+}
+
+/*
+ * Finish the chains of the first num_digits digits of the current WOTS
+ * signature (whose values, as the verifier received them, are in digits),
+ * just as the verifier would have if it hadn't had a WOTS buffer
+ */
+static void finish_chains( struct ts_context *ctx,
+		           const unsigned char *digits, unsigned num_digits ) {
+    const struct ts_parameter_set *ps = ctx->ps;
+    unsigned n = PS_N(ps);
+    unsigned max = PS_WOTS_MAX(ps);
+    for (unsigned d = 0; d < num_digits; d++) {
+	unsigned char chain[TS_MAX_HASH];
+	memcpy( chain, &digits[d * n], n );
+	for (unsigned i = TS_X(ctx)->wots.digits[d]; i < max; i++) {
+	    ts_set_wots_f_adr( ctx, ctx->auth_path_node, d, i );
+	    PS_F(ps)( chain, chain, ctx );
+	}
+	PS_NEXT_T(ps)( &ctx->big_iter, chain, ctx );
+    }
+}
+
+struct ts_context *ts_context_import( void *buffer, size_t len_buffer,
+                   const unsigned char *blob, size_t len_blob,
+                   const unsigned char *key,
+                   const void *message, size_t len_message,
+                   unsigned char *wots_buffer ) {
+    const struct ts_parameter_set *ps = check_header( blob, len_blob );
+    if (!ps) return 0;
+    struct ts_context *ctx = ts_context_from_buffer( buffer, len_buffer, ps );
+    if (!ctx || !key) return 0;
+    unsigned n = PS_N(ps);
+    size_t len_ctx = ts_context_size( ps );
+    const unsigned char *public_key = &blob[HEADER_SIZE];
+    const unsigned char *digits = &blob[HEADER_SIZE + 2*n + len_ctx];
+
+    /* The key has to be the one the blob was exported with */
+    int signer = (blob[6] & SIGNER) != 0;
+    if (signer) key = CONVERT_PRIVATE_KEY_TO_PUBLIC( key, n );
+    if (0 != memcmp( key, public_key, 2*n )) return 0;
+
+    /* And a signer's blob has to carry its MAC; we check that before we */
+    /* take anything from it (the buffer is the scratch space) */
+    if (signer) {
+	size_t len_mac = HEADER_SIZE + 2*n + len_ctx;
+	unsigned char mac[TS_MAX_HASH];
+	if (len_blob < len_mac + n) return 0;
+	ctx->ps = ps;
+	ctx->public_key = key;
+	blob_mac( mac, blob, len_mac, ctx );
+	int bad = differ( mac, &blob[len_mac], n );
+	memset( mac, 0, n );
+	if (bad) goto fail;
+    }
+
+    memcpy( ctx, &blob[HEADER_SIZE + 2*n], len_ctx );
+    ctx->ps = ps;
+    if (signer != is_signer( ctx )) goto fail;
+    if (!signer && !valid_verifier( ctx )) goto fail;
+    ctx->public_key = key;
+#if TS_NODE_CACHE
+    ctx->node_cache = 0;
+#endif
+#if TS_WOTS_CACHE
+    ctx->wots_cache = 0;
+#endif
+
+    if ((ctx->state == ts_verify_init) != !!(blob[6] & NEEDS_MESSAGE)) {
+	goto fail;
+    }
+    if (ctx->state == ts_verify_init) {
+	if (!message || len_message != ts_bytes_to_ull( &blob[24], 8 )) {
+	    goto fail;
+	}
+	TS_X(ctx)->verify.message = message;
+	TS_X(ctx)->verify.len_message = len_message;
+    }
+
+    /* The WOTS digits the verifier had collected */
+    unsigned num_digits = 0;
+    if ((blob[6] & HAD_WOTS_BUFFER) && ctx->state == ts_verify_wots) {
+	num_digits = TS_X(ctx)->wots.digit;
+	if (num_digits >= (unsigned)PS_WOTS_LEN(ps) ||
+	    len_blob < HEADER_SIZE + 2*n + len_ctx + num_digits * n) {
+	    goto fail;
+	}
+    }
+    ts_init_backends();
+#if TS_MULTI_LANE
+    ctx->wots_buffer = 0;
+    if ((blob[6] & HAD_WOTS_BUFFER) && wots_buffer) {
+	/* Hand them back to the verifier */
+	memcpy( wots_buffer, digits, num_digits * n );
+	ctx->wots_buffer = wots_buffer;
+	num_digits = 0;
+    }
+#else
+    (void)wots_buffer;
+#endif
+    /* Otherwise, finish those chains now */
+    finish_chains( ctx, digits, num_digits );
+    return ctx;
+
+fail:
+    memset( ctx, 0, len_ctx );
+    return 0;
+}
+
+struct ts_context *ts_context_fork( void *buffer, size_t len_buffer,
+                   const struct ts_context *src,
+                   unsigned char *wots_buffer ) {
+    if (!src || !src->ps) return 0;
+    if (!is_signer( src ) && !valid_verifier( src )) return 0;
+    struct ts_context *dst = ts_context_from_buffer( buffer, len_buffer,
+		                                     src->ps );
+    if (!dst || dst == src) return 0;
+
+    /* Everything (including the hash states) carries over as is; the */
+    /* pointers are to things the two can share (they're only read), */
+    /* except for the WOTS buffer */
+    memcpy( dst, src, ts_context_size( src->ps ) );
+#if TS_MULTI_LANE
+    if (src->wots_buffer) {
+	unsigned num_digits = wots_digits( src );
+	if (wots_buffer) {
+	    memcpy( wots_buffer, src->wots_buffer, num_digits * PS_N(src->ps) );
+	    dst->wots_buffer = wots_buffer;
+	} else {
+	    dst->wots_buffer = 0;
+	    finish_chains( dst, src->wots_buffer, num_digits );
+	}
+    }
+#else
+    (void)wots_buffer;
+#endif
+    return dst;
+}
@@ -30,6 +30,7 @@
 
 #include "fips202.h"
 #include "tune.h"
+#include "backend.h"
 
 #define NROUNDS 24
 static uint64_t ROL(uint64_t a, int offset) {
@@ -57,14 +58,14 @@ static const uint64_t KeccakF_RoundConstants[NROUNDS] = {
 #endif
 
 /*************************************************
- * Name:        KeccakF1600_StatePermute
+ * Name:        ts_keccak_permute_scalar
  *
  * Description: The Keccak F1600 Permutation
  *
  * Arguments:   - uint64_t *state: pointer to input/output Keccak state
  **************************************************/
 #if TS_SHAKE256_OPT != 2
-static void KeccakF1600_StatePermute(uint64_t *state) {
+void ts_keccak_permute_scalar(uint64_t *state) {
     int round;
 
     uint64_t BCa, BCe, BCi, BCo, BCu;
@@ -366,7 +367,7 @@ static void KeccakF1600_StatePermute(uint64_t *state) {
 
 /* Code from Markku-Juhani O. Saarinen <mjos@iki.fi> */
 /* Slower, but uses less RAM */
-static void KeccakF1600_StatePermute(uint64_t *st) {
+void ts_keccak_permute_scalar(uint64_t *st) {
     // constants
     static const uint64_t keccakf_rndc[NROUNDS] = {
         0x0000000000000001, 0x0000000000008082, 0x800000000000808a,
@@ -477,7 +478,7 @@ static void keccak_inc_absorb(SHAKE256_CTX* ctx, uint32_t r, const uint8_t *m,
         m += r - s_inc[25];
         s_inc[25] = 0;
 
-        KeccakF1600_StatePermute(s_inc);
+        TS_KECCAK_PERMUTE(s_inc);
     }
 
     for (i = 0; i < mlen; i++) {
@@ -538,7 +539,7 @@ static void keccak_inc_squeeze(uint8_t *h, size_t outlen,
 
     /* Then squeeze the remaining necessary blocks */
     while (outlen > 0) {
-        KeccakF1600_StatePermute(s_inc);
+        TS_KECCAK_PERMUTE(s_inc);
 
         for (i = 0; i < outlen && i < r; i++) {
             h[i] = (uint8_t)(s_inc[i >> 3] >> (8 * (i & 0x07)));
@@ -0,0 +1,177 @@
+#if !defined( FIXED_PARM_SET_H_ )
+#define FIXED_PARM_SET_H_
+
+/*
+ * This is used only if the package is built for a single parameter set
+ * (that is, TS_FIXED_PARM_SET is nonzero).  It translates the parameter set
+ * selected in tune.h into the compile time constants and hash functions
+ * that the PS_xxx macros in internal.h expand to
+ *
+ * Obvious question: why don't we just refer to the fields in the
+ * ts_ps_xxx structures?  Well, those are const structures defined in
+ * another source file; the compiler can't see their contents when compiling
+ * (say) tiny_sphincs.c, and so it would still need to load the values from
+ * memory, and call through the function pointers
+ */
+
+#include "tiny_sphincs.h"
+
+/* The T functions differ between SHAKE, SHA2 L1 and SHA2 L3/L5 */
+#define TS_FIXED_FAMILY_SHAKE    1
+#define TS_FIXED_FAMILY_SHA2_L1  2
+#define TS_FIXED_FAMILY_SHA2_L35 3
+
+#if TS_FIXED_PARM_SET == TS_PS_SHAKE_128F_SIMPLE
+#define TS_FIXED_N      16
+#define TS_FIXED_K      33
+#define TS_FIXED_T       6
+#define TS_FIXED_H      66
+#define TS_FIXED_D      22
+#define TS_FIXED_FAMILY TS_FIXED_FAMILY_SHAKE
+#elif TS_FIXED_PARM_SET == TS_PS_SHAKE_128S_SIMPLE
+#define TS_FIXED_N      16
+#define TS_FIXED_K      14
+#define TS_FIXED_T      12
+#define TS_FIXED_H      63
+#define TS_FIXED_D       7
+#define TS_FIXED_FAMILY TS_FIXED_FAMILY_SHAKE
+#elif TS_FIXED_PARM_SET == TS_PS_SHAKE_192F_SIMPLE
+#define TS_FIXED_N      24
+#define TS_FIXED_K      33
+#define TS_FIXED_T       8
+#define TS_FIXED_H      66
+#define TS_FIXED_D      22
+#define TS_FIXED_FAMILY TS_FIXED_FAMILY_SHAKE
+#elif TS_FIXED_PARM_SET == TS_PS_SHAKE_192S_SIMPLE
+#define TS_FIXED_N      24
+#define TS_FIXED_K      17
+#define TS_FIXED_T      14
+#define TS_FIXED_H      63
+#define TS_FIXED_D       7
+#define TS_FIXED_FAMILY TS_FIXED_FAMILY_SHAKE
+#elif TS_FIXED_PARM_SET == TS_PS_SHAKE_256F_SIMPLE
+#define TS_FIXED_N      32
+#define TS_FIXED_K      35
+#define TS_FIXED_T       9
+#define TS_FIXED_H      68
+#define TS_FIXED_D      17
+#define TS_FIXED_FAMILY TS_FIXED_FAMILY_SHAKE
+#elif TS_FIXED_PARM_SET == TS_PS_SHAKE_256S_SIMPLE
+#define TS_FIXED_N      32
+#define TS_FIXED_K      22
+#define TS_FIXED_T      14
+#define TS_FIXED_H      64
+#define TS_FIXED_D       8
+#define TS_FIXED_FAMILY TS_FIXED_FAMILY_SHAKE
+#elif TS_FIXED_PARM_SET == TS_PS_SHA2_128F_SIMPLE
+#define TS_FIXED_N      16
+#define TS_FIXED_K      33
+#define TS_FIXED_T       6
+#define TS_FIXED_H      66
+#define TS_FIXED_D      22
+#define TS_FIXED_FAMILY TS_FIXED_FAMILY_SHA2_L1
+#elif TS_FIXED_PARM_SET == TS_PS_SHA2_128S_SIMPLE
+#define TS_FIXED_N      16
+#define TS_FIXED_K      14
+#define TS_FIXED_T      12
+#define TS_FIXED_H      63
+#define TS_FIXED_D       7
+#define TS_FIXED_FAMILY TS_FIXED_FAMILY_SHA2_L1
+#elif TS_FIXED_PARM_SET == TS_PS_SHA2_192F_SIMPLE
+#define TS_FIXED_N      24
+#define TS_FIXED_K      33
+#define TS_FIXED_T       8
+#define TS_FIXED_H      66
+#define TS_FIXED_D      22
+#define TS_FIXED_FAMILY TS_FIXED_FAMILY_SHA2_L35
+#elif TS_FIXED_PARM_SET == TS_PS_SHA2_192S_SIMPLE
+#define TS_FIXED_N      24
+#define TS_FIXED_K      17
+#define TS_FIXED_T      14
+#define TS_FIXED_H      63
+#define TS_FIXED_D       7
+#define TS_FIXED_FAMILY TS_FIXED_FAMILY_SHA2_L35
+#elif TS_FIXED_PARM_SET == TS_PS_SHA2_256F_SIMPLE
+#define TS_FIXED_N      32
+#define TS_FIXED_K      35
+#define TS_FIXED_T       9
+#define TS_FIXED_H      68
+#define TS_FIXED_D      17
+#define TS_FIXED_FAMILY TS_FIXED_FAMILY_SHA2_L35
+#elif TS_FIXED_PARM_SET == TS_PS_SHA2_256S_SIMPLE
+#define TS_FIXED_N      32
+#define TS_FIXED_K      22
+#define TS_FIXED_T      14
+#define TS_FIXED_H      64
+#define TS_FIXED_D       8
+#define TS_FIXED_FAMILY TS_FIXED_FAMILY_SHA2_L35
+#else
+#error TS_FIXED_PARM_SET does not name a supported parameter set
+#endif
+
+/* All the standard parameter sets have w = 16 */
+#define TS_FIXED_LOG_W   4
+#define TS_FIXED_WOTS_LEN (2*TS_FIXED_N + 3)
+
+/*
+ * Make sure that the settings in tune.h actually allow the parameter set
+ * we've been asked to build for (as those settings size the arrays in the
+ * ts_context)
+ */
+#if TS_FIXED_FAMILY == TS_FIXED_FAMILY_SHAKE && !TS_SUPPORT_SHAKE
+#error TS_FIXED_PARM_SET is a SHAKE parameter set, but TS_SUPPORT_SHAKE is off
+#endif
+#if TS_FIXED_FAMILY != TS_FIXED_FAMILY_SHAKE && !TS_SUPPORT_SHA2
+#error TS_FIXED_PARM_SET is a SHA2 parameter set, but TS_SUPPORT_SHA2 is off
+#endif
+#if TS_FIXED_N > TS_MAX_HASH
+#error TS_FIXED_PARM_SET needs L3 or L5 support enabled
+#endif
+#if TS_FIXED_T > TS_MAX_T || TS_FIXED_H / TS_FIXED_D > TS_MAX_MERKLE_H
+#error TS_FIXED_PARM_SET is an S parameter set, but TS_SUPPORT_S is off
+#endif
+
+/*
+ * And now the hash functions
+ */
+#if TS_FIXED_FAMILY == TS_FIXED_FAMILY_SHAKE
+#include "shake256_func.h"
+#define TS_FIXED_SHA2            0
+#define TS_FIXED_PRF_MSG         ts_shake256_prf_msg
+#define TS_FIXED_HASH_MSG        ts_shake256_hash_msg
+#define TS_FIXED_PRF             ts_shake256_prf
+#define TS_FIXED_F               ts_shake256_f_simple
+#define TS_FIXED_INIT_T          ts_shake256_init_t_simple
+#define TS_FIXED_NEXT_T          ts_shake256_next_t_simple
+#define TS_FIXED_FINAL_T         ts_shake256_final_t_simple
+#define TS_FIXED_COMPUTE_PREHASH(ctx) ((void)(ctx))
+#else
+#include "sha2_func.h"
+#define TS_FIXED_SHA2            1
+#define TS_FIXED_PRF             ts_sha2_prf
+#define TS_FIXED_F               ts_sha2_f_simple
+#if TS_FIXED_FAMILY == TS_FIXED_FAMILY_SHA2_L1
+#define TS_FIXED_PRF_MSG         ts_sha2_L1_prf_msg
+#define TS_FIXED_HASH_MSG        ts_sha2_L1_hash_msg
+#define TS_FIXED_INIT_T          ts_sha2_L1_init_t_simple
+#define TS_FIXED_NEXT_T          ts_sha2_L1_next_t_simple
+#define TS_FIXED_FINAL_T         ts_sha2_L1_final_t_simple
+#if TS_SHA2_OPTIMIZATION
+#define TS_FIXED_COMPUTE_PREHASH(ctx) ts_sha2_L1_prehash(ctx)
+#endif
+#else
+#define TS_FIXED_PRF_MSG         ts_sha2_L35_prf_msg
+#define TS_FIXED_HASH_MSG        ts_sha2_L35_hash_msg
+#define TS_FIXED_INIT_T          ts_sha2_L35_init_t_simple
+#define TS_FIXED_NEXT_T          ts_sha2_L35_next_t_simple
+#define TS_FIXED_FINAL_T         ts_sha2_L35_final_t_simple
+#if TS_SHA2_OPTIMIZATION
+#define TS_FIXED_COMPUTE_PREHASH(ctx) ts_sha2_L35_prehash(ctx)
+#endif
+#endif
+#if !TS_SHA2_OPTIMIZATION
+#define TS_FIXED_COMPUTE_PREHASH(ctx) ((void)(ctx))
+#endif
+#endif
+
+#endif /* FIXED_PARM_SET_H_ */
@@ -0,0 +1,223 @@
+/*
+ * Four lane versions of the SHA-256 compression function and the Keccak
+ * permutation.  These compute four independent instances at once, using
+ * the compiler's vector extensions (so that each operation works on all
+ * four lanes); see lanes.c for how they're used.
+ *
+ * We build the same code twice: once for the baseline instruction set, and
+ * once with AVX2 enabled (via a target attribute, so the rest of the
+ * package needn't be built with AVX2); ts_init_backends picks the one
+ * this CPU can run.  There's also a version that just runs the single lane
+ * backend four times; that's what we use when that is faster (e.g. SHA-256
+ * on a CPU with the SHA extensions)
+ *
+ * The state is kept interleaved: word i of lane j is at [i][j]
+ */
+#include <string.h>
+#include "backend.h"
+#include "endian.h"
+
+#if TS_MULTI_LANE
+
+/*
+ * The versions that run the single lane backend on each lane in turn.
+ * Only the first num_lanes lanes are computed
+ */
+void ts_SHA256_compress_x4_scalar( uint32_t state[8][4],
+		const unsigned char block[4][64], unsigned num_lanes ) {
+    SHA256_CTX ctx;
+    for (unsigned j = 0; j < num_lanes; j++) {
+	for (int i = 0; i < 8; i++) ctx.h[i] = state[i][j];
+	TS_SHA256_COMPRESS( &ctx, block[j] );
+	for (int i = 0; i < 8; i++) state[i][j] = ctx.h[i];
+    }
+}
+
+void ts_keccak_permute_x4_scalar( uint64_t state[25][4],
+		unsigned num_lanes ) {
+    uint64_t s[25];
+    for (unsigned j = 0; j < num_lanes; j++) {
+	for (int i = 0; i < 25; i++) s[i] = state[i][j];
+	TS_KECCAK_PERMUTE( s );
+	for (int i = 0; i < 25; i++) state[i][j] = s[i];
+    }
+}
+
+#if TS_HAVE_VECTOR
+
+typedef uint32_t v32x4 __attribute__((vector_size(16)));
+typedef uint64_t v64x4 __attribute__((vector_size(32)));
+
+static const uint32_t K256[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint64_t RC[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL,
+    0x800000000000808aULL, 0x8000000080008000ULL,
+    0x000000000000808bULL, 0x0000000080000001ULL,
+    0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008aULL, 0x0000000000000088ULL,
+    0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL,
+    0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL,
+    0x000000000000800aULL, 0x800000008000000aULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL,
+    0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32-(n))))
+#define ROL64(x, n) (((x) << (n)) | ((x) >> (64-(n))))
+
+/*
+ * The bodies of the compression functions.  These are always inlined into
+ * the wrappers below (which is how we get both a baseline and an AVX2
+ * version out of the same source)
+ */
+static inline __attribute__((always_inline))
+void sha256_x4_body( uint32_t state[8][4],
+		const unsigned char block[4][64] ) {
+    v32x4 W[16], S[8];
+
+    for (int i = 0; i < 8; i++) memcpy( &S[i], state[i], sizeof S[i] );
+    for (int i = 0; i < 16; i++) {
+	for (int j = 0; j < 4; j++) {
+	    W[i][j] = (uint32_t)ts_bytes_to_ull( &block[j][4*i], 4 );
+	}
+    }
+
+    v32x4 a = S[0], b = S[1], c = S[2], d = S[3];
+    v32x4 e = S[4], f = S[5], g = S[6], h = S[7];
+    for (int i = 0; i < 64; i++) {
+	if (i >= 16) {
+	    v32x4 w2 = W[(i-2)&15], w15 = W[(i-15)&15];
+	    W[i&15] += (ROR32(w2, 17) ^ ROR32(w2, 19) ^ (w2 >> 10)) +
+		       W[(i-7)&15] +
+		       (ROR32(w15, 7) ^ ROR32(w15, 18) ^ (w15 >> 3));
+	}
+	v32x4 t0 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) +
+		   (g ^ (e & (f ^ g))) + K256[i] + W[i&15];
+	v32x4 t1 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) +
+		   (((a | b) & c) | (a & b));
+	h = g; g = f; f = e; e = d + t0;
+	d = c; c = b; b = a; a = t0 + t1;
+    }
+    S[0] += a; S[1] += b; S[2] += c; S[3] += d;
+    S[4] += e; S[5] += f; S[6] += g; S[7] += h;
+
+    for (int i = 0; i < 8; i++) memcpy( state[i], &S[i], sizeof S[i] );
+}
+
+/* Chi, on the row starting at lane y */
+#define CHI(y) \
+	A[y+0] = B[y+0] ^ (~B[y+1] & B[y+2]); \
+	A[y+1] = B[y+1] ^ (~B[y+2] & B[y+3]); \
+	A[y+2] = B[y+2] ^ (~B[y+3] & B[y+4]); \
+	A[y+3] = B[y+3] ^ (~B[y+4] & B[y+0]); \
+	A[y+4] = B[y+4] ^ (~B[y+0] & B[y+1]);
+
+static inline __attribute__((always_inline))
+void keccak_x4_body( uint64_t state[25][4] ) {
+    v64x4 A[25], B[25];
+    v64x4 C0, C1, C2, C3, C4, D0, D1, D2, D3, D4;
+
+    for (int i = 0; i < 25; i++) memcpy( &A[i], state[i], sizeof A[i] );
+
+    for (int round = 0; round < 24; round++) {
+	/* Theta */
+	C0 = A[0] ^ A[5] ^ A[10] ^ A[15] ^ A[20];
+	C1 = A[1] ^ A[6] ^ A[11] ^ A[16] ^ A[21];
+	C2 = A[2] ^ A[7] ^ A[12] ^ A[17] ^ A[22];
+	C3 = A[3] ^ A[8] ^ A[13] ^ A[18] ^ A[23];
+	C4 = A[4] ^ A[9] ^ A[14] ^ A[19] ^ A[24];
+	D0 = C4 ^ ROL64( C1, 1 );
+	D1 = C0 ^ ROL64( C2, 1 );
+	D2 = C1 ^ ROL64( C3, 1 );
+	D3 = C2 ^ ROL64( C4, 1 );
+	D4 = C3 ^ ROL64( C0, 1 );
+
+	/* Rho and pi (lane (x,y) moves to (y, 2x+3y)), with the theta */
+	/* step folded in */
+	B[ 0] = A[ 0] ^ D0;
+	B[ 1] = ROL64( A[ 6] ^ D1, 44 );
+	B[ 2] = ROL64( A[12] ^ D2, 43 );
+	B[ 3] = ROL64( A[18] ^ D3, 21 );
+	B[ 4] = ROL64( A[24] ^ D4, 14 );
+	B[ 5] = ROL64( A[ 3] ^ D3, 28 );
+	B[ 6] = ROL64( A[ 9] ^ D4, 20 );
+	B[ 7] = ROL64( A[10] ^ D0,  3 );
+	B[ 8] = ROL64( A[16] ^ D1, 45 );
+	B[ 9] = ROL64( A[22] ^ D2, 61 );
+	B[10] = ROL64( A[ 1] ^ D1,  1 );
+	B[11] = ROL64( A[ 7] ^ D2,  6 );
+	B[12] = ROL64( A[13] ^ D3, 25 );
+	B[13] = ROL64( A[19] ^ D4,  8 );
+	B[14] = ROL64( A[20] ^ D0, 18 );
+	B[15] = ROL64( A[ 4] ^ D4, 27 );
+	B[16] = ROL64( A[ 5] ^ D0, 36 );
+	B[17] = ROL64( A[11] ^ D1, 10 );
+	B[18] = ROL64( A[17] ^ D2, 15 );
+	B[19] = ROL64( A[23] ^ D3, 56 );
+	B[20] = ROL64( A[ 2] ^ D2, 62 );
+	B[21] = ROL64( A[ 8] ^ D3, 55 );
+	B[22] = ROL64( A[14] ^ D4, 39 );
+	B[23] = ROL64( A[15] ^ D0, 41 );
+	B[24] = ROL64( A[21] ^ D1,  2 );
+
+	/* Chi */
+	CHI(0) CHI(5) CHI(10) CHI(15) CHI(20)
+
+	/* Iota */
+	A[0] ^= RC[round];
+    }
+
+    for (int i = 0; i < 25; i++) memcpy( state[i], &A[i], sizeof A[i] );
+}
+
+/*
+ * The baseline versions.  These always compute all four lanes (that costs
+ * the same as computing fewer)
+ */
+void ts_SHA256_compress_x4_vector( uint32_t state[8][4],
+		const unsigned char block[4][64], unsigned num_lanes ) {
+    (void)num_lanes;
+    sha256_x4_body( state, block );
+}
+
+void ts_keccak_permute_x4_vector( uint64_t state[25][4],
+		unsigned num_lanes ) {
+    (void)num_lanes;
+    keccak_x4_body( state );
+}
+
+#if TS_HAVE_AVX2
+/* And the same, with AVX2 available */
+__attribute__((target("avx2")))
+void ts_SHA256_compress_x4_avx2( uint32_t state[8][4],
+		const unsigned char block[4][64], unsigned num_lanes ) {
+    (void)num_lanes;
+    sha256_x4_body( state, block );
+}
+
+__attribute__((target("avx2")))
+void ts_keccak_permute_x4_avx2( uint64_t state[25][4],
+		unsigned num_lanes ) {
+    (void)num_lanes;
+    keccak_x4_body( state );
+}
+#endif
+
+#endif /* TS_HAVE_VECTOR */
+
+#endif /* TS_MULTI_LANE */
@@ -23,6 +23,8 @@ struct ts_parameter_set {
     unsigned char d;   /* # of levels of Merkle trees */
     unsigned char merkle_h; /* Height of each Merkle tree = h/d */
     unsigned char sha2; /* Set if this is a SHA2 parameter set */
+    unsigned char log_w; /* log2 of the Winternitz parameter w */
+    unsigned char wots_len; /* # of WOTS digits (chains) */
 
 	/* The parameter-set specific functions, that is, the H_msg, PRF, */
         /* PRF_msg, F, H and T functions defined within the Sphincs+ spec */
@@ -57,6 +59,92 @@ struct ts_parameter_set {
     void (*compute_prehash)( struct ts_context *ctx );
 };
 
+/*
+ * This is how the code fetches values from the parameter set.  Normally,
+ * these just read the ts_parameter_set structure; however if we have been
+ * built for a single parameter set (TS_FIXED_PARM_SET), these expand to
+ * compile time constants and direct function calls (so the compiler can
+ * fold the constants into the loops, and doesn't need to go through
+ * function pointers).  The (0 ? x : y) form is there so that the ps
+ * expression is still referenced (and so we don't get 'unused variable'
+ * warnings)
+ * PS_COMPUTE_PREHASH is different; it actually performs the prehash (if
+ * this parameter set has one)
+ */
+#if TS_FIXED_PARM_SET
+#include "fixed_parm_set.h"
+#define PS_N(ps)         (0 ? (ps)->n : TS_FIXED_N)
+#define PS_K(ps)         (0 ? (ps)->k : TS_FIXED_K)
+#define PS_T(ps)         (0 ? (ps)->t : TS_FIXED_T)
+#define PS_H(ps)         (0 ? (ps)->h : TS_FIXED_H)
+#define PS_D(ps)         (0 ? (ps)->d : TS_FIXED_D)
+#define PS_MERKLE_H(ps)  (0 ? (ps)->merkle_h : TS_FIXED_H / TS_FIXED_D)
+#define PS_SHA2(ps)      (0 ? (ps)->sha2 : TS_FIXED_SHA2)
+#define PS_LOG_W(ps)     (0 ? (ps)->log_w : TS_FIXED_LOG_W)
+#define PS_WOTS_LEN(ps)  (0 ? (ps)->wots_len : TS_FIXED_WOTS_LEN)
+#define PS_PRF_MSG(ps)   (0 ? (ps)->prf_msg : TS_FIXED_PRF_MSG)
+#define PS_HASH_MSG(ps)  (0 ? (ps)->hash_msg : TS_FIXED_HASH_MSG)
+#define PS_PRF(ps)       (0 ? (ps)->prf : TS_FIXED_PRF)
+#define PS_F(ps)         (0 ? (ps)->f : TS_FIXED_F)
+#define PS_INIT_T(ps)    (0 ? (ps)->init_t : TS_FIXED_INIT_T)
+#define PS_NEXT_T(ps)    (0 ? (ps)->next_t : TS_FIXED_NEXT_T)
+#define PS_FINAL_T(ps)   (0 ? (ps)->final_t : TS_FIXED_FINAL_T)
+#define PS_COMPUTE_PREHASH(ps, ctx) ((void)(ps), \
+                                     TS_FIXED_COMPUTE_PREHASH(ctx))
+#else
+#define PS_N(ps)         ((ps)->n)
+#define PS_K(ps)         ((ps)->k)
+#define PS_T(ps)         ((ps)->t)
+#define PS_H(ps)         ((ps)->h)
+#define PS_D(ps)         ((ps)->d)
+#define PS_MERKLE_H(ps)  ((ps)->merkle_h)
+#define PS_SHA2(ps)      ((ps)->sha2)
+#if TS_CUSTOM_PS
+#define PS_LOG_W(ps)     ((ps)->log_w)
+#define PS_WOTS_LEN(ps)  ((ps)->wots_len)
+#else
+    /* The standard parameter sets all have w = 16 */
+#define PS_LOG_W(ps)     (0 ? (ps)->log_w : 4)
+#define PS_WOTS_LEN(ps)  (0 ? (ps)->wots_len : 2*PS_N(ps) + 3)
+#endif
+#define PS_PRF_MSG(ps)   ((ps)->prf_msg)
+#define PS_HASH_MSG(ps)  ((ps)->hash_msg)
+#define PS_PRF(ps)       ((ps)->prf)
+#define PS_F(ps)         ((ps)->f)
+#define PS_INIT_T(ps)    ((ps)->init_t)
+#define PS_NEXT_T(ps)    ((ps)->next_t)
+#define PS_FINAL_T(ps)   ((ps)->final_t)
+#define PS_COMPUTE_PREHASH(ps, ctx) \
+              ((ps)->compute_prehash ? (ps)->compute_prehash(ctx) : (void)0)
+#endif
+    /* The top of a WOTS chain (w-1) */
+#define PS_WOTS_MAX(ps)  ((1U << PS_LOG_W(ps)) - 1)
+
+/*
+ * This is where the parameter set dependent parts of the ts_context live.
+ * big_iter is at its usual place; however small_iter starts right after
+ * an iterator large enough for this parameter set's hash, and x (the
+ * per-state storage) right after that.  For a parameter set that needs the
+ * largest iterator, that's exactly where the compiler put them in the
+ * structure; for others, everything is packed lower, and so only
+ * ts_context_size(ps) bytes are needed.
+ * This means that code must never refer to ctx->small_iter or ctx->x
+ * directly; instead, use TS_SMALL_ITER(ctx) and TS_X(ctx)
+ */
+#define TS_CONTEXT_ROUND(size) (((size) + 7) & ~(size_t)7)
+#define TS_ITER_SIZE(ps) TS_CONTEXT_ROUND( !PS_SHA2(ps) ?          \
+                                     sizeof(SHAKE256_CTX) :        \
+                                 PS_N(ps) > 16 ? sizeof(SHA512_CTX) : \
+                                                 sizeof(SHA256_CTX) )
+#define TS_SMALL_ITER_OFFSET(ps) (offsetof(struct ts_context, big_iter) + \
+                                  TS_ITER_SIZE(ps))
+#define TS_X_OFFSET(ps)          (offsetof(struct ts_context, big_iter) + \
+                                  2 * TS_ITER_SIZE(ps))
+#define TS_SMALL_ITER(ctx) ((union t_iterator *)((unsigned char *)(ctx) + \
+                                  TS_SMALL_ITER_OFFSET((ctx)->ps)))
+#define TS_X(ctx) ((union ts_state_storage *)((unsigned char *)(ctx) + \
+                                  TS_X_OFFSET((ctx)->ps)))
+
 /*
  * This is how to convert various things related to keys
  * The pointer we store within the ts_context is actually a pointer to the
@@ -111,6 +199,15 @@ enum hash_reason {
 /* chain computations (in both the siggen and verify directions) */
 void ts_set_up_wots_signature(struct ts_context *ctx, unsigned next_leaf);
 
+/* Used by the ts_init_xxx_buffer routines to check the caller's buffer */
+struct ts_context *ts_context_from_buffer( void *buffer, size_t len_buffer,
+                                      const struct ts_parameter_set *ps );
+
+/* Map the standard parameter sets to and from their TS_PS_xxx numbers */
+/* (0 or NULL if that one isn't built in) */
+unsigned ts_ps_to_id( const struct ts_parameter_set *ps );
+const struct ts_parameter_set *ts_id_to_ps( unsigned id );
+
 /* Used internally to convert message hashes into FORS/hypertree locations */
 void ts_convert_message_hash_to_hypertree_position(
 	                       struct ts_context *ctx,
@@ -121,6 +218,31 @@ void ts_convert_message_hash_to_hypertree_position(
 void ts_wots_leaf( unsigned char *output, int leaf_index,
 	               struct ts_context *ctx );
 
+/* The same, but also place the values at steps 0, interval, 2*interval, */
+/* ... (up to w-1) along each chain into checkpoints ((w-1)/interval+1 of */
+/* them per chain, chain after chain).  If checkpoints is nonNULL, this uses */
+/* ctx->buffer (rather than TS_X) as scratch */
+void ts_wots_leaf_checkpoints( unsigned char *output, int leaf_index,
+		       unsigned char *checkpoints, unsigned interval,
+	               struct ts_context *ctx );
+
+#if TS_WOTS_CACHE
+/* Used by the signer to consult the WOTS checkpoint cache (see */
+/* wotscache.c) for the WOTS key auth_path_node of the current Merkle tree. */
+/* prepare is called at the start of each WOTS signature (and fills in */
+/* the entry if it's missing); chain places the latest checkpoint at or */
+/* below step value of chain digit into output, and returns its step (or */
+/* -1 if the cache doesn't have it); leaf returns 1 if it has the leaf */
+struct ts_wots_cache;
+void ts_wots_cache_prepare( struct ts_wots_cache *cache,
+		            struct ts_context *ctx );
+int ts_wots_cache_chain( struct ts_wots_cache *cache, unsigned char *output,
+		         unsigned digit, unsigned value,
+			 struct ts_context *ctx );
+int ts_wots_cache_leaf( struct ts_wots_cache *cache, unsigned char *output,
+			struct ts_context *ctx );
+#endif
+
 /* Construct the next node in the authentication path (and compute the */
 /* running root).  Used internally by the signature and keygen */
 /* processes */
@@ -131,6 +253,33 @@ void ts_merkle_path( void (*gen_leaf)(
 	                 enum hash_reason typecode,
 			 unsigned char *stack);
 
+/* Used by the verifiers that have the whole signature at hand: step the */
+/* chains [first, first+count) of a WOTS signature (in place) to the top */
+/* of their chains, and climb an entire authentication path (see verify.c) */
+void ts_wots_chains_to_top( unsigned char *wots, unsigned first,
+		            unsigned count, struct ts_context *ctx );
+void ts_climb_auth_path( const unsigned char *path, unsigned height,
+	                 enum hash_reason typecode, struct ts_context *ctx );
+
+/* Once we have H_msg, get the streaming verifier ready for the FORS */
+/* trees (see verify.c) */
+void ts_verify_start_fors( struct ts_context *ctx,
+			   unsigned char *message_hash );
+
+#if TS_MULTI_LANE
+/* Compute num_lanes (at most TS_LANES) independent T functions at once */
+/* (see lanes.c).  Lane j hashes the num_inputs (1 or 2) n-byte inputs */
+/* input[j*num_inputs], input[j*num_inputs+1] with the ADR structure at */
+/* adr + j*ADR_SIZE, and places the result into output[j].  The outputs may */
+/* overlap any of the inputs.  With a single input, this is F (or, if the */
+/* input is the secret seed, and adr is set up for a PRF, it's the PRF) */
+/* This may overwrite ctx->adr and the small_iter */
+#define TS_LANES 4
+void ts_t_lanes( unsigned char *output[],
+		   const unsigned char *input[], unsigned num_inputs,
+		   const unsigned char *adr,
+		   unsigned num_lanes, struct ts_context *ctx );
+#endif
 
 /* Routines to initialize values in the adr structure.  Appropriate */
 /* for both SHA2 and SHAKE parameter sets */
@@ -2,6 +2,27 @@
 #include "tiny_sphincs.h"
 #include "internal.h"
 
+/*
+ * Set up a context to work on the top level Merkle tree of this private key
+ */
+static void set_up_top_tree( struct ts_context *ctx,
+		const unsigned char *private_key,
+		const struct ts_parameter_set *ps ) {
+    unsigned n = PS_N(ps);
+    memset( ctx, 0, sizeof *ctx );  /* Just in case we forget to */
+                                    /* initialize something */
+    ctx->ps = ps;
+    ctx->public_key = CONVERT_PRIVATE_KEY_TO_PUBLIC(private_key, n);
+#if TS_SHA2_OPTIMIZATION
+    PS_COMPUTE_PREHASH( ps, ctx );
+#endif
+
+    ctx->buffer_offset = n;
+    ctx->hypertree_level = PS_D(ps) - 1; /* We're at the top of the */
+                                         /* hypertree */
+    ctx->tree_address = 0;  /* The top of the hypertree has tree address 0 */
+}
+
 /*
  * This generates a public/private keypair.
  * This gets hot-and-heavy with the internals of the signing logic
@@ -14,7 +35,9 @@ int ts_gen_key( unsigned char *private_key,
 	/* We need these - the public_key parameter is optional */
 	return 0;
     }
-    unsigned n = ps->n;
+    unsigned n = PS_N(ps);
+
+    ts_init_backends();
 
     /* Pick a random private key */
     if (!random_function( private_key, 3*n )) {
@@ -28,18 +51,9 @@ int ts_gen_key( unsigned char *private_key,
      * the top level Merkle tree
      */
     struct ts_context ctx;
-    memset( &ctx, 0, sizeof ctx );  /* Just in case we forget to */
-                                    /* initialize something */
-    ctx.ps = ps;
     unsigned char *pub;  /* Writable pointer to the public key */
-    ctx.public_key = pub = CONVERT_PRIVATE_KEY_TO_PUBLIC(private_key, n);
-#if TS_SHA2_OPTIMIZATION
-    if (ps->compute_prehash) ps->compute_prehash( &ctx );
-#endif
-
-    ctx.buffer_offset = n;
-    ctx.hypertree_level = ps->d - 1; /* We're at the top of the hypertree */
-    ctx.tree_address = 0;  /* The top of the hypertree has tree address 0 */ 
+    pub = CONVERT_PRIVATE_KEY_TO_PUBLIC(private_key, n);
+    set_up_top_tree( &ctx, private_key, ps );
     ctx.auth_path_node = 0; /* Actually, we don't care which leaf we use */
     ctx.merkle_level = 0;
 
@@ -49,9 +63,9 @@ int ts_gen_key( unsigned char *private_key,
      * keeps the root of the subtree computed so far in auth_path_buffer
      */
     ts_wots_leaf( ctx.auth_path_buffer, ctx.auth_path_node, &ctx );
-    for (int i=0; i<ps->merkle_h; i++) {
+    for (int i=0; i<PS_MERKLE_H(ps); i++) {
         ts_merkle_path( ts_wots_leaf, &ctx, ADR_TYPE_HASHTREE,
-                     ctx.x.merkle.stack );
+                     TS_X(&ctx)->merkle.stack );
     }
 
     /* The top level root is in auth_path_buffer; that's the root of the */
@@ -66,3 +80,75 @@ int ts_gen_key( unsigned char *private_key,
 
     return 1;
 }
+
+/*
+ * These allow the caller to split up the generation of the top level
+ * Merkle tree (for example, between threads).  ts_gen_key_subtree
+ * computes one node of that tree (by evaluating the entire subtree below
+ * it), and ts_gen_key_combine takes all the nodes at one level, and hashes
+ * them together to form the root (and so complete the key).
+ * private_key must already contain the first 3*n bytes (the secret seed,
+ * the PRF key and the public seed), and that's all these look at
+ */
+void ts_gen_key_subtree( unsigned char *node,
+		const unsigned char *private_key,
+		const struct ts_parameter_set *ps,
+		unsigned level, unsigned index ) {
+    ts_init_backends();
+
+    struct ts_context ctx;
+    set_up_top_tree( &ctx, private_key, ps );
+
+    /*
+     * ts_merkle_path evaluates the subtree of height merkle_level that is
+     * the sibling of the one containing leaf auth_path_node; so point
+     * auth_path_node at a leaf within the sibling of the subtree we want
+     */
+    ctx.merkle_level = level;
+    ctx.auth_path_node = (index << level) ^ (1U << level);
+    ts_merkle_path( ts_wots_leaf, &ctx, ADR_TYPE_HASHTREE,
+                    TS_X(&ctx)->merkle.stack );
+
+    /* ts_merkle_path leaves the root of the subtree it evaluated in */
+    /* buffer */
+    memcpy( node, ctx.buffer, PS_N(ps) );
+}
+
+int ts_gen_key_combine( unsigned char *private_key,
+		unsigned char *public_key,
+		const struct ts_parameter_set *ps,
+		unsigned char *nodes, unsigned level ) {
+    unsigned n = PS_N(ps);
+    if (!private_key || !ps || !nodes || level > PS_MERKLE_H(ps)) {
+	return 0;
+    }
+
+    struct ts_context ctx;
+    set_up_top_tree( &ctx, private_key, ps );
+
+    /*
+     * Hash the nodes together pairwise, one level at a time, until we get
+     * to the root.  We use the nodes array as our workspace
+     */
+    for (; level < PS_MERKLE_H(ps); level++) {
+	unsigned count = 1U << (PS_MERKLE_H(ps) - level - 1);
+	for (unsigned i = 0; i < count; i++) {
+	    union t_iterator *t = TS_SMALL_ITER(&ctx);
+	    ts_set_merkle_adr( &ctx, (2*i) << level, level,
+			       ADR_TYPE_HASHTREE );
+	    PS_INIT_T(ps)( t, &ctx );
+	    PS_NEXT_T(ps)( t, &nodes[ 2*i*n ], &ctx );
+	    PS_NEXT_T(ps)( t, &nodes[ (2*i+1)*n ], &ctx );
+	    PS_FINAL_T(ps)( &nodes[ i*n ], t, &ctx );
+	}
+    }
+
+    /* nodes[0] is now the root */
+    unsigned char *pub = CONVERT_PRIVATE_KEY_TO_PUBLIC(private_key, n);
+    memcpy( CONVERT_PUBLIC_KEY_TO_ROOT(pub, n), nodes, n );
+    if (public_key) {
+	memcpy( public_key, pub, 2*n );
+    }
+
+    return 1;
+}
@@ -0,0 +1,164 @@
+/*
+ * This is the cache of expanded public keys; see keycache.h for the API
+ *
+ * The entries are kept on a doubly linked list in most recently used order,
+ * and are indexed by a chained hash table (with as many buckets as
+ * entries).  Entries that have never been filled in start at the least
+ * recently used end, so we use them first
+ */
+#include <string.h>
+#include <stdint.h>
+#include "keycache.h"
+#include "internal.h"
+
+#define NONE ((unsigned)-1)
+
+struct ts_key_cache_entry {
+    struct ts_expanded_key key; /* Must be first; ts_key_cache_put */
+                                /* converts the key pointer back to the */
+                                /* entry */
+    unsigned prev, next;        /* The LRU list */
+    unsigned hash_next;         /* The next entry in this bucket */
+    unsigned pins;              /* Number of gets without a put */
+    unsigned char valid;        /* Set if key has been filled in */
+};
+
+size_t ts_key_cache_entry_size(void) {
+    return sizeof(struct ts_key_cache_entry) + sizeof(unsigned);
+}
+
+static void lock( struct ts_key_cache *cache ) {
+    if (cache->lock) cache->lock( cache->lock_arg );
+}
+
+static void unlock( struct ts_key_cache *cache ) {
+    if (cache->unlock) cache->unlock( cache->lock_arg );
+}
+
+/* FNV-1a over the public key, mixed with the parameter set */
+static unsigned bucket( const struct ts_key_cache *cache,
+                        const struct ts_parameter_set *ps,
+                        const unsigned char *public_key ) {
+    uint32_t h = 2166136261U ^ (uint32_t)(uintptr_t)ps;
+    for (unsigned i = 0; i < 2*PS_N(ps); i++) {
+	h = (h ^ public_key[i]) * 16777619U;
+    }
+    return h % cache->num_entries;
+}
+
+static void lru_remove( struct ts_key_cache *cache, unsigned i ) {
+    struct ts_key_cache_entry *e = &cache->entries[i];
+    if (e->prev == NONE) cache->lru_head = e->next;
+    else cache->entries[e->prev].next = e->next;
+    if (e->next == NONE) cache->lru_tail = e->prev;
+    else cache->entries[e->next].prev = e->prev;
+}
+
+static void lru_push_front( struct ts_key_cache *cache, unsigned i ) {
+    struct ts_key_cache_entry *e = &cache->entries[i];
+    e->prev = NONE;
+    e->next = cache->lru_head;
+    if (cache->lru_head == NONE) cache->lru_tail = i;
+    else cache->entries[cache->lru_head].prev = i;
+    cache->lru_head = i;
+}
+
+unsigned ts_key_cache_init( struct ts_key_cache *cache,
+                   void *memory, size_t len_memory,
+                   void (*lock_func)(void *), void (*unlock_func)(void *),
+                   void *lock_arg ) {
+    if (!cache) return 0;
+    memset( cache, 0, sizeof *cache );
+    if (!memory) return 0;
+
+    /* Align the entries */
+    size_t align = sizeof(uint64_t);
+    size_t skip = (align - (uintptr_t)memory % align) % align;
+    if (len_memory < skip) return 0;
+    size_t num_entries = (len_memory - skip) / ts_key_cache_entry_size();
+    if (num_entries >= NONE) num_entries = NONE - 1;
+    if (num_entries == 0) return 0;
+
+    cache->entries = (struct ts_key_cache_entry *)
+	                              ((unsigned char *)memory + skip);
+    cache->buckets = (unsigned *)(cache->entries + num_entries);
+    cache->num_entries = num_entries;
+    cache->lock = lock_func;
+    cache->unlock = unlock_func;
+    cache->lock_arg = lock_arg;
+
+    cache->lru_head = cache->lru_tail = NONE;
+    for (unsigned i = 0; i < cache->num_entries; i++) {
+	struct ts_key_cache_entry *e = &cache->entries[i];
+	e->valid = 0;
+	e->pins = 0;
+	e->hash_next = NONE;
+	lru_push_front( cache, i );
+	cache->buckets[i] = NONE;
+    }
+
+    return cache->num_entries;
+}
+
+const struct ts_expanded_key *ts_key_cache_get( struct ts_key_cache *cache,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key ) {
+    unsigned len_public_key = 2*PS_N(ps);
+    unsigned b = bucket( cache, ps, public_key );
+    unsigned i;
+
+    lock( cache );
+
+    /* Check if we have it already */
+    for (i = cache->buckets[b]; i != NONE; i = cache->entries[i].hash_next) {
+	struct ts_key_cache_entry *e = &cache->entries[i];
+	if (e->key.ps == ps &&
+	        0 == memcmp( e->key.public_key, public_key, len_public_key )) {
+	    cache->hits++;
+	    goto found;
+	}
+    }
+
+    /* We don't; find the least recently used entry that's not in use */
+    for (i = cache->lru_tail; i != NONE; i = cache->entries[i].prev) {
+	if (cache->entries[i].pins == 0) break;
+    }
+    if (i == NONE) {
+	unlock( cache );
+	return 0;    /* Everything is in use */
+    }
+    cache->misses++;
+
+    /* Unlink it from the hash chain it was on */
+    struct ts_key_cache_entry *e = &cache->entries[i];
+    if (e->valid) {
+	unsigned *p = &cache->buckets[ bucket( cache, e->key.ps,
+			                       e->key.public_key ) ];
+	while (*p != i) p = &cache->entries[*p].hash_next;
+	*p = e->hash_next;
+    }
+
+    /* And put the new key there */
+    ts_expand_public_key( &e->key, ps, public_key );
+    e->valid = 1;
+    e->hash_next = cache->buckets[b];
+    cache->buckets[b] = i;
+
+found:
+    lru_remove( cache, i );
+    lru_push_front( cache, i );
+    cache->entries[i].pins++;
+
+    unlock( cache );
+    return &cache->entries[i].key;
+}
+
+void ts_key_cache_put( struct ts_key_cache *cache,
+                   const struct ts_expanded_key *key ) {
+    if (!key) return;
+    struct ts_key_cache_entry *e = (struct ts_key_cache_entry *)key;
+
+    lock( cache );
+    if (e->pins > 0) e->pins--;
+    unlock( cache );
+}
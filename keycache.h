@@ -0,0 +1,82 @@
+#if !defined( KEYCACHE_H_ )
+#define KEYCACHE_H_
+
+/*
+ * This is a cache of expanded public keys (see ts_expand_public_key), for
+ * verifiers that see the same signers over and over.  It maps the public
+ * key bytes (and parameter set) to the expanded key, and holds the most
+ * recently used ones (evicting the least recently used one when it needs
+ * room).  Like the context pool, it lives in memory that the application
+ * provides.
+ *
+ * This is meant to be used this way:
+ *
+ * struct ts_key_cache cache;
+ * ts_key_cache_init( &cache, memory, len_memory, 0, 0, 0 );
+ *
+ * const struct ts_expanded_key *key = ts_key_cache_get( &cache, ps,
+ *                                                       public_key );
+ * if (!key) ... every entry is currently in use ...
+ * ts_init_verify_expanded( &ctx, message, len_message, key );
+ * ... ts_update_verify, ts_verify ...
+ * ts_key_cache_put( &cache, key );
+ *
+ * An entry returned by ts_key_cache_get is pinned (it won't be evicted)
+ * until the matching ts_key_cache_put, so it remains valid for the entire
+ * verification.
+ *
+ * If multiple threads share a cache, pass lock/unlock functions (e.g.
+ * wrapping a pthread mutex) to ts_key_cache_init; each get and put holds
+ * the lock only briefly (just for the lookup, or for expanding the key on
+ * a miss).  The verifications themselves run without holding it
+ */
+
+#include <stddef.h>
+#include "tiny_sphincs.h"
+
+struct ts_key_cache_entry;
+
+struct ts_key_cache {
+    struct ts_key_cache_entry *entries;
+    unsigned *buckets;      /* Hash table; the first entry in each chain */
+    unsigned num_entries;
+    unsigned lru_head;      /* The most recently used entry */
+    unsigned lru_tail;      /* The least recently used entry */
+    void (*lock)(void *);
+    void (*unlock)(void *);
+    void *lock_arg;
+    unsigned long hits, misses;  /* Statistics */
+};
+
+/*
+ * The number of bytes of memory the cache uses per entry
+ */
+size_t ts_key_cache_entry_size(void);
+
+/*
+ * Set up a cache in the given memory.  lock and unlock may be NULL (if the
+ * cache is used by only one thread); if not, they're called with lock_arg.
+ * This returns the number of entries in the cache (0 if the memory isn't
+ * enough for even one)
+ */
+unsigned ts_key_cache_init( struct ts_key_cache *cache,
+                   void *memory, size_t len_memory,
+                   void (*lock)(void *), void (*unlock)(void *),
+                   void *lock_arg );
+
+/*
+ * Look up the expanded version of this public key; if it isn't in the
+ * cache, expand it (evicting the least recently used entry that isn't in
+ * use).  This returns NULL if every entry is currently pinned
+ */
+const struct ts_expanded_key *ts_key_cache_get( struct ts_key_cache *cache,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key );
+
+/*
+ * Say that we're done with an entry that ts_key_cache_get returned
+ */
+void ts_key_cache_put( struct ts_key_cache *cache,
+                   const struct ts_expanded_key *key );
+
+#endif /* KEYCACHE_H_ */
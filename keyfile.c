@@ -0,0 +1,210 @@
+/*
+ * Helpers for the host tools; see keyfile.h
+ */
+#include <string.h>
+#include <ctype.h>
+#include "keyfile.h"
+
+#define ENTRY(name) { #name, &ts_ps_ ## name }
+
+static const struct {
+    const char *name;
+    const struct ts_parameter_set *ps;
+} parameter_sets[] = {
+#if TS_SUPPORT_SHAKE && TS_PS_ENABLED(TS_PS_SHAKE_128F_SIMPLE)
+    ENTRY(shake_128f_simple),
+#endif
+#if TS_SUPPORT_SHAKE && TS_SUPPORT_S && TS_PS_ENABLED(TS_PS_SHAKE_128S_SIMPLE)
+    ENTRY(shake_128s_simple),
+#endif
+#if TS_SUPPORT_SHAKE && (TS_SUPPORT_L3 || TS_SUPPORT_L5) && \
+    TS_PS_ENABLED(TS_PS_SHAKE_192F_SIMPLE)
+    ENTRY(shake_192f_simple),
+#endif
+#if TS_SUPPORT_SHAKE && TS_SUPPORT_S && (TS_SUPPORT_L3 || TS_SUPPORT_L5) && \
+    TS_PS_ENABLED(TS_PS_SHAKE_192S_SIMPLE)
+    ENTRY(shake_192s_simple),
+#endif
+#if TS_SUPPORT_SHAKE && TS_SUPPORT_L5 && TS_PS_ENABLED(TS_PS_SHAKE_256F_SIMPLE)
+    ENTRY(shake_256f_simple),
+#endif
+#if TS_SUPPORT_SHAKE && TS_SUPPORT_S && TS_SUPPORT_L5 && \
+    TS_PS_ENABLED(TS_PS_SHAKE_256S_SIMPLE)
+    ENTRY(shake_256s_simple),
+#endif
+#if TS_SUPPORT_SHA2 && TS_PS_ENABLED(TS_PS_SHA2_128F_SIMPLE)
+    ENTRY(sha2_128f_simple),
+#endif
+#if TS_SUPPORT_SHA2 && TS_SUPPORT_S && TS_PS_ENABLED(TS_PS_SHA2_128S_SIMPLE)
+    ENTRY(sha2_128s_simple),
+#endif
+#if TS_SUPPORT_SHA2 && (TS_SUPPORT_L5 || TS_SUPPORT_L3) && \
+    TS_PS_ENABLED(TS_PS_SHA2_192F_SIMPLE)
+    ENTRY(sha2_192f_simple),
+#endif
+#if TS_SUPPORT_SHA2 && (TS_SUPPORT_L5 || TS_SUPPORT_L3) && TS_SUPPORT_S && \
+    TS_PS_ENABLED(TS_PS_SHA2_192S_SIMPLE)
+    ENTRY(sha2_192s_simple),
+#endif
+#if TS_SUPPORT_SHA2 && TS_SUPPORT_L5 && TS_PS_ENABLED(TS_PS_SHA2_256F_SIMPLE)
+    ENTRY(sha2_256f_simple),
+#endif
+#if TS_SUPPORT_SHA2 && TS_SUPPORT_L5 && TS_SUPPORT_S && \
+    TS_PS_ENABLED(TS_PS_SHA2_256S_SIMPLE)
+    ENTRY(sha2_256s_simple),
+#endif
+    { 0, 0 }
+};
+
+const struct ts_parameter_set *ts_lookup_parameter_set( const char *name ) {
+    for (int i = 0; parameter_sets[i].name; i++) {
+	if (0 == strcmp( name, parameter_sets[i].name )) {
+	    return parameter_sets[i].ps;
+	}
+    }
+    return 0;
+}
+
+const char *ts_parameter_set_name( const struct ts_parameter_set *ps ) {
+    for (int i = 0; parameter_sets[i].name; i++) {
+	if (ps == parameter_sets[i].ps) {
+	    return parameter_sets[i].name;
+	}
+    }
+    return 0;
+}
+
+static int hex_digit( int c ) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c = tolower(c);
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/* Convert exactly len bytes of hex (and nothing more) */
+static int from_hex( unsigned char *out, unsigned len, const char *hex ) {
+    for (unsigned i = 0; i < len; i++) {
+	int hi = hex_digit( hex[2*i] );
+	int lo = hi < 0 ? -1 : hex_digit( hex[2*i+1] );
+	if (lo < 0) return 0;
+	out[i] = (unsigned char)(16*hi + lo);
+    }
+    return hex[2*len] == '\0';
+}
+
+/* Use a volatile pointer, so this isn't optimized away */
+static void zeroize( void *p, size_t n ) {
+    volatile unsigned char *q = p;
+    while (n--) *q++ = 0;
+}
+
+int ts_read_key_file( struct ts_key_file *key, const char *filename ) {
+    memset( key, 0, sizeof *key );
+    FILE *f = fopen( filename, "r" );
+    if (!f) {
+	perror( filename );
+	return 0;
+    }
+    /* The private key passes through stdio's buffer; make that one we */
+    /* can wipe */
+    char io_buffer[ 1024 ];
+    setvbuf( f, io_buffer, _IOFBF, sizeof io_buffer );
+
+    /* We allow for the values to come in any order, so we hold onto the */
+    /* hex until we know the parameter set */
+    char line[ 512 ];
+    char public_hex[ 4*TS_MAX_HASH + 1 ] = "";
+    char private_hex[ 8*TS_MAX_HASH + 1 ] = "";
+    int ok = 1;
+    unsigned line_number = 0;
+    while (ok && fgets( line, sizeof line, f )) {
+	line_number++;
+	char *p = line + strlen(line);
+	while (p > line && isspace((unsigned char)p[-1])) *--p = '\0';
+	p = line;
+	while (isspace((unsigned char)*p)) p++;
+	if (*p == '\0' || *p == '#') continue;
+
+	char *value = p;
+	while (*value && !isspace((unsigned char)*value)) value++;
+	if (*value) *value++ = '\0';
+	while (isspace((unsigned char)*value)) value++;
+
+	if (0 == strcmp( p, "parameter-set" )) {
+	    key->ps = ts_lookup_parameter_set( value );
+	    if (!key->ps) {
+		fprintf( stderr, "%s: unknown parameter set %s\n",
+			 filename, value );
+		ok = 0;
+	    }
+	} else if (0 == strcmp( p, "public-key" ) &&
+		   strlen(value) < sizeof public_hex) {
+	    strcpy( public_hex, value );
+	} else if (0 == strcmp( p, "private-key" ) &&
+		   strlen(value) < sizeof private_hex) {
+	    strcpy( private_hex, value );
+	    key->have_private_key = 1;
+	} else {
+	    fprintf( stderr, "%s:%u: unrecognized line\n", filename,
+		     line_number );
+	    ok = 0;
+	}
+    }
+    fclose( f );
+    if (!ok) goto done;
+    ok = 0;
+
+    if (!key->ps) {
+	fprintf( stderr, "%s: no parameter set\n", filename );
+	goto done;
+    }
+    unsigned len_public = ts_size_public_key( key->ps );
+    unsigned len_private = ts_size_private_key( key->ps );
+    if (!from_hex( key->public_key, len_public, public_hex )) {
+	fprintf( stderr, "%s: missing or malformed public key\n", filename );
+	goto done;
+    }
+    if (key->have_private_key) {
+	if (!from_hex( key->private_key, len_private, private_hex )) {
+	    fprintf( stderr, "%s: malformed private key\n", filename );
+	    goto done;
+	}
+	/* The private key ends with the public key; they have to agree */
+	/* (or we'd sign with one, and verify with the other) */
+	if (0 != memcmp( key->private_key + len_private - len_public,
+			 key->public_key, len_public )) {
+	    fprintf( stderr, "%s: the public key doesn't match the private "
+		     "key\n", filename );
+	    goto done;
+	}
+    }
+    ok = 1;
+done:
+    zeroize( io_buffer, sizeof io_buffer );
+    zeroize( line, sizeof line );
+    zeroize( private_hex, sizeof private_hex );
+    if (!ok) zeroize( key, sizeof *key );
+    return ok;
+}
+
+static void put_hex( FILE *f, const char *label, const unsigned char *p,
+		     unsigned len ) {
+    fprintf( f, "%s ", label );
+    for (unsigned i = 0; i < len; i++) {
+	fprintf( f, "%02x", p[i] );
+    }
+    fprintf( f, "\n" );
+}
+
+int ts_write_key_file( const struct ts_key_file *key, FILE *f ) {
+    const char *name = ts_parameter_set_name( key->ps );
+    if (!name) return 0;
+    fprintf( f, "parameter-set %s\n", name );
+    put_hex( f, "public-key", key->public_key,
+	     ts_size_public_key( key->ps ) );
+    if (key->have_private_key) {
+	put_hex( f, "private-key", key->private_key,
+		 ts_size_private_key( key->ps ) );
+    }
+    return !ferror( f );
+}
@@ -0,0 +1,54 @@
+#if !defined( KEYFILE_H_ )
+#define KEYFILE_H_
+
+/*
+ * Helpers for the host tools (tsphincsd and friends): naming parameter
+ * sets, and reading and writing key files.  These use stdio, and so
+ * aren't part of the core package.
+ *
+ * A key file is a text file that looks like this:
+ *
+ *     # Comments start with a #
+ *     parameter-set sha2_128f_simple
+ *     public-key 0123abcd...
+ *     private-key 4567ef01...
+ *
+ * The keys are in hex; the private-key line is optional (a file without
+ * one can only be used to verify)
+ */
+
+#include <stdio.h>
+#include "tiny_sphincs.h"
+
+struct ts_key_file {
+    const struct ts_parameter_set *ps;
+    unsigned char public_key[2*TS_MAX_HASH];
+    unsigned char private_key[4*TS_MAX_HASH];
+    int have_private_key;
+};
+
+/*
+ * Look up a parameter set by name (e.g. "shake_256s_simple"; that is,
+ * the name of the ts_ps_xxx variable without the ts_ps_).  Returns NULL
+ * if we don't know it (or it isn't enabled in tune.h)
+ */
+const struct ts_parameter_set *ts_lookup_parameter_set( const char *name );
+
+/*
+ * And the other way around; returns NULL if we don't know the set
+ */
+const char *ts_parameter_set_name( const struct ts_parameter_set *ps );
+
+/*
+ * Read a key file.  Returns 1 on success; on failure, this writes an
+ * error message to stderr and returns 0
+ */
+int ts_read_key_file( struct ts_key_file *key, const char *filename );
+
+/*
+ * Write a key file (with the private key if key->have_private_key).
+ * Returns 1 on success, 0 on failure
+ */
+int ts_write_key_file( const struct ts_key_file *key, FILE *f );
+
+#endif /* KEYFILE_H_ */
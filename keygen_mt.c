@@ -0,0 +1,220 @@
+/*
+ * Multithreaded key generation; see keygen_mt.h
+ *
+ * We split the top level Merkle tree into a number of subtrees (a few per
+ * thread, so that a slow thread doesn't hold up everyone), have the threads
+ * pick them off one at a time (ts_gen_key_subtree), and then hash the
+ * subtree roots together (ts_gen_key_combine)
+ *
+ * For bulk key generation, there's enough parallelism between the keys;
+ * each thread simply generates entire keys
+ */
+#include <string.h>
+#include <pthread.h>
+#include "keygen_mt.h"
+#include "internal.h"
+
+#define SUBTREES_PER_THREAD 4
+#define MAX_THREADS        64
+
+struct keygen_job {
+    const unsigned char *private_key;
+    const struct ts_parameter_set *ps;
+    unsigned level;             /* The level of the subtree roots */
+    unsigned num_subtrees;
+    unsigned next_subtree;      /* The next one no one has started on */
+    unsigned char *nodes;       /* Where the subtree roots go */
+    pthread_mutex_t lock;       /* Protects next_subtree */
+};
+
+static void *keygen_worker( void *arg ) {
+    struct keygen_job *job = arg;
+    unsigned n = PS_N(job->ps);
+
+    for (;;) {
+	pthread_mutex_lock( &job->lock );
+	unsigned i = job->next_subtree;
+	if (i < job->num_subtrees) job->next_subtree++;
+	pthread_mutex_unlock( &job->lock );
+	if (i >= job->num_subtrees) break;
+
+	ts_gen_key_subtree( &job->nodes[i*n], job->private_key, job->ps,
+			    job->level, i );
+    }
+    return 0;
+}
+
+int ts_gen_key_mt( unsigned char *private_key,
+		unsigned char *public_key,
+		const struct ts_parameter_set *ps,
+	        int (*random_function)(unsigned char *, size_t),
+		unsigned num_threads ) {
+    if (!random_function || !private_key || !ps) {
+	return 0;
+    }
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS;
+    unsigned n = PS_N(ps);
+    unsigned merkle_h = PS_MERKLE_H(ps);
+
+    /* Pick a random private key */
+    if (!random_function( private_key, 3*n )) {
+	return 0;
+    }
+
+    /* Once, from this thread; see ts_init_backends */
+    ts_init_backends();
+
+    /* Decide how finely to split up the tree */
+    unsigned level = merkle_h;
+    while (level > 0 &&
+	     (1U << (merkle_h - level)) < SUBTREES_PER_THREAD * num_threads) {
+	level--;
+    }
+
+    unsigned char nodes[ (1 << TS_MAX_MERKLE_H) * TS_MAX_HASH ];
+    struct keygen_job job;
+    job.private_key = private_key;
+    job.ps = ps;
+    job.level = level;
+    job.num_subtrees = 1U << (merkle_h - level);
+    job.next_subtree = 0;
+    job.nodes = nodes;
+    pthread_mutex_init( &job.lock, 0 );
+
+    /* Start up the other threads (if we can't, we'll just do the work */
+    /* with fewer) */
+    pthread_t threads[ MAX_THREADS ];
+    unsigned started = 0;
+    for (unsigned i = 1; i < num_threads; i++) {
+	if (0 != pthread_create( &threads[started], 0, keygen_worker, &job )) {
+	    break;
+	}
+	started++;
+    }
+    keygen_worker( &job );
+    for (unsigned i = 0; i < started; i++) {
+	pthread_join( threads[i], 0 );
+    }
+    pthread_mutex_destroy( &job.lock );
+
+    return ts_gen_key_combine( private_key, public_key, ps, nodes, level );
+}
+
+struct bulk_job {
+    const struct ts_parameter_set *ps;
+    unsigned count;
+    unsigned next_key;          /* The next key no one has started on */
+    int failed;                 /* Set if we need to stop */
+    unsigned char *private_keys, *public_keys;
+    int (*random_function)(unsigned char *, size_t);
+    int (*output)( unsigned, const unsigned char *, const unsigned char *,
+		   void * );
+    void *output_arg;
+    pthread_mutex_t lock;       /* Protects next_key, failed and calls to */
+                                /* random_function */
+    pthread_mutex_t output_lock; /* Serializes calls to output */
+};
+
+static void *bulk_worker( void *arg ) {
+    struct bulk_job *job = arg;
+    const struct ts_parameter_set *ps = job->ps;
+    unsigned len_private = ts_size_private_key( ps );
+    unsigned len_public = ts_size_public_key( ps );
+    unsigned n = PS_N(ps);
+    unsigned char scratch_private[ 4*TS_MAX_HASH ];
+    unsigned char scratch_public[ 2*TS_MAX_HASH ];
+
+    for (;;) {
+	/* Get the next key to work on, and its randomness.  We get the */
+	/* randomness while holding the lock, so that key i gets the i-th */
+	/* output of the random function */
+	pthread_mutex_lock( &job->lock );
+	unsigned i = job->next_key;
+	if (job->failed || i >= job->count) {
+	    pthread_mutex_unlock( &job->lock );
+	    break;
+	}
+	job->next_key++;
+	unsigned char *private_key = job->private_keys ?
+	       job->private_keys + (size_t)i * len_private : scratch_private;
+	unsigned char *public_key = job->public_keys ?
+	       job->public_keys + (size_t)i * len_public : scratch_public;
+	int ok = job->random_function( private_key, 3*n );
+	if (!ok) job->failed = 1;
+	pthread_mutex_unlock( &job->lock );
+	if (!ok) break;
+
+	/* The top level Merkle tree is the node at the top level */
+	unsigned char root[ TS_MAX_HASH ];
+	ts_gen_key_subtree( root, private_key, ps, PS_MERKLE_H(ps), 0 );
+	ts_gen_key_combine( private_key, public_key, ps, root,
+			    PS_MERKLE_H(ps) );
+
+	if (job->output) {
+	    pthread_mutex_lock( &job->output_lock );
+	    ok = job->output( i, private_key, public_key, job->output_arg );
+	    pthread_mutex_unlock( &job->output_lock );
+	    if (!ok) {
+		pthread_mutex_lock( &job->lock );
+		job->failed = 1;
+		pthread_mutex_unlock( &job->lock );
+		break;
+	    }
+	}
+    }
+
+    memset( scratch_private, 0, sizeof scratch_private );
+    return 0;
+}
+
+int ts_gen_keys( unsigned count,
+		unsigned char *private_keys,
+		unsigned char *public_keys,
+		const struct ts_parameter_set *ps,
+	        int (*random_function)(unsigned char *, size_t),
+		unsigned num_threads,
+		int (*output)( unsigned index,
+			       const unsigned char *private_key,
+			       const unsigned char *public_key,
+			       void *output_arg ),
+		void *output_arg ) {
+    if (!random_function || !ps) {
+	return 0;
+    }
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS;
+    if (num_threads > count) num_threads = count;
+
+    ts_init_backends();
+
+    struct bulk_job job;
+    job.ps = ps;
+    job.count = count;
+    job.next_key = 0;
+    job.failed = 0;
+    job.private_keys = private_keys;
+    job.public_keys = public_keys;
+    job.random_function = random_function;
+    job.output = output;
+    job.output_arg = output_arg;
+    pthread_mutex_init( &job.lock, 0 );
+    pthread_mutex_init( &job.output_lock, 0 );
+
+    pthread_t threads[ MAX_THREADS ];
+    unsigned started = 0;
+    for (unsigned i = 1; i < num_threads; i++) {
+	if (0 != pthread_create( &threads[started], 0, bulk_worker, &job )) {
+	    break;
+	}
+	started++;
+    }
+    bulk_worker( &job );
+    for (unsigned i = 0; i < started; i++) {
+	pthread_join( threads[i], 0 );
+    }
+    pthread_mutex_destroy( &job.lock );
+    pthread_mutex_destroy( &job.output_lock );
+
+    return !job.failed;
+}
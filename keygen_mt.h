@@ -0,0 +1,57 @@
+#if !defined( KEYGEN_MT_H_ )
+#define KEYGEN_MT_H_
+
+/*
+ * Multithreaded key generation.  This is meant for hosts (e.g. when
+ * provisioning devices); it uses POSIX threads, and so isn't part of the
+ * core package that goes onto an HSM.
+ */
+
+#include <stddef.h>
+#include "tiny_sphincs.h"
+
+/*
+ * This is ts_gen_key, with the evaluation of the top level Merkle tree
+ * spread across num_threads threads (including the calling one; at most
+ * 64).  It generates the same key that ts_gen_key would (given the same
+ * randomness).
+ * random_function is called only from the calling thread.
+ * This returns 1 on success, 0 on failure
+ */
+int ts_gen_key_mt( unsigned char *private_key,
+		unsigned char *public_key,
+		const struct ts_parameter_set *ps,
+	        int (*random_function)(unsigned char *, size_t),
+		unsigned num_threads );
+
+/*
+ * This generates count keypairs, spread across num_threads threads
+ * (including the calling one; at most 64); each thread works on its own
+ * key.
+ * private_keys, public_keys - where to place the keys; key i goes at
+ *             private_keys + i * ts_size_private_key(ps) (and similarly for
+ *             the public keys).  Either may be NULL, if you'd rather get
+ *             the keys through the output function
+ * random_function - called (with calls serialized, never concurrently)
+ *             once per key, in key order; so this generates the same keys
+ *             that calling ts_gen_key count times would
+ * output -    if non-NULL, this is called as each key is finished (which
+ *             isn't necessarily in index order), with the index, the
+ *             private and the public key, and output_arg.  Calls are
+ *             serialized.  If it returns 0, we stop generating keys (and
+ *             return failure)
+ * This returns 1 if all the keys were generated (and output), 0 on failure
+ */
+int ts_gen_keys( unsigned count,
+		unsigned char *private_keys,
+		unsigned char *public_keys,
+		const struct ts_parameter_set *ps,
+	        int (*random_function)(unsigned char *, size_t),
+		unsigned num_threads,
+		int (*output)( unsigned index,
+			       const unsigned char *private_key,
+			       const unsigned char *public_key,
+			       void *output_arg ),
+		void *output_arg );
+
+#endif /* KEYGEN_MT_H_ */
@@ -0,0 +1,146 @@
+/*
+ * This computes several independent T functions at once (using the four
+ * lane compression functions in hash_x4.c).  This is used whereever
+ * Sphincs+ needs a lot of hashes that don't depend on each other (e.g.
+ * the leaves of a FORS tree).
+ *
+ * All the hashes this is used for (PRF, F, and H, that is, T with two
+ * inputs) fit within a single compression function block for SHAKE and
+ * for SHA-256.  The exception is H for L3/L5 SHA2 parameter sets, which
+ * uses SHA-512; for that, we just compute the lanes one at a time
+ */
+#include <string.h>
+#include "tiny_sphincs.h"
+#include "internal.h"
+#include "sha2_func.h"
+#include "backend.h"
+#include "endian.h"
+
+#if TS_MULTI_LANE
+
+#define SHAKE256_RATE 136
+
+#if TS_SUPPORT_SHA2
+static void sha256_lanes( unsigned char *output[],
+		   const unsigned char *input[], unsigned num_inputs,
+		   const unsigned char *adr,
+		   unsigned num_lanes, struct ts_context *ctx ) {
+    unsigned n = PS_N(ctx->ps);
+    unsigned len = SHA2_ADR_SIZE + num_inputs * n;
+    uint32_t state[8][4];
+    unsigned char block[4][64];
+
+    /* Each lane starts with the SHA-256 state after the public seed */
+    /* block */
+    SHA256_CTX start;
+    ts_sha256_init_ctx( &start, ctx );
+    for (int i = 0; i < 8; i++) {
+	for (int j = 0; j < 4; j++) state[i][j] = start.h[i];
+    }
+
+    /* And then hashes ADR || input(s), padded out to the block size */
+    memset( block, 0, sizeof block );
+    for (unsigned j = 0; j < num_lanes; j++) {
+	memcpy( &block[j][0], adr + j*ADR_SIZE, SHA2_ADR_SIZE );
+	for (unsigned k = 0; k < num_inputs; k++) {
+	    memcpy( &block[j][SHA2_ADR_SIZE + k*n],
+		    input[j*num_inputs + k], n );
+	}
+	block[j][len] = 0x80;
+	ts_ull_to_bytes( &block[j][56], 8 * (uint64_t)(64 + len), 8 );
+    }
+
+    TS_SHA256_COMPRESS_X4( state, (const unsigned char (*)[64])block,
+			   num_lanes );
+
+    for (unsigned j = 0; j < num_lanes; j++) {
+	for (unsigned i = 0; i < n/4; i++) {
+	    ts_ull_to_bytes( &output[j][4*i], state[i][j], 4 );
+	}
+    }
+}
+#endif
+
+#if TS_SUPPORT_SHAKE
+static void shake256_lanes( unsigned char *output[],
+		   const unsigned char *input[], unsigned num_inputs,
+		   const unsigned char *adr,
+		   unsigned num_lanes, struct ts_context *ctx ) {
+    unsigned n = PS_N(ctx->ps);
+    const unsigned char *pub_seed = CONVERT_PUBLIC_KEY_TO_PUB_SEED(
+					       ctx->public_key, n );
+    uint64_t state[25][4];
+
+    memset( state, 0, sizeof state );
+    for (unsigned j = 0; j < num_lanes; j++) {
+	/* Absorb PK.seed || ADR || input(s) into this lane */
+	unsigned char block[SHAKE256_RATE];
+	unsigned len = 0;
+	memset( block, 0, sizeof block );
+	memcpy( &block[len], pub_seed, n ); len += n;
+	memcpy( &block[len], adr + j*ADR_SIZE, ADR_SIZE ); len += ADR_SIZE;
+	for (unsigned k = 0; k < num_inputs; k++) {
+	    memcpy( &block[len], input[j*num_inputs + k], n ); len += n;
+	}
+	block[len] ^= 0x1f;
+	block[SHAKE256_RATE-1] ^= 0x80;
+	for (unsigned i = 0; i < SHAKE256_RATE; i++) {
+	    state[i/8][j] ^= (uint64_t)block[i] << (8 * (i%8));
+	}
+    }
+
+    TS_KECCAK_PERMUTE_X4( state, num_lanes );
+
+    for (unsigned j = 0; j < num_lanes; j++) {
+	for (unsigned i = 0; i < n; i++) {
+	    output[j][i] = (unsigned char)(state[i/8][j] >> (8 * (i%8)));
+	}
+    }
+}
+#endif
+
+/*
+ * The fallback: compute each lane with the usual T function.  We place
+ * the results into a temporary buffer first, so that (as with the
+ * multilane versions) the outputs may overlap any of the inputs
+ */
+static void one_at_a_time( unsigned char *output[],
+		   const unsigned char *input[], unsigned num_inputs,
+		   const unsigned char *adr,
+		   unsigned num_lanes, struct ts_context *ctx ) {
+    unsigned n = PS_N(ctx->ps);
+    unsigned char result[TS_LANES][TS_MAX_HASH];
+    union t_iterator *t = TS_SMALL_ITER(ctx);
+
+    for (unsigned j = 0; j < num_lanes; j++) {
+	memcpy( ctx->adr, adr + j*ADR_SIZE, ADR_SIZE );
+	PS_INIT_T(ctx->ps)( t, ctx );
+	for (unsigned k = 0; k < num_inputs; k++) {
+	    PS_NEXT_T(ctx->ps)( t, input[j*num_inputs + k], ctx );
+	}
+	PS_FINAL_T(ctx->ps)( result[j], t, ctx );
+    }
+    for (unsigned j = 0; j < num_lanes; j++) {
+	memcpy( output[j], result[j], n );
+    }
+}
+
+void ts_t_lanes( unsigned char *output[],
+		   const unsigned char *input[], unsigned num_inputs,
+		   const unsigned char *adr,
+		   unsigned num_lanes, struct ts_context *ctx ) {
+    if (!TS_SUPPORT_SHA2 || !PS_SHA2(ctx->ps)) {
+#if TS_SUPPORT_SHAKE
+	shake256_lanes( output, input, num_inputs, adr, num_lanes, ctx );
+#endif
+    } else if (num_inputs == 1 || PS_N(ctx->ps) <= 16) {
+	/* F and PRF always use SHA-256; so does H for L1 */
+#if TS_SUPPORT_SHA2
+	sha256_lanes( output, input, num_inputs, adr, num_lanes, ctx );
+#endif
+    } else {
+	one_at_a_time( output, input, num_inputs, adr, num_lanes, ctx );
+    }
+}
+
+#endif /* TS_MULTI_LANE */
@@ -0,0 +1,202 @@
+/*
+ * This is the cache of verified hypertree paths; see pathcache.h for the
+ * API
+ *
+ * This is organized the same way as the key cache: the entries are kept
+ * on a doubly linked list in most recently used order, and are indexed by
+ * a chained hash table (with as many buckets as entries)
+ */
+#include <string.h>
+#include <stdint.h>
+#include "pathcache.h"
+#include "internal.h"
+
+#define NONE ((unsigned)-1)
+
+struct ts_path_cache_entry {
+    const struct ts_parameter_set *ps;
+    unsigned char public_key[2*TS_MAX_HASH];
+    struct ts_path_point point;
+    unsigned char digest[TS_PATH_DIGEST_SIZE]; /* Of the rest of the */
+                                /* signature */
+    unsigned prev, next;        /* The LRU list */
+    unsigned hash_next;         /* The next entry in this bucket */
+    unsigned char valid;        /* Set if this has been filled in */
+};
+
+size_t ts_path_cache_entry_size(void) {
+    return sizeof(struct ts_path_cache_entry) + sizeof(unsigned);
+}
+
+static void lock( struct ts_path_cache *cache ) {
+    if (cache->lock) cache->lock( cache->lock_arg );
+}
+
+static void unlock( struct ts_path_cache *cache ) {
+    if (cache->unlock) cache->unlock( cache->lock_arg );
+}
+
+/* FNV-1a over the public key and the point, mixed with the parameter set */
+static uint32_t fnv( uint32_t h, const unsigned char *p, unsigned len ) {
+    while (len--) {
+	h = (h ^ *p++) * 16777619U;
+    }
+    return h;
+}
+
+static unsigned bucket( const struct ts_path_cache *cache,
+                        const struct ts_parameter_set *ps,
+                        const unsigned char *public_key,
+                        const struct ts_path_point *point ) {
+    unsigned n = PS_N(ps);
+    unsigned char where[13];
+    where[0] = (unsigned char)point->layer;
+    for (int i = 0; i < 8; i++) {
+	where[1+i] = (unsigned char)(point->tree_address >> (8*i));
+    }
+    for (int i = 0; i < 4; i++) {
+	where[9+i] = (unsigned char)(point->leaf >> (8*i));
+    }
+    uint32_t h = 2166136261U ^ (uint32_t)(uintptr_t)ps;
+    h = fnv( h, public_key, 2*n );
+    h = fnv( h, where, sizeof where );
+    h = fnv( h, point->root, n );
+    return h % cache->num_entries;
+}
+
+static int same_point( const struct ts_path_cache_entry *e,
+                       const struct ts_parameter_set *ps,
+                       const unsigned char *public_key,
+                       const struct ts_path_point *point ) {
+    unsigned n = PS_N(ps);
+    return e->ps == ps &&
+	   e->point.layer == point->layer &&
+	   e->point.tree_address == point->tree_address &&
+	   e->point.leaf == point->leaf &&
+	   0 == memcmp( e->point.root, point->root, n ) &&
+	   0 == memcmp( e->public_key, public_key, 2*n );
+}
+
+static void lru_remove( struct ts_path_cache *cache, unsigned i ) {
+    struct ts_path_cache_entry *e = &cache->entries[i];
+    if (e->prev == NONE) cache->lru_head = e->next;
+    else cache->entries[e->prev].next = e->next;
+    if (e->next == NONE) cache->lru_tail = e->prev;
+    else cache->entries[e->next].prev = e->prev;
+}
+
+static void lru_push_front( struct ts_path_cache *cache, unsigned i ) {
+    struct ts_path_cache_entry *e = &cache->entries[i];
+    e->prev = NONE;
+    e->next = cache->lru_head;
+    if (cache->lru_head == NONE) cache->lru_tail = i;
+    else cache->entries[cache->lru_head].prev = i;
+    cache->lru_head = i;
+}
+
+unsigned ts_path_cache_init( struct ts_path_cache *cache,
+                   void *memory, size_t len_memory,
+                   void (*lock_func)(void *), void (*unlock_func)(void *),
+                   void *lock_arg ) {
+    if (!cache) return 0;
+    memset( cache, 0, sizeof *cache );
+    if (!memory) return 0;
+
+    /* Align the entries */
+    size_t align = sizeof(uint64_t);
+    size_t skip = (align - (uintptr_t)memory % align) % align;
+    if (len_memory < skip) return 0;
+    size_t num_entries = (len_memory - skip) / ts_path_cache_entry_size();
+    if (num_entries >= NONE) num_entries = NONE - 1;
+    if (num_entries == 0) return 0;
+
+    cache->entries = (struct ts_path_cache_entry *)
+	                              ((unsigned char *)memory + skip);
+    cache->buckets = (unsigned *)(cache->entries + num_entries);
+    cache->num_entries = num_entries;
+    cache->lock = lock_func;
+    cache->unlock = unlock_func;
+    cache->lock_arg = lock_arg;
+
+    cache->lru_head = cache->lru_tail = NONE;
+    for (unsigned i = 0; i < cache->num_entries; i++) {
+	struct ts_path_cache_entry *e = &cache->entries[i];
+	e->valid = 0;
+	e->hash_next = NONE;
+	lru_push_front( cache, i );
+	cache->buckets[i] = NONE;
+    }
+
+    return cache->num_entries;
+}
+
+/* Find the entry for this point (or NONE); called with the lock held */
+static unsigned find( struct ts_path_cache *cache, unsigned b,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key,
+                   const struct ts_path_point *point ) {
+    unsigned i;
+    for (i = cache->buckets[b]; i != NONE; i = cache->entries[i].hash_next) {
+	if (same_point( &cache->entries[i], ps, public_key, point )) break;
+    }
+    return i;
+}
+
+int ts_path_cache_check( struct ts_path_cache *cache,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key,
+                   const struct ts_path_point *point,
+                   const unsigned char *digest ) {
+    if (!cache || cache->num_entries == 0) return 0;
+    unsigned b = bucket( cache, ps, public_key, point );
+
+    lock( cache );
+    unsigned i = find( cache, b, ps, public_key, point );
+    int found = i != NONE && 0 == memcmp( cache->entries[i].digest, digest,
+			                  TS_PATH_DIGEST_SIZE );
+    if (found) {
+	cache->hits++;
+	lru_remove( cache, i );
+	lru_push_front( cache, i );
+    } else {
+	cache->misses++;
+    }
+    unlock( cache );
+
+    return found;
+}
+
+void ts_path_cache_add( struct ts_path_cache *cache,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key,
+                   const struct ts_path_point *point,
+                   const unsigned char *digest ) {
+    if (!cache || cache->num_entries == 0) return;
+    unsigned n = PS_N(ps);
+    unsigned b = bucket( cache, ps, public_key, point );
+
+    lock( cache );
+    unsigned i = find( cache, b, ps, public_key, point );
+    if (i == NONE) {
+	/* Take over the least recently used entry, unlinking it from */
+	/* the hash chain it was on */
+	i = cache->lru_tail;
+	struct ts_path_cache_entry *e = &cache->entries[i];
+	if (e->valid) {
+	    unsigned *p = &cache->buckets[ bucket( cache, e->ps,
+				    e->public_key, &e->point ) ];
+	    while (*p != i) p = &cache->entries[*p].hash_next;
+	    *p = e->hash_next;
+	}
+	e->ps = ps;
+	memcpy( e->public_key, public_key, 2*n );
+	e->point = *point;
+	e->valid = 1;
+	e->hash_next = cache->buckets[b];
+	cache->buckets[b] = i;
+    }
+    memcpy( cache->entries[i].digest, digest, TS_PATH_DIGEST_SIZE );
+    lru_remove( cache, i );
+    lru_push_front( cache, i );
+    unlock( cache );
+}
@@ -0,0 +1,97 @@
+#if !defined( PATHCACHE_H_ )
+#define PATHCACHE_H_
+
+/*
+ * This is a cache of hypertree paths that have already been verified, for
+ * verifiers that see a lot of signatures from the same signer (e.g.
+ * package repositories, firmware update servers).
+ *
+ * Two signatures from the same key that pass through the same Merkle tree
+ * in an upper hypertree layer carry exactly the same bytes from there up
+ * (the WOTS signatures and authentication paths depend only on the root
+ * that's being signed, and where it is).  So, once a signature verifies,
+ * we remember, for each upper layer, where the signature entered that
+ * layer (the public key, the layer, the tree address, the leaf and the
+ * root from the layer below) along with a digest of the rest of the
+ * signature from that point on.  When a later signature reaches a point
+ * that's in the cache, and the rest of its bytes have the same digest, we
+ * know that the rest would verify (it's the same computation on the same
+ * inputs), and so we needn't do the hashing.  If the digest differs, we
+ * verify the rest the usual way; hence this accepts and rejects exactly
+ * the same signatures that a full verification would.
+ *
+ * This is used by ts_verify_oneshot_cached (see verify_mt.h), which needs
+ * the entire signature at hand.  Like the key cache, it lives in memory
+ * that the application provides, and if multiple threads share a cache,
+ * pass lock/unlock functions to ts_path_cache_init
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tiny_sphincs.h"
+
+#define TS_PATH_DIGEST_SIZE 32  /* We use SHA-256 for the digests */
+
+struct ts_path_cache_entry;
+
+struct ts_path_cache {
+    struct ts_path_cache_entry *entries;
+    unsigned *buckets;      /* Hash table; the first entry in each chain */
+    unsigned num_entries;
+    unsigned lru_head;      /* The most recently used entry */
+    unsigned lru_tail;      /* The least recently used entry */
+    void (*lock)(void *);
+    void (*unlock)(void *);
+    void *lock_arg;
+    unsigned long hits, misses;  /* Statistics */
+};
+
+/*
+ * Where a signature enters a hypertree layer
+ */
+struct ts_path_point {
+    unsigned layer;          /* The hypertree layer */
+    uint64_t tree_address;   /* Which Merkle tree within that layer */
+    unsigned leaf;           /* Which leaf of that tree */
+    unsigned char root[TS_MAX_HASH]; /* The root of the layer below, that */
+                             /* is, what the leaf signs */
+};
+
+/*
+ * The number of bytes of memory the cache uses per entry
+ */
+size_t ts_path_cache_entry_size(void);
+
+/*
+ * Set up a cache in the given memory.  lock and unlock may be NULL (if the
+ * cache is used by only one thread); if not, they're called with lock_arg.
+ * This returns the number of entries in the cache (0 if the memory isn't
+ * enough for even one)
+ */
+unsigned ts_path_cache_init( struct ts_path_cache *cache,
+                   void *memory, size_t len_memory,
+                   void (*lock)(void *), void (*unlock)(void *),
+                   void *lock_arg );
+
+/*
+ * Check if we've verified the rest of a signature from this point on,
+ * and it had this digest.  Returns 1 if so
+ */
+int ts_path_cache_check( struct ts_path_cache *cache,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key,
+                   const struct ts_path_point *point,
+                   const unsigned char *digest );
+
+/*
+ * Record that the rest of a signature from this point on (which had this
+ * digest) verified.  This evicts the least recently used entry if there's
+ * no room
+ */
+void ts_path_cache_add( struct ts_path_cache *cache,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key,
+                   const struct ts_path_point *point,
+                   const unsigned char *digest );
+
+#endif /* PATHCACHE_H_ */
@@ -0,0 +1,144 @@
+/*
+ * This is a pool of ts_contexts, living within memory that the application
+ * provides; see pool.h for the API
+ *
+ * Each slot looks like this:
+ *    - The context itself (at the start of the slot, and so cache line
+ *      aligned)
+ *    - A small header, which tracks whether the slot is in use, its current
+ *      generation, and (if free) the next free slot
+ *    - Padding out to the next cache line
+ * A handle is the slot index (in the low TS_POOL_INDEX_BITS bits) combined
+ * with the slot's generation when it was acquired; we bump the generation
+ * on every release, so an old handle to a slot that has since been
+ * reacquired no longer matches
+ */
+#include <string.h>
+#include "pool.h"
+#include "internal.h"
+
+#define TS_POOL_INDEX_BITS 20
+#define TS_POOL_MAX_SLOTS  ((1U << TS_POOL_INDEX_BITS) - 1)
+#define TS_POOL_MAX_GEN    ((1U << (32 - TS_POOL_INDEX_BITS)) - 1)
+
+struct slot_header {
+    uint32_t generation;    /* 1..TS_POOL_MAX_GEN; never 0, so that a */
+                            /* valid handle is never TS_POOL_INVALID */
+    uint32_t next_free;     /* If free, the next free slot */
+    unsigned char in_use;
+};
+
+#define ROUND_UP(a, b) (((a) + (b) - 1) / (b) * (b))
+
+static size_t context_size( const struct ts_parameter_set *ps ) {
+    return ps ? ts_context_size(ps) : sizeof(struct ts_context);
+}
+
+size_t ts_pool_slot_size( const struct ts_parameter_set *ps ) {
+    return ROUND_UP( ROUND_UP( context_size(ps), sizeof(uint32_t) ) +
+                     sizeof(struct slot_header), TS_POOL_ALIGN );
+}
+
+static struct slot_header *header( const struct ts_pool *pool,
+                                   unsigned index ) {
+    return (struct slot_header *)(pool->slots + index * pool->slot_size +
+                         ROUND_UP( pool->context_size, sizeof(uint32_t) ));
+}
+
+/*
+ * Overwrite the memory in a way the compiler won't optimize away (as it
+ * could decide no one reads the memory afterwards)
+ */
+static void zeroize( void *p, size_t n ) {
+    volatile unsigned char *q = p;
+    while (n--) {
+	*q++ = 0;
+    }
+}
+
+unsigned ts_pool_init( struct ts_pool *pool, void *memory, size_t len_memory,
+                       const struct ts_parameter_set *ps ) {
+    if (!pool) return 0;
+    memset( pool, 0, sizeof *pool );
+    if (!memory) return 0;
+
+    /* Start at the first cache line boundary */
+    size_t skip = (TS_POOL_ALIGN - (uintptr_t)memory % TS_POOL_ALIGN) %
+	                                                   TS_POOL_ALIGN;
+    if (len_memory < skip) return 0;
+
+    pool->slots = (unsigned char *)memory + skip;
+    pool->context_size = context_size(ps);
+    pool->slot_size = ts_pool_slot_size(ps);
+    size_t num_slots = (len_memory - skip) / pool->slot_size;
+    if (num_slots > TS_POOL_MAX_SLOTS) num_slots = TS_POOL_MAX_SLOTS;
+    pool->num_slots = num_slots;
+    pool->num_free = num_slots;
+
+    /* Put every slot onto the free list, in order */
+    for (unsigned i = 0; i < pool->num_slots; i++) {
+	struct slot_header *h = header( pool, i );
+	h->generation = 1;
+	h->next_free = i + 1;
+	h->in_use = 0;
+    }
+    pool->free_list = 0;
+
+    return pool->num_slots;
+}
+
+ts_pool_handle ts_pool_acquire( struct ts_pool *pool ) {
+    if (!pool || pool->free_list >= pool->num_slots) {
+	return TS_POOL_INVALID;  /* Everything's in use */
+    }
+    unsigned index = pool->free_list;
+    struct slot_header *h = header( pool, index );
+    pool->free_list = h->next_free;
+    pool->num_free--;
+    h->in_use = 1;
+
+    return ((ts_pool_handle)h->generation << TS_POOL_INDEX_BITS) | index;
+}
+
+/*
+ * If this handle refers to an acquired slot, return its index; otherwise
+ * return -1
+ */
+static long lookup( const struct ts_pool *pool, ts_pool_handle handle ) {
+    if (!pool) return -1;
+    unsigned index = handle & TS_POOL_MAX_SLOTS;
+    uint32_t generation = handle >> TS_POOL_INDEX_BITS;
+    if (index >= pool->num_slots) return -1;
+    struct slot_header *h = header( pool, index );
+    if (!h->in_use || h->generation != generation) return -1;
+    return index;
+}
+
+struct ts_context *ts_pool_context( const struct ts_pool *pool,
+                                    ts_pool_handle handle ) {
+    long index = lookup( pool, handle );
+    if (index < 0) return 0;
+    return (struct ts_context *)(pool->slots + index * pool->slot_size);
+}
+
+int ts_pool_release( struct ts_pool *pool, ts_pool_handle handle ) {
+    long index = lookup( pool, handle );
+    if (index < 0) return 0;
+
+    /* The context may hold secret values (such as the WOTS and FORS */
+    /* stacks while signing); clear it out */
+    zeroize( pool->slots + index * pool->slot_size, pool->context_size );
+
+    struct slot_header *h = header( pool, index );
+    h->in_use = 0;
+    if (h->generation == TS_POOL_MAX_GEN) {
+	h->generation = 1;
+    } else {
+	h->generation++;
+    }
+    h->next_free = pool->free_list;
+    pool->free_list = index;
+    pool->num_free++;
+
+    return 1;
+}
@@ -0,0 +1,95 @@
+#if !defined( POOL_H_ )
+#define POOL_H_
+
+/*
+ * This is a pool of ts_contexts, for applications (such as a signing
+ * gateway) that have a large number of signatures or verifications in
+ * flight at once.  The pool lives in a single block of memory that the
+ * application provides; it is carved into slots (each holding one context
+ * sized for a given parameter set, see ts_context_size), and each slot is
+ * aligned to a cache line (so that contexts being used by different
+ * threads don't share a cache line).  Acquiring and releasing a context
+ * are O(1), and contexts are referred to by handle (so that a stale handle
+ * to a released context is detected, rather than silently referring to
+ * someone else's context).  When a context is released, we wipe it (as a
+ * signing context holds values derived from the private key).
+ *
+ * This is meant to be used this way:
+ *
+ * struct ts_pool pool;
+ * ts_pool_init( &pool, memory, len_memory, &ts_ps_sha2_128f_simple );
+ *
+ * ts_pool_handle h = ts_pool_acquire( &pool );
+ * if (h == TS_POOL_INVALID) ... all the contexts are in use ...
+ * struct ts_context *ctx = ts_init_sign_buffer( ts_pool_context( &pool, h ),
+ *                           pool.context_size, message, len_message,
+ *                           &ts_ps_sha2_128f_simple, private_key, rng );
+ * ... ts_sign( buffer, len_buffer, ctx ) as the client drains the signature
+ * ts_pool_release( &pool, h );
+ *
+ * A pool is not thread safe; either serialize calls to the ts_pool_xxx
+ * functions for a pool, or (simpler) give each worker thread its own pool.
+ * Once a context has been acquired, it can be used by any one thread
+ * without locking the pool
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tiny_sphincs.h"
+
+typedef uint32_t ts_pool_handle;
+#define TS_POOL_INVALID 0   /* Never returned as a valid handle */
+
+#define TS_POOL_ALIGN 64    /* The cache line size we align slots to */
+
+struct ts_pool {
+    unsigned char *slots;   /* The first slot */
+    size_t slot_size;       /* Bytes per slot (a multiple of TS_POOL_ALIGN) */
+    size_t context_size;    /* Bytes within each slot usable as a context */
+    unsigned num_slots;     /* The number of slots */
+    unsigned num_free;      /* The number of slots not currently acquired */
+    unsigned free_list;     /* The first free slot (num_slots if none) */
+};
+
+/*
+ * The number of bytes each slot in a pool for this parameter set takes
+ * (ps == NULL means the pool can hold contexts for any parameter set)
+ * A pool with N slots needs N * ts_pool_slot_size(ps) + TS_POOL_ALIGN - 1
+ * bytes of memory (or exactly N * ts_pool_slot_size(ps) if the memory is
+ * already aligned)
+ */
+size_t ts_pool_slot_size( const struct ts_parameter_set *ps );
+
+/*
+ * Set up a pool in the given memory, with contexts large enough for the
+ * parameter set ps (or any parameter set, if ps is NULL).  The pool can
+ * also be used with other parameter sets with a ts_context_size no larger
+ * than that.  The memory must remain valid while the pool is in use.
+ * This returns the number of slots in the pool (0 if the memory isn't
+ * enough for even one)
+ */
+unsigned ts_pool_init( struct ts_pool *pool, void *memory, size_t len_memory,
+                       const struct ts_parameter_set *ps );
+
+/*
+ * Get a free context from the pool.  Returns TS_POOL_INVALID if all of them
+ * are in use
+ */
+ts_pool_handle ts_pool_acquire( struct ts_pool *pool );
+
+/*
+ * Get the context (pool->context_size bytes) that a handle refers to.
+ * Returns NULL if the handle isn't currently acquired (e.g. it has been
+ * released).  The context is uninitialized when first acquired; set it
+ * up with ts_init_sign_buffer or ts_init_verify_buffer
+ */
+struct ts_context *ts_pool_context( const struct ts_pool *pool,
+                                    ts_pool_handle handle );
+
+/*
+ * Wipe the context and return it to the pool.  Returns 1 on success, 0 if
+ * the handle wasn't currently acquired
+ */
+int ts_pool_release( struct ts_pool *pool, ts_pool_handle handle );
+
+#endif /* POOL_H_ */
@@ -0,0 +1,337 @@
+/*
+ * Precomputed upper hypertree layers; see precompute.h
+ *
+ * The file layout: a HEADER_SIZE byte header, and then the trees, top
+ * layer first, and within a layer, in tree address order.  Each tree is
+ * 2**(merkle_h+1) nodes long: the nodes on each level (the leaves first,
+ * in index order), and then the MAC of the root (which exactly fills out
+ * the power of two).  So, everything is at an offset we can compute
+ *
+ * The header is:
+ *   0  - 7   "TSNODES" and a NUL
+ *   8  - 11  Version (1), big endian
+ *   12 - 16  n, merkle_h, d, whether it's a SHA2 parameter set, and the
+ *            number of layers
+ *   20 - 83  The public key (2n bytes, zero padded)
+ *   84 - 115 SHA-256 of the entire file (with this field zeroed)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "precompute.h"
+#include "internal.h"
+#include "endian.h"
+#include "sha2.h"
+
+#define HEADER_SIZE     128
+#define VERSION         1
+#define CHECKSUM_OFFSET 84
+#define MAX_THREADS     64
+#define MAX_TREE_BITS   40  /* At most 2**40 trees on the bottom layer */
+
+static const char magic[8] = "TSNODES";
+
+/* The number of trees on the layers above layer (counting from the top) */
+static uint64_t trees_above( const struct ts_parameter_set *ps,
+	                     unsigned layer ) {
+    uint64_t count = 0;
+    for (unsigned i = 0; i < layer; i++) {
+	count += (uint64_t)1 << (i * PS_MERKLE_H(ps));
+    }
+    return count;
+}
+
+static size_t tree_size( const struct ts_parameter_set *ps ) {
+    return ((size_t)2 << PS_MERKLE_H(ps)) * PS_N(ps);
+}
+
+/*
+ * Whether we'll handle this many layers.  This is checked before anything
+ * is computed from layers (which, when we open a file, comes from the
+ * file), so that trees_above can't overflow
+ */
+static int valid_layers( const struct ts_parameter_set *ps,
+	                 unsigned layers ) {
+    return layers >= 1 && layers <= (unsigned)PS_D(ps) &&
+	   (layers - 1) * PS_MERKLE_H(ps) <= MAX_TREE_BITS;
+}
+
+size_t ts_precomputed_size( const struct ts_parameter_set *ps,
+		            unsigned layers ) {
+    if (!valid_layers( ps, layers )) return 0;
+    uint64_t trees = trees_above( ps, layers );
+    size_t size = tree_size( ps );
+    if (trees > (SIZE_MAX - HEADER_SIZE) / size) return 0;  /* Too big */
+    return HEADER_SIZE + (size_t)trees * size;
+}
+
+/*
+ * Where a node is, relative to the start of its tree.  The root's MAC is
+ * at height merkle_h+1
+ */
+static size_t node_offset( const struct ts_parameter_set *ps,
+	                   unsigned height, unsigned index ) {
+    unsigned h = PS_MERKLE_H(ps);
+    size_t position;
+    if (height > h) {
+	position = ((size_t)2 << h) - 1;
+    } else {
+	position = ((size_t)2 << h) - ((size_t)2 << (h - height));
+    }
+    return (position + index) * PS_N(ps);
+}
+
+/*
+ * Where a tree is, relative to the start of the file; returns 0 if it's
+ * not one we have
+ */
+static size_t tree_offset( const struct ts_parameter_set *ps,
+	                   unsigned layers, unsigned layer, uint64_t tree ) {
+    unsigned from_top = PS_D(ps) - 1 - layer;
+    if (layer >= (unsigned)PS_D(ps) || from_top >= layers ||
+	    tree >= (uint64_t)1 << (from_top * PS_MERKLE_H(ps))) {
+	return 0;
+    }
+    return HEADER_SIZE + (trees_above( ps, from_top ) + tree) *
+	                                                 tree_size( ps );
+}
+
+static void checksum( unsigned char *digest, const unsigned char *map,
+	              size_t len ) {
+    static const unsigned char zero[32];
+    SHA256_CTX ctx;
+    ts_SHA256_init( &ctx );
+    ts_SHA256_update( &ctx, map, CHECKSUM_OFFSET );
+    ts_SHA256_update( &ctx, zero, 32 );
+    ts_SHA256_update( &ctx, map + CHECKSUM_OFFSET + 32,
+		      len - CHECKSUM_OFFSET - 32 );
+    ts_SHA256_final( digest, &ctx );
+}
+
+static void write_header( unsigned char *header,
+	                  const struct ts_parameter_set *ps,
+			  const unsigned char *public_key, unsigned layers ) {
+    unsigned n = PS_N(ps);
+    memset( header, 0, HEADER_SIZE );
+    memcpy( header, magic, 8 );
+    ts_ull_to_bytes( &header[8], VERSION, 4 );
+    header[12] = n;
+    header[13] = PS_MERKLE_H(ps);
+    header[14] = PS_D(ps);
+    header[15] = PS_SHA2(ps) != 0;
+    header[16] = layers;
+    memcpy( &header[20], public_key, 2*n );
+}
+
+struct precompute_job {
+    const unsigned char *private_key;
+    const struct ts_parameter_set *ps;
+    unsigned layers;
+    unsigned char *map;
+    uint64_t num_trees;
+    uint64_t next_tree;         /* The next one (counting from the top) */
+                                /* no one has started on */
+    int failed;
+    pthread_mutex_t lock;       /* Protects next_tree and failed */
+};
+
+/* The tree a worker is filling in */
+struct tree_writer {
+    struct precompute_job *job;
+    unsigned char *tree;
+};
+
+static void store_node( const unsigned char *node, const unsigned char *mac,
+		   unsigned layer, uint64_t tree, unsigned height,
+		   unsigned index, void *arg ) {
+    struct tree_writer *w = arg;
+    const struct ts_parameter_set *ps = w->job->ps;
+    unsigned n = PS_N(ps);
+    (void)layer; (void)tree;
+    memcpy( w->tree + node_offset( ps, height, index ), node, n );
+    if (mac) {
+	memcpy( w->tree + node_offset( ps, PS_MERKLE_H(ps) + 1, 0 ), mac, n );
+    }
+}
+
+static void *precompute_worker( void *arg ) {
+    struct precompute_job *job = arg;
+    const struct ts_parameter_set *ps = job->ps;
+    struct tree_writer w;
+    struct ts_node_cache cache = { store_node, 0, &w };
+    w.job = job;
+
+    for (;;) {
+	pthread_mutex_lock( &job->lock );
+	uint64_t i = job->next_tree;
+	int done = job->failed || i >= job->num_trees;
+	if (!done) job->next_tree++;
+	pthread_mutex_unlock( &job->lock );
+	if (done) break;
+
+	/* Which layer and tree that is */
+	unsigned from_top = 0;
+	while (i >= trees_above( ps, from_top + 1 )) from_top++;
+	unsigned layer = PS_D(ps) - 1 - from_top;
+	uint64_t tree = i - trees_above( ps, from_top );
+
+	w.tree = job->map + tree_offset( ps, job->layers, layer, tree );
+	if (!ts_precompute_tree( job->private_key, ps, layer, tree, &cache )) {
+	    pthread_mutex_lock( &job->lock );
+	    job->failed = 1;
+	    pthread_mutex_unlock( &job->lock );
+	    break;
+	}
+    }
+    return 0;
+}
+
+int ts_precompute( const char *filename,
+		   const unsigned char *private_key,
+		   const struct ts_parameter_set *ps,
+		   unsigned layers, unsigned num_threads ) {
+    if (!filename || !private_key || !ps) return 0;
+    size_t len = ts_precomputed_size( ps, layers );
+    if (len == 0) return 0;
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS;
+
+    /* We write a temporary file next to it, and rename that over the */
+    /* old one once it's complete; that way, a signer that has the old */
+    /* file mapped keeps seeing the old contents, and a failure leaves */
+    /* the old file as it was */
+    char *temp_filename = malloc( strlen( filename ) + 8 );
+    if (!temp_filename) return 0;
+    sprintf( temp_filename, "%s.XXXXXX", filename );
+    int fd = mkstemp( temp_filename );
+    if (fd < 0) {
+	free( temp_filename );
+	return 0;
+    }
+    unsigned char *map = MAP_FAILED;
+    if (0 == fchmod( fd, 0644 ) && 0 == ftruncate( fd, len )) {
+	map = mmap( 0, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    }
+    close( fd );
+    if (map == MAP_FAILED) {
+	unlink( temp_filename );
+	free( temp_filename );
+	return 0;
+    }
+
+    struct precompute_job job;
+    job.private_key = private_key;
+    job.ps = ps;
+    job.layers = layers;
+    job.map = map;
+    job.num_trees = trees_above( ps, layers );
+    job.next_tree = 0;
+    job.failed = 0;
+    pthread_mutex_init( &job.lock, 0 );
+
+    /* Once, from this thread; see ts_init_backends */
+    ts_init_backends();
+
+    pthread_t threads[ MAX_THREADS ];
+    unsigned started = 0;
+    for (unsigned i = 1; i < num_threads; i++) {
+	if (0 != pthread_create( &threads[started], 0, precompute_worker,
+			         &job )) {
+	    break;
+	}
+	started++;
+    }
+    precompute_worker( &job );
+    for (unsigned i = 0; i < started; i++) {
+	pthread_join( threads[i], 0 );
+    }
+    pthread_mutex_destroy( &job.lock );
+
+    /* Now that everything is there, fill in the header and checksum */
+    unsigned n = PS_N(ps);
+    write_header( map, ps, CONVERT_PRIVATE_KEY_TO_PUBLIC( private_key, n ),
+		  layers );
+    checksum( &map[CHECKSUM_OFFSET], map, len );
+
+    int ok = !job.failed;
+    if (0 != msync( map, len, MS_SYNC )) ok = 0;
+    munmap( map, len );
+    if (ok && 0 != rename( temp_filename, filename )) ok = 0;
+    if (!ok) unlink( temp_filename );
+    free( temp_filename );
+    return ok;
+}
+
+static int fetch_node( unsigned char *node, unsigned char *mac,
+		   unsigned layer, uint64_t tree, unsigned height,
+		   unsigned index, void *arg ) {
+    struct ts_precomputed *pc = arg;
+    const struct ts_parameter_set *ps = pc->ps;
+    unsigned n = PS_N(ps);
+    size_t offset = tree_offset( ps, pc->layers, layer, tree );
+    if (offset == 0 || height > (unsigned)PS_MERKLE_H(ps) ||
+	    index >= 1U << (PS_MERKLE_H(ps) - height)) {
+	return 0;
+    }
+    memcpy( node, pc->map + offset + node_offset( ps, height, index ), n );
+    if (mac) {
+	memcpy( mac, pc->map + offset +
+			node_offset( ps, PS_MERKLE_H(ps) + 1, 0 ), n );
+    }
+    return 1;
+}
+
+int ts_open_precomputed( struct ts_precomputed *pc, const char *filename,
+		   const struct ts_parameter_set *ps,
+		   const unsigned char *public_key ) {
+    memset( pc, 0, sizeof *pc );
+    int fd = open( filename, O_RDONLY );
+    struct stat st;
+    if (fd < 0) return 0;
+    if (0 != fstat( fd, &st ) || st.st_size < HEADER_SIZE) {
+	close( fd );
+	return 0;
+    }
+    size_t len = st.st_size;
+    unsigned char *map = mmap( 0, len, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (map == MAP_FAILED) return 0;
+
+    /* Check that the header is what we'd have written */
+    unsigned layers = map[16];
+    unsigned char expected[HEADER_SIZE], digest[32];
+    write_header( expected, ps, public_key, layers );
+    int ok = 0 == memcmp( map, expected, CHECKSUM_OFFSET ) &&
+	     valid_layers( ps, layers ) &&
+	     len == ts_precomputed_size( ps, layers );
+    if (ok) {
+	checksum( digest, map, len );
+	ok = 0 == memcmp( digest, &map[CHECKSUM_OFFSET], 32 );
+    }
+    if (!ok) {
+	munmap( map, len );
+	return 0;
+    }
+
+    /* The signer looks things up all over the place */
+    madvise( map, len, MADV_RANDOM );
+    pc->map = map;
+    pc->len_map = len;
+    pc->ps = ps;
+    pc->layers = layers;
+    pc->cache.store = 0;
+    pc->cache.fetch = fetch_node;
+    pc->cache.arg = pc;
+    return 1;
+}
+
+void ts_close_precomputed( struct ts_precomputed *pc ) {
+    if (pc->map) munmap( (void *)pc->map, pc->len_map );
+    memset( pc, 0, sizeof *pc );
+}
@@ -0,0 +1,75 @@
+#if !defined( PRECOMPUTE_H_ )
+#define PRECOMPUTE_H_
+
+/*
+ * Precomputed upper hypertree layers, for host based signers.
+ *
+ * Every signature goes through the top layers of the hypertree, and there
+ * aren't many trees up there (1 on the top layer, 2**(h/d) on the next,
+ * and so on), so it makes sense to compute them all once, ahead of time,
+ * and keep them in a file.  The signer maps the file, and uses it as its
+ * node cache (see ts_set_node_cache); for signatures, it then needs to
+ * compute only the lower layers.
+ *
+ * The file holds, for each tree on the precomputed layers, every node (the
+ * leaves, that is, the WOTS public keys, on up to the root) and the MAC
+ * the signer uses to recognize its roots.  It starts with a header (which
+ * says what key and parameter set it is for, and how many layers it has),
+ * and a SHA-256 checksum of the entire file.  Even if the file were to be
+ * modified, the signer wouldn't use anything from it that doesn't check
+ * out against the public key, or a MAC keyed with the private key; the
+ * checksum is there to catch accidents early.
+ *
+ * This uses POSIX threads and mmap, and so is host only
+ */
+
+#include <stddef.h>
+#include "tiny_sphincs.h"
+
+struct ts_precomputed {
+    struct ts_node_cache cache;     /* Hand this to ts_set_node_cache */
+
+    /* The rest is private */
+    const unsigned char *map;       /* The file */
+    size_t len_map;
+    const struct ts_parameter_set *ps;
+    unsigned layers;                /* How many of the top layers we have */
+};
+
+/*
+ * The size of the file for this many layers; 0 if ts_precompute wouldn't
+ * write one that big (too many layers, or more than 2**40 trees on the
+ * bottom one)
+ */
+size_t ts_precomputed_size( const struct ts_parameter_set *ps,
+		            unsigned layers );
+
+/*
+ * This computes the top layers of the hypertree for the private key,
+ * spread across num_threads threads (including the calling one; at most
+ * 64), and writes them to the file.  layers may be from 1 to d (but note
+ * that each layer has 2**(h/d) times as many trees as the one above it).
+ * An existing file is replaced only once the new one is complete (so a
+ * signer that has it open is unaffected).  Returns 1 on success, 0 on
+ * failure
+ */
+int ts_precompute( const char *filename,
+		   const unsigned char *private_key,
+		   const struct ts_parameter_set *ps,
+		   unsigned layers, unsigned num_threads );
+
+/*
+ * This maps in a file that ts_precompute wrote, and checks that it is for
+ * this public key and parameter set, and that the checksum is right.
+ * Returns 1 on success, 0 if not
+ */
+int ts_open_precomputed( struct ts_precomputed *pc, const char *filename,
+		   const struct ts_parameter_set *ps,
+		   const unsigned char *public_key );
+
+/*
+ * And this unmaps it
+ */
+void ts_close_precomputed( struct ts_precomputed *pc );
+
+#endif /* PRECOMPUTE_H_ */
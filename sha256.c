@@ -15,6 +15,7 @@
 #include "sha2.h"
 #include "internal.h"
 #include "endian.h"
+#include "backend.h"
 
 #define SHA256_FINALCOUNT_SIZE 8
 #define NUM_ROUNDS 64
@@ -52,7 +53,7 @@ static uint32_t RORc(uint32_t x, int rot) {
 #define Gamma0(x)       (S(x, 7) ^ S(x, 18) ^ R(x, 3))
 #define Gamma1(x)       (S(x, 17) ^ S(x, 19) ^ R(x, 10))
 
-static void compress( SHA256_CTX *ctx, const void *buf ) {
+void ts_SHA256_compress_scalar( SHA256_CTX *ctx, const void *buf ) {
     uint32_t S0, S1, S2, S3, S4, S5, S6, S7, t0, t1, t;
     unsigned i;
     const unsigned char *p;
@@ -146,7 +147,7 @@ void ts_SHA256_update( SHA256_CTX *ctx, const void *src, uint64_t input_count )
         input_count -= this_step;
         ctx->num = 0;
 
-        compress( ctx, this_block );
+        TS_SHA256_COMPRESS( ctx, this_block );
     }
 }
 
@@ -17,9 +17,9 @@ void ts_sha2_L1_prf_msg( unsigned char *output,
 	             const unsigned char *opt_buffer,
 		     const unsigned char *message, size_t len_message,
 		     struct ts_context *sc ) {
-    unsigned n = sc->ps->n;
+    unsigned n = PS_N(sc->ps);
     const unsigned char *public_key = sc->public_key;
-    SHA256_CTX *ctx = &sc->small_iter.sha2_L1_simple;
+    SHA256_CTX *ctx = &TS_SMALL_ITER(sc)->sha2_L1_simple;
     unsigned char block[sha256_block_size];
     unsigned char hash_output[32];  /* This holds the entire inner hash, even if */
 	                            /* n < 32.  That's because we're during a */
@@ -52,9 +52,9 @@ void ts_sha2_L1_hash_msg( unsigned char *output, size_t len_output,
 		     const unsigned char *randomness,
 		     const unsigned char *message, size_t len_message,
 		     struct ts_context *sc ) {
-    unsigned n = sc->ps->n;
+    unsigned n = PS_N(sc->ps);
     const unsigned char *public_key = sc->public_key;
-    SHA256_CTX *ctx = &sc->small_iter.sha2_L1_simple;
+    SHA256_CTX *ctx = &TS_SMALL_ITER(sc)->sha2_L1_simple;
     unsigned char msg_hash[2*TS_MAX_HASH + 32 + 4];
     ts_SHA256_init( ctx );
     ts_SHA256_update( ctx, randomness, n );
@@ -36,7 +36,7 @@ void ts_sha2_L1_init_t_simple( union t_iterator *t,
 /* We call this with each of the inputs in succession */
 void ts_sha2_L1_next_t_simple( union t_iterator *t, const unsigned char *input,
 		     const struct ts_context *ctx ) {
-    int n = ctx->ps->n;
+    int n = PS_N(ctx->ps);
     ts_SHA256_update( &t->sha2_L1_simple, input, n );
 }
 
@@ -44,7 +44,7 @@ void ts_sha2_L1_next_t_simple( union t_iterator *t, const unsigned char *input,
 /* output to T(input1, input2, ..., inputn) */
 void ts_sha2_L1_final_t_simple(unsigned char *output, union t_iterator *t,
 		    const struct ts_context *ctx ) {
-    int n = ctx->ps->n;
+    int n = PS_N(ctx->ps);
     ts_SHA256_final_trunc( output, &t->sha2_L1_simple, n );
 }
 
@@ -57,8 +57,8 @@ void ts_sha2_L1_final_t_simple(unsigned char *output, union t_iterator *t,
  * this once saves quite a bit of time
  */
 void ts_sha2_L1_prehash( struct ts_context *sc ) {
-    int n = sc->ps->n;
-    SHA256_CTX *ctx = &sc->small_iter.sha2_L1_simple;
+    int n = PS_N(sc->ps);
+    SHA256_CTX *ctx = &TS_SMALL_ITER(sc)->sha2_L1_simple;
     ts_SHA256_init( ctx );
 
     ts_SHA256_update( ctx, CONVERT_PUBLIC_KEY_TO_PUB_SEED(sc->public_key, n ), n );
@@ -18,8 +18,8 @@
  */
 void ts_sha2_prf( unsigned char *output,
 		     struct ts_context *sc ) {
-    int n = sc->ps->n;
-    SHA256_CTX *ctx = &sc->small_iter.sha2_L1_simple;
+    int n = PS_N(sc->ps);
+    SHA256_CTX *ctx = &TS_SMALL_ITER(sc)->sha2_L1_simple;
     ts_sha256_init_ctx( ctx, sc );
 
     ts_SHA256_update( ctx, sc->adr, SHA2_ADR_SIZE );
@@ -45,7 +45,7 @@ void ts_sha256_init_ctx( SHA256_CTX *ctx,
      */
     ts_SHA256_init( ctx );
 
-    int n = sc->ps->n;
+    int n = PS_N(sc->ps);
     ts_SHA256_update( ctx, CONVERT_PUBLIC_KEY_TO_PUB_SEED(sc->public_key, n), n);
 
     for (int i = n; i < sha256_block_size; i++) {
@@ -0,0 +1,85 @@
+/*
+ * SHA-256 compression function using the x86 SHA extensions (SHA-NI)
+ *
+ * This is selected at runtime (by ts_init_backends) only if the CPU
+ * advertises the SHA extensions (and SSE4.1); we build it with a target
+ * attribute, so that the rest of the package doesn't need to be compiled
+ * with those instructions enabled
+ *
+ * The round structure follows the Intel SHA extensions white paper
+ */
+#include "backend.h"
+
+#if TS_BACKEND_DISPATCH && TS_HAVE_SHA_NI
+
+#include <immintrin.h>
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+__attribute__((target("sha,sse4.1")))
+void ts_SHA256_compress_sha_ni( SHA256_CTX *ctx, const void *buf ) {
+    const __m128i byteswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                            0x0405060700010203ULL);
+    const unsigned char *p = (const unsigned char *)buf;
+    __m128i state0, state1, save0, save1, tmp, msg;
+    __m128i W[4];   /* The last 16 words of the message schedule */
+    unsigned i;
+
+    /*
+     * The SHA-NI instructions want the state as ABEF and CDGH, rather than
+     * ABCD EFGH
+     */
+    tmp = _mm_loadu_si128((const __m128i *)&ctx->h[0]);    /* ABCD */
+    state1 = _mm_loadu_si128((const __m128i *)&ctx->h[4]); /* EFGH */
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);                    /* CDAB */
+    state1 = _mm_shuffle_epi32(state1, 0x1B);              /* EFGH */
+    state0 = _mm_alignr_epi8(tmp, state1, 8);              /* ABEF */
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);           /* CDGH */
+    save0 = state0;
+    save1 = state1;
+
+    /* Each iteration does four rounds */
+    for (i = 0; i < 16; i++) {
+        if (i < 4) {
+            W[i] = _mm_shuffle_epi8(
+                      _mm_loadu_si128((const __m128i *)(p + 16*i)), byteswap);
+        } else {
+            /* W[i&3] currently holds the words from 16 rounds ago */
+            tmp = _mm_sha256msg1_epu32(W[i&3], W[(i+1)&3]);
+            tmp = _mm_add_epi32(tmp, _mm_alignr_epi8(W[(i+3)&3],
+                                                     W[(i+2)&3], 4));
+            W[i&3] = _mm_sha256msg2_epu32(tmp, W[(i+3)&3]);
+        }
+        msg = _mm_add_epi32(W[i&3],
+                            _mm_loadu_si128((const __m128i *)&K[4*i]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    }
+
+    /* feedback */
+    state0 = _mm_add_epi32(state0, save0);
+    state1 = _mm_add_epi32(state1, save1);
+
+    /* And convert back to ABCD EFGH */
+    tmp = _mm_shuffle_epi32(state0, 0x1B);                 /* FEBA */
+    state1 = _mm_shuffle_epi32(state1, 0xB1);              /* DCHG */
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);           /* DCBA */
+    state1 = _mm_alignr_epi8(state1, tmp, 8);              /* ABEF */
+    _mm_storeu_si128((__m128i *)&ctx->h[0], state0);
+    _mm_storeu_si128((__m128i *)&ctx->h[4], state1);
+}
+
+#endif
@@ -2,7 +2,8 @@
 #include "sha2_func.h"
 #include "tune.h"
 
-#if TS_SUPPORT_SHA2 && (TS_SUPPORT_L5 || TS_SUPPORT_L3) && TS_SUPPORT_S
+#if TS_SUPPORT_SHA2 && (TS_SUPPORT_L5 || TS_SUPPORT_L3) && TS_SUPPORT_S && \
+    TS_PS_ENABLED(TS_PS_SHA2_192S_SIMPLE)
 
 const struct ts_parameter_set ts_ps_sha2_192s_simple = {
     24,                /* Size of the hash */
@@ -12,6 +13,8 @@ const struct ts_parameter_set ts_ps_sha2_192s_simple = {
     7,                 /* # of levels of Merkle trees */
     9,                 /* Height of each Merkle tree = h/d */
     1,                 /* This is a SHA-2 parameter set */
+    4,                 /* log2(w); w = 16 */
+    51,                /* # of WOTS digits = 2n+3 */
 
     ts_sha2_L35_prf_msg, /* prf_msg */
     ts_sha2_L35_hash_msg, /* hash_msg */
@@ -2,7 +2,8 @@
 #include "sha2_func.h"
 #include "tune.h"
 
-#if TS_SUPPORT_SHA2 && TS_SUPPORT_L5
+#if TS_SUPPORT_SHA2 && TS_SUPPORT_L5 && \
+    TS_PS_ENABLED(TS_PS_SHA2_256F_SIMPLE)
 
 const struct ts_parameter_set ts_ps_sha2_256f_simple = {
     32,                /* Size of the hash */
@@ -12,6 +13,8 @@ const struct ts_parameter_set ts_ps_sha2_256f_simple = {
     17,                /* # of levels of Merkle trees */
     4,                 /* Height of each Merkle tree = h/d */
     1,                 /* This is a SHA-2 parameter set */
+    4,                 /* log2(w); w = 16 */
+    67,                /* # of WOTS digits = 2n+3 */
 
     ts_sha2_L35_prf_msg, /* prf_msg */
     ts_sha2_L35_hash_msg, /* hash_msg */
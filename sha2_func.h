@@ -1,3 +1,6 @@
+#if !defined( SHA2_FUNC_H_ )
+#define SHA2_FUNC_H_
+
 #include <stddef.h>
 #include "tiny_sphincs.h"
 
@@ -47,3 +50,5 @@ struct SHA512_CTX;
 void ts_sha512_init_ctx( struct SHA512_CTX *sha_ctx,
 		     struct ts_context *ctx );
 void ts_sha2_L35_prehash( struct ts_context *ctx );
+
+#endif /* SHA2_FUNC_H_ */
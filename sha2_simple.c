@@ -14,8 +14,8 @@
 void ts_sha2_f_simple( unsigned char *output,
 	             const unsigned char *inblock,
 	             struct ts_context *sc) {
-    SHA256_CTX *ctx = &sc->small_iter.sha2_L1_simple;
-    int n = sc->ps->n;
+    SHA256_CTX *ctx = &TS_SMALL_ITER(sc)->sha2_L1_simple;
+    int n = PS_N(sc->ps);
     ts_sha256_init_ctx( ctx, sc );
 
     ts_SHA256_update( ctx, sc->adr, SHA2_ADR_SIZE );
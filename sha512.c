@@ -14,6 +14,7 @@
 #include <string.h>
 #include "sha2.h"
 #include "endian.h"
+#include "backend.h"
 
 /* 
  * Do not change these #define values. They are defined to appease
@@ -77,7 +78,7 @@ static const unsigned long long K[SHA512_K_SIZE] = {
 #define Gamma0(x)       (S(x, 1) ^ S(x, 8) ^ R(x, 7))
 #define Gamma1(x)       (S(x, 19) ^ S(x, 61) ^ R(x, 6))
 
-static void sha512_compress (SHA512_CTX * ctx, const void *buf) {
+void ts_SHA512_compress_scalar (SHA512_CTX * ctx, const void *buf) {
     uint64_t S[SHA512_S_SIZE], t0, t1;
     int i;
 
@@ -165,7 +166,7 @@ void ts_SHA512_update( SHA512_CTX *ctx, const void *src, uint64_t input_count )
         input_count -= this_step;
         ctx->in_buffer = 0;
 
-        sha512_compress( ctx, this_block );
+        TS_SHA512_COMPRESS( ctx, this_block );
     }
 }
 
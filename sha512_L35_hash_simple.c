@@ -34,7 +34,7 @@ void ts_sha2_L35_init_t_simple( union t_iterator *t,
 /* We call this with each of the inputs in succession */
 void ts_sha2_L35_next_t_simple( union t_iterator *t, const unsigned char *input,
 		     const struct ts_context *ctx ) {
-    int n = ctx->ps->n;
+    int n = PS_N(ctx->ps);
     ts_SHA512_update( &t->sha2_L35_simple, input, n );
 }
 
@@ -42,7 +42,7 @@ void ts_sha2_L35_next_t_simple( union t_iterator *t, const unsigned char *input,
 /* output to T(input1, input2, ..., inputn) */
 void ts_sha2_L35_final_t_simple(unsigned char *output, union t_iterator *t,
 		    const struct ts_context *ctx ) {
-    int n = ctx->ps->n;
+    int n = PS_N(ctx->ps);
     ts_SHA512_final_trunc( output, &t->sha2_L35_simple, n );
 }
 
@@ -62,8 +62,8 @@ void ts_sha2_L35_prehash( struct ts_context *sc ) {
     ts_sha2_L1_prehash( sc );
 
     /* And we have to precompute the SHA-512 state ourselves */
-    int n = sc->ps->n;
-    SHA512_CTX *ctx = &sc->small_iter.sha2_L35_simple;
+    int n = PS_N(sc->ps);
+    SHA512_CTX *ctx = &TS_SMALL_ITER(sc)->sha2_L35_simple;
     ts_SHA512_init( ctx );
 
     ts_SHA512_update( ctx, CONVERT_PUBLIC_KEY_TO_PUB_SEED(sc->public_key, n), n );
@@ -11,9 +11,9 @@ void ts_sha2_L35_prf_msg( unsigned char *output,
 	             const unsigned char *opt_buffer,
 		     const unsigned char *message, size_t len_message,
 		     struct ts_context *sc ) {
-    unsigned n = sc->ps->n;
+    unsigned n = PS_N(sc->ps);
     const unsigned char *public_key = sc->public_key;
-    SHA512_CTX *ctx = &sc->small_iter.sha2_L35_simple;
+    SHA512_CTX *ctx = &TS_SMALL_ITER(sc)->sha2_L35_simple;
     unsigned char block[sha512_block_size];
     unsigned char hash_output[64];
 
@@ -43,9 +43,9 @@ void ts_sha2_L35_hash_msg( unsigned char *output, size_t len_output,
 		     const unsigned char *randomness,
 		     const unsigned char *message, size_t len_message,
 		     struct ts_context *sc ) {
-    unsigned n = sc->ps->n;
+    unsigned n = PS_N(sc->ps);
     const unsigned char *public_key = sc->public_key;
-    SHA512_CTX *ctx = &sc->small_iter.sha2_L35_simple;
+    SHA512_CTX *ctx = &TS_SMALL_ITER(sc)->sha2_L35_simple;
     unsigned char msg_hash[2*TS_MAX_HASH + 64 + 4];
     ts_SHA512_init( ctx );
     ts_SHA512_update( ctx, randomness, n );
@@ -83,7 +83,7 @@ void ts_sha512_init_ctx( SHA512_CTX *ctx,
 #else
     ts_SHA512_init( ctx );
 
-    int n = sc->ps->n;
+    int n = PS_N(sc->ps);
     ts_SHA512_update( ctx, CONVERT_PUBLIC_KEY_TO_PUB_SEED(sc->public_key, n), n );
 
     for (int i = n; i < sha512_block_size; i++) {
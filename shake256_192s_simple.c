@@ -1,8 +1,10 @@
+#include "tiny_sphincs.h"
 #include "internal.h"
 #include "shake256_func.h"
 #include "tune.h"
 
-#if TS_SUPPORT_SHAKE && TS_SUPPORT_S && (TS_SUPPORT_L3 || TS_SUPPORT_L5)
+#if TS_SUPPORT_SHAKE && TS_SUPPORT_S && (TS_SUPPORT_L3 || TS_SUPPORT_L5) && \
+    TS_PS_ENABLED(TS_PS_SHAKE_192S_SIMPLE)
 
 const struct ts_parameter_set ts_ps_shake_192s_simple = {
     24,                /* Size of the hash */
@@ -12,6 +14,8 @@ const struct ts_parameter_set ts_ps_shake_192s_simple = {
     7,                 /* # of levels of Merkle trees */
     9,                 /* Height of each Merkle tree = h/d */
     0,                 /* This is not a SHA-2 parameter set */
+    4,                 /* log2(w); w = 16 */
+    51,                /* # of WOTS digits = 2n+3 */
 
     ts_shake256_prf_msg, /* prf_msg */
     ts_shake256_hash_msg, /* hash_msg */
@@ -1,8 +1,10 @@
+#include "tiny_sphincs.h"
 #include "internal.h"
 #include "shake256_func.h"
 #include "tune.h"
 
-#if TS_SUPPORT_SHAKE && TS_SUPPORT_L5
+#if TS_SUPPORT_SHAKE && TS_SUPPORT_L5 && \
+    TS_PS_ENABLED(TS_PS_SHAKE_256F_SIMPLE)
 
 const struct ts_parameter_set ts_ps_shake_256f_simple = {
     32,                /* Size of the hash */
@@ -12,6 +14,8 @@ const struct ts_parameter_set ts_ps_shake_256f_simple = {
     17,                /* # of levels of Merkle trees */
     4,                 /* Height of each Merkle tree = h/d */
     0,                 /* This is not a SHA-2 parameter set */
+    4,                 /* log2(w); w = 16 */
+    67,                /* # of WOTS digits = 2n+3 */
 
     ts_shake256_prf_msg, /* prf_msg */
     ts_shake256_hash_msg, /* hash_msg */
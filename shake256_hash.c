@@ -18,9 +18,9 @@ void ts_shake256_prf_msg( unsigned char *output,
 	             const unsigned char *opt_rand,
 		     const unsigned char *message, size_t len_message,
 		     struct ts_context *sc ) {
-    int n = sc->ps->n;
+    int n = PS_N(sc->ps);
     const unsigned char *public_key = sc->public_key;
-    SHAKE256_CTX *ctx = &sc->small_iter.shake256_simple;
+    SHAKE256_CTX *ctx = &TS_SMALL_ITER(sc)->shake256_simple;
 
     ts_shake256_inc_init(ctx);
 
@@ -38,9 +38,9 @@ void ts_shake256_hash_msg( unsigned char *output, size_t len_output,
 		     const unsigned char *randomness,
 		     const unsigned char *message, size_t len_message,
 		     struct ts_context *sc ) {
-    int n = sc->ps->n;
+    int n = PS_N(sc->ps);
     const unsigned char *public_key = sc->public_key;
-    SHAKE256_CTX *ctx = &sc->small_iter.shake256_simple;
+    SHAKE256_CTX *ctx = &TS_SMALL_ITER(sc)->shake256_simple;
 
     ts_shake256_inc_init(ctx);
 
@@ -62,8 +62,8 @@ void ts_shake256_hash_msg( unsigned char *output, size_t len_output,
  */
 void ts_shake256_prf( unsigned char *output,
 		     struct ts_context *sc ) {
-    int n = sc->ps->n;
-    SHAKE256_CTX *ctx = &sc->small_iter.shake256_simple;
+    int n = PS_N(sc->ps);
+    SHAKE256_CTX *ctx = &TS_SMALL_ITER(sc)->shake256_simple;
 
     ts_shake256_inc_init(ctx);
  
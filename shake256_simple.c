@@ -17,7 +17,7 @@
 void ts_shake256_f_simple( unsigned char *output,
 	             const unsigned char *inblock,
 	             struct ts_context *ctx) {
-    union t_iterator *t = &ctx->small_iter; /* The small_iter is always */
+    union t_iterator *t = TS_SMALL_ITER(ctx); /* The small_iter is always */
 	                                    /* unused when this is called */
 
     /* For SHAKE256, the single input T function is the same as the */
@@ -31,7 +31,7 @@ void ts_shake256_f_simple( unsigned char *output,
 /* It uses 't' to store the state of the evaluation */
 void ts_shake256_init_t_simple( union t_iterator *t,
 		     struct ts_context *ctx ) {
-    unsigned n = ctx->ps->n;
+    unsigned n = PS_N(ctx->ps);
     const unsigned char *public_key = ctx->public_key;
     SHAKE256_CTX *iter = &t->shake256_simple;
 
@@ -44,7 +44,7 @@ void ts_shake256_init_t_simple( union t_iterator *t,
 /* We call this with each of the inputs in succession */
 void ts_shake256_next_t_simple( union t_iterator *t, const unsigned char *input,
 		     const struct ts_context *ctx ) {
-    unsigned n = ctx->ps->n;
+    unsigned n = PS_N(ctx->ps);
     SHAKE256_CTX *iter = &t->shake256_simple;
     ts_shake256_inc_absorb(iter, input, n);
 }
@@ -53,7 +53,7 @@ void ts_shake256_next_t_simple( union t_iterator *t, const unsigned char *input,
 /* output to T(input1, input2, ..., inputn) */
 void ts_shake256_final_t_simple(unsigned char *output, union t_iterator *t,
 		    const struct ts_context *ctx ) {
-    unsigned n = ctx->ps->n;
+    unsigned n = PS_N(ctx->ps);
     SHAKE256_CTX *iter = &t->shake256_simple;
 
     ts_shake256_inc_finalize(iter);
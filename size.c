@@ -1,3 +1,4 @@
+#include "tiny_sphincs.h"
 #include "internal.h"
 
 /*
@@ -7,15 +8,70 @@
  */
 
 unsigned ts_size_private_key( const struct ts_parameter_set *ps ) {
-    return 4 * ps->n;
+    return 4 * PS_N(ps);
 }
 
 unsigned ts_size_public_key( const struct ts_parameter_set *ps ) {
-    return 2 * ps->n;
+    return 2 * PS_N(ps);
 }
 unsigned ts_size_signature( const struct ts_parameter_set *ps ) {
-    return ps->n * (1 +                           /* R */
-		   (ps->t + 1) * ps->k +          /* FORS trees */
-		   ps->d * (2*ps->n+3) +          /* WOTS+ signatures */
-                   ps->h);                        /* Merkle trees */
+    return PS_N(ps) * (1 +                        /* R */
+		   (PS_T(ps) + 1) * PS_K(ps) +    /* FORS trees */
+		   PS_D(ps) * PS_WOTS_LEN(ps) +   /* WOTS+ signatures */
+                   PS_H(ps));                     /* Merkle trees */
+}
+
+/*
+ * The size of the buffer that holds an entire WOTS signature (one hash for
+ * each of the chains); see ts_set_wots_buffer
+ */
+size_t ts_wots_buffer_size( const struct ts_parameter_set *ps ) {
+    return PS_WOTS_LEN(ps) * PS_N(ps);
+}
+
+/*
+ * This returns the number of bytes of a ts_context that signing or
+ * verifying with this parameter set actually touches (see TS_X_OFFSET in
+ * internal.h for how we lay things out).  This is never more than
+ * sizeof(struct ts_context)
+ */
+size_t ts_context_size( const struct ts_parameter_set *ps ) {
+    size_t n = PS_N(ps);
+    union ts_state_storage *x = 0;  /* Used only within sizeof */
+
+	/* When signing FORS trees, we need the stack for the tree; when */
+	/* verifying, we also place the message hash there */
+    size_t fors_stack = (PS_T(ps) - 1) * n;
+    if (fors_stack < MAX_MESSAGE_HASH) fors_stack = MAX_MESSAGE_HASH;
+    size_t size = sizeof x->fors.fors_node + fors_stack;
+
+	/* One digit for each WOTS chain */
+    size_t wots = sizeof x->wots.digit + PS_WOTS_LEN(ps);
+    if (size < wots) size = wots;
+
+	/* The Merkle stack */
+    size_t merkle = sizeof x->merkle.buffer + (PS_MERKLE_H(ps) - 1) * n;
+    if (size < merkle) size = merkle;
+
+    if (size < sizeof x->verify) size = sizeof x->verify;
+
+#if TS_NODE_CACHE
+	/* An authentication path from the node cache */
+    size_t cached = PS_MERKLE_H(ps) * n;
+    if (size < cached) size = cached;
+#endif
+
+    return TS_CONTEXT_ROUND( TS_X_OFFSET(ps) + size );
+}
+
+/*
+ * Check if the caller's buffer can be used as a context for this parameter
+ * set; if so, return it as one
+ */
+struct ts_context *ts_context_from_buffer( void *buffer, size_t len_buffer,
+                                      const struct ts_parameter_set *ps ) {
+    if (!buffer || !ps) return 0;
+    if ((uintptr_t)buffer % TS_CONTEXT_ALIGN != 0) return 0;
+    if (len_buffer < ts_context_size(ps)) return 0;
+    return buffer;
 }
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <string.h>
+#include "tiny_sphincs.h"
+#include "sha2.h"
+#include "fips202.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out the hash backends (see ts_set_backend); for every
+ * accelerated implementation this CPU supports (including the four lane
+ * ones), we check that it gives the same answers as the portable C one.  The KAT tests (sha512, shake256,
+ * testvector) check whatever ts_init_backends picked; this makes sure that
+ * we also cover the scalar code on CPUs where we'd never pick it.
+ * This isn't much of a test on CPUs without any accelerated
+ * implementations (in that case, we'll just compare the scalar code
+ * against itself)
+ */
+
+#define MAX_MESSAGE 300
+
+/* Hash the message in odd sized pieces, to exercise the buffering logic */
+static void hash( unsigned char *output, int primitive,
+                  const unsigned char *message, unsigned len_message ) {
+    unsigned step = 1 + len_message / 7;
+
+    switch (primitive) {
+    case TS_PRIM_SHA256: {
+	SHA256_CTX ctx;
+	ts_SHA256_init( &ctx );
+	for (unsigned i=0; i<len_message; i+=step) {
+	    unsigned this_len = len_message - i;
+	    if (this_len > step) this_len = step;
+	    ts_SHA256_update( &ctx, message+i, this_len );
+	}
+	ts_SHA256_final( output, &ctx );
+	break;
+    }
+    case TS_PRIM_SHA512: {
+	SHA512_CTX ctx;
+	ts_SHA512_init( &ctx );
+	for (unsigned i=0; i<len_message; i+=step) {
+	    unsigned this_len = len_message - i;
+	    if (this_len > step) this_len = step;
+	    ts_SHA512_update( &ctx, message+i, this_len );
+	}
+	ts_SHA512_final( output, &ctx );
+	break;
+    }
+    case TS_PRIM_KECCAK: {
+	SHAKE256_CTX ctx;
+	ts_shake256_inc_init( &ctx );
+	for (unsigned i=0; i<len_message; i+=step) {
+	    unsigned this_len = len_message - i;
+	    if (this_len > step) this_len = step;
+	    ts_shake256_inc_absorb( &ctx, message+i, this_len );
+	}
+	ts_shake256_inc_finalize( &ctx );
+	ts_shake256_inc_squeeze( output, 64, &ctx );
+	break;
+    }
+    }
+}
+
+/*
+ * The four lane primitives are used only within the signer, so we check
+ * those by hashing an entire signature
+ */
+static int seeded_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 5*i + 1;
+    }
+    return 1;
+}
+
+static void hash_signature( unsigned char *output, int primitive ) {
+    const struct ts_parameter_set *ps = (primitive == TS_PRIM_SHA256_X4) ?
+	           TEST_PS_sha2_128f_simple : TEST_PS_shake_128f_simple;
+    if (!ps) ps = TEST_PS_ANY;   /* Built for one parameter set */
+    unsigned char private_key[128];
+    seeded_rand( private_key, ts_size_private_key( ps ) );
+
+    struct ts_context ctx;
+    SHA256_CTX sha;
+    ts_SHA256_init( &sha );
+    ts_init_sign( &ctx, "abc", 3, ps, private_key, 0 );
+    for (;;) {
+	unsigned char buffer[500];
+	unsigned n = ts_sign( buffer, sizeof buffer, &ctx );
+	if (n == 0) break;
+	ts_SHA256_update( &sha, buffer, n );
+    }
+    ts_SHA256_final( output, &sha );
+}
+
+static const char *primitive_name[] = { "SHA-256", "SHA-512", "Keccak",
+				        "SHA-256 x4", "Keccak x4" };
+static const char *backend_name[] = { "scalar", "SHA-NI", "vector", "AVX2" };
+
+int test_backend(int fast_flag, enum noise_level level) {
+    (void)fast_flag;
+    unsigned char message[MAX_MESSAGE];
+    int success = 1;
+
+    for (int i=0; i<MAX_MESSAGE; i++) {
+	message[i] = (unsigned char)(37*i + 11);
+    }
+
+    ts_init_backends();
+
+    for (int primitive = TS_PRIM_SHA256; primitive <= TS_PRIM_KECCAK_X4;
+                                                            primitive++) {
+	int orig_backend = ts_get_backend( primitive );
+
+	for (int backend = TS_BACKEND_SCALAR+1;
+		   backend < (int)(sizeof backend_name / sizeof *backend_name);
+	                                                         backend++) {
+	    if (!ts_set_backend( primitive, backend )) {
+		continue;  /* Not supported on this CPU */
+	    }
+	    if (level >= loud) {
+		printf( "    Checking %s %s\n", primitive_name[primitive],
+		                               backend_name[backend] );
+	    }
+
+	    if (primitive >= TS_PRIM_SHA256_X4) {
+		unsigned char expected[32], actual[32];
+		ts_set_backend( primitive, TS_BACKEND_SCALAR );
+		hash_signature( expected, primitive );
+		ts_set_backend( primitive, backend );
+		hash_signature( actual, primitive );
+		if (0 != memcmp( expected, actual, 32 )) {
+		    printf( "    *** %s %s signature mismatch\n",
+			    primitive_name[primitive], backend_name[backend] );
+		    success = 0;
+		}
+		continue;
+	    }
+
+	    for (unsigned len = 0; len <= MAX_MESSAGE; len++) {
+		unsigned char expected[64] = { 0 }, actual[64] = { 0 };
+		ts_set_backend( primitive, TS_BACKEND_SCALAR );
+		hash( expected, primitive, message, len );
+		ts_set_backend( primitive, backend );
+		hash( actual, primitive, message, len );
+		if (0 != memcmp( expected, actual, 64 )) {
+		    printf( "    *** %s %s mismatch at length %u\n",
+			    primitive_name[primitive], backend_name[backend],
+			    len );
+		    success = 0;
+		    break;
+		}
+	    }
+	}
+
+	ts_set_backend( primitive, orig_backend );
+    }
+
+    return success;
+}
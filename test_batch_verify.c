@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "tiny_sphincs.h"
+#include "batch_verify.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out the batch file verifier: we write out a directory of
+ * signed files (with some of them broken in various ways), and check that
+ * each one gets the right verdict, however many threads we use
+ */
+
+#define NUM_FILES 12
+
+static int seeded_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 0x3c ^ (5*i);
+    }
+    return 1;
+}
+
+static int write_file( const char *name, const void *data, size_t len ) {
+    FILE *f = fopen( name, "wb" );
+    if (!f) return 0;
+    int ok = (len == fwrite( data, 1, len, f ));
+    if (0 != fclose( f )) ok = 0;
+    return ok;
+}
+
+int test_batch_verify(int fast_flag, enum noise_level level) {
+    const struct ts_parameter_set *ps = TEST_PS_ANY;
+    unsigned char private_key[128], public_key[64];
+    if (!ts_gen_key( private_key, public_key, ps, seeded_rand )) {
+	printf( "*** Key generation failed\n" );
+	return 0;
+    }
+
+    char dir[] = "/tmp/ts_batchXXXXXX";
+    if (!mkdtemp( dir )) {
+	printf( "*** Unable to create a temporary directory\n" );
+	return 0;
+    }
+    char artifact[NUM_FILES][64], signature[NUM_FILES][64];
+    enum ts_batch_result expected[NUM_FILES];
+    size_t len_sig = ts_size_signature( ps );
+    size_t max_len = fast_flag ? 100000 : 1000000;
+    unsigned char *message = malloc( max_len );
+    unsigned char *sig = malloc( len_sig );
+    int ok = 0;
+    if (!message || !sig) {
+	printf( "*** MALLOC FAILURE\n" );
+	goto done;
+    }
+    for (size_t i=0; i<max_len; i++) message[i] = (unsigned char)(i * 31);
+
+    /* File i is (i^2 * max_len / NUM_FILES^2) bytes long (so, with file */
+    /* 0, we check empty files), and signed; then we break some of them */
+    for (unsigned i=0; i<NUM_FILES; i++) {
+	sprintf( artifact[i], "%s/file%u", dir, i );
+	sprintf( signature[i], "%s/file%u.sig", dir, i );
+	size_t len = i*i * (max_len / (NUM_FILES*NUM_FILES));
+	struct ts_context ctx;
+	ts_init_sign( &ctx, message, len, ps, private_key, 0 );
+	ts_sign( sig, len_sig, &ctx );
+	expected[i] = ts_batch_valid;
+	switch (i % 6) {
+	case 1: sig[ len_sig/2 ] ^= 0x10;        /* Corrupted signature */
+		expected[i] = ts_batch_invalid; break;
+	case 3: message[ len/2 ] ^= 0x01;        /* Corrupted file */
+		expected[i] = ts_batch_invalid; break;
+	case 5: len_sig -= 1;                    /* Truncated signature */
+		expected[i] = ts_batch_invalid; break;
+	}
+	if (i == 4) expected[i] = ts_batch_error;  /* Missing signature */
+	if ((i != 4 && !write_file( signature[i], sig, len_sig )) ||
+	    !write_file( artifact[i], message, len )) {
+	    printf( "*** Unable to write to %s\n", dir );
+	    goto done;
+	}
+	if (i % 6 == 3) message[ len/2 ] ^= 0x01;
+	if (i % 6 == 5) len_sig += 1;
+    }
+
+    static const unsigned thread_counts[] = { 1, 2, 3, 8, 64 };
+    for (unsigned t=0; t<sizeof thread_counts/sizeof *thread_counts; t++) {
+	unsigned num_threads = thread_counts[t];
+	if (level >= loud) {
+	    printf( "    Checking with %u threads\n", num_threads );
+	}
+	struct ts_batch_item items[NUM_FILES+1];
+	unsigned count = 0, num_valid = 0;
+	for (unsigned i=0; i<NUM_FILES; i++) {
+	    items[count].artifact = artifact[i];
+	    items[count].signature = signature[i];
+	    items[count].ps = ps;
+	    items[count].public_key = public_key;
+	    count++;
+	    if (expected[i] == ts_batch_valid) num_valid++;
+	}
+	/* And one where the file itself is missing */
+	items[count].artifact = "/nonexistent/file";
+	items[count].signature = signature[0];
+	items[count].ps = ps;
+	items[count].public_key = public_key;
+	count++;
+
+	if (num_valid != ts_verify_batch( items, count, num_threads )) {
+	    printf( "*** Wrong number of files verified with %u threads\n",
+		    num_threads );
+	    goto done;
+	}
+	for (unsigned i=0; i<count; i++) {
+	    enum ts_batch_result want = i < NUM_FILES ? expected[i] :
+							ts_batch_error;
+	    if (items[i].result != want) {
+		printf( "*** Wrong result for %s with %u threads\n",
+			items[i].artifact, num_threads );
+		goto done;
+	    }
+	}
+    }
+    ok = 1;
+
+done:
+    for (unsigned i=0; i<NUM_FILES; i++) {
+	sprintf( artifact[i], "%s/file%u", dir, i );
+	sprintf( signature[i], "%s/file%u.sig", dir, i );
+	unlink( artifact[i] );
+	unlink( signature[i] );
+    }
+    rmdir( dir );
+    free( message );
+    free( sig );
+    return ok;
+}
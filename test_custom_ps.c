@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tiny_sphincs.h"
+#include "verify_mt.h"
+#include "wotscache.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out parameter sets built at runtime: one built with the same
+ * parameters as a standard parameter set should give the same keys and
+ * signatures; ones with other values of w should sign and verify (by all
+ * the verifiers we have), and reject modified signatures; and ones that
+ * can't work should be refused
+ */
+
+/* Where we build the parameter sets */
+static union {
+    unsigned char bytes[256];
+    void *align_p;
+    unsigned long long align_u;
+} storage[2];
+
+#if TS_CUSTOM_PS
+static int seeded_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 0x3b ^ (11*i);
+    }
+    return 1;
+}
+
+/* Sign the message; returns the signature (malloc'ed), or NULL */
+static unsigned char *sign( const struct ts_parameter_set *ps,
+		            const unsigned char *private_key,
+			    struct ts_wots_cache *cache ) {
+    size_t len_sig = ts_size_signature( ps );
+    unsigned char *sig = malloc( len_sig );
+    struct ts_context ctx;
+    if (!sig) return 0;
+    ts_init_sign( &ctx, "abc", 3, ps, private_key, 0 );
+    if (cache) ts_set_wots_cache( &ctx, cache );
+    if (len_sig != ts_sign( sig, len_sig, &ctx )) {
+	free( sig );
+	return 0;
+    }
+    return sig;
+}
+
+/* Does the signature verify (with and without a WOTS buffer)? */
+static int verify( const unsigned char *sig,
+		   const struct ts_parameter_set *ps,
+		   const unsigned char *public_key ) {
+    static unsigned char wots_buffer[ TS_MAX_WOTS_DIGITS * TS_MAX_HASH ];
+    size_t len_sig = ts_size_signature( ps );
+    int result[2];
+    for (int use_buffer = 0; use_buffer < 2; use_buffer++) {
+	struct ts_context ctx;
+	ts_init_verify( &ctx, "abc", 3, ps, public_key );
+	if (use_buffer) {
+	    ts_set_wots_buffer( &ctx, wots_buffer,
+				ts_wots_buffer_size( ps ) );
+	}
+	/* In odd sized chunks */
+	for (size_t i = 0; i < len_sig; i += 37) {
+	    size_t chunk = len_sig - i;
+	    if (chunk > 37) chunk = 37;
+	    ts_update_verify( sig + i, chunk, &ctx );
+	}
+	result[use_buffer] = ts_verify( &ctx );
+    }
+    if (result[0] != result[1]) return -1;
+    return result[0];
+}
+
+/* Build a parameter set, and make sure it's the same as a standard one */
+static int check_same( const struct ts_parameter_set *standard,
+		       const char *name, unsigned n, unsigned h, unsigned d,
+		       unsigned k, unsigned t, int family,
+		       enum noise_level level ) {
+    if (level >= loud) {
+	printf( "    Checking %s\n", name );
+    }
+    const struct ts_parameter_set *ps = ts_make_parameter_set(
+		  &storage[0], sizeof storage[0], n, h, d, k, t, 16, family );
+    if (!ps) {
+	printf( "*** Unable to build %s\n", name );
+	return 0;
+    }
+    unsigned char private_key[2][128], public_key[2][64];
+    if (ts_size_signature( ps ) != ts_size_signature( standard ) ||
+	ts_size_public_key( ps ) != ts_size_public_key( standard ) ||
+	ts_context_size( ps ) != ts_context_size( standard ) ||
+	!ts_gen_key( private_key[0], public_key[0], standard, seeded_rand ) ||
+	!ts_gen_key( private_key[1], public_key[1], ps, seeded_rand ) ||
+	0 != memcmp( private_key[0], private_key[1],
+		     ts_size_private_key( ps ))) {
+	printf( "*** %s differs from the standard one\n", name );
+	return 0;
+    }
+    unsigned char *sig[2];
+    sig[0] = sign( standard, private_key[0], 0 );
+    sig[1] = sign( ps, private_key[1], 0 );
+    int ok = sig[0] && sig[1] &&
+	     0 == memcmp( sig[0], sig[1], ts_size_signature( ps ) ) &&
+	     verify( sig[0], ps, public_key[0] ) == 1;
+    if (!ok) {
+	printf( "*** %s signature differs from the standard one\n", name );
+    }
+    free( sig[0] );
+    free( sig[1] );
+    return ok;
+}
+
+/* Build a parameter set with another w, and try it out */
+static int check_w( const char *name, unsigned n, unsigned h, unsigned d,
+		    unsigned k, unsigned t, unsigned w, int family,
+		    unsigned expected_wots_len, enum noise_level level ) {
+    if (level >= loud) {
+	printf( "    Checking %s\n", name );
+    }
+    const struct ts_parameter_set *ps = ts_make_parameter_set(
+		  &storage[0], sizeof storage[0], n, h, d, k, t, w, family );
+    if (!ps) {
+	printf( "*** Unable to build %s\n", name );
+	return 0;
+    }
+    size_t len_sig = ts_size_signature( ps );
+    if (len_sig != n * (1 + (t+1)*k + d*expected_wots_len + h) ||
+	ts_wots_buffer_size( ps ) != n * expected_wots_len) {
+	printf( "*** %s has the wrong signature size\n", name );
+	return 0;
+    }
+    unsigned char private_key[128], public_key[64];
+    if (!ts_gen_key( private_key, public_key, ps, seeded_rand )) {
+	printf( "*** Key generation failed\n" );
+	return 0;
+    }
+    unsigned char *sig = sign( ps, private_key, 0 ), *sig_cached = 0;
+    unsigned char *memory = 0;
+    int ok = 0;
+    if (!sig) {
+	printf( "*** Signing failed\n" );
+	goto done;
+    }
+    if (verify( sig, ps, public_key ) != 1 ||
+	!ts_verify_oneshot( "abc", 3, sig, len_sig, public_key, ps, 3 )) {
+	printf( "*** %s signature didn't verify\n", name );
+	goto done;
+    }
+
+    /* The checkpoint cache has to agree as well */
+#if TS_WOTS_CACHE
+    struct ts_wots_cache cache;
+    size_t len_memory = 64 * ts_wots_cache_slot_size( ps, 2 );
+    memory = malloc( len_memory );
+    if (!memory || !ts_wots_cache_init( &cache, memory, len_memory, ps,
+					public_key, 2, 0, 0, 0, 0 )) {
+	printf( "*** Cache init failed\n" );
+	goto done;
+    }
+    for (int pass = 0; pass < 2; pass++) {
+	sig_cached = sign( ps, private_key, &cache );
+	if (!sig_cached || 0 != memcmp( sig, sig_cached, len_sig )) {
+	    printf( "*** %s signature with the cache differs\n", name );
+	    goto done;
+	}
+	free( sig_cached );
+	sig_cached = 0;
+    }
+    ts_wots_cache_clear( &cache );
+#endif
+
+    /* Modify some bytes (every WOTS signature, and a spread elsewhere) */
+    for (size_t offset = 0; offset < len_sig; offset += 53) {
+	sig[offset] ^= 0x10;
+	int result = verify( sig, ps, public_key );
+	int result_mt = ts_verify_oneshot( "abc", 3, sig, len_sig,
+					   public_key, ps, 2 );
+	sig[offset] ^= 0x10;
+	if (result != 0 || result_mt != 0) {
+	    printf( "*** %s accepted a modified signature (offset %zu)\n",
+		    name, offset );
+	    goto done;
+	}
+    }
+
+    /* And it isn't something we can export */
+    struct ts_context ctx;
+    unsigned char blob[64];
+    ts_init_verify( &ctx, "abc", 3, ps, public_key );
+    if (ts_context_export( blob, sizeof blob, &ctx ) != 0) {
+	printf( "*** Context with %s exported\n", name );
+	goto done;
+    }
+
+    ok = 1;
+done:
+    free( sig );
+    free( sig_cached );
+    free( memory );
+    return ok;
+}
+#endif
+
+int test_custom_ps(int fast_flag, enum noise_level level) {
+#if !TS_CUSTOM_PS
+    (void)fast_flag;
+    (void)level;
+    /* Built without it; it should always refuse */
+    return ts_make_parameter_set( &storage[0], sizeof storage[0],
+				  16, 66, 22, 33, 6, 16, TS_HASH_SHA2 ) == 0;
+#else
+    /* The same as the standard ones */
+    if (!check_same( &ts_ps_sha2_128f_simple, "sha2_128f_simple",
+		     16, 66, 22, 33, 6, TS_HASH_SHA2, level ) ||
+	!check_same( &ts_ps_shake_128f_simple, "shake_128f_simple",
+		     16, 66, 22, 33, 6, TS_HASH_SHAKE, level )) {
+	return 0;
+    }
+    if (!fast_flag) {
+	if (!check_same( &ts_ps_shake_256f_simple, "shake_256f_simple",
+		         32, 68, 17, 35, 9, TS_HASH_SHAKE, level ) ||
+	    !check_same( &ts_ps_sha2_256f_simple, "sha2_256f_simple",
+		         32, 68, 17, 35, 9, TS_HASH_SHA2, level )) {
+	    return 0;
+	}
+    }
+
+    /* Other w; these are small trees, so they're quick.  The checksums */
+    /* come to 4 digits (n=16, w=4), 5 (with 6 bits of padding; n=24, */
+    /* w=4) and 2 (w=256).  And a hypertree of just one layer (so no */
+    /* tree address bits in H_msg) */
+    if (!check_w( "sha2 n=16 w=4", 16, 12, 3, 8, 5, 4, TS_HASH_SHA2,
+		  64+4, level ) ||
+	!check_w( "shake n=16 w=256", 16, 12, 3, 8, 5, 256, TS_HASH_SHAKE,
+		  16+2, level ) ||
+	!check_w( "shake n=32 w=4", 32, 16, 4, 10, 6, 4, TS_HASH_SHAKE,
+		  128+5, level ) ||
+	!check_w( "sha2 n=24 w=4", 24, 12, 3, 8, 5, 4, TS_HASH_SHA2,
+		  96+5, level ) ||
+	!check_w( "sha2 d=1", 16, 3, 1, 8, 5, 16, TS_HASH_SHA2,
+		  32+3, level )) {
+	return 0;
+    }
+    if (!fast_flag) {
+	if (!check_w( "sha2 n=32 w=256", 32, 16, 4, 10, 6, 256,
+		      TS_HASH_SHA2, 32+2, level ) ||
+	    !check_w( "shake n=16 w=16", 16, 20, 5, 12, 7, 16,
+		      TS_HASH_SHAKE, 32+3, level )) {
+	    return 0;
+	}
+    }
+
+    /* And ones we can't build */
+    static const struct {
+	unsigned n, h, d, k, t, w;
+	int family;
+    } bad[] = {
+	{ 16, 66, 22, 33,  6,   8, TS_HASH_SHA2 },  /* w */
+	{ 16, 66, 22, 33,  6,   2, TS_HASH_SHA2 },
+	{ 20, 66, 22, 33,  6,  16, TS_HASH_SHA2 },  /* n */
+	{ 16, 66, 20, 33,  6,  16, TS_HASH_SHA2 },  /* d doesn't divide h */
+	{ 16, 66,  0, 33,  6,  16, TS_HASH_SHA2 },
+	{ 16, 66,  2, 33,  6,  16, TS_HASH_SHA2 },  /* h/d too big */
+	{ 16,  0,  1, 10,  6,  16, TS_HASH_SHA2 },  /* h/d too small */
+	{ 16, 66, 22, TS_MAX_FORS+1, 6, 16, TS_HASH_SHA2 },  /* k */
+	{ 16, 66, 22, 33, TS_MAX_T+1, 16, TS_HASH_SHA2 },    /* t */
+	{ 16, 66, 22,  0,  6,  16, TS_HASH_SHA2 },
+	{ 16, 80, 10, 33,  6,  16, TS_HASH_SHA2 },  /* tree address > 64 */
+	{ 32, 68, 17, 35, 14,  16, TS_HASH_SHA2 },  /* H_msg too long */
+	{ 16, 66, 22, 33,  6,  16, 7 },             /* hash family */
+    };
+    for (unsigned i = 0; i < sizeof bad / sizeof *bad; i++) {
+	if (ts_make_parameter_set( &storage[1], sizeof storage[1],
+		      bad[i].n, bad[i].h, bad[i].d, bad[i].k, bad[i].t,
+		      bad[i].w, bad[i].family )) {
+	    printf( "*** Bad parameter set %u accepted\n", i );
+	    return 0;
+	}
+    }
+    if (ts_make_parameter_set( &storage[1], ts_parameter_set_size() - 1,
+		      16, 66, 22, 33, 6, 16, TS_HASH_SHA2 ) ||
+	ts_make_parameter_set( storage[1].bytes + 1, ts_parameter_set_size(),
+		      16, 66, 22, 33, 6, 16, TS_HASH_SHA2 )) {
+	printf( "*** Bad buffer accepted\n" );
+	return 0;
+    }
+    return 1;
+#endif
+}
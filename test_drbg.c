@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "tiny_sphincs.h"
+#include "verify_mt.h"
+#include "drbg.h"
+#include "drbg_async.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out the DRBG that serves OptRand: that it gives the expected
+ * output (computed by an independent implementation of HMAC_DRBG, or of
+ * the SHAKE256 construction in drbg.h), that it reseeds when it should,
+ * and copes with a random_function that fails, that signatures made with
+ * it are randomized, and that the threaded version has its seeds ready
+ * for the callers (and gives every thread different output)
+ */
+
+/* A 'random' function that gives a known stream of bytes */
+static unsigned stream_pos, stream_calls;
+static int stream_fail;
+static int stream_rand( unsigned char *p, size_t num_bytes ) {
+    if (stream_fail) return 0;
+    stream_calls++;
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 0x5a + 7*stream_pos++;
+    }
+    return 1;
+}
+
+/* The output for stream_rand, personalization "tsphincs", a reseed */
+/* interval of 2, and requests of 32, 40 and 16 bytes */
+static const unsigned char expected[88] =
+#if TS_SUPPORT_SHA2
+	"\x1d\xa0\x6e\x7c\xc6\x6d\xb0\x1f\x18\x7f\x65\x31\xa6\x72\xbd\x14"
+	"\xdd\xc7\xa5\x5b\xc1\x40\xaf\xba\x36\xd6\xdc\x39\x5d\x0e\x71\x12"
+	"\xc0\xbe\xb7\x52\x13\xf0\x8c\x4d\xc6\xf8\xa1\xc1\x4a\x20\x70\x43"
+	"\x63\x07\xb1\x22\x4a\xee\x7b\xde\x2a\x5a\x8b\x62\x4c\xf2\xaa\xe9"
+	"\x33\x93\x33\x0d\xec\x97\xb4\xa1\x65\x94\x76\x62\x02\xc2\x00\xa1"
+	"\x25\xf4\x08\x90\x88\x52\xab\x49";
+#else
+	"\x0c\x56\xf9\x99\x62\x62\x22\x0d\xb2\x74\x60\x5a\x9d\xf6\x7e\x5d"
+	"\xa7\x70\xaf\xd0\x2e\xa6\xcd\xb7\x80\xa2\x5e\x1e\x2f\xe3\x34\x5f"
+	"\xc4\x08\x18\xc7\x92\xfe\xa5\x6d\x4a\xd8\x07\xfd\x19\xba\xae\x84"
+	"\x09\x91\xb5\x11\xa9\x4f\x34\x18\xec\x72\x8d\x30\xa4\xc3\xe3\xa7"
+	"\x60\xb5\x59\x7e\x39\xeb\xf8\x37\x5c\x01\x8a\x65\xe8\x7f\x21\x6d"
+	"\x47\x92\x79\x9f\x3a\x44\x55\x6f";
+#endif
+
+static int check_known_answer( void ) {
+    struct ts_drbg drbg;
+    unsigned char output[88];
+    stream_pos = stream_calls = 0;
+    stream_fail = 0;
+    if (!ts_drbg_init( &drbg, stream_rand, 2, "tsphincs", 8 ) ||
+	!ts_drbg_generate( &drbg, output, 32 ) ||
+	!ts_drbg_generate( &drbg, output+32, 40 ) ||
+	!ts_drbg_generate( &drbg, output+72, 16 )) {
+	printf( "*** DRBG failed\n" );
+	return 0;
+    }
+    if (0 != memcmp( output, expected, sizeof output )) {
+	printf( "*** DRBG gave the wrong output\n" );
+	return 0;
+    }
+    if (stream_calls != 2 || stream_pos != 2*TS_DRBG_SEED_LEN ||
+	drbg.reseeds != 1) {
+	printf( "*** DRBG didn't reseed when expected\n" );
+	return 0;
+    }
+    ts_drbg_clear( &drbg );
+    return 1;
+}
+
+static int check_failures( void ) {
+    struct ts_drbg drbg, copy;
+    unsigned char output[32], output_copy[32];
+
+    /* Can't seed it */
+    stream_fail = 1;
+    if (ts_drbg_init( &drbg, stream_rand, 3, 0, 0 ) ||
+	ts_drbg_generate( &drbg, output, sizeof output ) ||
+	ts_drbg_init( &drbg, 0, 3, 0, 0 )) {
+	printf( "*** DRBG worked without a seed\n" );
+	return 0;
+    }
+
+    /* It fails when the reseed does, and recovers when it can reseed */
+    stream_fail = 0;
+    if (!ts_drbg_init( &drbg, stream_rand, 3, 0, 0 )) return 0;
+    stream_fail = 1;
+    for (int i=0; i<3; i++) {
+	if (!ts_drbg_generate( &drbg, output, sizeof output )) {
+	    printf( "*** DRBG failed before a reseed was due\n" );
+	    return 0;
+	}
+    }
+    if (ts_drbg_generate( &drbg, output, sizeof output )) {
+	printf( "*** DRBG went past its reseed interval\n" );
+	return 0;
+    }
+    stream_fail = 0;
+    if (!ts_drbg_generate( &drbg, output, sizeof output ) ||
+	drbg.requests != 1) {
+	printf( "*** DRBG didn't recover\n" );
+	return 0;
+    }
+
+    /* A reseed with a seed we give it changes what comes out */
+    copy = drbg;
+    static const unsigned char seed[5] = "seed";
+    if (!ts_drbg_reseed( &drbg, seed, sizeof seed ) ||
+	!ts_drbg_generate( &drbg, output, sizeof output ) ||
+	!ts_drbg_generate( &copy, output_copy, sizeof output_copy ) ||
+	0 == memcmp( output, output_copy, sizeof output )) {
+	printf( "*** Reseed didn't change the DRBG\n" );
+	return 0;
+    }
+
+    /* Requests that are too long */
+    static unsigned char big[ TS_DRBG_MAX_REQUEST + 1 ];
+    if (!ts_drbg_generate( &drbg, big, TS_DRBG_MAX_REQUEST ) ||
+	ts_drbg_generate( &drbg, big, TS_DRBG_MAX_REQUEST + 1 )) {
+	printf( "*** DRBG request length check failed\n" );
+	return 0;
+    }
+    ts_drbg_clear( &drbg );
+    if (ts_drbg_generate( &drbg, output, sizeof output )) {
+	printf( "*** DRBG worked after being cleared\n" );
+	return 0;
+    }
+    return 1;
+}
+
+/* Signing with OptRand from the DRBG */
+static struct ts_drbg sign_drbg;
+static int drbg_random( unsigned char *p, size_t len ) {
+    return ts_drbg_generate( &sign_drbg, p, len );
+}
+
+static int check_sign( void ) {
+#if TS_SUPPORT_SHA2
+    const struct ts_parameter_set *ps = TEST_PS_ANY;
+#else
+    const struct ts_parameter_set *ps = &ts_ps_shake_128f_simple;
+#endif
+    unsigned char private_key[128], public_key[64];
+    size_t len_sig = ts_size_signature( ps );
+    unsigned char *sig[2] = { malloc( len_sig ), malloc( len_sig ) };
+    int ok = 0;
+    stream_fail = 0;
+    if (!sig[0] || !sig[1] ||
+	!ts_gen_key( private_key, public_key, ps, stream_rand ) ||
+	!ts_drbg_init( &sign_drbg, stream_rand, 0, 0, 0 )) {
+	printf( "*** Setup failed\n" );
+	goto done;
+    }
+    for (int i=0; i<2; i++) {
+	struct ts_context ctx;
+	ts_init_sign( &ctx, "abc", 3, ps, private_key, drbg_random );
+	if (len_sig != ts_sign( sig[i], len_sig, &ctx ) ||
+	    !ts_verify_oneshot( "abc", 3, sig[i], len_sig, public_key, ps,
+			        1 )) {
+	    printf( "*** Signature with the DRBG didn't verify\n" );
+	    goto done;
+	}
+    }
+    if (0 == memcmp( sig[0], sig[1], len_sig )) {
+	printf( "*** Signatures with the DRBG weren't randomized\n" );
+	goto done;
+    }
+    ok = 1;
+done:
+    ts_drbg_clear( &sign_drbg );
+    free( sig[0] );
+    free( sig[1] );
+    return ok;
+}
+
+/* A 'random' function for the threaded tests, which notes which threads */
+/* call it */
+static pthread_mutex_t thread_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t main_thread;
+static unsigned main_calls, other_calls, thread_pos;
+static int thread_rand( unsigned char *p, size_t num_bytes ) {
+    pthread_mutex_lock( &thread_lock );
+    if (pthread_equal( pthread_self(), main_thread )) {
+	main_calls++;
+    } else {
+	other_calls++;
+    }
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 0x33 + 5*thread_pos++;
+    }
+    pthread_mutex_unlock( &thread_lock );
+    return 1;
+}
+
+/* Wait (up to 10 seconds) until the thread has the next seed ready */
+static int wait_for_seed( struct ts_drbg_async *a ) {
+    for (int i=0; i<10000; i++) {
+	pthread_mutex_lock( &a->lock );
+	int ready = a->have_seed;
+	pthread_mutex_unlock( &a->lock );
+	if (ready) return 1;
+	struct timespec ms = { 0, 1000000 };
+	nanosleep( &ms, 0 );
+    }
+    return 0;
+}
+
+/*
+ * A 'random' function that fails in the background thread (so the
+ * callers have to fetch the seeds), and checks that the caller isn't
+ * holding the DRBG's lock when it does (if it were, trylock would keep
+ * failing; the thread may hold it for a moment, so we give it a while)
+ */
+static struct ts_drbg_async *unlocked_drbg;
+static unsigned locked_calls;
+static int unlocked_rand( unsigned char *p, size_t num_bytes ) {
+    if (!pthread_equal( pthread_self(), main_thread )) return 0;
+    if (unlocked_drbg) {
+	int i;
+	for (i=0; i<1000; i++) {
+	    if (0 == pthread_mutex_trylock( &unlocked_drbg->lock )) {
+		pthread_mutex_unlock( &unlocked_drbg->lock );
+		break;
+	    }
+	    struct timespec ms = { 0, 1000000 };
+	    nanosleep( &ms, 0 );
+	}
+	if (i == 1000) locked_calls++;
+    }
+    return thread_rand( p, num_bytes );
+}
+
+#define NUM_THREADS  4
+#define PER_THREAD   200
+#define OUTPUT_LEN   16
+static struct ts_drbg_async shared;
+static unsigned char outputs[NUM_THREADS * PER_THREAD][OUTPUT_LEN];
+
+static void *generate_thread( void *arg ) {
+    unsigned char (*out)[OUTPUT_LEN] = arg;
+    for (int i=0; i<PER_THREAD; i++) {
+	if (!ts_drbg_async_generate( &shared, out[i], OUTPUT_LEN )) {
+	    memset( out[i], 0, OUTPUT_LEN );
+	}
+    }
+    return 0;
+}
+
+static int compare_output( const void *a, const void *b ) {
+    return memcmp( a, b, OUTPUT_LEN );
+}
+
+static int check_async( enum noise_level level ) {
+    main_thread = pthread_self();
+    main_calls = other_calls = 0;
+
+    /* With the seed there in time, the callers never fetch one */
+    struct ts_drbg_async a;
+    unsigned char output[32];
+    if (!ts_drbg_async_init( &a, thread_rand, 4, 0, 0 )) {
+	printf( "*** Async DRBG init failed\n" );
+	ts_drbg_async_stop( &a );
+	return 0;
+    }
+    for (int i=0; i<20; i++) {
+	if (!wait_for_seed( &a ) ||
+	    !ts_drbg_async_generate( &a, output, sizeof output )) {
+	    printf( "*** Async DRBG failed\n" );
+	    ts_drbg_async_stop( &a );
+	    return 0;
+	}
+    }
+    unsigned long reseeds = a.drbg.reseeds;
+    unsigned long prefetched = a.prefetched;
+    ts_drbg_async_stop( &a );
+    if (main_calls != 1 || reseeds != 4 || prefetched != 4) {
+	printf( "*** Async DRBG reseeded in the caller (%u calls, %lu "
+		"reseeds, %lu prefetched)\n", main_calls, reseeds,
+		prefetched );
+	return 0;
+    }
+
+    /* Without the thread's seeds, the caller fetches them, and not */
+    /* while holding the lock */
+    main_calls = other_calls = locked_calls = 0;
+    unlocked_drbg = 0;
+    if (!ts_drbg_async_init( &a, unlocked_rand, 2, 0, 0 )) {
+	printf( "*** Async DRBG init failed\n" );
+	ts_drbg_async_stop( &a );
+	return 0;
+    }
+    unlocked_drbg = &a;
+    for (int i=0; i<10; i++) {
+	if (!ts_drbg_async_generate( &a, output, sizeof output )) {
+	    printf( "*** Async DRBG failed without the thread's seeds\n" );
+	    ts_drbg_async_stop( &a );
+	    return 0;
+	}
+    }
+    unlocked_drbg = 0;
+    reseeds = a.drbg.reseeds;
+    prefetched = a.prefetched;
+    ts_drbg_async_stop( &a );
+    if (main_calls != 5 || reseeds != 4 || prefetched != 0 ||
+	locked_calls != 0) {
+	printf( "*** Async DRBG caller reseeds went wrong (%u calls, %u with "
+		"the lock held, %lu reseeds)\n", main_calls, locked_calls,
+		reseeds );
+	return 0;
+    }
+
+    /* Several threads at once get different output */
+    if (!ts_drbg_async_init( &shared, thread_rand, 8, "shared", 6 )) {
+	printf( "*** Async DRBG init failed\n" );
+	ts_drbg_async_stop( &shared );
+	return 0;
+    }
+    pthread_t threads[NUM_THREADS];
+    for (int i=0; i<NUM_THREADS; i++) {
+	if (0 != pthread_create( &threads[i], 0, generate_thread,
+				 outputs[i * PER_THREAD] )) {
+	    generate_thread( outputs[i * PER_THREAD] );
+	    threads[i] = main_thread;
+	}
+    }
+    for (int i=0; i<NUM_THREADS; i++) {
+	if (!pthread_equal( threads[i], main_thread )) {
+	    pthread_join( threads[i], 0 );
+	}
+    }
+    reseeds = shared.drbg.reseeds;
+    prefetched = shared.prefetched;
+    ts_drbg_async_stop( &shared );
+    if (level >= loud) {
+	printf( "    %lu reseeds, %lu with a prefetched seed\n",
+		reseeds, prefetched );
+    }
+    if (reseeds != (NUM_THREADS * PER_THREAD - 1) / 8) {
+	printf( "*** Async DRBG reseeded %lu times\n", reseeds );
+	return 0;
+    }
+    qsort( outputs, NUM_THREADS * PER_THREAD, OUTPUT_LEN, compare_output );
+    static const unsigned char zero[OUTPUT_LEN];
+    for (int i=0; i<NUM_THREADS * PER_THREAD; i++) {
+	if (0 == memcmp( outputs[i], zero, OUTPUT_LEN ) ||
+	    (i > 0 && 0 == memcmp( outputs[i-1], outputs[i], OUTPUT_LEN ))) {
+	    printf( "*** Async DRBG gave repeated output\n" );
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+int test_drbg(int fast_flag, enum noise_level level) {
+    (void)fast_flag;
+    return check_known_answer() &&
+	   check_failures() &&
+	   check_sign() &&
+	   check_async( level );
+}
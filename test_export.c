@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "tiny_sphincs.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out exporting contexts, and importing them back in: a
+ * signature or a verification that's suspended (at various points), and
+ * resumed in a fresh context, should come out just as if it had run
+ * straight through; and blobs that aren't for this key (or have been
+ * mangled) should be refused.  It also tests forking contexts: each fork
+ * should carry on as the original would have, without disturbing it
+ */
+
+static int seeded_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 0x4d ^ (9*i);
+    }
+    return 1;
+}
+
+/* Where we suspend: right at the start, partway through R, and then */
+/* spread across the signature */
+static size_t cut_point( unsigned i, size_t len_sig ) {
+    switch (i) {
+    case 0: return 0;
+    case 1: return 5;
+    default: return (len_sig - 1) * (i - 1) / 7;
+    }
+}
+#define NUM_CUTS 9
+
+/* Export the context, and import it into a fresh buffer */
+static struct ts_context *move( struct ts_context *ctx, void *buffer,
+		   size_t len_buffer, unsigned char *blob, size_t len_blob,
+		   const unsigned char *key, const void *message,
+		   unsigned char *wots_buffer ) {
+    size_t len = ts_context_export( blob, len_blob, ctx );
+    memset( ctx, 0xa5, sizeof *ctx );   /* It's gone */
+    if (len == 0) return 0;
+    return ts_context_import( buffer, len_buffer, blob, len, key,
+			      message, message ? 3 : 0, wots_buffer );
+}
+
+static int check( const struct ts_parameter_set *ps, const char *name,
+	          enum noise_level level ) {
+    if (level >= loud) {
+	printf( "    Checking %s\n", name );
+    }
+    unsigned char private_key[128], public_key[64];
+    if (!ts_gen_key( private_key, public_key, ps, seeded_rand )) {
+	printf( "*** Key generation failed\n" );
+	return 0;
+    }
+    static const unsigned char message[3] = "abc";
+    size_t len_sig = ts_size_signature( ps );
+    size_t len_blob = ts_context_export_size( ps );
+    size_t len_buffer = ts_context_size( ps );
+    unsigned char *expected = malloc( len_sig );
+    unsigned char *sig = malloc( len_sig );
+    unsigned char *blob = malloc( len_blob );
+    unsigned char *wots_buffer = malloc( ts_wots_buffer_size( ps ) );
+    unsigned char *other_wots_buffer = malloc( ts_wots_buffer_size( ps ) );
+    struct ts_context *buffer = malloc( len_buffer );
+    struct ts_context ctx, *p;
+    int ok = 0;
+    if (!expected || !sig || !blob || !wots_buffer || !other_wots_buffer ||
+	!buffer) {
+	printf( "*** MALLOC FAILURE\n" );
+	goto done;
+    }
+
+    ts_init_sign( &ctx, message, 3, ps, private_key, 0 );
+    if (len_sig != ts_sign( expected, len_sig, &ctx )) {
+	printf( "*** Signing failed\n" );
+	goto done;
+    }
+
+    /* Suspend the signer, and resume it elsewhere */
+    for (unsigned i = 1; i < NUM_CUTS; i++) {
+	size_t cut = cut_point( i, len_sig );
+	ts_init_sign( &ctx, message, 3, ps, private_key, 0 );
+	if (cut != ts_sign( sig, cut, &ctx )) {
+	    printf( "*** Signing failed\n" );
+	    goto done;
+	}
+	p = move( &ctx, buffer, len_buffer, blob, len_blob, private_key,
+		  0, 0 );
+	if (!p || len_sig - cut != ts_sign( sig + cut, len_sig - cut, p ) ||
+	    0 != memcmp( sig, expected, len_sig )) {
+	    printf( "*** Resumed signature differs (at %zu)\n", cut );
+	    goto done;
+	}
+    }
+
+    /* A signer's blob is MACed; one that's been modified (so it'd */
+    /* resume at some other state, or some other tree), or lost its MAC, */
+    /* is refused */
+    {
+	size_t cut = cut_point( 4, len_sig );
+	ts_init_sign( &ctx, message, 3, ps, private_key, 0 );
+	ts_sign( sig, cut, &ctx );
+	size_t len = ts_context_export( blob, len_blob, &ctx );
+	size_t where = 32 + ts_size_public_key( ps );   /* The context */
+	size_t flip[4] = {
+	    where + offsetof(struct ts_context, state),
+	    where + offsetof(struct ts_context, tree_address),
+	    where + offsetof(struct ts_context, adr) + 3,
+	    len - 1,                                     /* The MAC */
+	};
+	if (len == 0 ||
+	    !ts_context_import( buffer, len_buffer, blob, len, private_key,
+				0, 0, 0 ) ||
+	    ts_context_import( buffer, len_buffer, blob, len - 1, private_key,
+			       0, 0, 0 ) ||
+	    ts_context_import( buffer, len_buffer, blob, len, public_key,
+			       0, 0, 0 )) {
+	    printf( "*** Signer blob import went wrong\n" );
+	    goto done;
+	}
+	for (unsigned i = 0; i < 4; i++) {
+	    blob[flip[i]] ^= 0x01;
+	    p = ts_context_import( buffer, len_buffer, blob, len, private_key,
+				   0, 0, 0 );
+	    blob[flip[i]] ^= 0x01;
+	    if (p) {
+		printf( "*** Modified signer blob accepted (byte %zu)\n",
+			flip[i] );
+		goto done;
+	    }
+	}
+    }
+
+    /* Suspend the verifier, with and without a WOTS buffer (which we */
+    /* sometimes give back, and sometimes don't); after the cut, we */
+    /* sometimes damage the signature, which should still be noticed */
+    for (unsigned i = 0; i < NUM_CUTS; i++) {
+	for (unsigned how = 0; how < 4; how++) {
+	    size_t cut = cut_point( i, len_sig );
+	    int damage = how & 1;
+	    int use_buffer = how >= 2;
+	    memcpy( sig, expected, len_sig );
+	    if (damage) sig[ cut + (len_sig - cut) / 2 ] ^= 0x40;
+	    ts_init_verify( &ctx, message, 3, ps, public_key );
+	    if (use_buffer) {
+		ts_set_wots_buffer( &ctx, wots_buffer,
+				    ts_wots_buffer_size( ps ) );
+	    }
+	    ts_update_verify( sig, cut, &ctx );
+	    size_t len = ts_context_export( blob, len_blob, &ctx );
+	    if (len == 0 || ts_context_blob_ps( blob, len ) != ps ||
+		ts_context_blob_needs_message( blob, len ) != (i < 2)) {
+		printf( "*** Bad blob (at %zu)\n", cut );
+		goto done;
+	    }
+	    p = move( &ctx, buffer, len_buffer, blob, len_blob, public_key,
+		      message, how == 3 ? wots_buffer : 0 );
+	    if (!p) {
+		printf( "*** Unable to resume verification (at %zu)\n", cut );
+		goto done;
+	    }
+	    ts_update_verify( sig + cut, len_sig - cut, p );
+	    if (ts_verify( p ) == damage) {
+		printf( "*** Resumed verification gave the wrong answer "
+			"(at %zu)\n", cut );
+		goto done;
+	    }
+	}
+    }
+
+    /* Fork the signer; both halves should produce the rest of the */
+    /* signature */
+    for (unsigned i = 1; i < NUM_CUTS; i++) {
+	size_t cut = cut_point( i, len_sig );
+	ts_init_sign( &ctx, message, 3, ps, private_key, 0 );
+	ts_sign( sig, cut, &ctx );
+	p = ts_context_fork( buffer, len_buffer, &ctx, 0 );
+	if (!p || len_sig - cut != ts_sign( sig + cut, len_sig - cut, p ) ||
+	    0 != memcmp( sig, expected, len_sig )) {
+	    printf( "*** Forked signature differs (at %zu)\n", cut );
+	    goto done;
+	}
+	memset( sig + cut, 0, len_sig - cut );
+	if (len_sig - cut != ts_sign( sig + cut, len_sig - cut, &ctx ) ||
+	    0 != memcmp( sig, expected, len_sig )) {
+	    printf( "*** Forking disturbed the signer (at %zu)\n", cut );
+	    goto done;
+	}
+    }
+
+    /* Fork the verifier, and give the two different tails (one good, */
+    /* one damaged, in either order), with and without WOTS buffers */
+    for (unsigned i = 0; i < NUM_CUTS; i++) {
+	for (unsigned how = 0; how < 6; how++) {
+	    size_t cut = cut_point( i, len_sig );
+	    int damage_fork = how & 1;
+	    int use_buffer = how >= 2;
+	    memcpy( sig, expected, len_sig );
+	    sig[ cut + (len_sig - cut) / 2 ] ^= 0x40;  /* The damaged tail */
+	    ts_init_verify( &ctx, message, 3, ps, public_key );
+	    if (use_buffer) {
+		ts_set_wots_buffer( &ctx, wots_buffer,
+				    ts_wots_buffer_size( ps ) );
+	    }
+	    ts_update_verify( expected, cut, &ctx );
+	    p = ts_context_fork( buffer, len_buffer, &ctx,
+				 how >= 4 ? other_wots_buffer : 0 );
+	    if (!p) {
+		printf( "*** Unable to fork the verifier (at %zu)\n", cut );
+		goto done;
+	    }
+	    /* Run the fork first, to make sure it leaves the original be */
+	    const unsigned char *tail[2] = { expected, sig };
+	    ts_update_verify( tail[damage_fork] + cut, len_sig - cut, p );
+	    ts_update_verify( tail[!damage_fork] + cut, len_sig - cut, &ctx );
+	    if (ts_verify( p ) == damage_fork ||
+		ts_verify( &ctx ) != damage_fork) {
+		printf( "*** Forked verification gave the wrong answer "
+			"(at %zu)\n", cut );
+		goto done;
+	    }
+	}
+    }
+    if (ts_context_fork( &ctx, sizeof ctx, &ctx, 0 )) {
+	printf( "*** Context forked onto itself\n" );
+	goto done;
+    }
+
+    /* And now some blobs that ought to be refused */
+    ts_init_verify( &ctx, message, 3, ps, public_key );
+    ts_update_verify( expected, len_sig / 2, &ctx );
+    size_t len = ts_context_export( blob, len_blob, &ctx );
+    unsigned char other_key[64];
+    memcpy( other_key, public_key, sizeof other_key );
+    other_key[3] ^= 1;
+    if (len == 0 ||
+	ts_context_export( blob, len - 1, &ctx ) != 0 ||
+	ts_context_import( buffer, len_buffer, blob, len, other_key,
+			   0, 0, 0 ) ||
+	ts_context_import( buffer, len_buffer - 8, blob, len, public_key,
+			   0, 0, 0 ) ||
+	ts_context_import( buffer, len_buffer, blob, len - 1, public_key,
+			   0, 0, 0 )) {
+	printf( "*** Bad import accepted\n" );
+	goto done;
+    }
+    for (unsigned i = 0; i < 20; i++) {    /* Every byte of the header */
+	blob[i] ^= 0x80;                    /* we check */
+	p = ts_context_import( buffer, len_buffer, blob, len, public_key,
+			       0, 0, 0 );
+	blob[i] ^= 0x80;
+	if (p) {
+	    printf( "*** Mangled blob accepted (byte %u)\n", i );
+	    goto done;
+	}
+    }
+    /* A verifier blob has no MAC, but one whose state has been changed */
+    /* to something the verifier couldn't be in (finished, or with an */
+    /* index out of range) is refused; we try that both just after R, */
+    /* and up in the hypertree */
+    for (unsigned i = 0; i < 2; i++) {
+	size_t cut = i ? len_sig - 2 * ts_size_public_key( ps ) :
+			 ts_size_public_key( ps ) / 2;
+	ts_init_verify( &ctx, message, 3, ps, public_key );
+	ts_update_verify( expected, cut, &ctx );
+	len = ts_context_export( blob, len_blob, &ctx );
+	size_t where = 32 + ts_size_public_key( ps );   /* The context */
+	struct ts_context image;
+	memcpy( &image, &blob[where], len_buffer );
+	if (len == 0 || !ts_context_import( buffer, len_buffer, blob, len,
+					    public_key, 0, 0, 0 )) {
+	    printf( "*** Unable to resume verification (at %zu)\n", cut );
+	    goto done;
+	}
+	for (unsigned how = 0; how < 6; how++) {
+	    struct ts_context bad = image;
+	    switch (how) {
+	    case 0: bad.state = ts_verify_success; break;
+	    case 1: bad.state = ts_verify_fail; break;
+	    case 2: bad.buffer_offset = 0xff; break;
+	    case 3: bad.fors_tree = 0xff; break;
+	    case 4: bad.merkle_level = 0xff; break;
+	    case 5: bad.hypertree_level = 0xff; break;
+	    }
+	    memcpy( &blob[where], &bad, len_buffer );
+	    p = ts_context_import( buffer, len_buffer, blob, len, public_key,
+				   0, 0, 0 );
+	    memcpy( &blob[where], &image, len_buffer );
+	    if (p) {
+		printf( "*** Modified verifier blob accepted (at %zu, "
+			"change %u)\n", cut, how );
+		goto done;
+	    }
+	}
+    }
+    /* Nor will a finished verifier fork */
+    ts_init_verify( &ctx, message, 3, ps, public_key );
+    ts_update_verify( expected, len_sig, &ctx );
+    if (ts_context_fork( buffer, len_buffer, &ctx, 0 )) {
+	printf( "*** Finished verifier forked\n" );
+	goto done;
+    }
+
+    /* A verifier that still needs the message won't resume without it */
+    ts_init_verify( &ctx, message, 3, ps, public_key );
+    len = ts_context_export( blob, len_blob, &ctx );
+    if (ts_context_import( buffer, len_buffer, blob, len, public_key,
+			   0, 0, 0 ) ||
+	ts_context_import( buffer, len_buffer, blob, len, public_key,
+			   message, 2, 0 )) {
+	printf( "*** Import without the message accepted\n" );
+	goto done;
+    }
+
+    ok = 1;
+done:
+    free( expected );
+    free( sig );
+    free( blob );
+    free( wots_buffer );
+    free( other_wots_buffer );
+    free( buffer );
+    return ok;
+}
+
+int test_export(int fast_flag, enum noise_level level) {
+#if TS_FIXED_PARM_SET
+    /* Built for the one parameter set; that's what we check */
+    (void)fast_flag;
+    return check( TEST_PS_ANY, TEST_PS_ANY_NAME, level );
+#else
+    if (!check( &ts_ps_sha2_128f_simple, "sha2_128f_simple", level ) ||
+        !check( &ts_ps_shake_192f_simple, "shake_192f_simple", level )) {
+	return 0;
+    }
+    if (!fast_flag) {
+	if (!check( &ts_ps_sha2_256f_simple, "sha2_256f_simple", level ) ||
+	    !check( &ts_ps_shake_128s_simple, "shake_128s_simple", level )) {
+	    return 0;
+	}
+    }
+    return 1;
+#endif
+}
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <string.h>
+#include "tiny_sphincs.h"
+#include "keycache.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out the expanded public keys, and the cache of them
+ */
+
+#define NUM_ENTRIES 3
+#define NUM_KEYS    5
+
+static unsigned char seed;
+static int seeded_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = seed + i;
+    }
+    return 1;
+}
+
+/* Sign the message, and feed the signature to the verifier */
+static int sign_and_verify( struct ts_context *verify,
+                            const unsigned char *private_key,
+                            const struct ts_parameter_set *ps,
+                            const unsigned char *message, size_t len ) {
+    struct ts_context sign;
+    ts_init_sign( &sign, message, len, ps, private_key, 0 );
+    for (;;) {
+	unsigned char buffer[100];
+	unsigned n = ts_sign( buffer, sizeof buffer, &sign );
+	if (n == 0) break;
+	ts_update_verify( buffer, n, verify );
+    }
+    return ts_verify( verify );
+}
+
+static int test_expanded( const struct ts_parameter_set *ps ) {
+    unsigned char private_key[128], public_key[64];
+    seed = 1;
+    if (!ts_gen_key( private_key, public_key, ps, seeded_rand )) {
+	printf( "*** Key generation failed\n" );
+	return 0;
+    }
+    static const unsigned char message[3] = { 'a', 'b', 'c' };
+    struct ts_expanded_key key;
+    ts_expand_public_key( &key, ps, public_key );
+    memset( public_key, 0, sizeof public_key ); /* The expanded key should */
+                                      /* have its own copy */
+
+    struct ts_context verify;
+    ts_init_verify_expanded( &verify, message, sizeof message, &key );
+    if (1 != sign_and_verify( &verify, private_key, ps,
+			      message, sizeof message )) {
+	printf( "*** Expanded key did not verify\n" );
+	return 0;
+    }
+    ts_init_verify_expanded( &verify, message, 2, &key );
+    if (0 != sign_and_verify( &verify, private_key, ps,
+			      message, sizeof message )) {
+	printf( "*** Expanded key verified the wrong message\n" );
+	return 0;
+    }
+    return 1;
+}
+
+int test_keycache(int fast_flag, enum noise_level level) {
+    (void)fast_flag;
+    (void)level;
+
+    /* Check expanded keys with SHA2 (both the SHA-256 and the SHA-512 */
+    /* flavors) and SHAKE parameter sets */
+#if TS_FIXED_PARM_SET
+    /* Built for the one parameter set; that's what we check */
+    if (!test_expanded( TEST_PS_ANY )) {
+	return 0;
+    }
+#else
+    if (!test_expanded( &ts_ps_sha2_128f_simple ) ||
+	          !test_expanded( &ts_ps_sha2_192f_simple ) ||
+	          !test_expanded( &ts_ps_shake_128f_simple )) {
+	return 0;
+    }
+#endif
+
+    /* Now the cache */
+    const struct ts_parameter_set *ps = TEST_PS_ANY;
+    unsigned len_public = ts_size_public_key( ps );
+    unsigned char public_key[NUM_KEYS][64];
+    for (int i=0; i<NUM_KEYS; i++) {
+	unsigned char private_key[128];
+	seed = 10*i;
+	if (!ts_gen_key( private_key, public_key[i], ps, seeded_rand )) {
+	    printf( "*** Key generation failed\n" );
+	    return 0;
+	}
+    }
+
+    static unsigned char memory[ NUM_ENTRIES * 200 ];
+    struct ts_key_cache cache;
+    size_t len_memory = NUM_ENTRIES * ts_key_cache_entry_size() + 7;
+    if (len_memory > sizeof memory ||
+	     NUM_ENTRIES != ts_key_cache_init( &cache, memory, len_memory,
+				               0, 0, 0 )) {
+	printf( "*** Wrong number of cache entries\n" );
+	return 0;
+    }
+
+    /* Fill the cache */
+    const struct ts_expanded_key *k[NUM_KEYS];
+    for (int i=0; i<NUM_ENTRIES; i++) {
+	k[i] = ts_key_cache_get( &cache, ps, public_key[i] );
+	if (!k[i] || 0 != memcmp( k[i]->public_key, public_key[i], len_public )) {
+	    printf( "*** Cache returned the wrong key\n" );
+	    return 0;
+	}
+    }
+    /* Everything is pinned; we shouldn't be able to add another */
+    if (ts_key_cache_get( &cache, ps, public_key[3] )) {
+	printf( "*** Cache evicted a pinned entry\n" );
+	return 0;
+    }
+    /* But we can get the ones already there */
+    const struct ts_expanded_key *again = ts_key_cache_get( &cache, ps,
+			                                    public_key[0] );
+    if (again != k[0] || cache.hits != 1) {
+	printf( "*** Cache missed an entry it has\n" );
+	return 0;
+    }
+    ts_key_cache_put( &cache, again );
+    for (int i=0; i<NUM_ENTRIES; i++) {
+	ts_key_cache_put( &cache, k[i] );
+    }
+
+    /* Key 0 was used most recently, so adding key 3 should evict key 1 */
+    k[3] = ts_key_cache_get( &cache, ps, public_key[3] );
+    if (k[3] != k[1]) {
+	printf( "*** Cache didn't evict the least recently used entry\n" );
+	return 0;
+    }
+    ts_key_cache_put( &cache, k[3] );
+    unsigned long misses = cache.misses;
+    const struct ts_expanded_key *k0 = ts_key_cache_get( &cache, ps,
+			                                 public_key[0] );
+    const struct ts_expanded_key *k2 = ts_key_cache_get( &cache, ps,
+			                                 public_key[2] );
+    if (k0 != k[0] || k2 != k[2] || cache.misses != misses) {
+	printf( "*** Cache lost an entry\n" );
+	return 0;
+    }
+    ts_key_cache_put( &cache, k0 );
+    ts_key_cache_put( &cache, k2 );
+
+    /* Key 1 was evicted; getting it again should be a miss (and still */
+    /* give the right key) */
+    k[1] = ts_key_cache_get( &cache, ps, public_key[1] );
+    if (!k[1] || cache.misses != misses + 1 ||
+	    0 != memcmp( k[1]->public_key, public_key[1], len_public )) {
+	printf( "*** Cache returned the wrong key\n" );
+	return 0;
+    }
+    struct ts_expanded_key direct;
+    ts_expand_public_key( &direct, ps, public_key[1] );
+    if (0 != memcmp( &direct, k[1], sizeof direct )) {
+	printf( "*** Cached expanded key differs\n" );
+	return 0;
+    }
+    ts_key_cache_put( &cache, k[1] );
+
+    return 1;
+}
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "tiny_sphincs.h"
+#include "keyfile.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out the key files the host tools use (keyfile.h): that what
+ * ts_write_key_file writes reads back as the same key, that the reader
+ * takes the lines in any order (with comments and blank lines), and that
+ * it rejects the files it should
+ */
+
+static int seeded_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 0x71 + 11*i;
+    }
+    return 1;
+}
+
+static char filename[] = "/tmp/ts_keyfileXXXXXX";
+
+static int write_text( const char *text ) {
+    FILE *f = fopen( filename, "w" );
+    if (!f) return 0;
+    int ok = (EOF != fputs( text, f ));
+    if (0 != fclose( f )) ok = 0;
+    return ok;
+}
+
+/*
+ * ts_read_key_file reports what's wrong on stderr; when we're reading
+ * files we expect it to reject, we don't want to see that
+ */
+static int saved_stderr = -1;
+static void hide_stderr( enum noise_level level ) {
+    if (level >= loud) return;
+    fflush( stderr );
+    saved_stderr = dup( 2 );
+    int null = open( "/dev/null", O_WRONLY );
+    if (null >= 0) {
+	dup2( null, 2 );
+	close( null );
+    }
+}
+static void show_stderr( void ) {
+    if (saved_stderr < 0) return;
+    fflush( stderr );
+    dup2( saved_stderr, 2 );
+    close( saved_stderr );
+    saved_stderr = -1;
+}
+
+/* Check that a file with this text is rejected */
+static int check_rejected( const char *text, const char *what,
+			   enum noise_level level ) {
+    struct ts_key_file key;
+    if (!write_text( text )) {
+	printf( "*** Unable to write %s\n", filename );
+	return 0;
+    }
+    hide_stderr( level );
+    int ok = ts_read_key_file( &key, filename );
+    show_stderr();
+    if (ok) {
+	printf( "*** Key file with %s accepted\n", what );
+	return 0;
+    }
+    return 1;
+}
+
+static void to_hex( char *out, const unsigned char *p, unsigned len ) {
+    for (unsigned i=0; i<len; i++) {
+	sprintf( out + 2*i, "%02x", p[i] );
+    }
+}
+
+int test_keyfile(int fast_flag, enum noise_level level) {
+    (void)fast_flag;
+    const struct ts_parameter_set *ps = TEST_PS_ANY;
+    const char *name = TEST_PS_ANY_NAME;
+    unsigned len_public = ts_size_public_key( ps );
+    unsigned len_private = ts_size_private_key( ps );
+
+    if (ts_lookup_parameter_set( name ) != ps ||
+	     !ts_parameter_set_name( ps ) ||
+	     0 != strcmp( ts_parameter_set_name( ps ), name ) ||
+	     ts_lookup_parameter_set( "sha2_128x_simple" )) {
+	printf( "*** Parameter set names don't match up\n" );
+	return 0;
+    }
+
+    struct ts_key_file key, key2;
+    memset( &key, 0, sizeof key );
+    key.ps = ps;
+    if (!ts_gen_key( key.private_key, key.public_key, ps, seeded_rand )) {
+	printf( "*** Key generation failed\n" );
+	return 0;
+    }
+    int fd = mkstemp( filename );
+    if (fd < 0) {
+	printf( "*** Unable to create a temporary file\n" );
+	return 0;
+    }
+    close( fd );
+    int ok = 0;
+
+    /* What we write, we read back; first with the private key, and */
+    /* then without it */
+    for (int with_private = 1; with_private >= 0; with_private--) {
+	key.have_private_key = with_private;
+	FILE *f = fopen( filename, "w" );
+	int written = f && ts_write_key_file( &key, f );
+	if (f && 0 != fclose( f )) written = 0;
+	if (!written) {
+	    printf( "*** Unable to write %s\n", filename );
+	    goto done;
+	}
+	if (!ts_read_key_file( &key2, filename ) ||
+		key2.ps != ps ||
+		key2.have_private_key != with_private ||
+		0 != memcmp( key2.public_key, key.public_key, len_public ) ||
+		(with_private && 0 != memcmp( key2.private_key,
+					key.private_key, len_private ))) {
+	    printf( "*** Key file didn't read back as written\n" );
+	    goto done;
+	}
+    }
+
+    /* The lines can come in any order, with comments and blank lines */
+    /* (and uppercase hex) */
+    char public_hex[ 4*TS_MAX_HASH + 1 ], private_hex[ 8*TS_MAX_HASH + 1 ];
+    to_hex( public_hex, key.public_key, len_public );
+    to_hex( private_hex, key.private_key, len_private );
+    for (char *p = private_hex; *p; p++) {
+	if (*p >= 'a' && *p <= 'f') *p += 'A' - 'a';
+    }
+    char text[ 1024 ];
+    sprintf( text, "# A key\n\n  private-key %s  \npublic-key %s\n"
+		   "\t# The parameter set\nparameter-set %s\n",
+		   private_hex, public_hex, name );
+    if (!write_text( text ) ||
+	    !ts_read_key_file( &key2, filename ) ||
+	    key2.ps != ps || !key2.have_private_key ||
+	    0 != memcmp( key2.public_key, key.public_key, len_public ) ||
+	    0 != memcmp( key2.private_key, key.private_key, len_private )) {
+	printf( "*** Reordered key file not read correctly\n" );
+	goto done;
+    }
+
+    /* And the ones that should be rejected */
+    to_hex( private_hex, key.private_key, len_private );
+    char other_public_hex[ 4*TS_MAX_HASH + 1 ];
+    strcpy( other_public_hex, public_hex );
+    other_public_hex[0] = other_public_hex[0] == '0' ? '1' : '0';
+    struct {
+	const char *ps, *public_key, *private_key, *extra, *what;
+    } bad[] = {
+	{ "sha2_128x_simple", public_hex, 0, 0, "an unknown parameter set" },
+	{ 0, public_hex, 0, 0, "no parameter set" },
+	{ name, 0, 0, 0, "no public key" },
+	{ name, public_hex + 2, 0, 0, "a short public key" },
+	{ name, public_hex, private_hex + 2, 0, "a short private key" },
+	{ name, other_public_hex, private_hex, 0,
+	  "a public key that doesn't match the private key" },
+	{ name, public_hex, 0, "public-key-2 00\n", "an unknown line" },
+	{ name, public_hex, 0, "private-key zz\n", "bad hex" },
+    };
+    for (unsigned i=0; i<sizeof bad / sizeof *bad; i++) {
+	size_t len = 0;
+	if (bad[i].ps) {
+	    len += sprintf( text + len, "parameter-set %s\n", bad[i].ps );
+	}
+	if (bad[i].public_key) {
+	    len += sprintf( text + len, "public-key %s\n", bad[i].public_key );
+	}
+	if (bad[i].private_key) {
+	    len += sprintf( text + len, "private-key %s\n",
+			    bad[i].private_key );
+	}
+	if (bad[i].extra) {
+	    len += sprintf( text + len, "%s", bad[i].extra );
+	}
+	if (!check_rejected( text, bad[i].what, level )) goto done;
+    }
+
+    /* A missing file, too */
+    unlink( filename );
+    hide_stderr( level );
+    int read_missing = ts_read_key_file( &key2, filename );
+    show_stderr();
+    if (read_missing) {
+	printf( "*** Missing key file read\n" );
+	goto done;
+    }
+
+    ok = 1;
+done:
+    unlink( filename );
+    memset( &key, 0, sizeof key );
+    memset( &key2, 0, sizeof key2 );
+    return ok;
+}
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <string.h>
+#include "tiny_sphincs.h"
+#include "keygen_mt.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out the ways of splitting up key generation (the subtree
+ * API, and the multithreaded key generation built on it); they should
+ * produce exactly the keys that ts_gen_key does
+ */
+
+static unsigned char seed;
+static int seeded_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = seed + 3*i;
+    }
+    return 1;
+}
+
+static int check( const struct ts_parameter_set *ps, const char *name,
+                  enum noise_level level ) {
+    unsigned len_private = ts_size_private_key( ps );
+    unsigned len_public = ts_size_public_key( ps );
+    unsigned char expected_private[128], expected_public[64];
+
+    if (level >= loud) {
+	printf( "    Checking %s\n", name );
+    }
+
+    seed = 7;
+    if (!ts_gen_key( expected_private, expected_public, ps, seeded_rand )) {
+	printf( "*** ts_gen_key failed\n" );
+	return 0;
+    }
+
+    static const unsigned thread_counts[] = { 1, 2, 3, 8 };
+    for (unsigned i=0; i<sizeof thread_counts/sizeof *thread_counts; i++) {
+	unsigned char private_key[128], public_key[64];
+	memset( private_key, 0, sizeof private_key );
+	if (!ts_gen_key_mt( private_key, public_key, ps, seeded_rand,
+			    thread_counts[i] )) {
+	    printf( "*** ts_gen_key_mt failed\n" );
+	    return 0;
+	}
+	if (0 != memcmp( private_key, expected_private, len_private ) ||
+	    0 != memcmp( public_key, expected_public, len_public )) {
+	    printf( "*** ts_gen_key_mt with %u threads gave a different key "
+		    "for %s\n", thread_counts[i], name );
+	    return 0;
+	}
+    }
+
+    return 1;
+}
+
+/*
+ * And the bulk key generation
+ */
+#define NUM_BULK 7
+
+static unsigned next_seed;
+static int counting_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = next_seed + 3*i;
+    }
+    next_seed++;
+    return 1;
+}
+
+static unsigned char streamed[NUM_BULK][64];
+static unsigned num_streamed, len_streamed;
+static int stream_key( unsigned index, const unsigned char *private_key,
+		       const unsigned char *public_key, void *arg ) {
+    (void)private_key;
+    if (index >= NUM_BULK || arg != streamed) return 0;
+    memcpy( streamed[index], public_key, len_streamed );
+    num_streamed++;
+    return 1;
+}
+
+static int stop_early( unsigned index, const unsigned char *private_key,
+		       const unsigned char *public_key, void *arg ) {
+    (void)index; (void)private_key; (void)public_key; (void)arg;
+    return 0;
+}
+
+static int check_bulk( enum noise_level level ) {
+    const struct ts_parameter_set *ps = TEST_PS_ANY;
+    unsigned len_private = ts_size_private_key( ps );
+    unsigned len_public = ts_size_public_key( ps );
+    /* ts_gen_keys packs the keys, so these are indexed by the key size */
+    unsigned char expected_private[NUM_BULK * 128];
+    unsigned char expected_public[NUM_BULK * 64];
+
+    if (level >= loud) {
+	printf( "    Checking bulk generation\n" );
+    }
+
+    /* What ts_gen_key gives us, one key at a time */
+    next_seed = 0;
+    for (int i=0; i<NUM_BULK; i++) {
+	if (!ts_gen_key( &expected_private[i * len_private],
+			 &expected_public[i * len_public], ps,
+			 counting_rand )) {
+	    printf( "*** ts_gen_key failed\n" );
+	    return 0;
+	}
+    }
+
+    for (unsigned threads = 1; threads <= 4; threads++) {
+	unsigned char private_keys[NUM_BULK * 128];
+	unsigned char public_keys[NUM_BULK * 64];
+	next_seed = 0;
+	num_streamed = 0;
+	len_streamed = len_public;
+	memset( streamed, 0, sizeof streamed );
+	if (!ts_gen_keys( NUM_BULK, private_keys, public_keys,
+			  ps, counting_rand, threads, stream_key, streamed )) {
+	    printf( "*** ts_gen_keys failed\n" );
+	    return 0;
+	}
+	if (0 != memcmp( private_keys, expected_private,
+			                     NUM_BULK * len_private ) ||
+	    0 != memcmp( public_keys, expected_public,
+			                     NUM_BULK * len_public )) {
+	    printf( "*** ts_gen_keys with %u threads gave different keys\n",
+		    threads );
+	    return 0;
+	}
+	if (num_streamed != NUM_BULK) {
+	    printf( "*** ts_gen_keys didn't output every key\n" );
+	    return 0;
+	}
+	for (int i=0; i<NUM_BULK; i++) {
+	    if (0 != memcmp( streamed[i], &expected_public[i * len_public],
+			     len_public )) {
+		printf( "*** ts_gen_keys output the wrong key\n" );
+		return 0;
+	    }
+	}
+    }
+
+    /* Streaming only (no arrays) */
+    next_seed = 0;
+    num_streamed = 0;
+    if (!ts_gen_keys( NUM_BULK, 0, 0, ps, counting_rand, 3,
+		      stream_key, streamed ) || num_streamed != NUM_BULK) {
+	printf( "*** ts_gen_keys without arrays failed\n" );
+	return 0;
+    }
+
+    /* The output function can stop things */
+    if (ts_gen_keys( NUM_BULK, 0, 0, ps, counting_rand, 2,
+		     stop_early, 0 )) {
+	printf( "*** ts_gen_keys didn't stop when asked\n" );
+	return 0;
+    }
+
+    return 1;
+}
+
+int test_keygen_mt(int fast_flag, enum noise_level level) {
+#if TS_FIXED_PARM_SET
+    /* Built for the one parameter set; that's what we check */
+    (void)fast_flag;
+    return check( TEST_PS_ANY, TEST_PS_ANY_NAME, level ) &&
+           check_bulk( level );
+#else
+    if (!check( &ts_ps_sha2_128f_simple, "sha2_128f_simple", level ) ||
+        !check( &ts_ps_shake_192f_simple, "shake_192f_simple", level ) ||
+        !check( &ts_ps_sha2_256f_simple, "sha2_256f_simple", level ) ||
+        !check_bulk( level )) {
+	return 0;
+    }
+    if (!fast_flag) {
+        if (!check( &ts_ps_sha2_128s_simple, "sha2_128s_simple", level ) ||
+            !check( &ts_ps_shake_256s_simple, "shake_256s_simple", level )) {
+	    return 0;
+	}
+    }
+    return 1;
+#endif
+}
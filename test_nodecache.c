@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tiny_sphincs.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out the signer's node cache: signatures should come out the
+ * same whether or not there's a cache, whether it's cold or warm, and
+ * whatever the (untrusted) cache does to the nodes it holds
+ */
+
+static int seeded_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 0x17 ^ (13*i);
+    }
+    return 1;
+}
+
+/* A simple minded node store; it just lists everything it's given */
+struct node {
+    unsigned layer, height, index;
+    uint64_t tree;
+    unsigned char value[TS_MAX_HASH], mac[TS_MAX_HASH];
+};
+struct store {
+    struct node *nodes;
+    unsigned count, max_count;
+    unsigned n;
+    unsigned stored, fetched;   /* How often we've been called */
+};
+
+static struct node *find( struct store *s, unsigned layer, uint64_t tree,
+		          unsigned height, unsigned index ) {
+    for (unsigned i=0; i<s->count; i++) {
+	struct node *p = &s->nodes[i];
+	if (p->layer == layer && p->tree == tree && p->height == height &&
+		p->index == index) {
+	    return p;
+	}
+    }
+    return 0;
+}
+
+static void store_node( const unsigned char *node, const unsigned char *mac,
+		   unsigned layer, uint64_t tree, unsigned height,
+		   unsigned index, void *arg ) {
+    struct store *s = arg;
+    s->stored++;
+    struct node *p = find( s, layer, tree, height, index );
+    if (!p) {
+	if (s->count == s->max_count) return;   /* We're full */
+	p = &s->nodes[s->count++];
+    }
+    p->layer = layer; p->tree = tree; p->height = height; p->index = index;
+    memcpy( p->value, node, s->n );
+    memset( p->mac, 0, s->n );
+    if (mac) memcpy( p->mac, mac, s->n );
+}
+
+static int fetch_node( unsigned char *node, unsigned char *mac,
+		   unsigned layer, uint64_t tree, unsigned height,
+		   unsigned index, void *arg ) {
+    struct store *s = arg;
+    struct node *p = find( s, layer, tree, height, index );
+    if (!p) return 0;
+    s->fetched++;
+    memcpy( node, p->value, s->n );
+    if (mac) memcpy( mac, p->mac, s->n );
+    return 1;
+}
+
+/* Sign the message (deterministically), with the cache if one is given */
+static int sign( unsigned char *sig, const unsigned char *message,
+		 size_t len_message, const struct ts_parameter_set *ps,
+		 const unsigned char *private_key,
+		 const struct ts_node_cache *cache ) {
+    struct ts_context ctx;
+    size_t len_sig = ts_size_signature( ps );
+    ts_init_sign( &ctx, message, len_message, ps, private_key, 0 );
+    if (cache && !ts_set_node_cache( &ctx, cache )) return 0;
+    /* Ask for odd sized chunks, to make sure we handle those */
+    size_t offset = 0;
+    for (;;) {
+	unsigned m = ts_sign( sig + offset, 37, &ctx );
+	if (m == 0) break;
+	offset += m;
+    }
+    return offset == len_sig;
+}
+
+static int check( const struct ts_parameter_set *ps, const char *name,
+	          enum noise_level level ) {
+    if (level >= loud) {
+	printf( "    Checking %s\n", name );
+    }
+    unsigned char private_key[128], public_key[64];
+    if (!ts_gen_key( private_key, public_key, ps, seeded_rand )) {
+	printf( "*** Key generation failed\n" );
+	return 0;
+    }
+    size_t len_sig = ts_size_signature( ps );
+    unsigned char *expected = malloc( len_sig );
+    unsigned char *sig = malloc( len_sig );
+    struct store s;
+    memset( &s, 0, sizeof s );
+    s.max_count = 20000;
+    s.n = ts_size_public_key( ps ) / 2;
+    s.nodes = malloc( s.max_count * sizeof *s.nodes );
+    struct ts_node_cache cache = { store_node, fetch_node, &s };
+    int ok = 0;
+    if (!expected || !sig || !s.nodes) {
+	printf( "*** MALLOC FAILURE\n" );
+	goto done;
+    }
+
+    static const unsigned char message[2][3] = { "abc", "xyz" };
+    for (int m = 0; m < 2; m++) {
+	if (!sign( expected, message[m], 3, ps, private_key, 0 )) {
+	    printf( "*** Signing failed\n" );
+	    goto done;
+	}
+
+	/* First cold (for the first message; for the second, the top */
+	/* layers are warm), and then warm */
+	for (int pass = 0; pass < 2; pass++) {
+	    s.stored = s.fetched = 0;
+	    if (!sign( sig, message[m], 3, ps, private_key, &cache ) ||
+		0 != memcmp( sig, expected, len_sig )) {
+		printf( "*** Signature with the cache differs\n" );
+		goto done;
+	    }
+	    if (pass == 1 && (s.stored != 0 || s.fetched == 0)) {
+		printf( "*** The cache wasn't used on the second pass\n" );
+		goto done;
+	    }
+	}
+    }
+
+    /* Now have the cache misbehave: we corrupt each kind of node in */
+    /* turn (a node on a path, a leaf, a root, a MAC); the signer must */
+    /* notice (and compute the path itself) */
+    unsigned merkle_h = 0;
+    for (unsigned i=0; i<s.count; i++) {
+	if (merkle_h < s.nodes[i].height) merkle_h = s.nodes[i].height;
+    }
+    if (!sign( expected, message[0], 3, ps, private_key, 0 )) {
+	printf( "*** Signing failed\n" );
+	goto done;
+    }
+    for (int what = 0; what < 4; what++) {
+	for (unsigned i=0; i<s.count; i++) {
+	    struct node *p = &s.nodes[i];
+	    switch (what) {
+	    case 0: if (p->height > 0 && p->height < merkle_h) {
+			p->value[0] ^= 1;
+		    }
+		    break;
+	    case 1: if (p->height == 0) p->value[1] ^= 2; break;
+	    case 2: if (p->height == merkle_h) p->value[2] ^= 4; break;
+	    case 3: if (p->height == merkle_h) p->mac[3] ^= 8; break;
+	    }
+	}
+	s.stored = s.fetched = 0;
+	if (!sign( sig, message[0], 3, ps, private_key, &cache ) ||
+	    0 != memcmp( sig, expected, len_sig ) || s.stored == 0) {
+	    printf( "*** Corrupted cache not detected (case %d)\n", what );
+	    goto done;
+	}
+    }
+
+    ok = 1;
+done:
+    free( expected );
+    free( sig );
+    free( s.nodes );
+    return ok;
+}
+
+int test_nodecache(int fast_flag, enum noise_level level) {
+#if !TS_NODE_CACHE
+    return 1;     /* Built without it; nothing to test */
+#endif
+#if TS_FIXED_PARM_SET
+    /* Built for the one parameter set; that's what we check */
+    (void)fast_flag;
+    return check( TEST_PS_ANY, TEST_PS_ANY_NAME, level );
+#else
+    if (!check( &ts_ps_sha2_128f_simple, "sha2_128f_simple", level ) ||
+        !check( &ts_ps_shake_192f_simple, "shake_192f_simple", level )) {
+	return 0;
+    }
+    if (!fast_flag) {
+	if (!check( &ts_ps_sha2_128s_simple, "sha2_128s_simple", level )) {
+	    return 0;
+	}
+    }
+    return 1;
+#endif
+}
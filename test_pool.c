@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "tiny_sphincs.h"
+#include "pool.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out the context pool; it checks the bookkeeping (handles,
+ * exhaustion, stale handles, wiping on release), and that contexts from
+ * the pool can actually sign and verify
+ */
+
+#define NUM_SLOTS 5
+
+static int fixed_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = i;
+    }
+    return 1;
+}
+
+int test_pool(int fast_flag, enum noise_level level) {
+    (void)fast_flag;
+    (void)level;
+    const struct ts_parameter_set *ps = TEST_PS_ANY;
+    static unsigned char memory[ NUM_SLOTS * sizeof(struct ts_context) +
+				 NUM_SLOTS * 64 + 64 ];
+    struct ts_pool pool;
+
+    /* Make the memory deliberately misaligned */
+    size_t len_memory = NUM_SLOTS * ts_pool_slot_size( ps ) + TS_POOL_ALIGN-1;
+    unsigned char *start = memory + 1;
+    if (NUM_SLOTS != ts_pool_init( &pool, start, len_memory, ps )) {
+	printf( "*** Wrong number of slots\n" );
+	return 0;
+    }
+    if (pool.context_size < ts_context_size( ps )) {
+	printf( "*** Slots too small\n" );
+	return 0;
+    }
+
+    /* Acquire all the slots */
+    ts_pool_handle h[NUM_SLOTS];
+    for (int i=0; i<NUM_SLOTS; i++) {
+	h[i] = ts_pool_acquire( &pool );
+	struct ts_context *ctx = ts_pool_context( &pool, h[i] );
+	if (h[i] == TS_POOL_INVALID || !ctx) {
+	    printf( "*** Could not acquire slot\n" );
+	    return 0;
+	}
+	if ((uintptr_t)ctx % TS_POOL_ALIGN != 0) {
+	    printf( "*** Slot not aligned\n" );
+	    return 0;
+	}
+	for (int j=0; j<i; j++) {
+	    if (ctx == ts_pool_context( &pool, h[j] )) {
+		printf( "*** Slot handed out twice\n" );
+		return 0;
+	    }
+	}
+	memset( ctx, 0xff, pool.context_size );
+    }
+    if (ts_pool_acquire( &pool ) != TS_POOL_INVALID) {
+	printf( "*** Acquired more slots than the pool has\n" );
+	return 0;
+    }
+
+    /* Release one; it should be wiped, and its handle should go stale */
+    unsigned char *released = (unsigned char *)ts_pool_context( &pool, h[2] );
+    if (!ts_pool_release( &pool, h[2] )) {
+	printf( "*** Release failed\n" );
+	return 0;
+    }
+    for (size_t i=0; i<pool.context_size; i++) {
+	if (released[i] != 0) {
+	    printf( "*** Context not wiped on release\n" );
+	    return 0;
+	}
+    }
+    if (ts_pool_context( &pool, h[2] ) || ts_pool_release( &pool, h[2] )) {
+	printf( "*** Stale handle still accepted\n" );
+	return 0;
+    }
+    ts_pool_handle h2 = ts_pool_acquire( &pool );
+    if (h2 == TS_POOL_INVALID || h2 == h[2] ||
+	       (unsigned char *)ts_pool_context( &pool, h2 ) != released) {
+	printf( "*** Released slot not reused\n" );
+	return 0;
+    }
+    if (ts_pool_context( &pool, h[2] )) {
+	printf( "*** Stale handle accepted after reuse\n" );
+	return 0;
+    }
+    h[2] = h2;
+
+    /* Now, sign and verify using two contexts from the pool */
+    unsigned char private_key[128], public_key[64];
+    if (!ts_gen_key( private_key, public_key, ps, fixed_rand )) {
+	printf( "*** Key generation failed\n" );
+	return 0;
+    }
+    static const unsigned char message[3] = { 'a', 'b', 'c' };
+    struct ts_context *sign = ts_init_sign_buffer(
+		   ts_pool_context( &pool, h[0] ), pool.context_size,
+		   message, sizeof message, ps, private_key, 0 );
+    struct ts_context *verify = ts_init_verify_buffer(
+		   ts_pool_context( &pool, h[4] ), pool.context_size,
+		   message, sizeof message, ps, public_key );
+    if (!sign || !verify) {
+	printf( "*** Pool context rejected by init\n" );
+	return 0;
+    }
+    for (;;) {
+	unsigned char buffer[100];
+	unsigned n = ts_sign( buffer, sizeof buffer, sign );
+	if (n == 0) break;
+	ts_update_verify( buffer, n, verify );
+    }
+    if (1 != ts_verify( verify )) {
+	printf( "*** Signature from pool context did not verify\n" );
+	return 0;
+    }
+
+    for (int i=0; i<NUM_SLOTS; i++) {
+	if (!ts_pool_release( &pool, h[i] )) {
+	    printf( "*** Release failed\n" );
+	    return 0;
+	}
+    }
+    if (pool.num_free != NUM_SLOTS) {
+	printf( "*** Slots leaked\n" );
+	return 0;
+    }
+
+    return 1;
+}
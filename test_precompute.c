@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "tiny_sphincs.h"
+#include "precompute.h"
+#include "sha2.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out the precomputed upper layers: we write out a file, and
+ * check that signatures come out the same with it as without, that the
+ * file holds what it should, and that we refuse files that have been
+ * damaged, or are for some other key
+ */
+
+static int seeded_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 0x5c ^ (7*i);
+    }
+    return 1;
+}
+
+static int other_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 0x3a ^ (11*i);
+    }
+    return 1;
+}
+
+/* Counts how often the signer uses the file */
+struct counted_cache {
+    const struct ts_node_cache *inner;
+    unsigned fetched;
+};
+
+static int fetch_node( unsigned char *node, unsigned char *mac,
+		   unsigned layer, uint64_t tree, unsigned height,
+		   unsigned index, void *arg ) {
+    struct counted_cache *c = arg;
+    int found = c->inner->fetch( node, mac, layer, tree, height, index,
+				 c->inner->arg );
+    if (found) c->fetched++;
+    return found;
+}
+
+static int sign( unsigned char *sig, const struct ts_parameter_set *ps,
+		 const unsigned char *private_key,
+		 const struct ts_node_cache *cache ) {
+    struct ts_context ctx;
+    ts_init_sign( &ctx, "abc", 3, ps, private_key, 0 );
+    if (cache && !ts_set_node_cache( &ctx, cache )) return 0;
+    size_t offset = 0;
+    for (;;) {
+	unsigned m = ts_sign( sig + offset, 1000, &ctx );
+	if (m == 0) break;
+	offset += m;
+    }
+    return offset == ts_size_signature( ps );
+}
+
+/* Flip a bit in the file at offset */
+static int damage( const char *filename, long offset ) {
+    FILE *f = fopen( filename, "r+b" );
+    if (!f) return 0;
+    int ok = 0 == fseek( f, offset, SEEK_SET );
+    int c = ok ? fgetc( f ) : EOF;
+    ok = c != EOF && 0 == fseek( f, offset, SEEK_SET ) &&
+	 EOF != fputc( c ^ 0x10, f );
+    if (0 != fclose( f )) ok = 0;
+    return ok;
+}
+
+/*
+ * Rewrite the file to claim it has some other number of layers, with the
+ * checksum (SHA-256 over the file, with the checksum itself zeroed) fixed
+ * up to match, as someone crafting a file would
+ */
+static int claim_layers( const char *filename, unsigned layers ) {
+    FILE *f = fopen( filename, "r+b" );
+    if (!f) return 0;
+    int ok = 0;
+    unsigned char *file = 0;
+    long len;
+    if (0 != fseek( f, 0, SEEK_END ) || (len = ftell( f )) < 128 ||
+	    !(file = malloc( len )) ||
+	    0 != fseek( f, 0, SEEK_SET ) ||
+	    1 != fread( file, len, 1, f )) {
+	goto done;
+    }
+    file[16] = layers;
+    memset( &file[84], 0, 32 );
+    SHA256_CTX ctx;
+    ts_SHA256_init( &ctx );
+    ts_SHA256_update( &ctx, file, len );
+    ts_SHA256_final( &file[84], &ctx );
+    ok = 0 == fseek( f, 0, SEEK_SET ) && 1 == fwrite( file, len, 1, f );
+done:
+    free( file );
+    if (0 != fclose( f )) ok = 0;
+    return ok;
+}
+
+static int check( const struct ts_parameter_set *ps, const char *name,
+	          unsigned d, unsigned merkle_h, unsigned layers,
+		  enum noise_level level ) {
+    if (level >= loud) {
+	printf( "    Checking %s with %u layers\n", name, layers );
+    }
+    unsigned char private_key[128], public_key[64];
+    unsigned char other_private_key[128], other_public_key[64];
+    if (!ts_gen_key( private_key, public_key, ps, seeded_rand ) ||
+	!ts_gen_key( other_private_key, other_public_key, ps, other_rand )) {
+	printf( "*** Key generation failed\n" );
+	return 0;
+    }
+    unsigned n = ts_size_public_key( ps ) / 2;
+    size_t len_sig = ts_size_signature( ps );
+    unsigned char *expected = malloc( len_sig );
+    unsigned char *sig = malloc( len_sig );
+    char filename[] = "/tmp/ts_precomputeXXXXXX";
+    int fd = mkstemp( filename );
+    struct ts_precomputed pc;
+    memset( &pc, 0, sizeof pc );
+    int ok = 0;
+    if (!expected || !sig || fd < 0) {
+	printf( "*** Unable to set up\n" );
+	goto done;
+    }
+    close( fd );
+
+    if (!ts_precompute( filename, private_key, ps, layers, 3 )) {
+	printf( "*** Precompute failed\n" );
+	goto done;
+    }
+    if (!ts_open_precomputed( &pc, filename, ps, public_key )) {
+	printf( "*** Unable to open the precomputed file\n" );
+	goto done;
+    }
+
+    /* The root of the top tree is the root in the public key */
+    unsigned char node[TS_MAX_HASH], mac[TS_MAX_HASH];
+    if (!pc.cache.fetch( node, mac, d-1, 0, merkle_h, 0, pc.cache.arg ) ||
+	0 != memcmp( node, public_key + n, n )) {
+	printf( "*** The top root isn't the public key root\n" );
+	goto done;
+    }
+
+    /* Signatures come out the same, and the file gets used */
+    struct counted_cache counted = { &pc.cache, 0 };
+    struct ts_node_cache cache = { 0, fetch_node, &counted };
+    if (!sign( expected, ps, private_key, 0 ) ||
+	!sign( sig, ps, private_key, &cache ) ||
+	0 != memcmp( sig, expected, len_sig )) {
+	printf( "*** Signature with the precomputed file differs\n" );
+	goto done;
+    }
+    if (counted.fetched == 0) {
+	printf( "*** The precomputed file wasn't used\n" );
+	goto done;
+    }
+    ts_close_precomputed( &pc );
+
+    /* Some other key's file is refused */
+    if (ts_open_precomputed( &pc, filename, ps, other_public_key )) {
+	printf( "*** Precomputed file accepted for the wrong key\n" );
+	goto done;
+    }
+
+    /* As is a damaged one (in the header, and in the body) */
+    long offsets[2] = { 13, (long)ts_precomputed_size( ps, layers ) - 1 };
+    for (int i = 0; i < 2; i++) {
+	if (!damage( filename, offsets[i] )) {
+	    printf( "*** Unable to modify the file\n" );
+	    goto done;
+	}
+	if (ts_open_precomputed( &pc, filename, ps, public_key )) {
+	    printf( "*** Damaged precomputed file accepted\n" );
+	    goto done;
+	}
+	damage( filename, offsets[i] );
+    }
+    if (!ts_open_precomputed( &pc, filename, ps, public_key )) {
+	printf( "*** Restored precomputed file refused\n" );
+	goto done;
+    }
+
+    /* A file claiming all d layers is refused, even with a checksum to */
+    /* match, when that's more than we'd write (which, for d = 22, would */
+    /* overflow the size) */
+    if ((d - 1) * merkle_h > 40) {
+	if (ts_precomputed_size( ps, d ) != 0 ||
+	    ts_precompute( filename, private_key, ps, d, 1 )) {
+	    printf( "*** Precompute accepted %u layers\n", d );
+	    goto done;
+	}
+	ts_close_precomputed( &pc );
+	if (!claim_layers( filename, d )) {
+	    printf( "*** Unable to modify the file\n" );
+	    goto done;
+	}
+	if (ts_open_precomputed( &pc, filename, ps, public_key )) {
+	    printf( "*** File claiming %u layers accepted\n", d );
+	    goto done;
+	}
+	if (!claim_layers( filename, layers ) ||
+	    !ts_open_precomputed( &pc, filename, ps, public_key )) {
+	    printf( "*** Restored precomputed file refused\n" );
+	    goto done;
+	}
+    }
+
+    /* Writing a new file (for the other key) over it while it's open */
+    /* replaces it, rather than changing it under the signer using it */
+    if (!ts_precompute( filename, other_private_key, ps, layers, 2 )) {
+	printf( "*** Precompute over an open file failed\n" );
+	goto done;
+    }
+    if (!pc.cache.fetch( node, mac, d-1, 0, merkle_h, 0, pc.cache.arg ) ||
+	0 != memcmp( node, public_key + n, n )) {
+	printf( "*** The open file changed when it was rewritten\n" );
+	goto done;
+    }
+    ts_close_precomputed( &pc );
+    if (!ts_open_precomputed( &pc, filename, ps, other_public_key )) {
+	printf( "*** Rewritten precomputed file refused\n" );
+	goto done;
+    }
+
+    ok = 1;
+done:
+    ts_close_precomputed( &pc );
+    if (fd >= 0) unlink( filename );
+    free( expected );
+    free( sig );
+    return ok;
+}
+
+int test_precompute(int fast_flag, enum noise_level level) {
+#if !TS_NODE_CACHE
+    return 1;     /* Built without it; nothing to test */
+#endif
+#if TS_FIXED_PARM_SET
+    /* Built for the one parameter set; that's what we check */
+    (void)fast_flag;
+    return check( TEST_PS_ANY, TEST_PS_ANY_NAME, TEST_PS_ANY_D,
+                  TEST_PS_ANY_MERKLE_H, 1, level );
+#else
+    /* The d and merkle_h are the parameter set's */
+    if (!check( &ts_ps_sha2_128f_simple, "sha2_128f_simple", 22, 3, 2,
+		level ) ||
+        !check( &ts_ps_shake_192f_simple, "shake_192f_simple", 22, 3, 1,
+		level )) {
+	return 0;
+    }
+    if (!fast_flag) {
+	if (!check( &ts_ps_sha2_128s_simple, "sha2_128s_simple", 7, 9, 1,
+		    level )) {
+	    return 0;
+	}
+    }
+    return 1;
+#endif
+}
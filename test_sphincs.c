@@ -5,6 +5,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <stddef.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "test_sphincs.h"
 
 /*
@@ -17,14 +19,37 @@ static struct {
     int warn_expense;                  /* Should we warn that this test */
                                        /* will take a while in -full mode */
     int (*test_enabled)(int);          /* Check if this tests is enabled */
+    int can_split;                     /* Can this test be split across */
+                                       /* jobs (see test_in_shard) */
 } test_list[] = {
-    { "sha512", test_sha512, "SHA512 known answer tests", 0, 0 },
-    { "shake256", test_shake256, "SHAKE256 known answer tests", 0, 0 },
-    { "testvector", test_testvector, "test vectors extracted from the reference code", 0, 0 },
-    { "verify", test_verify, "test verification logic", 1, 0 },
+    { "sha512", test_sha512, "SHA512 known answer tests", 0, 0, 0 },
+    { "shake256", test_shake256, "SHAKE256 known answer tests", 0, 0, 0 },
+    { "testvector", test_testvector, "test vectors extracted from the reference code", 0, 0, 1 },
+    { "verify", test_verify, "test verification logic", 1, 0, 1 },
+    { "backend", test_backend, "hash backends agree with the scalar code", 0, 0, 0 },
+    { "pool", test_pool, "context pool", 0, 0, 0 },
+    { "keycache", test_keycache, "expanded public keys and their cache", 0, 0, 0 },
+    { "keygen_mt", test_keygen_mt, "split, multithreaded and bulk key generation", 0, 0, 0 },
+    { "verify_mt", test_verify_mt, "multithreaded one-shot verification and the path cache", 0, 0, 0 },
+    { "batch_verify", test_batch_verify, "batch verification of signed files", 0, 0, 0 },
+    { "verify_async", test_verify_async, "streaming verification with H_msg in the background", 0, 0, 0 },
+    { "nodecache", test_nodecache, "signing with a cache of hypertree nodes", 0, 0, 0 },
+    { "precompute", test_precompute, "signing with precomputed upper layers", 0, 0, 0 },
+    { "wotscache", test_wotscache, "signing with a cache of WOTS chain checkpoints", 0, 0, 0 },
+    { "export", test_export, "suspending, resuming and forking contexts", 0, 0, 0 },
+    { "custom_ps", test_custom_ps, "parameter sets built at runtime", 0, 0, 0 },
+    { "drbg", test_drbg, "the DRBG that serves OptRand", 0, 0, 0 },
+    { "keyfile", test_keyfile, "reading and writing key files", 0, 0, 0 },
+    { "tsphincsd", test_tsphincsd, "the signing daemon, over its socket", 0, 0, 0 },
  /* Add more here */  
 };
 
+unsigned test_shard = 0, test_num_shards = 1;
+
+int test_in_shard(unsigned item) {
+    return item % test_num_shards == test_shard;
+}
+
 /*
  * This will run the listed tests; tests is a bitmap containing which tests
  * should be run; tests&1 is test_lis[t0], tests&2 is test_list[1], etc
@@ -57,14 +82,167 @@ static int run_tests( unsigned tests, int force_tests, int fast_flag,
     return success_flag;
 }
 
+/*
+ * This runs the listed tests as up to num_jobs jobs at once.  Each job is
+ * a separate process (the tests keep state in statics, and so can't share
+ * an address space), with its output going to a temporary file; a test
+ * that can be split is run as num_jobs jobs, each doing its share of the
+ * work items.  We report on the tests in order, once all the jobs for a
+ * test are done, so the output looks as it would if they were run one
+ * after another
+ */
+struct job {
+    unsigned test;      /* Index into test_list */
+    unsigned shard;
+    unsigned num_shards;
+    FILE *output;
+    pid_t pid;          /* 0 if not started yet */
+    int done;
+    int passed;
+};
+
+static int run_tests_parallel( unsigned tests, int force_tests,
+                      int fast_flag, enum noise_level level,
+                      unsigned num_jobs ) {
+    unsigned num_tests = sizeof test_list / sizeof *test_list;
+    struct job *job = calloc( num_tests * num_jobs, sizeof *job );
+    if (!job) {
+        printf( "*** MALLOC FAILURE\n" );
+        return EXIT_FAILURE;
+    }
+    unsigned count = 0, i;
+    for (i = 0; i < num_tests; i++) {
+        if (0 == ( tests & (1<<i))) continue;
+        if (test_list[i].test_enabled &&
+                                   !test_list[i].test_enabled(fast_flag)) {
+            continue;
+        }
+        unsigned shards = test_list[i].can_split ? num_jobs : 1;
+        for (unsigned k = 0; k < shards; k++) {
+            job[count].test = i;
+            job[count].shard = k;
+            job[count].num_shards = shards;
+            count++;
+        }
+    }
+
+    /* Progress from the jobs themselves would just be jumbled together; */
+    /* we report how many jobs are done instead */
+    enum noise_level job_level = level == loud ? loud : quiet;
+    int success_flag = EXIT_SUCCESS;
+    int stop = 0;
+    unsigned next_start = 0, next_report = 0, running = 0, finished = 0;
+    while (next_report < count) {
+        /* Start as many jobs as we can */
+        while (!stop && running < num_jobs && next_start < count) {
+            struct job *j = &job[next_start];
+            j->output = tmpfile();
+            if (!j->output) {
+                printf( "*** UNABLE TO CREATE TEMPORARY FILE\n" );
+                stop = 1;
+                success_flag = EXIT_FAILURE;
+                break;
+            }
+            fflush(stdout);
+            j->pid = fork();
+            if (j->pid == 0) {
+                /* We're the job */
+                dup2( fileno(j->output), STDOUT_FILENO );
+                test_shard = j->shard;
+                test_num_shards = j->num_shards;
+                int passed = test_list[j->test].test_routine(fast_flag,
+                                                             job_level);
+                fflush(stdout);
+                _exit( passed ? 0 : 1 );
+            }
+            if (j->pid < 0) {
+                printf( "*** UNABLE TO START JOB\n" );
+                fclose( j->output );
+                j->output = 0;
+                j->pid = 0;
+                stop = 1;
+                success_flag = EXIT_FAILURE;
+                break;
+            }
+            next_start++;
+            running++;
+        }
+
+        /* Report on the next test, if all its jobs are done */
+        struct job *first = &job[next_report];
+        unsigned n = first->num_shards, k;
+        for (k = 0; k < n && first[k].done; k++)
+            ;
+        if (k == n) {
+            printf( "Running %s", test_list[first->test].test_name );
+            if (test_list[first->test].warn_expense && !fast_flag) {
+                printf( " (warning: this will take a while)" );
+            }
+            printf( ":\n" );
+            int test_passed = 1;
+            for (k = 0; k < n; k++) {
+                int c;
+                rewind( first[k].output );
+                while ((c = getc( first[k].output )) != EOF) putchar( c );
+                fclose( first[k].output );
+                first[k].output = 0;
+                test_passed &= first[k].passed;
+            }
+            next_report += n;
+            if (test_passed) {
+                printf( "  Passed        \n" );
+            } else {
+                printf( "  **** TEST FAILED ****\n" );
+                success_flag = EXIT_FAILURE;
+                if (!force_tests) stop = 1;   /* Stop on first failure? */
+            }
+            fflush(stdout);
+            if (stop) break;
+            continue;
+        }
+        if (running == 0) break;   /* Nothing more will finish */
+
+        /* Wait for some job to finish */
+        int status;
+        pid_t pid = wait( &status );
+        if (pid < 0) break;
+        for (k = 0; k < next_start; k++) {
+            if (job[k].pid == pid && !job[k].done) break;
+        }
+        if (k == next_start) continue;
+        job[k].done = 1;
+        job[k].passed = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (WIFSIGNALED(status)) {
+            fprintf( job[k].output, "*** JOB KILLED BY SIGNAL %d\n",
+                     WTERMSIG(status) );
+        }
+        running--;
+        finished++;
+        if (level == whisper) {
+            printf( "%u/%u jobs\r", finished, count );
+            fflush(stdout);
+        }
+    }
+
+    /* If we stopped early, clean up after the jobs still running */
+    while (running > 0 && wait( 0 ) > 0) running--;
+    for (i = 0; i < count; i++) {
+        if (job[i].output) fclose( job[i].output );
+    }
+    free( job );
+    return success_flag;
+}
+
 static void usage(char *program_name) {
-    printf( "Usage: %s [-f] [-q] [-v] [-full] [tests]\n", program_name );
+    printf( "Usage: %s [-f] [-q] [-v] [-full] [-j N] [tests]\n", program_name );
     printf( "   \"all\" will run all tests\n" );
     printf( "   -q will remove progress messages during the longer tests\n" );
     printf( "   -v will add additional progress messages during some tests\n" );
     printf( "   -f will force running of all tests, even on failure\n" );
     printf( "   -full will have the tests run the entire suite\n" );
     printf( "          Warning: some tests may take over an hour in full mode\n" );
+    printf( "   -j N will run up to N jobs at once (the longer tests are\n" );
+    printf( "          split into N jobs)\n" );
     printf( "Supported tests:\n" );
     unsigned i;
     for (i = 0; i < sizeof test_list / sizeof *test_list; i++) {
@@ -77,6 +255,7 @@ int main( int argc, char **argv ) {
     unsigned tests_to_run = 0;
     int force_tests = 0;
     int fast_flag = 1;
+    unsigned num_jobs = 1;
     enum noise_level level = whisper;
     for (i = 1; i < argc; i++) {
         char *test = argv[i];
@@ -98,6 +277,16 @@ int main( int argc, char **argv ) {
             force_tests = 1;
         } else if (0 == strcmp( test, "-full" )) {
             fast_flag = 0;
+        } else if (0 == strncmp( test, "-j", 2 )) {
+            const char *arg = test[2] ? &test[2] : argv[++i];
+            char *end;
+            unsigned long n = arg ? strtoul( arg, &end, 10 ) : 0;
+            if (!arg || *end || n < 1 || n > 256) {
+                printf( "-j needs a number of jobs (1 to 256)\n" );
+                usage( argv[0] );
+                return EXIT_FAILURE;
+            }
+            num_jobs = n;
         } else if (0 == strcmp( test, "-q" )) {
             level = quiet;
         } else if (0 == strcmp( test, "-v" )) {
@@ -113,5 +302,9 @@ int main( int argc, char **argv ) {
         exit(EXIT_FAILURE);  /* FAILURE == We didn't pass the tests */
     }
 
+    if (num_jobs > 1) {
+        return run_tests_parallel( tests_to_run, force_tests, fast_flag,
+                                   level, num_jobs );
+    }
     return run_tests( tests_to_run, force_tests, fast_flag, level );
 }
@@ -1,10 +1,179 @@
 #if !defined( TEST_SPHINCS_H_ )
 #define TEST_SPHINCS_H_
+#include "tiny_sphincs.h"
+
 enum noise_level { quiet, whisper, loud };
+
+/*
+ * When the tests are run in parallel (-j), a test that can be split (see
+ * test_list in test_sphincs.c) is run as test_num_shards separate jobs;
+ * each job does only the work items (say, parameter sets) for which
+ * test_in_shard is true.  When not, test_in_shard is always true
+ */
+extern unsigned test_shard, test_num_shards;
+extern int test_in_shard(unsigned item);
+
+/*
+ * The parameter sets, as the tests refer to them.  In a build for a single
+ * parameter set (TS_FIXED_PARM_SET), the others don't exist, and these
+ * are NULL for them.  TEST_PS_ANY is one that the build always has
+ * (sha2_128f_simple, or the one it was built for), along with its name,
+ * d and Merkle tree height, for tests that can run on any of them
+ */
+#define TEST_NO_PS ((const struct ts_parameter_set *)0)
+
+#if TS_PS_ENABLED(TS_PS_SHAKE_128F_SIMPLE)
+#define TEST_PS_shake_128f_simple (&ts_ps_shake_128f_simple)
+#else
+#define TEST_PS_shake_128f_simple TEST_NO_PS
+#endif
+
+#if TS_PS_ENABLED(TS_PS_SHAKE_128S_SIMPLE)
+#define TEST_PS_shake_128s_simple (&ts_ps_shake_128s_simple)
+#else
+#define TEST_PS_shake_128s_simple TEST_NO_PS
+#endif
+
+#if TS_PS_ENABLED(TS_PS_SHAKE_192F_SIMPLE)
+#define TEST_PS_shake_192f_simple (&ts_ps_shake_192f_simple)
+#else
+#define TEST_PS_shake_192f_simple TEST_NO_PS
+#endif
+
+#if TS_PS_ENABLED(TS_PS_SHAKE_192S_SIMPLE)
+#define TEST_PS_shake_192s_simple (&ts_ps_shake_192s_simple)
+#else
+#define TEST_PS_shake_192s_simple TEST_NO_PS
+#endif
+
+#if TS_PS_ENABLED(TS_PS_SHAKE_256F_SIMPLE)
+#define TEST_PS_shake_256f_simple (&ts_ps_shake_256f_simple)
+#else
+#define TEST_PS_shake_256f_simple TEST_NO_PS
+#endif
+
+#if TS_PS_ENABLED(TS_PS_SHAKE_256S_SIMPLE)
+#define TEST_PS_shake_256s_simple (&ts_ps_shake_256s_simple)
+#else
+#define TEST_PS_shake_256s_simple TEST_NO_PS
+#endif
+
+#if TS_PS_ENABLED(TS_PS_SHA2_128F_SIMPLE)
+#define TEST_PS_sha2_128f_simple (&ts_ps_sha2_128f_simple)
+#else
+#define TEST_PS_sha2_128f_simple TEST_NO_PS
+#endif
+
+#if TS_PS_ENABLED(TS_PS_SHA2_128S_SIMPLE)
+#define TEST_PS_sha2_128s_simple (&ts_ps_sha2_128s_simple)
+#else
+#define TEST_PS_sha2_128s_simple TEST_NO_PS
+#endif
+
+#if TS_PS_ENABLED(TS_PS_SHA2_192F_SIMPLE)
+#define TEST_PS_sha2_192f_simple (&ts_ps_sha2_192f_simple)
+#else
+#define TEST_PS_sha2_192f_simple TEST_NO_PS
+#endif
+
+#if TS_PS_ENABLED(TS_PS_SHA2_192S_SIMPLE)
+#define TEST_PS_sha2_192s_simple (&ts_ps_sha2_192s_simple)
+#else
+#define TEST_PS_sha2_192s_simple TEST_NO_PS
+#endif
+
+#if TS_PS_ENABLED(TS_PS_SHA2_256F_SIMPLE)
+#define TEST_PS_sha2_256f_simple (&ts_ps_sha2_256f_simple)
+#else
+#define TEST_PS_sha2_256f_simple TEST_NO_PS
+#endif
+
+#if TS_PS_ENABLED(TS_PS_SHA2_256S_SIMPLE)
+#define TEST_PS_sha2_256s_simple (&ts_ps_sha2_256s_simple)
+#else
+#define TEST_PS_sha2_256s_simple TEST_NO_PS
+#endif
+
+#if !TS_FIXED_PARM_SET || TS_FIXED_PARM_SET == TS_PS_SHA2_128F_SIMPLE
+#define TEST_PS_ANY          TEST_PS_sha2_128f_simple
+#define TEST_PS_ANY_NAME     "sha2_128f_simple"
+#define TEST_PS_ANY_D        22
+#define TEST_PS_ANY_MERKLE_H 3
+#elif TS_FIXED_PARM_SET == TS_PS_SHAKE_128F_SIMPLE
+#define TEST_PS_ANY          TEST_PS_shake_128f_simple
+#define TEST_PS_ANY_NAME     "shake_128f_simple"
+#define TEST_PS_ANY_D        22
+#define TEST_PS_ANY_MERKLE_H 3
+#elif TS_FIXED_PARM_SET == TS_PS_SHAKE_128S_SIMPLE
+#define TEST_PS_ANY          TEST_PS_shake_128s_simple
+#define TEST_PS_ANY_NAME     "shake_128s_simple"
+#define TEST_PS_ANY_D        7
+#define TEST_PS_ANY_MERKLE_H 9
+#elif TS_FIXED_PARM_SET == TS_PS_SHAKE_192F_SIMPLE
+#define TEST_PS_ANY          TEST_PS_shake_192f_simple
+#define TEST_PS_ANY_NAME     "shake_192f_simple"
+#define TEST_PS_ANY_D        22
+#define TEST_PS_ANY_MERKLE_H 3
+#elif TS_FIXED_PARM_SET == TS_PS_SHAKE_192S_SIMPLE
+#define TEST_PS_ANY          TEST_PS_shake_192s_simple
+#define TEST_PS_ANY_NAME     "shake_192s_simple"
+#define TEST_PS_ANY_D        7
+#define TEST_PS_ANY_MERKLE_H 9
+#elif TS_FIXED_PARM_SET == TS_PS_SHAKE_256F_SIMPLE
+#define TEST_PS_ANY          TEST_PS_shake_256f_simple
+#define TEST_PS_ANY_NAME     "shake_256f_simple"
+#define TEST_PS_ANY_D        17
+#define TEST_PS_ANY_MERKLE_H 4
+#elif TS_FIXED_PARM_SET == TS_PS_SHAKE_256S_SIMPLE
+#define TEST_PS_ANY          TEST_PS_shake_256s_simple
+#define TEST_PS_ANY_NAME     "shake_256s_simple"
+#define TEST_PS_ANY_D        8
+#define TEST_PS_ANY_MERKLE_H 8
+#elif TS_FIXED_PARM_SET == TS_PS_SHA2_128S_SIMPLE
+#define TEST_PS_ANY          TEST_PS_sha2_128s_simple
+#define TEST_PS_ANY_NAME     "sha2_128s_simple"
+#define TEST_PS_ANY_D        7
+#define TEST_PS_ANY_MERKLE_H 9
+#elif TS_FIXED_PARM_SET == TS_PS_SHA2_192F_SIMPLE
+#define TEST_PS_ANY          TEST_PS_sha2_192f_simple
+#define TEST_PS_ANY_NAME     "sha2_192f_simple"
+#define TEST_PS_ANY_D        22
+#define TEST_PS_ANY_MERKLE_H 3
+#elif TS_FIXED_PARM_SET == TS_PS_SHA2_192S_SIMPLE
+#define TEST_PS_ANY          TEST_PS_sha2_192s_simple
+#define TEST_PS_ANY_NAME     "sha2_192s_simple"
+#define TEST_PS_ANY_D        7
+#define TEST_PS_ANY_MERKLE_H 9
+#elif TS_FIXED_PARM_SET == TS_PS_SHA2_256F_SIMPLE
+#define TEST_PS_ANY          TEST_PS_sha2_256f_simple
+#define TEST_PS_ANY_NAME     "sha2_256f_simple"
+#define TEST_PS_ANY_D        17
+#define TEST_PS_ANY_MERKLE_H 4
+#elif TS_FIXED_PARM_SET == TS_PS_SHA2_256S_SIMPLE
+#define TEST_PS_ANY          TEST_PS_sha2_256s_simple
+#define TEST_PS_ANY_NAME     "sha2_256s_simple"
+#define TEST_PS_ANY_D        8
+#define TEST_PS_ANY_MERKLE_H 8
+#endif
 	
 extern int test_testvector(int fast_flag, enum noise_level level);
 extern int test_sha512(int fast_flag, enum noise_level level);
 extern int test_shake256(int fast_flag, enum noise_level level);
 extern int test_verify(int fast_flag, enum noise_level level);
+extern int test_backend(int fast_flag, enum noise_level level);
+extern int test_pool(int fast_flag, enum noise_level level);
+extern int test_keycache(int fast_flag, enum noise_level level);
+extern int test_keygen_mt(int fast_flag, enum noise_level level);
+extern int test_verify_mt(int fast_flag, enum noise_level level);
+extern int test_batch_verify(int fast_flag, enum noise_level level);
+extern int test_verify_async(int fast_flag, enum noise_level level);
+extern int test_nodecache(int fast_flag, enum noise_level level);
+extern int test_precompute(int fast_flag, enum noise_level level);
+extern int test_wotscache(int fast_flag, enum noise_level level);
+extern int test_export(int fast_flag, enum noise_level level);
+extern int test_custom_ps(int fast_flag, enum noise_level level);
+extern int test_drbg(int fast_flag, enum noise_level level);
+extern int test_keyfile(int fast_flag, enum noise_level level);
+extern int test_tsphincsd(int fast_flag, enum noise_level level);
 
 #endif /* TEST_SPHINCS_H_ */
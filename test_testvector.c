@@ -48,34 +48,36 @@ static struct v {
 #include "testvector.h"
 };
 
-// Given a parameter set name, return a key of that type
-static const struct ts_parameter_set *lookup_parameter_set(const char *name) {
-    if (0 == strcmp( name, "sha2_128f_simple" ))
-        return &ts_ps_sha2_128f_simple;
-    if (0 == strcmp( name, "shake_128f_simple" ))
-        return &ts_ps_shake_128f_simple;
-    if (0 == strcmp( name, "sha2_128s_simple" ))
-        return &ts_ps_sha2_128s_simple;
-    if (0 == strcmp( name, "shake_128s_simple" ))
-        return &ts_ps_shake_128s_simple;
-
-    if (0 == strcmp( name, "sha2_192f_simple" ))
-        return &ts_ps_sha2_192f_simple;
-    if (0 == strcmp( name, "shake_192f_simple" ))
-        return &ts_ps_shake_192f_simple;
-    if (0 == strcmp( name, "sha2_192s_simple" ))
-        return &ts_ps_sha2_192s_simple;
-    if (0 == strcmp( name, "shake_192s_simple" ))
-        return &ts_ps_shake_192s_simple;
-
-    if (0 == strcmp( name, "sha2_256f_simple" ))
-        return &ts_ps_sha2_256f_simple;
-    if (0 == strcmp( name, "shake_256f_simple" ))
-        return &ts_ps_shake_256f_simple;
-    if (0 == strcmp( name, "sha2_256s_simple" ))
-        return &ts_ps_sha2_256s_simple;
-    if (0 == strcmp( name, "shake_256s_simple" ))
-        return &ts_ps_shake_256s_simple;
+// Given a parameter set name, find it.  This returns 0 if we've never
+// heard of it; *ps is NULL if we have, but this build doesn't have it (see
+// TS_FIXED_PARM_SET)
+static int lookup_parameter_set(const char *name,
+                                const struct ts_parameter_set **ps) {
+    static const struct {
+        const char *name;
+        const struct ts_parameter_set *ps;
+    } table[] = {
+        { "sha2_128f_simple", TEST_PS_sha2_128f_simple },
+        { "shake_128f_simple", TEST_PS_shake_128f_simple },
+        { "sha2_128s_simple", TEST_PS_sha2_128s_simple },
+        { "shake_128s_simple", TEST_PS_shake_128s_simple },
+
+        { "sha2_192f_simple", TEST_PS_sha2_192f_simple },
+        { "shake_192f_simple", TEST_PS_shake_192f_simple },
+        { "sha2_192s_simple", TEST_PS_sha2_192s_simple },
+        { "shake_192s_simple", TEST_PS_shake_192s_simple },
+
+        { "sha2_256f_simple", TEST_PS_sha2_256f_simple },
+        { "shake_256f_simple", TEST_PS_shake_256f_simple },
+        { "sha2_256s_simple", TEST_PS_sha2_256s_simple },
+        { "shake_256s_simple", TEST_PS_shake_256s_simple },
+    };
+    for (unsigned i=0; i<sizeof table/sizeof *table; i++) {
+        if (0 == strcmp( name, table[i].name )) {
+            *ps = table[i].ps;
+            return 1;
+        }
+    }
 
     printf( "*** UNRECOGNIZED PARAMETER SET %s\n", name );
     return 0;
@@ -98,9 +100,91 @@ static int optrand_rng( unsigned char *target, size_t num_bytes ) {
     return 1;
 }
 
+/* The guard area we place after the context */
+#define GUARD_SIZE 64
+#define GUARD_BYTE 0xa5
+
 /* For our SHA256 implementation, we borrow the one from Sphincs */
 #include "sha2.h"
 
+/*
+ * Generate and verify the signature again, but this time in contexts that
+ * are only ts_context_size(ps) bytes long (ts_init_sign_buffer and
+ * ts_init_verify_buffer), followed by a guard area that they shouldn't
+ * touch.  The signature should be the same
+ */
+static int check_sized_context( const struct v *v,
+		const struct ts_parameter_set *ps,
+		const unsigned char *private_key,
+		const unsigned char *public_key,
+		const unsigned char *message, size_t len_message ) {
+    size_t len_ctx = ts_context_size( ps );
+    if (len_ctx > sizeof(struct ts_context)) {
+        printf( "*** CONTEXT SIZE FOR %s TOO LARGE\n",
+                v->parameter_set_name );
+        return 0;
+    }
+    static union {
+        struct ts_context ctx; /* To get the alignment */
+        unsigned char buffer[sizeof(struct ts_context) + GUARD_SIZE];
+    } sign_buffer, verify_buffer;
+    memset( &sign_buffer, GUARD_BYTE, sizeof sign_buffer );
+    memset( &verify_buffer, GUARD_BYTE, sizeof verify_buffer );
+
+    struct ts_context *ctx = ts_init_sign_buffer( &sign_buffer, len_ctx,
+                            message, len_message, ps,
+                            private_key, optrand_rng );
+    if (!ctx || ts_init_sign_buffer( &sign_buffer, len_ctx-1,
+                            message, len_message, ps,
+                            private_key, optrand_rng )) {
+        printf( "*** ts_init_sign_buffer DID NOT CHECK SIZE\n" );
+        return 0;
+    }
+    struct ts_context *verify_ctx = ts_init_verify_buffer( &verify_buffer,
+                      len_ctx, message, len_message, ps, public_key );
+    if (!verify_ctx) {
+        printf( "*** ts_init_verify_buffer FAILED\n" );
+        return 0;
+    }
+
+    SHA256_CTX hash_ctx;
+    ts_SHA256_init( &hash_ctx );
+    for (;;) {
+        unsigned char buffer[ 42 ];
+        unsigned n = ts_sign( buffer, sizeof buffer, ctx );
+        if (n == 0) break;
+        ts_SHA256_update( &hash_ctx, buffer, n );
+        if (1 != ts_update_verify( buffer, n, verify_ctx )) {
+            printf( "*** SIZED CONTEXT VERIFY DETECTED FAILURE FOR %s\n",
+                    v->parameter_set_name );
+            return 0;
+        }
+    }
+    unsigned char hash[32];
+    ts_SHA256_final( hash, &hash_ctx );
+    if (0 != memcmp( v->hash_sig, hash, 32 )) {
+        printf( "*** SIZED CONTEXT GENERATED DIFFERENT SIGNATURE FOR %s\n",
+                v->parameter_set_name );
+        return 0;
+    }
+    if (1 != ts_verify( verify_ctx )) {
+        printf( "*** SIZED CONTEXT SIGNATURE DID NOT VERIFY FOR %s\n",
+                v->parameter_set_name );
+        return 0;
+    }
+
+    /* And make sure neither wrote past the end of its context */
+    for (size_t j = len_ctx; j < sizeof sign_buffer.buffer; j++) {
+        if (sign_buffer.buffer[j] != GUARD_BYTE ||
+                      verify_buffer.buffer[j] != GUARD_BYTE) {
+            printf( "*** CONTEXT OVERRUN FOR %s\n",
+                    v->parameter_set_name );
+            return 0;
+        }
+    }
+    return 1;
+}
+
 /* And here is the main code which actually runs the test */
 int test_testvector(int fast_flag, enum noise_level level) {
     (void)fast_flag;  /* Test is so fast there's no point in skipping some */
@@ -108,16 +192,17 @@ int test_testvector(int fast_flag, enum noise_level level) {
 
     for (unsigned i=0; i<sizeof vectors/sizeof *vectors; i++) {
         struct v *v = &vectors[i];
+        if (!test_in_shard(i)) continue;
+
+        /* Get the parameter set */
+        const struct ts_parameter_set *ps;
+        if (!lookup_parameter_set(v->parameter_set_name, &ps)) return 0;
+        if (!ps) continue;     /* Not in this build */
 
         if (level == loud) {
             printf( " Checking %s\n", v->parameter_set_name);
         }
 
-        /* Get the parameter set */
-        const struct ts_parameter_set *ps =
-	                      lookup_parameter_set(v->parameter_set_name);
-        if (!ps) return 0;
-
         /* Generate the public/private key pair */
 	unsigned char private_key[128];
 	unsigned char public_key[64];
@@ -190,6 +275,12 @@ int test_testvector(int fast_flag, enum noise_level level) {
             return 0;
         }
 
+	/* And the same again, in contexts sized for the parameter set */
+	if (!check_sized_context( v, ps, private_key, public_key,
+				  message, sizeof message )) {
+	    return 0;
+	}
+
         /* We're good for this parameter set */
     }
 
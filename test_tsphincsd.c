@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "tiny_sphincs.h"
+#include "keyfile.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out the signing daemon, end to end: we write out a key file
+ * (and a copy without the private key), start ./tsphincsd on them (which
+ * the Makefile builds along with this), and sign and verify over its
+ * socket.  Then we send it a SIGTERM, and check that it shuts down
+ * cleanly.  We do this twice, once taking the randomness from getentropy,
+ * and once from the DRBG (-r)
+ */
+
+#define DAEMON "./tsphincsd"
+
+static int seeded_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 0x25 + 9*i;
+    }
+    return 1;
+}
+
+static void sleep_ms( unsigned ms ) {
+    struct timespec t = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep( &t, 0 );
+}
+
+static int send_all( int fd, const void *p, size_t len ) {
+    const unsigned char *q = p;
+    while (len > 0) {
+	ssize_t k = send( fd, q, len, MSG_NOSIGNAL );
+	if (k < 0 && errno == EINTR) continue;
+	if (k <= 0) return 0;
+	q += k;
+	len -= k;
+    }
+    return 1;
+}
+
+static int recv_all( int fd, void *p, size_t len ) {
+    unsigned char *q = p;
+    while (len > 0) {
+	ssize_t k = recv( fd, q, len, 0 );
+	if (k < 0 && errno == EINTR) continue;
+	if (k <= 0) return 0;
+	q += k;
+	len -= k;
+    }
+    return 1;
+}
+
+static void put_u32( unsigned char *p, uint32_t x ) {
+    p[0] = x >> 24; p[1] = x >> 16; p[2] = x >> 8; p[3] = x;
+}
+
+static uint32_t get_u32( const unsigned char *p ) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	   ((uint32_t)p[2] << 8) | p[3];
+}
+
+/*
+ * Connect to the daemon; it may still be starting up, so we give it a
+ * few seconds
+ */
+static int connect_daemon( const char *socket_path ) {
+    struct sockaddr_un addr;
+    memset( &addr, 0, sizeof addr );
+    addr.sun_family = AF_UNIX;
+    strcpy( addr.sun_path, socket_path );
+    for (int tries = 0; tries < 500; tries++) {
+	int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if (fd < 0) return -1;
+	if (0 == connect( fd, (struct sockaddr *)&addr, sizeof addr )) {
+	    /* Don't hang if the daemon stops answering */
+	    struct timeval timeout = { 10, 0 };
+	    setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+			sizeof timeout );
+	    return fd;
+	}
+	close( fd );
+	sleep_ms( 10 );
+    }
+    return -1;
+}
+
+/* Send a request; sig is only for verify */
+static int send_request( int fd, char op, unsigned key,
+			 const void *message, size_t len_message,
+			 const void *sig, size_t len_sig ) {
+    unsigned char header[6];
+    header[0] = op;
+    header[1] = key;
+    put_u32( header+2, len_message );
+    if (!send_all( fd, header, 6 ) ||
+	    !send_all( fd, message, len_message )) {
+	return 0;
+    }
+    if (op == 'V') {
+	put_u32( header, len_sig );
+	if (!send_all( fd, header, 4 ) || !send_all( fd, sig, len_sig )) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/* Returns the status byte, or -1 if we didn't get one */
+static int get_status( int fd ) {
+    unsigned char status;
+    return recv_all( fd, &status, 1 ) ? status : -1;
+}
+
+/* Ask for a verify; returns the status */
+static int daemon_verify( int fd, unsigned key, const void *message,
+			  size_t len_message, const void *sig,
+			  size_t len_sig ) {
+    if (!send_request( fd, 'V', key, message, len_message, sig, len_sig )) {
+	return -1;
+    }
+    return get_status( fd );
+}
+
+/* Send one request on a new connection, and return the status */
+static int one_request( const char *socket_path, char op, unsigned key ) {
+    int fd = connect_daemon( socket_path );
+    if (fd < 0) return -1;
+    int status = send_request( fd, op, key, "abc", 3, 0, 0 ) ?
+		 get_status( fd ) : -1;
+    close( fd );
+    return status;
+}
+
+static int write_key_file( const char *name, const struct ts_key_file *key ) {
+    FILE *f = fopen( name, "w" );
+    if (!f) return 0;
+    int ok = ts_write_key_file( key, f );
+    if (0 != fclose( f )) ok = 0;
+    return ok;
+}
+
+/*
+ * Wait (for a few seconds at most) for the daemon to exit; returns 1 if
+ * it exited with EXIT_SUCCESS
+ */
+static int wait_daemon( pid_t pid ) {
+    for (int tries = 0; tries < 500; tries++) {
+	int status;
+	pid_t p = waitpid( pid, &status, WNOHANG );
+	if (p == pid) {
+	    return WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+	}
+	if (p < 0) return 0;
+	sleep_ms( 10 );
+    }
+    kill( pid, SIGKILL );
+    waitpid( pid, 0, 0 );
+    return 0;
+}
+
+static int run_daemon( const struct ts_parameter_set *ps,
+		       const unsigned char *public_key,
+		       const char *dir, const char *reseed,
+		       enum noise_level level ) {
+    char socket_path[100], private_file[100], public_file[100];
+    sprintf( socket_path, "%s/socket", dir );
+    sprintf( private_file, "%s/private", dir );
+    sprintf( public_file, "%s/public", dir );
+    size_t len_sig = ts_size_signature( ps );
+
+    if (level >= loud) {
+	printf( "    Checking %s -r %s\n", DAEMON, reseed );
+    }
+    fflush( stdout );
+    pid_t pid = fork();
+    if (pid < 0) {
+	printf( "*** Unable to fork\n" );
+	return 0;
+    }
+    if (pid == 0) {
+	execl( DAEMON, DAEMON, "-w", "2", "-r", reseed, socket_path,
+	       private_file, public_file, (char *)0 );
+	_exit( 127 );
+    }
+
+    int ok = 0, fd = -1;
+    unsigned char *sig = malloc( len_sig );
+    static const char message[] = "Sign me";
+    if (!sig) {
+	printf( "*** MALLOC FAILURE\n" );
+	goto done;
+    }
+    fd = connect_daemon( socket_path );
+    if (fd < 0) {
+	printf( "*** Unable to connect to %s (has it been built?)\n", DAEMON );
+	goto done;
+    }
+
+    /* Sign; we check the signature ourselves */
+    unsigned char header[4];
+    if (!send_request( fd, 'S', 0, message, sizeof message, 0, 0 ) ||
+	    get_status( fd ) != 0 ||
+	    !recv_all( fd, header, 4 ) || get_u32( header ) != len_sig ||
+	    !recv_all( fd, sig, len_sig )) {
+	printf( "*** Signing over the socket failed\n" );
+	goto done;
+    }
+    struct ts_context ctx;
+    ts_init_verify( &ctx, message, sizeof message, ps, public_key );
+    ts_update_verify( sig, len_sig, &ctx );
+    if (1 != ts_verify( &ctx )) {
+	printf( "*** Signature from the daemon didn't verify\n" );
+	goto done;
+    }
+
+    /* And have the daemon verify it, with either key file (on the same */
+    /* connection), along with a modified one and the wrong message */
+    if (daemon_verify( fd, 0, message, sizeof message, sig, len_sig ) != 0 ||
+	daemon_verify( fd, 1, message, sizeof message, sig, len_sig ) != 0) {
+	printf( "*** Daemon didn't verify a valid signature\n" );
+	goto done;
+    }
+    sig[ len_sig / 2 ] ^= 0x04;
+    int status = daemon_verify( fd, 0, message, sizeof message, sig, len_sig );
+    sig[ len_sig / 2 ] ^= 0x04;
+    if (status != 1 ||
+	daemon_verify( fd, 0, "Sign m", 6, sig, len_sig ) != 1) {
+	printf( "*** Daemon verified a bad signature\n" );
+	goto done;
+    }
+
+    /* The requests it should refuse: a key it doesn't have, and signing */
+    /* with a key file without the private key */
+    if (one_request( socket_path, 'S', 2 ) != 0xff ||
+	one_request( socket_path, 'V', 2 ) != 0xff ||
+	one_request( socket_path, 'S', 1 ) != 0xff ||
+	one_request( socket_path, 'X', 0 ) != 0xff) {
+	printf( "*** Daemon accepted a bad request\n" );
+	goto done;
+    }
+
+    /* The metrics */
+    if (one_request( socket_path, 'M', 0 ) != 0) {
+	printf( "*** Daemon didn't give its metrics\n" );
+	goto done;
+    }
+
+    ok = 1;
+done:
+    if (fd >= 0) close( fd );
+    free( sig );
+
+    /* And it shuts down cleanly when asked */
+    kill( pid, SIGTERM );
+    if (!wait_daemon( pid )) {
+	if (ok) printf( "*** Daemon didn't exit cleanly on SIGTERM\n" );
+	ok = 0;
+    }
+    struct stat st;
+    if (ok && 0 == stat( socket_path, &st )) {
+	printf( "*** Daemon didn't remove its socket\n" );
+	ok = 0;
+    }
+    unlink( socket_path );
+    return ok;
+}
+
+int test_tsphincsd(int fast_flag, enum noise_level level) {
+    (void)fast_flag;
+    const struct ts_parameter_set *ps = TEST_PS_ANY;
+    struct ts_key_file key;
+    memset( &key, 0, sizeof key );
+    key.ps = ps;
+    if (!ts_gen_key( key.private_key, key.public_key, ps, seeded_rand )) {
+	printf( "*** Key generation failed\n" );
+	return 0;
+    }
+
+    char dir[] = "/tmp/ts_daemonXXXXXX";
+    if (!mkdtemp( dir )) {
+	printf( "*** Unable to create a temporary directory\n" );
+	return 0;
+    }
+    char private_file[100], public_file[100];
+    sprintf( private_file, "%s/private", dir );
+    sprintf( public_file, "%s/public", dir );
+    int ok = 0;
+    key.have_private_key = 1;
+    int written = write_key_file( private_file, &key );
+    key.have_private_key = 0;
+    if (!written || !write_key_file( public_file, &key )) {
+	printf( "*** Unable to write to %s\n", dir );
+	goto done;
+    }
+
+    ok = run_daemon( ps, key.public_key, dir, "0", level ) &&
+	 run_daemon( ps, key.public_key, dir, "2", level );
+
+done:
+    unlink( private_file );
+    unlink( public_file );
+    rmdir( dir );
+    memset( &key, 0, sizeof key );
+    return ok;
+}
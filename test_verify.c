@@ -14,9 +14,71 @@ static int local_rand( unsigned char *buffer, size_t n ) {
     return 1;
 }
 
+/*
+ * Check the verifier with a WOTS buffer: the signature should verify (even
+ * if passed in small chunks), and flipping bits should make it fail
+ */
+static int check_wots_buffer( unsigned char *s, size_t len_signature,
+		       const struct ts_parameter_set *ps,
+                       const unsigned char *message, size_t len_message,
+		       const unsigned char *public_key, int fast_flag ) {
+    static unsigned char wots_buffer[ (2*64+3) * 64 ];
+    size_t len_wots_buffer = ts_wots_buffer_size( ps );
+    struct ts_context ctx;
+
+    memset( &ctx, '#', sizeof ctx );
+    ts_init_verify( &ctx, message, len_message, ps, public_key );
+    if (ts_set_wots_buffer( &ctx, wots_buffer, len_wots_buffer-1 )) {
+	printf( "*** TOO SHORT WOTS BUFFER ACCEPTED\n" );
+	return 0;
+    }
+    if (!ts_set_wots_buffer( &ctx, wots_buffer, len_wots_buffer )) {
+	return 1;  /* Built without multiple lanes; nothing to test */
+    }
+    if (1 != ts_update_verify( s, len_signature, &ctx ) ||
+        1 != ts_verify( &ctx )) {
+        printf( "*** BUFFERED WOTS VERIFY FAILED\n" );
+	return 0;
+    }
+
+    ts_init_verify( &ctx, message, len_message, ps, public_key );
+    ts_set_wots_buffer( &ctx, wots_buffer, len_wots_buffer );
+    for (size_t i=0; i<len_signature; i+=7) {
+        unsigned chunk = len_signature-i;
+	if (chunk > 7) chunk = 7;
+        ts_update_verify( s+i, chunk, &ctx );
+    }
+    if (1 != ts_verify( &ctx )) {
+        printf( "*** INCREMENTAL BUFFERED WOTS VERIFY FAILED\n" );
+	return 0;
+    }
+
+    unsigned increment = fast_flag ? 97 : 13;
+    for (size_t offset = 0; offset < len_signature; offset += increment) {
+	s[offset] ^= 1 << (offset % 8);
+        ts_init_verify( &ctx, message, len_message, ps, public_key );
+        ts_set_wots_buffer( &ctx, wots_buffer, len_wots_buffer );
+	int ok = ts_update_verify( s, len_signature, &ctx ) ||
+                 ts_verify( &ctx );
+	s[offset] ^= 1 << (offset % 8);
+	if (ok) {
+            printf( "*** BUFFERED WOTS VERIFY ACCEPTED MODIFIED SIGNATURE\n" );
+	    return 0;
+	}
+    }
+    return 1;
+}
+
 static size_t total_sig_len, processed_sig_len;
 static int prev_percentage;
 
+/*
+ * If we're split into shards, each parameter set is split into this many
+ * work items, each of which is a range of offsets for the bit flip test
+ */
+#define NUM_RANGES 4
+static unsigned next_item;
+
 static int do_test( const struct ts_parameter_set *ps,
                        const char* parameter_set_name, int always,
 		       int fast_flag, int level, int iter ) {
@@ -36,6 +98,15 @@ static int do_test( const struct ts_parameter_set *ps,
         return 1;
     }
 
+    /* Skip it if this shard doesn't get any of its offset ranges */
+    unsigned first_item = next_item;
+    next_item += NUM_RANGES;
+    unsigned range;
+    for (range = 0; range < NUM_RANGES; range++) {
+        if (test_in_shard(first_item + range)) break;
+    }
+    if (range == NUM_RANGES) return 1;
+
     if (level == loud) {
         printf( " Checking %s\n", parameter_set_name);
     }
@@ -125,12 +196,27 @@ static int do_test( const struct ts_parameter_set *ps,
 	}
     }
 
+    if (!check_wots_buffer( s, len_signature, ps, message, len_message,
+			    public_key, fast_flag )) {
+	free(s);
+	return 0;
+    }
+
     /*
      * Now step through the signature and flip bits; verify that those
-     * flipped bits prevent the signature from validating
+     * flipped bits prevent the signature from validating.  Everything
+     * before the flipped byte is the same as in the unmodified signature,
+     * so rather than start each verification from the beginning, we keep
+     * a verifier (clean) that has been given the signature up to the
+     * current offset, and fork it for each flipped bit
      */
+    struct ts_context clean;
+    ts_init_verify( &clean, message, len_message, ps, public_key );
+    size_t clean_offset = 0;
     unsigned increment = fast_flag ? 5 : 1;
     for (size_t offset = 0; offset < len_signature; offset += increment) {
+        if (!test_in_shard(first_item +
+                           offset * NUM_RANGES / len_signature)) continue;
         if (level >= whisper) {
             /* Update the percentage completed if needed */
             int this_percentage = (int)current_percent;
@@ -142,15 +228,39 @@ static int do_test( const struct ts_parameter_set *ps,
             current_percent += increment * percentage_inc;
         }
 
+        /* Bring the clean verifier up to this offset */
+        ts_update_verify( s + clean_offset, offset - clean_offset, &clean );
+        clean_offset = offset;
+
+        /* Every so often, make sure that the unmodified rest of the */
+        /* signature validates when resumed from here */
+        if (offset % (64*increment) == 0) {
+            memset( &ctx, offset, sizeof ctx );
+            if (!ts_context_fork( &ctx, sizeof ctx, &clean, 0 ) ||
+                1 != ts_update_verify( s + offset, len_signature - offset,
+                                       &ctx ) ||
+                1 != ts_verify( &ctx )) {
+                printf( "*** RESUMED UNMODIFIED SIGNATURE DID NOT "
+                        "VALIDATE\n" );
+                free(s);
+                return 0;
+            }
+        }
+
         unsigned bit_increment = fast_flag ? 8 : 1;
         for (unsigned bit = 0; bit < 8; bit += bit_increment) {
             s[offset] ^= (1 << bit);
 
             memset( &ctx, offset+bit, sizeof ctx );
-            ts_init_verify( &ctx, message, len_message, ps, public_key );
+            if (!ts_context_fork( &ctx, sizeof ctx, &clean, 0 )) {
+                printf( "*** UNABLE TO FORK VERIFIER\n" );
+                free(s);
+                return 0;
+            }
 
             /* Make sure that it doesn't verify */
-            if (0 != ts_update_verify( s, len_signature, &ctx ) ||
+            if (0 != ts_update_verify( s + offset, len_signature - offset,
+                                       &ctx ) ||
                  0 != ts_verify( &ctx )) {
                 printf( "*** SIGNATURE VALIDATED FOR MODIFIED SIGNATURE\n" );
 		free(s);
@@ -186,9 +296,17 @@ static int do_test( const struct ts_parameter_set *ps,
 }
 
 #define CONCAT( A, B ) A##B
+/* Parameter sets this build doesn't have are skipped; if it was built */
+/* for just one, we always do that one */
+#if TS_FIXED_PARM_SET
+#define ONLY_PARM_SET 1
+#else
+#define ONLY_PARM_SET 0
+#endif
 #define RUN_TEST(PARM_SET, always) {                                \
-    const struct ts_parameter_set *ps = &CONCAT( ts_ps_, PARM_SET ); \
-    if (!do_test( ps, #PARM_SET, always, fast_flag, level, iter )) { \
+    const struct ts_parameter_set *ps = CONCAT( TEST_PS_, PARM_SET ); \
+    if (ps && !do_test( ps, #PARM_SET, (always) || ONLY_PARM_SET,   \
+                        fast_flag, level, iter )) {                 \
         return 0;                                                   \
     }                                                               \
 }
@@ -197,6 +315,7 @@ int test_verify(int fast_flag, enum noise_level level) {
     total_sig_len = 0;
     processed_sig_len = 0;
     prev_percentage = -1;
+    next_item = 0;
     for (unsigned iter=0; iter <= 1; iter++) {
 
         /*
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tiny_sphincs.h"
+#include "verify_async.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out verification with H_msg in the background; it should
+ * accept and reject exactly the same signatures that the streaming
+ * verifier does, however the signature is chopped up, and however much
+ * staging buffer it has
+ */
+
+static int seeded_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 0x69 ^ (11*i);
+    }
+    return 1;
+}
+
+static int async_verify( const unsigned char *message, size_t len_message,
+			 const unsigned char *sig, size_t len_sig,
+			 const unsigned char *public_key,
+			 const struct ts_parameter_set *ps,
+			 unsigned char *staging, size_t len_staging,
+			 size_t chunk ) {
+    struct ts_verify_async av;
+    ts_init_verify_async( &av, message, len_message, ps, public_key,
+			  staging, len_staging );
+    while (len_sig > 0) {
+	size_t this_chunk = chunk < len_sig ? chunk : len_sig;
+	ts_update_verify_async( sig, this_chunk, &av );
+	sig += this_chunk;
+	len_sig -= this_chunk;
+    }
+    return ts_verify_async( &av );
+}
+
+static int check( const struct ts_parameter_set *ps, const char *name,
+	          int fast_flag, enum noise_level level ) {
+    if (level >= loud) {
+	printf( "    Checking %s\n", name );
+    }
+    unsigned char private_key[128], public_key[64];
+    if (!ts_gen_key( private_key, public_key, ps, seeded_rand )) {
+	printf( "*** Key generation failed\n" );
+	return 0;
+    }
+    size_t len_message = fast_flag ? 100000 : 2000000;
+    size_t len_sig = ts_size_signature( ps );
+    unsigned char *message = malloc( len_message );
+    unsigned char *sig = malloc( len_sig + 1 );
+    unsigned char *staging = malloc( len_sig );
+    int ok = 0;
+    if (!message || !sig || !staging) {
+	printf( "*** MALLOC FAILURE\n" );
+	goto done;
+    }
+    for (size_t i=0; i<len_message; i++) message[i] = (unsigned char)(i*7);
+    struct ts_context ctx;
+    ts_init_sign( &ctx, message, len_message, ps, private_key, 0 );
+    ts_sign( sig, len_sig, &ctx );
+    sig[len_sig] = 0;
+
+    size_t staging_sizes[] = { 0, 100, len_sig };
+    size_t chunks[] = { 1, 33, 4096, len_sig + 1 };
+    /* Bytes in R, the first FORS tree, the hypertree, and the very end */
+    size_t flips[] = { 0, 100, len_sig / 2, len_sig - 1 };
+    for (unsigned s=0; s<sizeof staging_sizes/sizeof *staging_sizes; s++) {
+	for (unsigned c=0; c<sizeof chunks/sizeof *chunks; c++) {
+	    size_t len_staging = staging_sizes[s], chunk = chunks[c];
+	    if (fast_flag && chunk == 1 && len_staging != 100) continue;
+	    if (1 != async_verify( message, len_message, sig, len_sig,
+			    public_key, ps, staging, len_staging, chunk )) {
+		printf( "*** Valid signature rejected (staging %u, "
+			"chunk %u)\n", (unsigned)len_staging, (unsigned)chunk );
+		goto done;
+	    }
+	    if (0 != async_verify( message, len_message - 1, sig, len_sig,
+			    public_key, ps, staging, len_staging, chunk ) ||
+		0 != async_verify( message, len_message, sig, len_sig - 1,
+			    public_key, ps, staging, len_staging, chunk ) ||
+		0 != async_verify( message, len_message, sig, len_sig + 1,
+			    public_key, ps, staging, len_staging, chunk ) ||
+		0 != async_verify( message, len_message, sig, 10,
+			    public_key, ps, staging, len_staging, chunk )) {
+		printf( "*** Invalid signature accepted (staging %u, "
+			"chunk %u)\n", (unsigned)len_staging, (unsigned)chunk );
+		goto done;
+	    }
+	    for (unsigned f=0; f<sizeof flips/sizeof *flips; f++) {
+		sig[flips[f]] ^= 0x04;
+		int v = async_verify( message, len_message, sig, len_sig,
+			    public_key, ps, staging, len_staging, chunk );
+		sig[flips[f]] ^= 0x04;
+		if (v != 0) {
+		    printf( "*** Corrupted signature accepted (byte %u)\n",
+			    (unsigned)flips[f] );
+		    goto done;
+		}
+	    }
+	}
+    }
+
+    /* And check the WOTS buffer mode works with it */
+#if TS_MULTI_LANE
+    {
+	unsigned char wots[ (2*TS_MAX_HASH+3) * TS_MAX_HASH ];
+	struct ts_verify_async av;
+	ts_init_verify_async( &av, message, len_message, ps, public_key,
+			      staging, len_sig );
+	if (!ts_set_wots_buffer( &av.ctx, wots, sizeof wots )) {
+	    printf( "*** Unable to set the WOTS buffer\n" );
+	    ts_verify_async( &av );
+	    goto done;
+	}
+	ts_update_verify_async( sig, len_sig, &av );
+	if (1 != ts_verify_async( &av )) {
+	    printf( "*** Valid signature rejected with a WOTS buffer\n" );
+	    goto done;
+	}
+    }
+#endif
+    ok = 1;
+
+done:
+    free( message );
+    free( sig );
+    free( staging );
+    return ok;
+}
+
+int test_verify_async(int fast_flag, enum noise_level level) {
+#if TS_FIXED_PARM_SET
+    /* Built for the one parameter set; that's what we check */
+    return check( TEST_PS_ANY, TEST_PS_ANY_NAME, fast_flag, level );
+#else
+    return check( &ts_ps_sha2_128f_simple, "sha2_128f_simple",
+		  fast_flag, level ) &&
+           check( &ts_ps_shake_128f_simple, "shake_128f_simple",
+		  fast_flag, level );
+#endif
+}
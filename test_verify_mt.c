@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tiny_sphincs.h"
+#include "verify_mt.h"
+#include "pathcache.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out the multithreaded one-shot verifier; it should accept
+ * and reject exactly the same signatures that the streaming verifier does
+ */
+
+static int seeded_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 0x5a ^ (7*i);
+    }
+    return 1;
+}
+
+static int streaming_verify( const unsigned char *message, size_t len_message,
+			     const unsigned char *sig, size_t len_sig,
+			     const unsigned char *public_key,
+			     const struct ts_parameter_set *ps ) {
+    struct ts_context ctx;
+    ts_init_verify( &ctx, message, len_message, ps, public_key );
+    ts_update_verify( sig, len_sig, &ctx );
+    return ts_verify( &ctx );
+}
+
+/* Check that both verifiers give the expected answer */
+static int agree( const unsigned char *message, size_t len_message,
+	          const unsigned char *sig, size_t len_sig,
+	          const unsigned char *public_key,
+	          const struct ts_parameter_set *ps, int expected,
+		  unsigned num_threads, const char *what ) {
+    if (expected != streaming_verify( message, len_message, sig, len_sig,
+				      public_key, ps )) {
+	printf( "*** Streaming verifier got %s wrong\n", what );
+	return 0;
+    }
+    if (expected != ts_verify_oneshot( message, len_message, sig, len_sig,
+				       public_key, ps, num_threads )) {
+	printf( "*** One-shot verifier (%u threads) got %s wrong\n",
+		num_threads, what );
+	return 0;
+    }
+    return 1;
+}
+
+static int check( const struct ts_parameter_set *ps, const char *name,
+	          int fast_flag, enum noise_level level ) {
+    if (level >= loud) {
+	printf( "    Checking %s\n", name );
+    }
+    unsigned char private_key[128], public_key[64];
+    if (!ts_gen_key( private_key, public_key, ps, seeded_rand )) {
+	printf( "*** Key generation failed\n" );
+	return 0;
+    }
+    static const unsigned char message[3] = { 'a', 'b', 'c' };
+    size_t len_sig = ts_size_signature( ps );
+    unsigned char *sig = malloc( len_sig + 1 );
+    if (!sig) {
+	printf( "*** MALLOC FAILURE\n" );
+	return 0;
+    }
+    struct ts_context ctx;
+    ts_init_sign( &ctx, message, sizeof message, ps, private_key, 0 );
+    ts_sign( sig, len_sig, &ctx );
+    sig[len_sig] = 0;
+
+    int ok = 0;
+    static const unsigned thread_counts[] = { 1, 2, 3, 8 };
+    for (unsigned i=0; i<sizeof thread_counts/sizeof *thread_counts; i++) {
+	unsigned threads = thread_counts[i];
+	if (!agree( message, sizeof message, sig, len_sig, public_key, ps,
+		    1, threads, "a valid signature" ) ||
+	    !agree( message, 2, sig, len_sig, public_key, ps,
+		    0, threads, "the wrong message" ) ||
+	    !agree( message, sizeof message, sig, len_sig-1, public_key, ps,
+		    0, threads, "a short signature" ) ||
+	    !agree( message, sizeof message, sig, len_sig+1, public_key, ps,
+		    0, threads, "a long signature" )) {
+	    goto done;
+	}
+    }
+
+    /* Flip bits throughout the signature (R, the FORS trees and every */
+    /* hypertree layer) */
+    size_t increment = len_sig / (fast_flag ? 60 : 600) + 1;
+    for (size_t offset = 0; offset < len_sig; offset += increment) {
+	unsigned char mask = 1 << (offset % 8);
+	sig[offset] ^= mask;
+	int same = agree( message, sizeof message, sig, len_sig, public_key,
+			  ps, 0, 1 + offset % 4, "a modified signature" );
+	sig[offset] ^= mask;
+	if (!same) goto done;
+    }
+    ok = 1;
+done:
+    free( sig );
+    return ok;
+}
+
+/*
+ * Now the path cache.  Signatures from the same key share their upper
+ * hypertree layers; the cache should notice, and yet still reject any
+ * signature that's been modified (including within the part the cache
+ * has seen before)
+ */
+#define NUM_MESSAGES 9    /* sha2_128f has 8 leaves in its top tree, so */
+                          /* at least two of these share the top layer */
+#define NUM_ENTRIES 200
+
+static int check_cache( enum noise_level level ) {
+    const struct ts_parameter_set *ps = TEST_PS_sha2_128f_simple;
+    if (!ps) return 1;  /* Not in this build; the above relies on it */
+    if (level >= loud) {
+	printf( "    Checking the path cache\n" );
+    }
+    unsigned char private_key[64], public_key[32];
+    if (!ts_gen_key( private_key, public_key, ps, seeded_rand )) {
+	printf( "*** Key generation failed\n" );
+	return 0;
+    }
+    size_t len_sig = ts_size_signature( ps );
+    size_t len_layer = (2*16 + 3 + 3) * 16;  /* WOTS sig + auth path */
+    unsigned char *sig = malloc( NUM_MESSAGES * len_sig );
+    if (!sig) {
+	printf( "*** MALLOC FAILURE\n" );
+	return 0;
+    }
+    unsigned char message[NUM_MESSAGES][1];
+    for (int i=0; i<NUM_MESSAGES; i++) {
+	struct ts_context ctx;
+	message[i][0] = i;
+	ts_init_sign( &ctx, message[i], 1, ps, private_key, 0 );
+	ts_sign( &sig[i*len_sig], len_sig, &ctx );
+    }
+
+    static unsigned char memory[ NUM_ENTRIES * 200 ];  /* Enough for the */
+                                  /* upper 21 layers of each signature */
+    struct ts_path_cache cache;
+    int ok = 0;
+    if (0 == ts_path_cache_init( &cache, memory, sizeof memory, 0, 0, 0 )) {
+	printf( "*** Path cache too small\n" );
+	goto done;
+    }
+
+    /* They all verify, and (since some share the top layer), some of */
+    /* them hit the cache */
+    for (int i=0; i<NUM_MESSAGES; i++) {
+	if (1 != ts_verify_oneshot_cached( message[i], 1, &sig[i*len_sig],
+				    len_sig, public_key, ps, 2, &cache )) {
+	    printf( "*** Valid signature failed with the path cache\n" );
+	    goto done;
+	}
+    }
+    if (cache.hits == 0) {
+	printf( "*** Path cache didn't notice the shared layers\n" );
+	goto done;
+    }
+
+    /* Modifying any layer (including the top one, which the cache has */
+    /* seen) gets the signature rejected, as does the wrong message */
+    unsigned char *s = &sig[2*len_sig];
+    for (size_t offset = len_sig - 1; offset > len_sig / 2;
+	                              offset -= len_layer / 3) {
+	s[offset] ^= 0x10;
+	int result = ts_verify_oneshot_cached( message[2], 1, s, len_sig,
+				    public_key, ps, 1, &cache );
+	s[offset] ^= 0x10;
+	if (result != 0) {
+	    printf( "*** Path cache accepted a modified signature\n" );
+	    goto done;
+	}
+    }
+    if (0 != ts_verify_oneshot_cached( message[3], 1, s, len_sig,
+				    public_key, ps, 1, &cache )) {
+	printf( "*** Path cache accepted the wrong message\n" );
+	goto done;
+    }
+
+    /* And the cache still has the right things */
+    unsigned long hits = cache.hits;
+    if (1 != ts_verify_oneshot_cached( message[2], 1, s, len_sig,
+				    public_key, ps, 1, &cache ) ||
+	    cache.hits != hits + 1) {
+	printf( "*** Path cache lost a verified path\n" );
+	goto done;
+    }
+    ok = 1;
+done:
+    free( sig );
+    return ok;
+}
+
+int test_verify_mt(int fast_flag, enum noise_level level) {
+#if TS_FIXED_PARM_SET
+    /* Built for the one parameter set; that's what we check */
+    return check( TEST_PS_ANY, TEST_PS_ANY_NAME, fast_flag, level ) &&
+           check_cache( level );
+#else
+    if (!check( &ts_ps_sha2_128f_simple, "sha2_128f_simple", fast_flag, level ) ||
+        !check( &ts_ps_shake_128f_simple, "shake_128f_simple", fast_flag, level ) ||
+        !check( &ts_ps_sha2_192f_simple, "sha2_192f_simple", fast_flag, level ) ||
+        !check( &ts_ps_shake_256f_simple, "shake_256f_simple", fast_flag, level ) ||
+        !check_cache( level )) {
+	return 0;
+    }
+    if (!fast_flag) {
+        if (!check( &ts_ps_sha2_128s_simple, "sha2_128s_simple", fast_flag, level ) ||
+            !check( &ts_ps_shake_256s_simple, "shake_256s_simple", fast_flag, level )) {
+	    return 0;
+	}
+    }
+    return 1;
+#endif
+}
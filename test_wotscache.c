@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tiny_sphincs.h"
+#include "wotscache.h"
+#include "test_sphincs.h"
+
+/*
+ * This tests out the WOTS checkpoint cache: signatures should come out
+ * the same whether or not there's a cache, whether it's cold or warm, and
+ * whatever the interval, and however small the cache is
+ */
+
+static int seeded_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 0x29 ^ (5*i);
+    }
+    return 1;
+}
+
+static int other_rand( unsigned char *p, size_t num_bytes ) {
+    for (unsigned i=0; i<num_bytes; i++) {
+        *p++ = 0x61 ^ (3*i);
+    }
+    return 1;
+}
+
+/* Sign the message (deterministically), with the cache if one is given */
+static int sign( unsigned char *sig, const unsigned char *message,
+		 const struct ts_parameter_set *ps,
+		 const unsigned char *private_key,
+		 struct ts_wots_cache *cache ) {
+    struct ts_context ctx;
+    size_t len_sig = ts_size_signature( ps );
+    ts_init_sign( &ctx, message, 3, ps, private_key, 0 );
+    if (cache && !ts_set_wots_cache( &ctx, cache )) return 0;
+    /* Ask for odd sized chunks, to make sure we handle those */
+    size_t offset = 0;
+    for (;;) {
+	unsigned m = ts_sign( sig + offset, 41, &ctx );
+	if (m == 0) break;
+	offset += m;
+    }
+    return offset == len_sig;
+}
+
+static int check( const struct ts_parameter_set *ps, const char *name,
+	          unsigned d, enum noise_level level ) {
+    if (level >= loud) {
+	printf( "    Checking %s\n", name );
+    }
+    unsigned char private_key[128], public_key[64];
+    unsigned char other_private_key[128], other_public_key[64];
+    if (!ts_gen_key( private_key, public_key, ps, seeded_rand ) ||
+	!ts_gen_key( other_private_key, other_public_key, ps, other_rand )) {
+	printf( "*** Key generation failed\n" );
+	return 0;
+    }
+    size_t len_sig = ts_size_signature( ps );
+    unsigned char *expected[2], *sig = malloc( len_sig );
+    expected[0] = malloc( len_sig );
+    expected[1] = malloc( len_sig );
+    size_t len_memory = 200 * ts_wots_cache_slot_size( ps, 1 );
+    unsigned char *memory = malloc( len_memory );
+    struct ts_wots_cache cache;
+    int ok = 0;
+    if (!expected[0] || !expected[1] || !sig || !memory) {
+	printf( "*** MALLOC FAILURE\n" );
+	goto done;
+    }
+    static const unsigned char message[2][3] = { "abc", "xyz" };
+    for (int m = 0; m < 2; m++) {
+	if (!sign( expected[m], message[m], ps, private_key, 0 )) {
+	    printf( "*** Signing failed\n" );
+	    goto done;
+	}
+    }
+
+    /* Each interval, caching every layer, and then just the top one; */
+    /* then with room for only one key (so each layer evicts the one */
+    /* below it, and nothing is ever a hit) */
+    static const unsigned intervals[] = { 1, 4, 5, 15 };
+    for (unsigned t = 0; t < 6; t++) {
+	unsigned interval = t < 4 ? intervals[t] : 4;
+	unsigned min_layer = t == 4 ? d-1 : 0;
+	size_t len = t == 5 ? ts_wots_cache_slot_size( ps, interval ) + 7 :
+	                      len_memory;
+	if (0 == ts_wots_cache_init( &cache, memory, len, ps, public_key,
+				     interval, min_layer, 0, 0, 0 )) {
+	    printf( "*** Cache init failed\n" );
+	    goto done;
+	}
+
+	/* First cold (for the first message; for the second, the top */
+	/* layer is warm), and then warm */
+	for (int m = 0; m < 2; m++) {
+	    for (int pass = 0; pass < 2; pass++) {
+		cache.hits = cache.misses = 0;
+		if (!sign( sig, message[m], ps, private_key, &cache ) ||
+		    0 != memcmp( sig, expected[m], len_sig )) {
+		    printf( "*** Signature with the cache differs "
+			    "(interval %u)\n", interval );
+		    goto done;
+		}
+		if (pass == 1 && t != 5 && cache.hits == 0) {
+		    printf( "*** The cache wasn't used on the second pass\n" );
+		    goto done;
+		}
+		if (t == 4 && cache.hits + cache.misses != 1) {
+		    printf( "*** Layers below min_layer were cached\n" );
+		    goto done;
+		}
+	    }
+	}
+    }
+
+    /* It won't be used for some other key, or once it's been cleared */
+    struct ts_context ctx;
+    ts_init_sign( &ctx, "abc", 3, ps, other_private_key, 0 );
+    if (ts_set_wots_cache( &ctx, &cache )) {
+	printf( "*** Cache accepted for the wrong key\n" );
+	goto done;
+    }
+    ts_wots_cache_clear( &cache );
+    ts_init_sign( &ctx, "abc", 3, ps, private_key, 0 );
+    if (ts_set_wots_cache( &ctx, &cache )) {
+	printf( "*** Cleared cache accepted\n" );
+	goto done;
+    }
+
+    ok = 1;
+done:
+    free( expected[0] );
+    free( expected[1] );
+    free( sig );
+    free( memory );
+    return ok;
+}
+
+int test_wotscache(int fast_flag, enum noise_level level) {
+#if !TS_WOTS_CACHE
+    return 1;     /* Built without it; nothing to test */
+#endif
+#if TS_FIXED_PARM_SET
+    /* Built for the one parameter set; that's what we check */
+    (void)fast_flag;
+    return check( TEST_PS_ANY, TEST_PS_ANY_NAME, TEST_PS_ANY_D, level );
+#else
+    /* The d is the parameter set's */
+    if (!check( &ts_ps_sha2_128f_simple, "sha2_128f_simple", 22, level ) ||
+        !check( &ts_ps_shake_192f_simple, "shake_192f_simple", 22, level )) {
+	return 0;
+    }
+    if (!fast_flag) {
+	if (!check( &ts_ps_sha2_256s_simple, "sha2_256s_simple", 8, level )) {
+	    return 0;
+	}
+    }
+    return 1;
+#endif
+}
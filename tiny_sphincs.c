@@ -8,8 +8,14 @@
 #include "internal.h"
 #include "endian.h"
 
+/*
+ * Take the next num_bits bits (rounded up to whole bytes) from the message
+ * hash.  num_bits may be 0 (the tree address, with a hypertree of just one
+ * layer)
+ */
 static uint64_t extract_int_from_hash( const unsigned char *hash, 
 		unsigned *hash_offset, unsigned num_bits ) {
+    if (num_bits == 0) return 0;
     uint64_t sum = 0;
     for (unsigned i=0; i<num_bits; i+=8) {
 	sum = 256*sum + hash[ ++*hash_offset ];
@@ -22,7 +28,7 @@ static uint64_t extract_int_from_hash( const unsigned char *hash,
  * These handle both the standard and SHA2 versions of that structure
  */
 static void set_layer_adr( unsigned layer, struct ts_context *ctx ) {
-    if (!TS_SUPPORT_SHAKE || ctx->ps->sha2) {
+    if (!TS_SUPPORT_SHAKE || PS_SHA2(ctx->ps)) {
 	ctx->adr[ LAYER_SHA2_OFFSET ] = layer;
     } else {
 	ts_ull_to_bytes( &ctx->adr[ LAYER_OFFSET ], layer, 4 );
@@ -31,7 +37,7 @@ static void set_layer_adr( unsigned layer, struct ts_context *ctx ) {
 
 static void set_tree_adr( unsigned long long tree,
 	                   struct ts_context *ctx ) {
-    if (!TS_SUPPORT_SHAKE || ctx->ps->sha2) {
+    if (!TS_SUPPORT_SHAKE || PS_SHA2(ctx->ps)) {
 	ts_ull_to_bytes( &ctx->adr[ TREE_SHA2_OFFSET ], tree, 8 );
     } else {
 	ts_ull_to_bytes( &ctx->adr[ TREE_OFFSET ], tree, 12 );
@@ -40,7 +46,7 @@ static void set_tree_adr( unsigned long long tree,
 
 static void set_type_adr( unsigned type,
 	                  struct ts_context *ctx ) {
-    if (!TS_SUPPORT_SHAKE || ctx->ps->sha2) {
+    if (!TS_SUPPORT_SHAKE || PS_SHA2(ctx->ps)) {
 	ctx->adr[ TYPE_SHA2_OFFSET ] = type;
     } else {
 	ts_ull_to_bytes( &ctx->adr[ TYPE_OFFSET ], type, 4 );
@@ -49,7 +55,7 @@ static void set_type_adr( unsigned type,
 
 static void set_keypair_adr( unsigned keypair,
 	                   struct ts_context *ctx ) {
-    if (!TS_SUPPORT_SHAKE || ctx->ps->sha2) {
+    if (!TS_SUPPORT_SHAKE || PS_SHA2(ctx->ps)) {
 	ts_ull_to_bytes( &ctx->adr[ KEYPAIR_SHA2_OFFSET ], keypair, 4 );
     } else {
 	ts_ull_to_bytes( &ctx->adr[ KEYPAIR_OFFSET ], keypair, 4 );
@@ -58,7 +64,7 @@ static void set_keypair_adr( unsigned keypair,
 
 static void set_tree_height_adr( unsigned tree_height,
 	                   struct ts_context *ctx ) {
-    if (!TS_SUPPORT_SHAKE || ctx->ps->sha2) {
+    if (!TS_SUPPORT_SHAKE || PS_SHA2(ctx->ps)) {
 	ts_ull_to_bytes( &ctx->adr[ TREEHEIGHT_SHA2_OFFSET ], tree_height, 4 );
     } else {
 	ts_ull_to_bytes( &ctx->adr[ TREEHEIGHT_OFFSET ], tree_height, 4 );
@@ -68,7 +74,7 @@ static void set_tree_height_adr( unsigned tree_height,
 
 static void set_tree_index_adr( unsigned tree_index,
 	                   struct ts_context *ctx ) {
-    if (!TS_SUPPORT_SHAKE || ctx->ps->sha2) {
+    if (!TS_SUPPORT_SHAKE || PS_SHA2(ctx->ps)) {
 	ts_ull_to_bytes( &ctx->adr[ TREEINDEX_SHA2_OFFSET ], tree_index, 4 );
     } else {
 	ts_ull_to_bytes( &ctx->adr[ TREEINDEX_OFFSET ], tree_index, 4 );
@@ -89,7 +95,7 @@ static void set_fors_prf_adr(struct ts_context *ctx,
     set_keypair_adr( ctx->fors_keypair_addr, ctx );
     set_tree_height_adr( 0, ctx ); /* FORS PRFs are done at the bottom */
                                         /* of the FORS trees */
-    set_tree_index_adr( (ctx->fors_tree << ctx->ps->t) + leaf_index, ctx );
+    set_tree_index_adr( (ctx->fors_tree << PS_T(ctx->ps)) + leaf_index, ctx );
 }
 
 void ts_set_fors_leaf_adr(struct ts_context *ctx,
@@ -100,7 +106,7 @@ void ts_set_fors_leaf_adr(struct ts_context *ctx,
     set_keypair_adr( ctx->fors_keypair_addr, ctx );
     set_tree_height_adr( 0, ctx ); /* FORS leaves are done at the bottom */
                                          /* of the FORS trees */
-    set_tree_index_adr( (ctx->fors_tree << ctx->ps->t) + leaf_index, ctx );
+    set_tree_index_adr( (ctx->fors_tree << PS_T(ctx->ps)) + leaf_index, ctx );
 }
 
 
@@ -132,7 +138,7 @@ void ts_set_merkle_adr(struct ts_context *ctx,
     set_type_adr( typecode, ctx );
     set_keypair_adr( ctx->fors_keypair_addr, ctx );
     set_tree_height_adr( level+1, ctx );
-    set_tree_index_adr( ((ctx->fors_tree << ctx->ps->t) + node) >> (level+1), ctx );
+    set_tree_index_adr( ((ctx->fors_tree << PS_T(ctx->ps)) + node) >> (level+1), ctx );
 }
 
 void ts_set_fors_root_adr(struct ts_context *ctx) {
@@ -160,7 +166,7 @@ void ts_set_wots_header_adr(unsigned merkle_leaf,
 static void fors_prf( unsigned char *output, int leaf_index,
 	              struct ts_context *ctx ) {
     set_fors_prf_adr(ctx, leaf_index );
-    (ctx->ps->prf)( output, ctx );
+    PS_PRF(ctx->ps)( output, ctx );
 }
 
 /*
@@ -169,7 +175,7 @@ static void fors_prf( unsigned char *output, int leaf_index,
 static void wots_prf( unsigned char *output, int tree_index,
 	              int digit_index, struct ts_context *ctx) {
     set_wots_prf_adr(ctx, tree_index, digit_index );
-    (ctx->ps->prf)( output, ctx );
+    PS_PRF(ctx->ps)( output, ctx );
 }
 		  
 /*
@@ -178,10 +184,171 @@ static void wots_prf( unsigned char *output, int tree_index,
 static void fors_leaf( unsigned char *output, int leaf_index,
 	               struct ts_context *ctx) {
     set_fors_prf_adr(ctx, leaf_index );
-    (ctx->ps->prf)( output, ctx );
+    PS_PRF(ctx->ps)( output, ctx );
     set_type_adr( ADR_TYPE_FORSTREE, ctx );  /* The adr structure */
                          /* is identical except for the type field */
-    (ctx->ps->f)( output, output, ctx );
+    PS_F(ctx->ps)( output, output, ctx );
+}
+
+#if TS_MULTI_LANE
+/*
+ * Compute count consecutive FORS leaves (starting at first_leaf), TS_LANES
+ * at a time, placing them into output
+ */
+static void fors_leaves_lanes( unsigned char *output, unsigned first_leaf,
+	                       unsigned count, struct ts_context *ctx ) {
+    unsigned n = PS_N(ctx->ps);
+    const unsigned char *sec_seed = CONVERT_PUBLIC_KEY_TO_SEC_SEED(
+	                                        ctx->public_key, n );
+    unsigned char adr[TS_LANES][ADR_SIZE];
+    unsigned char *out[TS_LANES];
+    const unsigned char *in[TS_LANES];
+
+    for (unsigned i = 0; i < count; i += TS_LANES) {
+	unsigned lanes = count - i;
+	if (lanes > TS_LANES) lanes = TS_LANES;
+
+	/* PRF to get the FORS private values */
+	for (unsigned j = 0; j < lanes; j++) {
+	    set_fors_prf_adr( ctx, first_leaf + i + j );
+	    memcpy( adr[j], ctx->adr, ADR_SIZE );
+	    out[j] = &output[(i+j)*n];
+	    in[j] = sec_seed;
+	}
+	ts_t_lanes( out, in, 1, &adr[0][0],
+		    lanes, ctx );
+
+	/* And F to get the leaves */
+	for (unsigned j = 0; j < lanes; j++) {
+	    ts_set_fors_leaf_adr( ctx, first_leaf + i + j );
+	    memcpy( adr[j], ctx->adr, ADR_SIZE );
+	    in[j] = out[j];
+	}
+	ts_t_lanes( out, in, 1, &adr[0][0],
+		    lanes, ctx );
+    }
+}
+
+/*
+ * Compute the root of the FORS subtree of height h whose leftmost leaf is
+ * node, placing it into ctx->buffer.  We generate the leaves in batches of
+ * TS_FORS_BATCH, and hash each batch down to a single node level by level
+ * (with the nodes on a level computed TS_LANES at a time).  The batch
+ * roots are then combined using the usual stack
+ */
+static void fors_subtree_lanes( struct ts_context *ctx, unsigned node,
+	                        unsigned h, unsigned char *stack ) {
+    unsigned n = PS_N(ctx->ps);
+    unsigned size_h = 1 << h;
+    unsigned batch = TS_FORS_BATCH, batch_h = 0;
+    if (batch > size_h) batch = size_h;
+    while ((1U << batch_h) < batch) batch_h++;
+    unsigned char leaves[TS_FORS_BATCH * TS_MAX_HASH];
+    unsigned char adr[TS_LANES][ADR_SIZE];
+    unsigned char *out[TS_LANES];
+    const unsigned char *in[2*TS_LANES];
+
+    for (unsigned first = 0; first < size_h; first += batch) {
+	fors_leaves_lanes( leaves, node + first, batch, ctx );
+
+	/* Hash the batch down to one node; on each level, node i of the */
+	/* next level up is the hash of nodes 2i and 2i+1 */
+	for (unsigned level = 0, count = batch/2; count > 0;
+				                 level++, count /= 2) {
+	    for (unsigned i = 0; i < count; i += TS_LANES) {
+		unsigned lanes = count - i;
+		if (lanes > TS_LANES) lanes = TS_LANES;
+		for (unsigned j = 0; j < lanes; j++) {
+		    ts_set_merkle_adr( ctx, node + first + ((2*(i+j)) << level),
+			               level, ADR_TYPE_FORSTREE );
+		    memcpy( adr[j], ctx->adr, ADR_SIZE );
+		    in[2*j]   = &leaves[2*(i+j)*n];
+		    in[2*j+1] = &leaves[(2*(i+j)+1)*n];
+		    out[j]    = &leaves[(i+j)*n];
+		}
+		ts_t_lanes( out, in, 2, &adr[0][0],
+			    lanes, ctx );
+	    }
+	}
+	memcpy( ctx->buffer, leaves, n );
+
+	/* And combine the batch root with nodes we have stored in the */
+	/* stack (just as ts_merkle_path does, starting at level batch_h) */
+	unsigned k = batch_h;
+	for (unsigned nod = first >> batch_h; nod & 1; nod >>= 1, k++) {
+	    union t_iterator *t = TS_SMALL_ITER(ctx);
+	    ts_set_merkle_adr(ctx, node+first, k, ADR_TYPE_FORSTREE);
+	    PS_INIT_T(ctx->ps)( t, ctx );
+	    PS_NEXT_T(ctx->ps)( t, &stack[k*n], ctx );
+	    PS_NEXT_T(ctx->ps)( t, ctx->buffer, ctx );
+	    PS_FINAL_T(ctx->ps)( ctx->buffer, t, ctx );
+	}
+	if (k < h) {
+	    memcpy( &stack[k*n], ctx->buffer, n );
+	}
+    }
+}
+#endif
+
+#if TS_NODE_CACHE
+/*
+ * Compare two buffers, without stopping at the first difference (this is
+ * used to check MACs).  Returns nonzero if they differ
+ */
+static int differ( const unsigned char *a, const unsigned char *b,
+		   unsigned n ) {
+    unsigned char diff = 0;
+    while (n--) {
+	diff |= *a++ ^ *b++;
+    }
+    return diff;
+}
+
+/*
+ * The MAC we hand to the node cache along with each Merkle root we
+ * compute, so that we can trust the root when it comes back.  This is
+ * PRF_msg (which is keyed with SK.prf) over a label, the layer, the tree
+ * address and the root.  For opt_rand we use all zeros, which isn't what
+ * we use when generating R (that's either random or PK.seed), so a MAC is
+ * never the R of some signature (or vice versa)
+ */
+static void node_mac( unsigned char *mac, unsigned layer, uint64_t tree,
+		      const unsigned char *root, struct ts_context *ctx ) {
+    static const char label[] = "tiny sphincs node cache";
+    unsigned n = PS_N(ctx->ps);
+    unsigned char opt_rand[TS_MAX_HASH];
+    unsigned char message[sizeof label + 9 + TS_MAX_HASH];
+    unsigned len = sizeof label;
+    memset( opt_rand, 0, n );
+    memcpy( message, label, len );
+    message[len++] = layer;
+    ts_ull_to_bytes( &message[len], tree, 8 ); len += 8;
+    memcpy( &message[len], root, n ); len += n;
+    PS_PRF_MSG(ctx->ps)( mac, opt_rand, message, len, ctx );
+}
+#endif
+
+/*
+ * If we have a node cache, hand it this node of the current Merkle tree
+ * (with a MAC, if it's the root).  FORS nodes aren't worth caching (we'll
+ * likely never need them again)
+ */
+static void export_node( struct ts_context *ctx, enum hash_reason typecode,
+	                 unsigned height, unsigned index,
+			 const unsigned char *node ) {
+#if TS_NODE_CACHE
+    const struct ts_node_cache *cache = ctx->node_cache;
+    if (!cache || !cache->store || typecode != ADR_TYPE_HASHTREE) return;
+    unsigned char mac[TS_MAX_HASH];
+    int is_root = (height == PS_MERKLE_H(ctx->ps));
+    if (is_root) {
+	node_mac( mac, ctx->hypertree_level, ctx->tree_address, node, ctx );
+    }
+    cache->store( node, is_root ? mac : 0, ctx->hypertree_level,
+		  ctx->tree_address, height, index, cache->arg );
+#else
+    (void)ctx; (void)typecode; (void)height; (void)index; (void)node;
+#endif
 }
 
 /*
@@ -199,7 +366,8 @@ static void fors_leaf( unsigned char *output, int leaf_index,
  * will be the value of the root.
  *
  * This is used for both FORS and Merkle trees (distinguished by the
- * typecode parameter)
+ * typecode parameter).  If TS_MULTI_LANE is set, FORS trees are done by
+ * fors_subtree_lanes instead (which doesn't use gen_leaf)
  */
 void ts_merkle_path( void (*gen_leaf)(
 			        unsigned char *output, int leaf_index,
@@ -207,7 +375,7 @@ void ts_merkle_path( void (*gen_leaf)(
 	                 struct ts_context *ctx,
 	                 enum hash_reason typecode,
 			 unsigned char *stack) {
-    unsigned n = ctx->ps->n;
+    unsigned n = PS_N(ctx->ps);
     unsigned h = ctx->merkle_level; /* Height of the subtree we're */
                             /* generating */
     ctx->merkle_level += 1; /* When we're done, we're on to the next */
@@ -216,20 +384,28 @@ void ts_merkle_path( void (*gen_leaf)(
     unsigned node = ctx->auth_path_node ^ size_h;
     node &= ~(size_h - 1);
 
+#if TS_MULTI_LANE
+    if (typecode == ADR_TYPE_FORSTREE) {
+	/* FORS leaves are cheap enough that we do them in batches */
+	fors_subtree_lanes( ctx, node, h, stack );
+    } else
+#endif
     /* Step through every leaf in the subtree we're evaluating */
     for (unsigned i = 0; i<size_h; i++) {
 	/* Generate that leaf */
 	gen_leaf( ctx->buffer, node+i, ctx );
+	export_node( ctx, typecode, 0, node+i, ctx->buffer );
 
 	/* And combine it with nodes we have stored in the stack */
 	unsigned k = 0;
         for (unsigned nod = i; nod & 1; nod >>= 1, k++) {
-	    union t_iterator *t = &ctx->small_iter;
+	    union t_iterator *t = TS_SMALL_ITER(ctx);
             ts_set_merkle_adr(ctx, node+i, k, typecode);
-	    ctx->ps->init_t( t, ctx );
-	    ctx->ps->next_t( t, &stack[k*n], ctx );
-	    ctx->ps->next_t( t, ctx->buffer, ctx );
-	    ctx->ps->final_t( ctx->buffer, t, ctx );
+	    PS_INIT_T(ctx->ps)( t, ctx );
+	    PS_NEXT_T(ctx->ps)( t, &stack[k*n], ctx );
+	    PS_NEXT_T(ctx->ps)( t, ctx->buffer, ctx );
+	    PS_FINAL_T(ctx->ps)( ctx->buffer, t, ctx );
+	    export_node( ctx, typecode, k+1, (node+i) >> (k+1), ctx->buffer );
 	}
 
 	/* If we're not at the top of the tree, place the intermedate */
@@ -246,17 +422,19 @@ void ts_merkle_path( void (*gen_leaf)(
     /* And update the auth_path buffer */
     {
         ts_set_merkle_adr(ctx, node, h, typecode);
-	union t_iterator *t = &ctx->small_iter;
-	ctx->ps->init_t( t, ctx );
+	union t_iterator *t = TS_SMALL_ITER(ctx);
+	PS_INIT_T(ctx->ps)( t, ctx );
 	if ((ctx->auth_path_node & size_h) != 0) {
- 	    ctx->ps->next_t( t, ctx->buffer, ctx );
-	    ctx->ps->next_t( t, ctx->auth_path_buffer, ctx );
+ 	    PS_NEXT_T(ctx->ps)( t, ctx->buffer, ctx );
+	    PS_NEXT_T(ctx->ps)( t, ctx->auth_path_buffer, ctx );
 	} else { 
-	    ctx->ps->next_t( t, ctx->auth_path_buffer, ctx );
-	    ctx->ps->next_t( t, ctx->buffer, ctx );
+	    PS_NEXT_T(ctx->ps)( t, ctx->auth_path_buffer, ctx );
+	    PS_NEXT_T(ctx->ps)( t, ctx->buffer, ctx );
 	}
-	ctx->ps->final_t( ctx->auth_path_buffer, t, ctx );
+	PS_FINAL_T(ctx->ps)( ctx->auth_path_buffer, t, ctx );
     }
+    export_node( ctx, typecode, h+1, ctx->auth_path_node >> (h+1),
+		 ctx->auth_path_buffer );
 }
 
 /*
@@ -270,9 +448,9 @@ void ts_convert_message_hash_to_hypertree_position(
     unsigned hash_offset = 0;
     unsigned bit_so_far = 0;
 
-    for (int k=0; k<ps->k; k++) {
+    for (int k=0; k<PS_K(ps); k++) {
         unsigned this_index = 0;
-	for (int t=0; t<ps->t; t++) {
+	for (int t=0; t<PS_T(ps); t++) {
 	    if (bit_so_far == 8) {
 		hash_offset++;
 		bit_so_far = 0;
@@ -294,14 +472,14 @@ void ts_convert_message_hash_to_hypertree_position(
 	    this_index = 2*this_index + (bit&1);
 #endif
 	}
-	ctx->x.fors.fors_node[k] = this_index;
+	TS_X(ctx)->fors.fors_node[k] = this_index;
     }
 
     /* Now extract the bottom level Merkle tree */
     ctx->tree_address = extract_int_from_hash( message_hash,
-		              &hash_offset, ps->h - ps->merkle_h );
+		              &hash_offset, PS_H(ps) - PS_MERKLE_H(ps) );
     ctx->fors_keypair_addr = extract_int_from_hash( message_hash,
-		              &hash_offset, ps->merkle_h );
+		              &hash_offset, PS_MERKLE_H(ps) );
 }
 
 /*
@@ -315,13 +493,21 @@ void ts_init_sign( struct ts_context *ctx,
                    const struct ts_parameter_set *ps,
                    const unsigned char *private_key,
 	           int (*random_function)(unsigned char *, size_t) ) {
-    unsigned n = ps->n;
+    unsigned n = PS_N(ps);
+
+    ts_init_backends();
 
     ctx->ps = ps;
     ctx->public_key = CONVERT_PRIVATE_KEY_TO_PUBLIC( private_key, n );
+#if TS_NODE_CACHE
+    ctx->node_cache = 0;
+#endif
+#if TS_WOTS_CACHE
+    ctx->wots_cache = 0;
+#endif
 
 #if TS_SHA2_OPTIMIZATION
-    if (ps->compute_prehash) ps->compute_prehash( ctx );
+    PS_COMPUTE_PREHASH( ps, ctx );
 #endif
 
     /* Step 1: generate the randomness */
@@ -336,12 +522,12 @@ void ts_init_sign( struct ts_context *ctx,
 		    n);
         }
 
-        ps->prf_msg( randomness, opt_buffer, message, len_message, ctx );
+        PS_PRF_MSG(ps)( randomness, opt_buffer, message, len_message, ctx );
     }
 
     /* Step 2: hash the message */
     unsigned char message_hash[MAX_MESSAGE_HASH];
-    ps->hash_msg( message_hash, sizeof message_hash, randomness,
+    PS_HASH_MSG(ps)( message_hash, sizeof message_hash, randomness,
 		     message, len_message, ctx );
 
     /* Step 3: convert the hash into fors_tree leaves and position */
@@ -360,26 +546,55 @@ void ts_init_sign( struct ts_context *ctx,
 
     /* And initialize the iterator that'll hash the FORS roots together */
     ts_set_fors_root_adr(ctx);
-    ps->init_t( &ctx->big_iter, ctx );
+    PS_INIT_T(ps)( &ctx->big_iter, ctx );
+}
+
+/*
+ * This is ts_init_sign, using a caller provided buffer (which may be
+ * smaller than a full ts_context) as the context
+ */
+struct ts_context *ts_init_sign_buffer( void *buffer, size_t len_buffer,
+                   const void *message, size_t len_message,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *private_key,
+	           int (*random_function)(unsigned char *, size_t) ) {
+    struct ts_context *ctx = ts_context_from_buffer( buffer, len_buffer, ps );
+    if (ctx) {
+	ts_init_sign( ctx, message, len_message, ps, private_key,
+		      random_function );
+    }
+    return ctx;
 }
 
 /*
- * Given a hash, convert it into the series of WOTS digits
+ * Given a hash, convert it into the series of WOTS digits: the hash, log_w
+ * bits at a time (most significant bits first), followed by the checksum
+ * (the sum of w-1-digit over those), in as many base w digits as it takes
+ * (most significant first).  For w = 16, that's two digits per byte, and
+ * a three digit checksum
  */
 static void compute_wots_digits( unsigned char *digits,
-	                         const unsigned char *hash, int n ) {
-    unsigned sum = 2*15*n;
-    for (int i=0; i<n; i++) {
-	unsigned char byte = *hash++;
-	unsigned d;
-	*digits++ = d = byte >> 4;
-	sum -= d;
-	*digits++ = d = byte & 0xf;
+	                         const unsigned char *hash,
+				 const struct ts_parameter_set *ps ) {
+    unsigned log_w = PS_LOG_W(ps);
+    unsigned max = PS_WOTS_MAX(ps);
+    unsigned len_1 = 8 * PS_N(ps) / log_w;
+    unsigned len_2 = PS_WOTS_LEN(ps) - len_1;
+    unsigned sum = len_1 * max;
+    unsigned byte = 0, bits = 0;
+    for (unsigned i=0; i<len_1; i++) {
+	if (bits == 0) {
+	    byte = *hash++;
+	    bits = 8;
+	}
+	bits -= log_w;
+	unsigned d = (byte >> bits) & max;
+	*digits++ = d;
 	sum -= d;
     }
-    *digits++ = (sum >> 8) & 0xf;
-    *digits++ = (sum >> 4) & 0xf;
-    *digits   = (sum     ) & 0xf;
+    while (len_2--) {
+	*digits++ = (sum >> (len_2 * log_w)) & max;
+    }
 }
 
 /*
@@ -390,11 +605,11 @@ static void compute_wots_digits( unsigned char *digits,
  */
 void ts_set_up_wots_signature(struct ts_context *ctx, unsigned next_leaf) {
     ctx->state = ts_wots;
-    ctx->x.wots.digit = 0;
+    TS_X(ctx)->wots.digit = 0;
         /* Compute the value of the leaf node.  We need to do that */
         /* for the incremental computation that'll result in the root */
-    compute_wots_digits( ctx->x.wots.digits, ctx->auth_path_buffer,
-		         ctx->ps->n );
+    compute_wots_digits( TS_X(ctx)->wots.digits, ctx->auth_path_buffer,
+		         ctx->ps );
     ctx->auth_path_node = next_leaf;
     ctx->fors_keypair_addr = 0;
 }
@@ -403,34 +618,298 @@ void ts_set_up_wots_signature(struct ts_context *ctx, unsigned next_leaf) {
  * Generate the next hash in the current WOTS+ signature
  */
 static void generate_next_wots_hash(struct ts_context *ctx) {
-    int digit = ctx->x.wots.digit++;
+    int digit = TS_X(ctx)->wots.digit++;
+    int start = -1;
 
-    wots_prf( ctx->buffer, ctx->auth_path_node, digit, ctx );
-    for (int i=0; i<ctx->x.wots.digits[digit]; i++) {
+#if TS_WOTS_CACHE
+    /* If we have a checkpoint on this chain, start from there */
+    if (ctx->wots_cache) {
+	if (digit == 0) ts_wots_cache_prepare( ctx->wots_cache, ctx );
+	start = ts_wots_cache_chain( ctx->wots_cache, ctx->buffer, digit,
+			        TS_X(ctx)->wots.digits[digit], ctx );
+    }
+#endif
+    if (start < 0) {
+	wots_prf( ctx->buffer, ctx->auth_path_node, digit, ctx );
+	start = 0;
+    }
+    for (int i=start; i<TS_X(ctx)->wots.digits[digit]; i++) {
         ts_set_wots_f_adr(ctx, ctx->auth_path_node, digit, i);
-        (ctx->ps->f)( ctx->buffer, ctx->buffer, ctx );
+        PS_F(ctx->ps)( ctx->buffer, ctx->buffer, ctx );
     }
     ctx->buffer_offset = 0;
 }
 
+#if TS_MULTI_LANE
+/*
+ * Set the hash address field of an ADR structure that's not the one in
+ * the context (that is, one of the per-lane ones)
+ */
+static void set_lane_hash_adr( unsigned char *adr, unsigned hash_address,
+	                       struct ts_context *ctx ) {
+    if (!TS_SUPPORT_SHAKE || PS_SHA2(ctx->ps)) {
+	ts_ull_to_bytes( &adr[ TREEINDEX_SHA2_OFFSET ], hash_address, 4 );
+    } else {
+	ts_ull_to_bytes( &adr[ TREEINDEX_OFFSET ], hash_address, 4 );
+    }
+}
+
 /*
  * Compute a leaf of a Merkle tree (which is a WOTS public key)
+ * We advance TS_LANES chains at a time in lockstep, and then absorb their
+ * tops (in order) into the T function
+ * If checkpoints is nonNULL, we also place every interval'th value along
+ * each chain there (see ts_wots_leaf_checkpoints in internal.h)
  */
-void ts_wots_leaf( unsigned char *output, int leaf_index,
+void ts_wots_leaf_checkpoints( unsigned char *output, int leaf_index,
+		       unsigned char *checkpoints, unsigned interval,
 	               struct ts_context *ctx ) {
+    unsigned n = PS_N(ctx->ps);
+    unsigned max = PS_WOTS_MAX(ctx->ps);
+    unsigned per_chain = checkpoints ? max/interval + 1 : 0;
+    unsigned num_digits = PS_WOTS_LEN(ctx->ps);
+    const unsigned char *sec_seed = CONVERT_PUBLIC_KEY_TO_SEC_SEED(
+	                                        ctx->public_key, n );
+    unsigned char chain[TS_LANES][TS_MAX_HASH];
+    unsigned char adr[TS_LANES][ADR_SIZE];
+    unsigned char *out[TS_LANES];
+    const unsigned char *in[TS_LANES];
+
     ts_set_wots_header_adr( leaf_index, ctx );
-    ctx->ps->init_t( &ctx->big_iter, ctx );
+    PS_INIT_T(ctx->ps)( &ctx->big_iter, ctx );
+
+    for (unsigned d = 0; d < num_digits; d += TS_LANES) {
+	unsigned lanes = num_digits - d;
+	if (lanes > TS_LANES) lanes = TS_LANES;
+
+	/* Compute the chain starts */
+	for (unsigned j = 0; j < lanes; j++) {
+	    set_wots_prf_adr( ctx, leaf_index, d+j );
+	    memcpy( adr[j], ctx->adr, ADR_SIZE );
+	    in[j] = sec_seed;
+	    out[j] = chain[j];
+	}
+	ts_t_lanes( out, in, 1, &adr[0][0], lanes, ctx );
+
+	/* Walk the chains up to the top; only the hash address changes */
+	/* from step to step */
+	for (unsigned j = 0; j < lanes; j++) {
+	    ts_set_wots_f_adr( ctx, leaf_index, d+j, 0 );
+	    memcpy( adr[j], ctx->adr, ADR_SIZE );
+	    in[j] = chain[j];
+	}
+	for (unsigned i = 0; i <= max; i++) {
+	    if (per_chain && i % interval == 0) {
+		for (unsigned j = 0; j < lanes; j++) {
+		    memcpy( &checkpoints[((d+j)*per_chain + i/interval) * n],
+			    chain[j], n );
+		}
+	    }
+	    if (i == max) break;
+	    for (unsigned j = 0; j < lanes; j++) {
+		set_lane_hash_adr( adr[j], i, ctx );
+	    }
+	    ts_t_lanes( out, in, 1, &adr[0][0], lanes, ctx );
+	}
 
-    for (int d = 0; d < 2*ctx->ps->n + 3; d++) {
-	unsigned char *buffer = ctx->x.merkle.buffer;
+	/* And add the tops to the WOTS public key hash */
+	for (unsigned j = 0; j < lanes; j++) {
+	    PS_NEXT_T(ctx->ps)( &ctx->big_iter, chain[j], ctx );
+	}
+    }
+    PS_FINAL_T(ctx->ps)( output, &ctx->big_iter, ctx );
+}
+#else
+/*
+ * Compute a leaf of a Merkle tree (which is a WOTS public key)
+ * If checkpoints is nonNULL, we also place every interval'th value along
+ * each chain there (see ts_wots_leaf_checkpoints in internal.h)
+ */
+void ts_wots_leaf_checkpoints( unsigned char *output, int leaf_index,
+		       unsigned char *checkpoints, unsigned interval,
+	               struct ts_context *ctx ) {
+    unsigned n = PS_N(ctx->ps);
+    unsigned max = PS_WOTS_MAX(ctx->ps);
+    unsigned per_chain = checkpoints ? max/interval + 1 : 0;
+    /* If we're filling in checkpoints, we're in the middle of a WOTS */
+    /* signature (whose digits are in TS_X), so work in buffer instead */
+    unsigned char *buffer = checkpoints ? ctx->buffer :
+	                                  TS_X(ctx)->merkle.buffer;
+    ts_set_wots_header_adr( leaf_index, ctx );
+    PS_INIT_T(ctx->ps)( &ctx->big_iter, ctx );
+
+    for (int d = 0; d < PS_WOTS_LEN(ctx->ps); d++) {
         wots_prf( buffer, leaf_index, d, ctx );
-        for (int i=0; i<15; i++) {
+        for (unsigned i=0; ; i++) {
+	    if (per_chain && i % interval == 0) {
+		memcpy( &checkpoints[(d*per_chain + i/interval) * n],
+			buffer, n );
+	    }
+	    if (i == max) break;
             ts_set_wots_f_adr(ctx, leaf_index, d, i);
-            (ctx->ps->f)( buffer, buffer, ctx );
+            PS_F(ctx->ps)( buffer, buffer, ctx );
         }
-        ctx->ps->next_t(&ctx->big_iter, buffer, ctx );
+        PS_NEXT_T(ctx->ps)(&ctx->big_iter, buffer, ctx );
+    }
+    PS_FINAL_T(ctx->ps)(output, &ctx->big_iter, ctx );
+}
+#endif
+
+void ts_wots_leaf( unsigned char *output, int leaf_index,
+	               struct ts_context *ctx ) {
+    ts_wots_leaf_checkpoints( output, leaf_index, 0, 0, ctx );
+}
+
+/*
+ * The signer has just finished the WOTS signature of auth_path_node; place
+ * that leaf into auth_path_buffer, taking it from the WOTS checkpoint
+ * cache if that has it
+ */
+static void signer_wots_leaf( struct ts_context *ctx ) {
+#if TS_WOTS_CACHE
+    if (ctx->wots_cache &&
+	    ts_wots_cache_leaf( ctx->wots_cache, ctx->auth_path_buffer, ctx )) {
+	return;
+    }
+#endif
+    ts_wots_leaf( ctx->auth_path_buffer, ctx->auth_path_node, ctx );
+}
+
+/*
+ * We've generated the authentication path of the current Merkle tree (and
+ * the root is in auth_path_buffer); step up to the WOTS signature of that
+ * root in the parent tree (or finish, if this was the top)
+ */
+static void next_merkle_tree( struct ts_context *ctx ) {
+    ctx->hypertree_level++;
+    if (ctx->hypertree_level == PS_D(ctx->ps)) {
+        /* We're at the top of the hypertree - all done */
+        ctx->state = ts_done;
+	return;
     }
-    ctx->ps->final_t(output, &ctx->big_iter, ctx );
+    /* Step upwards to the parent Merkle tree */
+    ctx->auth_path_node = ctx->tree_address &
+	                      ((1 << PS_MERKLE_H(ctx->ps))-1);
+    ctx->tree_address >>= PS_MERKLE_H(ctx->ps);
+    ts_set_up_wots_signature(ctx, ctx->auth_path_node);
+}
+
+#if TS_NODE_CACHE
+/*
+ * Ask the node cache for the authentication path of leaf auth_path_node
+ * in the current Merkle tree, and check it.  If it passes, the path goes
+ * into TS_X(ctx)->cached.path, the root into auth_path_buffer, and this
+ * returns 1
+ */
+static int fetch_merkle_path( struct ts_context *ctx ) {
+    const struct ts_node_cache *cache = ctx->node_cache;
+    unsigned n = PS_N(ctx->ps);
+    unsigned h = PS_MERKLE_H(ctx->ps);
+    unsigned layer = ctx->hypertree_level;
+    uint64_t tree = ctx->tree_address;
+    unsigned leaf = ctx->auth_path_node;
+    unsigned char *path = TS_X(ctx)->cached.path;
+    unsigned char root[TS_MAX_HASH], mac[TS_MAX_HASH];
+
+    /* Get the leaf, its authentication path, and the root */
+    if (!cache->fetch( ctx->auth_path_buffer, 0, layer, tree, 0, leaf,
+		       cache->arg )) {
+	return 0;
+    }
+    for (unsigned i = 0; i < h; i++) {
+	if (!cache->fetch( &path[i*n], 0, layer, tree, i, (leaf >> i) ^ 1,
+			   cache->arg )) {
+	    return 0;
+	}
+    }
+    if (!cache->fetch( root, mac, layer, tree, h, 0, cache->arg )) {
+	return 0;
+    }
+
+    /* We trust the root if it's the one in the public key, or if it */
+    /* carries our MAC */
+    if (layer + 1 == (unsigned)PS_D(ctx->ps)) {
+	if (differ( root, CONVERT_PUBLIC_KEY_TO_ROOT( ctx->public_key, n ),
+		    n )) {
+	    return 0;
+	}
+    } else {
+	unsigned char expected[TS_MAX_HASH];
+	node_mac( expected, layer, tree, root, ctx );
+	if (differ( mac, expected, n )) return 0;
+    }
+
+    /* And we trust the path if it takes the leaf to that root.  We took */
+    /* the leaf from the cache as well; however, if the host gave us a */
+    /* different leaf, and a path from it that still gets to the real */
+    /* root, it has found a hash collision */
+    ts_climb_auth_path( path, h, ADR_TYPE_HASHTREE, ctx );
+    if (differ( ctx->auth_path_buffer, root, n )) return 0;
+    ctx->merkle_level = 0;
+    return 1;
+}
+#endif
+
+/*
+ * Have the signer use (and fill) a node cache
+ */
+int ts_set_node_cache( struct ts_context *ctx,
+		   const struct ts_node_cache *cache ) {
+#if TS_NODE_CACHE
+    if (ctx->state <= ts_sign_state || ctx->state >= ts_verify_state) {
+	return 0;
+    }
+    ctx->node_cache = cache;
+    return 1;
+#else
+    (void)ctx; (void)cache;
+    return 0;
+#endif
+}
+
+/*
+ * Compute an entire Merkle tree of the hypertree, handing each node to the
+ * cache, just as the signer does with the ones it computes
+ */
+int ts_precompute_tree( const unsigned char *private_key,
+		const struct ts_parameter_set *ps,
+		unsigned layer, uint64_t tree,
+		const struct ts_node_cache *cache ) {
+#if TS_NODE_CACHE
+    unsigned n = PS_N(ps);
+    if (!private_key || !ps || !cache || !cache->store ||
+	                layer >= (unsigned)PS_D(ps)) {
+	return 0;
+    }
+    ts_init_backends();
+
+    struct ts_context ctx;
+    memset( &ctx, 0, sizeof ctx );
+    ctx.ps = ps;
+    ctx.public_key = CONVERT_PRIVATE_KEY_TO_PUBLIC( private_key, n );
+#if TS_SHA2_OPTIMIZATION
+    PS_COMPUTE_PREHASH( ps, &ctx );
+#endif
+    ctx.node_cache = cache;
+    ctx.hypertree_level = layer;
+    ctx.tree_address = tree;
+
+    /* The authentication path of leaf 0 covers every other node (and */
+    /* leaves the root in auth_path_buffer, which ts_merkle_path hands */
+    /* over with its MAC) */
+    ctx.auth_path_node = 0;
+    ctx.merkle_level = 0;
+    ts_wots_leaf( ctx.auth_path_buffer, 0, &ctx );
+    export_node( &ctx, ADR_TYPE_HASHTREE, 0, 0, ctx.auth_path_buffer );
+    for (int i = 0; i < PS_MERKLE_H(ps); i++) {
+	ts_merkle_path( ts_wots_leaf, &ctx, ADR_TYPE_HASHTREE,
+		        TS_X(&ctx)->merkle.stack );
+    }
+    return 1;
+#else
+    (void)private_key; (void)ps; (void)layer; (void)tree; (void)cache;
+    return 0;
+#endif
 }
 
 /*
@@ -441,7 +920,7 @@ void ts_wots_leaf( unsigned char *output, int leaf_index,
 unsigned ts_sign( unsigned char *dest, unsigned m,
                   struct ts_context *ctx ) {
     unsigned orig_m = m;
-    unsigned n = ctx->ps->n;
+    unsigned n = PS_N(ctx->ps);
 
     if (ctx->state <= ts_sign_state || ctx->state >= ts_verify_state) {
 	/* We've been handed an invalid context (or one that's been set */
@@ -466,7 +945,7 @@ unsigned ts_sign( unsigned char *dest, unsigned m,
 	/* are in the signature */
 	switch (ctx->state) {
         case ts_fors_leaf: {   /* The next value is a FORS leaf */
-	    unsigned node = ctx->x.fors.fors_node[ctx->fors_tree];
+	    unsigned node = TS_X(ctx)->fors.fors_node[ctx->fors_tree];
 	    ctx->auth_path_node = node;
             fors_prf( ctx->buffer, node, ctx );
 	    ctx->buffer_offset = 0;
@@ -480,18 +959,18 @@ unsigned ts_sign( unsigned char *dest, unsigned m,
 	case ts_fors: {
             /* Generate the next node in the FORS Merkle path */
 	    ts_merkle_path( fors_leaf, ctx, ADR_TYPE_FORSTREE,
-			 ctx->x.fors.stack );
-	    if (ctx->merkle_level == ctx->ps->t) {
+			 TS_X(ctx)->fors.stack );
+	    if (ctx->merkle_level == PS_T(ctx->ps)) {
 		 /* We hit the top of the FORS tree */
 		
                  /* Add the FORS tree root to the running hash */
-                 ctx->ps->next_t( &ctx->big_iter, ctx->auth_path_buffer,
+                 PS_NEXT_T(ctx->ps)( &ctx->big_iter, ctx->auth_path_buffer,
 			          ctx );
 		 ctx->state = ts_fors_leaf;
                  ctx->fors_tree++;
-		 if (ctx->fors_tree == ctx->ps->k) {
+		 if (ctx->fors_tree == PS_K(ctx->ps)) {
 	             /* We got all the FORS root; get the final hash */
-                     ctx->ps->final_t( ctx->auth_path_buffer,
+                     PS_FINAL_T(ctx->ps)( ctx->auth_path_buffer,
 				       &ctx->big_iter, ctx );
 		     ctx->fors_tree = 0;
 		     ts_set_up_wots_signature(ctx, ctx->fors_keypair_addr);
@@ -501,34 +980,53 @@ unsigned ts_sign( unsigned char *dest, unsigned m,
         }
 	case ts_wots: {  /* The next value is from a WOTS+ signature */
             generate_next_wots_hash(ctx);
-	    int d = ctx->x.wots.digit;
-	    if (d == 2*ctx->ps->n + 3) {
+	    int d = TS_X(ctx)->wots.digit;
+	    if (d == PS_WOTS_LEN(ctx->ps)) {
 		/* We've generated all the WOTS digits */
-                ctx->state = ts_merkle;
                 ctx->merkle_level = 0;
-	        ts_wots_leaf( ctx->auth_path_buffer, ctx->auth_path_node,
-			   ctx );
+#if TS_NODE_CACHE
+		if (ctx->node_cache) {
+		    /* We'll ask the cache for the path once the caller has */
+		    /* taken this hash (we need buffer to check the path) */
+		    ctx->state = ts_merkle_lookup;
+		    continue;
+		}
+#endif
+                ctx->state = ts_merkle;
+		signer_wots_leaf( ctx );
 	    }
 	    continue;
 	}
+#if TS_NODE_CACHE
+	case ts_merkle_lookup:  /* See if the node cache has this path */
+	    if (ctx->node_cache && fetch_merkle_path( ctx )) {
+		ctx->state = ts_merkle_cached;
+		continue;
+	    }
+	    /* It doesn't; compute it the usual way */
+	    ctx->state = ts_merkle;
+	    ctx->merkle_level = 0;
+	    signer_wots_leaf( ctx );
+	    export_node( ctx, ADR_TYPE_HASHTREE, 0, ctx->auth_path_node,
+			 ctx->auth_path_buffer );
+	    continue;
+	case ts_merkle_cached:  /* The next value is from the cached path */
+	    memcpy( ctx->buffer,
+		    &TS_X(ctx)->cached.path[ ctx->merkle_level * n ], n );
+	    ctx->buffer_offset = 0;
+	    ctx->merkle_level++;
+	    if (ctx->merkle_level == PS_MERKLE_H(ctx->ps)) {
+		next_merkle_tree( ctx );
+	    }
+	    continue;
+#endif
 	case ts_merkle: {  /* The next value is from a Merkle signature */
             /* Generate the next node in the Merkle path */
 	    ts_merkle_path( ts_wots_leaf, ctx, ADR_TYPE_HASHTREE,
-			 ctx->x.merkle.stack );
-	    if (ctx->merkle_level == ctx->ps->merkle_h) {
+			 TS_X(ctx)->merkle.stack );
+	    if (ctx->merkle_level == PS_MERKLE_H(ctx->ps)) {
 		 /* We hit the top of the Merkle tree */
-		 ctx->hypertree_level++;
-		 if (ctx->hypertree_level == ctx->ps->d) {
-                     /* We're at the top of the hypertree - all done */
-                     ctx->state = ts_done;
-		     continue;
-		 }
-		 /* Step upwards to the parent Merkle tree */
-
-		 ctx->auth_path_node = ctx->tree_address &
-			                      ((1 << ctx->ps->merkle_h)-1);
-		 ctx->tree_address >>= ctx->ps->merkle_h;
-		 ts_set_up_wots_signature(ctx, ctx->auth_path_node);
+		 next_merkle_tree( ctx );
 	    }
 	    continue;
 	}
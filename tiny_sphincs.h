@@ -22,7 +22,31 @@
 #define TS_MAX_HASH 16  /* L1 hash size */
 #endif
 
+/*
+ * Identifiers for the parameter sets.  These are used to build the package
+ * for a single parameter set (see TS_FIXED_PARM_SET in tune.h)
+ */
+#define TS_PS_SHAKE_128F_SIMPLE  1
+#define TS_PS_SHAKE_128S_SIMPLE  2
+#define TS_PS_SHAKE_192F_SIMPLE  3
+#define TS_PS_SHAKE_192S_SIMPLE  4
+#define TS_PS_SHAKE_256F_SIMPLE  5
+#define TS_PS_SHAKE_256S_SIMPLE  6
+#define TS_PS_SHA2_128F_SIMPLE   7
+#define TS_PS_SHA2_128S_SIMPLE   8
+#define TS_PS_SHA2_192F_SIMPLE   9
+#define TS_PS_SHA2_192S_SIMPLE  10
+#define TS_PS_SHA2_256F_SIMPLE  11
+#define TS_PS_SHA2_256S_SIMPLE  12
+
+/* Whether we support parameter sets built at runtime (see tune.h) */
+#if TS_CUSTOM_PARM_SET && !TS_FIXED_PARM_SET
+#define TS_CUSTOM_PS 1
+#define TS_MAX_WOTS_DIGITS (4*TS_MAX_HASH + 5)  /* w = 4 */
+#else
+#define TS_CUSTOM_PS 0
 #define TS_MAX_WOTS_DIGITS (2*TS_MAX_HASH + 3)
+#endif
 #define TS_MAX_FORS 35  /* The maximum number of FORS trees we have */
 
 /* We could make these depend on the supported parameter set */
@@ -59,6 +83,7 @@
 #endif
 
 struct ts_parameter_set; /* The user needn't know the ugly details */
+struct ts_wots_cache;    /* See wotscache.h */
 
 /*
  * This allows the incremental evaluation of a T function
@@ -96,6 +121,8 @@ struct ts_context {
         ts_fors,    /* Working on the FORS trees */
 	ts_wots,    /* Working on a WOTS signature */
 	ts_merkle,  /* Working on a merkle authentication path */
+	ts_merkle_lookup, /* About to ask the node cache for a path */
+	ts_merkle_cached, /* Outputing a path from the node cache */
 	ts_done,    /* We finished */
 
 	ts_verify_state, /* These are the states for the verification pro */
@@ -133,10 +160,22 @@ struct ts_context {
 
     unsigned char auth_path_buffer[TS_MAX_HASH]; /* Intermediate value */
                                      /* for processing Merkle nodes */
-
-    union t_iterator big_iter;       /* Used to combine FORS roots and */
-                                     /* WOTS heads */
-    union t_iterator small_iter;     /* Used for everything else */
+#if TS_MULTI_LANE
+    unsigned char *wots_buffer;      /* If nonNULL, where the verifier */
+                                     /* collects each WOTS signature */
+                                     /* (see ts_set_wots_buffer) */
+#endif
+#if TS_NODE_CACHE
+    const struct ts_node_cache *node_cache; /* If nonNULL, where the */
+                                     /* signer sends the hypertree nodes */
+                                     /* it computes, and gets them back */
+                                     /* (see ts_set_node_cache) */
+#endif
+#if TS_WOTS_CACHE
+    struct ts_wots_cache *wots_cache; /* If nonNULL, the checkpoints of */
+                                     /* the WOTS chains of the upper */
+                                     /* layers (see ts_set_wots_cache) */
+#endif
 
 #if TS_SUPPORT_SHA2 && TS_SHA2_OPTIMIZATION
     /* These store the SHA2 state after hashing the public seed */
@@ -147,8 +186,20 @@ struct ts_context {
 #endif
 #endif
 
+    /*
+     * The remaining fields are sized for the worst case parameter set.
+     * The code doesn't actually refer to small_iter and x directly;
+     * instead, it places them right after the iterator(s) sized for the
+     * parameter set actually in use (see TS_SMALL_ITER, TS_X in internal.h).
+     * That way, a context for a smaller parameter set can be truncated to
+     * ts_context_size(ps) bytes
+     */
+    union t_iterator big_iter;       /* Used to combine FORS roots and */
+                                     /* WOTS heads */
+    union t_iterator small_iter;     /* Used for everything else */
+
     /* Storage for holding information specific to a state */
-    union {
+    union ts_state_storage {
 	struct {
 	    unsigned short fors_node[TS_MAX_FORS];
 	    unsigned char stack[(TS_MAX_T-1) * TS_MAX_HASH];
@@ -165,6 +216,12 @@ struct ts_context {
 	    const void *message;
 	    size_t len_message;
 	} verify; /* Used when we're starting a signature verify */
+#if TS_NODE_CACHE
+	struct {
+	    unsigned char path[TS_MAX_MERKLE_H * TS_MAX_HASH];
+	} cached; /* A Merkle authentication path we got from the node */
+	          /* cache */
+#endif
     } x;
 };
 
@@ -189,6 +246,28 @@ int ts_gen_key( unsigned char *private_key,
 		const struct ts_parameter_set *ps,
 	        int (*random_function)(unsigned char *, size_t) );
 
+/*
+ * These split up the work that ts_gen_key does, so that it can be spread
+ * out (e.g. across threads; see keygen_mt.h).  The bulk of key generation
+ * is evaluating the top level Merkle tree (which has 2**(h/d) leaves).
+ * ts_gen_key_subtree computes the node at the given level (0 = leaf) and
+ * index within that tree, and places it (n bytes) into node.
+ * ts_gen_key_combine takes all 2**(h/d - level) nodes at one level (in
+ * order, n bytes each), hashes them into the root, and places that root
+ * into the private key (and writes the public key, if public_key is
+ * non-NULL).  It overwrites the nodes array.  It returns 1 on success.
+ * For both, the private key must already hold its first 3*n bytes (as
+ * ts_gen_key would get from the random_function)
+ */
+void ts_gen_key_subtree( unsigned char *node,
+		const unsigned char *private_key,
+		const struct ts_parameter_set *ps,
+		unsigned level, unsigned index );
+int ts_gen_key_combine( unsigned char *private_key,
+		unsigned char *public_key,
+		const struct ts_parameter_set *ps,
+		unsigned char *nodes, unsigned level );
+
 /*
  * This starts out the signing process, initializing the context structure
  * (and doing the work we can do before we output any part of the
@@ -227,6 +306,71 @@ void ts_init_sign( struct ts_context *ctx,
 unsigned ts_sign( unsigned char *dest, unsigned n,
                   struct ts_context *ctx );
 
+/*
+ * The nodes in the hypertree are all public; the only reason a signer
+ * computes them is that it doesn't have them stored anywhere.  If the
+ * signer is (say) an HSM attached to a host with plenty of storage, it can
+ * give the host each node it computes, and on later signatures ask for
+ * the authentication paths back, rather than computing them again; on a
+ * warm cache, signing is then mostly the FORS trees and the WOTS
+ * signatures.
+ * The host isn't trusted: the signer only uses a path if it takes the
+ * Merkle leaf to a root it trusts, that is, the root in the public key,
+ * or a root it computed itself earlier (which it hands to the host along
+ * with a MAC, keyed with the private key).  Anything else (including the
+ * host not having the nodes) and it computes the path as usual.
+ * Nodes are named by hypertree layer (0 is the bottom), the tree within
+ * that layer, the height within the tree (0 for the leaves, merkle_h for
+ * the root) and the index on that level.
+ */
+struct ts_node_cache {
+    /* Called with each node we compute.  mac is non-NULL (and n bytes) */
+    /* only for roots; it needs to be handed back with the root.  This */
+    /* may be NULL, if the cache is read only */
+    void (*store)( const unsigned char *node, const unsigned char *mac,
+		   unsigned layer, uint64_t tree, unsigned height,
+		   unsigned index, void *arg );
+    /* Looks up a node that was stored, placing it (and, for a root, its */
+    /* mac) into the buffers given.  Returns 1 if found, 0 if not */
+    int (*fetch)( unsigned char *node, unsigned char *mac,
+		   unsigned layer, uint64_t tree, unsigned height,
+		   unsigned index, void *arg );
+    void *arg;
+};
+
+/*
+ * Have this signature use the node cache (which needs to remain valid
+ * until the signature is done); call this after ts_init_sign.  NULL goes
+ * back to computing everything.
+ * The signature is the same either way.  This returns 1 on success, 0 if
+ * the context isn't signing, or the package was built without
+ * TS_NODE_CACHE
+ */
+int ts_set_node_cache( struct ts_context *ctx,
+		   const struct ts_node_cache *cache );
+
+/*
+ * This has the signer take the WOTS signatures (and leaves) of the upper
+ * hypertree layers from a checkpoint cache (see wotscache.h), and fill it
+ * in as it goes.  Call it after ts_init_sign, and before the first
+ * ts_sign.  It returns 0 if the cache was set up for a different key, or
+ * without TS_WOTS_CACHE
+ */
+int ts_set_wots_cache( struct ts_context *ctx,
+		   struct ts_wots_cache *cache );
+
+/*
+ * This computes an entire Merkle tree (tree within hypertree layer layer;
+ * the top layer is d-1), and hands each node to cache->store, along with
+ * the root's MAC, just as a signer would.  This can be used to fill a
+ * node cache ahead of time (see precompute.h).  It needs the full private
+ * key; it returns 1 on success, 0 on failure (or without TS_NODE_CACHE)
+ */
+int ts_precompute_tree( const unsigned char *private_key,
+		const struct ts_parameter_set *ps,
+		unsigned layer, uint64_t tree,
+		const struct ts_node_cache *cache );
+
 /*
  * This starts the signature verification process, initializing the
  * context structure
@@ -245,6 +389,32 @@ void ts_init_verify( struct ts_context *ctx,
                    const struct ts_parameter_set *ps,
                    const unsigned char *public_key );
 
+/*
+ * If you verify many signatures from the same signer, you can do the
+ * per-public key setup that ts_init_verify does just once.
+ * ts_expand_public_key computes an expanded public key (which holds a copy
+ * of the public key, so the original needn't remain valid), and
+ * ts_init_verify_expanded starts a verification with it (and is otherwise
+ * the same as ts_init_verify).  The expanded key needs to remain valid
+ * (and unmodified) during the entire verification process
+ */
+struct ts_expanded_key {
+    const struct ts_parameter_set *ps;
+    unsigned char public_key[2*TS_MAX_HASH];
+#if TS_SUPPORT_SHA2 && TS_SHA2_OPTIMIZATION
+    uint32_t prehash_sha256[8];
+#if TS_SUPPORT_L5 || TS_SUPPORT_L3
+    uint64_t prehash_sha512[8];
+#endif
+#endif
+};
+void ts_expand_public_key( struct ts_expanded_key *key,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key );
+void ts_init_verify_expanded( struct ts_context *ctx,
+                   const void *message, size_t len_message,
+                   const struct ts_expanded_key *key );
+
 /*
  * This processes the next N byte of the signature to verify
  * If this notices a fatal error midway, this returns 0 - in that
@@ -266,6 +436,23 @@ int ts_update_verify( const unsigned char *sig, unsigned n,
  */
 int ts_verify( struct ts_context *ctx );
 
+/*
+ * By default, the verifier completes each WOTS chain as its digit arrives,
+ * one hash after another.  If you can spare ts_wots_buffer_size(ps) bytes
+ * (about 2k for L5 parameter sets), you can have it instead collect an
+ * entire WOTS signature, and then complete all the chains at once in
+ * parallel hash lanes, which is a good deal faster.  Call this after
+ * ts_init_verify (or one of its variants), and before passing it any of
+ * the signature; the buffer needs to remain valid during the entire
+ * verification process.  Passing NULL goes back to the default.
+ * This returns 1 on success, 0 if the buffer is too short, the context
+ * isn't at the start of a verification, or the package was built without
+ * TS_MULTI_LANE (in which case the verifier works the default way)
+ */
+size_t ts_wots_buffer_size( const struct ts_parameter_set *ps );
+int ts_set_wots_buffer( struct ts_context *ctx,
+                   unsigned char *buffer, size_t len_buffer );
+
 /*
  * The sizes of various things
  */
@@ -273,47 +460,239 @@ unsigned ts_size_private_key( const struct ts_parameter_set *ps );
 unsigned ts_size_public_key( const struct ts_parameter_set *ps );
 unsigned ts_size_signature( const struct ts_parameter_set *ps );
 
+/*
+ * A struct ts_context is sized for the worst case parameter set that
+ * tune.h allows.  If you need to keep a lot of contexts around, you can
+ * instead have each one take only ts_context_size(ps) bytes (which is
+ * never more than sizeof(struct ts_context)), and use these versions of
+ * the init functions.  They're the same as ts_init_sign and ts_init_verify,
+ * except that they use the buffer you provide as the context (and return
+ * a pointer to it, to pass to ts_sign, ts_update_verify and ts_verify).
+ * They return NULL (and do nothing) if the buffer is shorter than
+ * ts_context_size(ps) or not aligned to a TS_CONTEXT_ALIGN boundary.
+ * Note: such a context must be used only with the parameter set it was
+ * initialized with
+ */
+#define TS_CONTEXT_ALIGN 8
+size_t ts_context_size( const struct ts_parameter_set *ps );
+struct ts_context *ts_init_sign_buffer( void *buffer, size_t len_buffer,
+                   const void *message, size_t len_message,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *private_key,
+	           int (*random_function)(unsigned char *, size_t) );
+struct ts_context *ts_init_verify_buffer( void *buffer, size_t len_buffer,
+                   const void *message, size_t len_message,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key );
+
+/*
+ * Suspending a signature or a verification, and resuming it later (or in
+ * another process).  ts_context_export writes the state of the context
+ * (at most ts_context_export_size(ps) bytes) into blob, and returns the
+ * number of bytes written (0 if len_blob is too short).  The blob
+ * identifies the parameter set by its TS_PS_xxx number rather than by a
+ * pointer, and has no other pointers in it, so it can be written out and
+ * read back in elsewhere; however, it can only be imported by a build
+ * with the same tune.h settings and byte order (the import checks).  It
+ * contains the public key, but none of the private key
+ *
+ * ts_context_import resumes from a blob, using the buffer you provide as
+ * the context (as ts_init_sign_buffer does; it returns NULL if the blob
+ * is bad, or the buffer is too small).  key is what the context was
+ * initialized with (the private key for a signer, the public key for a
+ * verifier); it must match the public key in the blob.  message is needed
+ * only if the verifier hadn't gotten R yet (ts_context_blob_needs_message
+ * says); it must be the same message.  If the verifier was using a WOTS
+ * buffer (ts_set_wots_buffer), you can give it one again (the bytes it
+ * had collected are in the blob); if you don't, it finishes those chains
+ * during the import, and carries on without one.  Node and WOTS caches
+ * aren't part of the blob; the signer can be given those again after the
+ * import.  Importing the same blob twice is harmless: both resume the
+ * same signature, and produce the same bytes
+ * ts_context_blob_ps returns the parameter set of a blob (so you know how
+ * big a buffer to import it into), or NULL if it isn't one we support.
+ * Note: the import checks that the blob is for this build and this key.
+ * A signer's blob also carries a MAC (keyed with the private key), which
+ * the import checks before it takes anything from the blob, so a signer
+ * can't be made to resume somewhere else; still, it holds the signer's
+ * secrets, so keep blobs where you'd keep the context itself.  A
+ * verifier's blob has no MAC: the import refuses one whose state is out
+ * of range (or that has already finished), but a blob that has been
+ * modified otherwise can make the verifier accept a signature it
+ * shouldn't.  Keep verifier blobs in storage you trust.  Exporting
+ * a signer briefly uses the context's scratch space, so don't export a
+ * context that another thread is using (forking from it, say)
+ */
+size_t ts_context_export_size( const struct ts_parameter_set *ps );
+size_t ts_context_export( unsigned char *blob, size_t len_blob,
+                   const struct ts_context *ctx );
+const struct ts_parameter_set *ts_context_blob_ps( const unsigned char *blob,
+                   size_t len_blob );
+int ts_context_blob_needs_message( const unsigned char *blob,
+                   size_t len_blob );
+struct ts_context *ts_context_import( void *buffer, size_t len_buffer,
+                   const unsigned char *blob, size_t len_blob,
+                   const unsigned char *key,
+                   const void *message, size_t len_message,
+                   unsigned char *wots_buffer );
+
+/*
+ * Forking a context: this makes a copy of src (a signature or verification
+ * in progress) in the buffer you provide (which needs ts_context_size
+ * bytes; the same rules as ts_init_sign_buffer apply), and returns it
+ * (NULL if src isn't a context, or the buffer won't do).  From then on,
+ * the two are independent; each can be continued (ts_sign, or
+ * ts_update_verify and ts_verify) without affecting the other, and
+ * neither has to be continued at all.  This copies the hash states in
+ * progress as well, so a verifier that forks at some offset in the
+ * signature needn't rehash anything before that offset; e.g. to try
+ * several candidate tails of a signature, you feed the common prefix to
+ * one verifier, then fork it once per tail.
+ *
+ * What the two share, they only read: the parameter set, the key, and the
+ * message, if the verifier hadn't gotten R yet (so keep those around as
+ * long as either is in use).  A signer's node cache and WOTS cache are
+ * shared too (see those for whether they can be used by two signers at
+ * once).  A forked signer produces exactly the bytes the original would
+ * have (the randomness for R has already been chosen).  A verifier's WOTS
+ * buffer isn't shared: if src has one, pass another one (of
+ * ts_wots_buffer_size bytes) as wots_buffer, and what src has collected
+ * so far is copied into it; if you pass NULL, those chains are finished
+ * (which takes up to 15 F calls each) and the fork carries on without one.
+ * wots_buffer is ignored if src doesn't have one.
+ * Note: a fork of a signer holds the same secrets the original does;
+ * keep it wherever you'd keep the original
+ */
+struct ts_context *ts_context_fork( void *buffer, size_t len_buffer,
+                   const struct ts_context *src,
+                   unsigned char *wots_buffer );
+
+/*
+ * Selecting the hash backends (the low level SHA-256, SHA-512 and Keccak
+ * implementations, and their four lane versions).  If TS_BACKEND_DISPATCH
+ * is set in tune.h, ts_init_backends() probes the CPU and picks the
+ * fastest implementation of each it supports.  ts_init_sign,
+ * ts_init_verify and ts_gen_key call this for you; this does the probe
+ * only the first time (under pthread_once, so any number of threads may
+ * call it at once)
+ *
+ * ts_set_backend overrides the choice for one primitive (intended for
+ * testing); it returns 1 on success, 0 if that implementation isn't
+ * available on this CPU (or this build).  It updates a global table that
+ * every signer and verifier reads, so call it before starting any other
+ * threads.  ts_get_backend returns the implementation currently in use
+ */
+#define TS_PRIM_SHA256     0
+#define TS_PRIM_SHA512     1
+#define TS_PRIM_KECCAK     2
+#define TS_PRIM_SHA256_X4  3  /* The four lane versions (used only if */
+#define TS_PRIM_KECCAK_X4  4  /* TS_MULTI_LANE is set in tune.h) */
+
+#define TS_BACKEND_SCALAR  0  /* Portable C; always available.  For the */
+                              /* four lane primitives, this runs the */
+                              /* single lane one four times */
+#define TS_BACKEND_SHA_NI  1  /* x86 SHA extensions (SHA-256 only) */
+#define TS_BACKEND_VECTOR  2  /* Compiler vector extensions (four lane */
+                              /* primitives only) */
+#define TS_BACKEND_AVX2    3  /* The same, built for AVX2 (x86 only) */
+
+void ts_init_backends(void);
+int ts_set_backend(int primitive, int backend);
+int ts_get_backend(int primitive);
+
+/*
+ * If we've been built for a single parameter set, that's the only one
+ * that is available
+ */
+#if TS_FIXED_PARM_SET
+#define TS_PS_ENABLED(id) (TS_FIXED_PARM_SET == (id))
+#else
+#define TS_PS_ENABLED(id) 1
+#endif
+
 /*
  * And all the supported parameter sets
  */
-#if TS_SUPPORT_SHAKE
+#if TS_SUPPORT_SHAKE && \
+    TS_PS_ENABLED(TS_PS_SHAKE_128F_SIMPLE)
 extern const struct ts_parameter_set ts_ps_shake_128f_simple;
 #endif
-#if TS_SUPPORT_SHAKE && TS_SUPPORT_S
+#if TS_SUPPORT_SHAKE && TS_SUPPORT_S && \
+    TS_PS_ENABLED(TS_PS_SHAKE_128S_SIMPLE)
 extern const struct ts_parameter_set ts_ps_shake_128s_simple;
 #endif
-#if TS_SUPPORT_SHAKE && (TS_SUPPORT_L3 || TS_SUPPORT_L5)
+#if TS_SUPPORT_SHAKE && (TS_SUPPORT_L3 || TS_SUPPORT_L5) && \
+    TS_PS_ENABLED(TS_PS_SHAKE_192F_SIMPLE)
 extern const struct ts_parameter_set ts_ps_shake_192f_simple;
 #endif
-#if TS_SUPPORT_SHAKE && TS_SUPPORT_S && (TS_SUPPORT_L3 || TS_SUPPORT_L5)
+#if TS_SUPPORT_SHAKE && TS_SUPPORT_S && (TS_SUPPORT_L3 || TS_SUPPORT_L5) && \
+    TS_PS_ENABLED(TS_PS_SHAKE_192S_SIMPLE)
 extern const struct ts_parameter_set ts_ps_shake_192s_simple;
 #endif
-#if TS_SUPPORT_SHAKE && TS_SUPPORT_L5
+#if TS_SUPPORT_SHAKE && TS_SUPPORT_L5 && \
+    TS_PS_ENABLED(TS_PS_SHAKE_256F_SIMPLE)
 extern const struct ts_parameter_set ts_ps_shake_256f_simple;
 #endif
-#if TS_SUPPORT_SHAKE && TS_SUPPORT_S && TS_SUPPORT_L5
+#if TS_SUPPORT_SHAKE && TS_SUPPORT_S && TS_SUPPORT_L5 && \
+    TS_PS_ENABLED(TS_PS_SHAKE_256S_SIMPLE)
 extern const struct ts_parameter_set ts_ps_shake_256s_simple;
 #endif
 
-#if TS_SUPPORT_SHA2
+#if TS_SUPPORT_SHA2 && \
+    TS_PS_ENABLED(TS_PS_SHA2_128F_SIMPLE)
 extern const struct ts_parameter_set ts_ps_sha2_128f_simple;
 #endif
-#if TS_SUPPORT_SHA2 && TS_SUPPORT_S
+#if TS_SUPPORT_SHA2 && TS_SUPPORT_S && \
+    TS_PS_ENABLED(TS_PS_SHA2_128S_SIMPLE)
 extern const struct ts_parameter_set ts_ps_sha2_128s_simple;
 #endif
 
-#if TS_SUPPORT_SHA2 && (TS_SUPPORT_L5 || TS_SUPPORT_L3)
+#if TS_SUPPORT_SHA2 && (TS_SUPPORT_L5 || TS_SUPPORT_L3) && \
+    TS_PS_ENABLED(TS_PS_SHA2_192F_SIMPLE)
 extern const struct ts_parameter_set ts_ps_sha2_192f_simple;
 #endif
-#if TS_SUPPORT_SHA2 && (TS_SUPPORT_L5 || TS_SUPPORT_L3) & TS_SUPPORT_S
+#if TS_SUPPORT_SHA2 && (TS_SUPPORT_L5 || TS_SUPPORT_L3) & TS_SUPPORT_S && \
+    TS_PS_ENABLED(TS_PS_SHA2_192S_SIMPLE)
 extern const struct ts_parameter_set ts_ps_sha2_192s_simple;
 #endif
 
-#if TS_SUPPORT_SHA2 && TS_SUPPORT_L5
+#if TS_SUPPORT_SHA2 && TS_SUPPORT_L5 && \
+    TS_PS_ENABLED(TS_PS_SHA2_256F_SIMPLE)
 extern const struct ts_parameter_set ts_ps_sha2_256f_simple;
 #endif
-#if TS_SUPPORT_SHA2 && TS_SUPPORT_L5 && TS_SUPPORT_S
+#if TS_SUPPORT_SHA2 && TS_SUPPORT_L5 && TS_SUPPORT_S && \
+    TS_PS_ENABLED(TS_PS_SHA2_256S_SIMPLE)
 extern const struct ts_parameter_set ts_ps_sha2_256s_simple;
 #endif
 
+/*
+ * Building a parameter set at runtime (if TS_CUSTOM_PARM_SET is set in
+ * tune.h).  This fills in the buffer you provide (ts_parameter_set_size()
+ * bytes, aligned to a TS_CONTEXT_ALIGN boundary) with a parameter set with
+ * hash size n (16, 24 or 32), hypertree height h, d hypertree layers, k
+ * FORS trees of height t, and Winternitz parameter w (4, 16 or 256), using
+ * the given hash family (TS_HASH_SHAKE or TS_HASH_SHA2; for SHA2, n = 16
+ * uses SHA-256 throughout, as the L1 parameter sets do, and larger n use
+ * SHA-512 for H and T, as the L3/L5 ones do).  It returns the parameter
+ * set, to use just as you would the built in ones, or NULL if it can't
+ * build one: if the parameters aren't valid, this build doesn't support
+ * that n or hash family, or the parameter set needs more room than tune.h
+ * sized the context for (e.g. h/d larger than the S parameter sets use).
+ * Key generation, signing and verification work with it as with any other;
+ * the key and signature sizes follow from the parameters (w = 4 has 4n
+ * digits plus a 4 or 5 digit checksum in each WOTS signature; w = 256, n
+ * digits plus 2).  Note: these parameter sets don't have a TS_PS_xxx
+ * number, so contexts using them can't be exported (ts_context_export),
+ * and a build for a single parameter set (TS_FIXED_PARM_SET) can't make
+ * them at all.  Also, it's up to you to pick parameters that give the
+ * security level you're after; all this checks is that they'll work
+ */
+#define TS_HASH_SHAKE 0
+#define TS_HASH_SHA2  1
+size_t ts_parameter_set_size(void);
+const struct ts_parameter_set *ts_make_parameter_set(
+                   void *buffer, size_t len_buffer,
+                   unsigned n, unsigned h, unsigned d, unsigned k,
+                   unsigned t, unsigned w, int hash_family );
+
 #endif /* TINY_SPHINCS_H_ */
@@ -0,0 +1,463 @@
+/*
+ * tsphincs: a command line tool for signing and verifying files
+ *
+ * Usage:
+ *   tsphincs keygen parameter_set key_file
+ *   tsphincs sign [-p precomputed_file] key_file file [signature_file]
+ *   tsphincs verify key_file file signature_file
+ *   tsphincs batch key_file manifest [num_threads]
+ *   tsphincs precompute key_file layers precomputed_file [num_threads]
+ *
+ * keygen writes a new key file (see keyfile.h) with the private key in
+ * it; strip the private-key line to get a file you can hand to verifiers.
+ * sign writes the signature to signature_file (through a temporary file
+ * that's renamed into place once the signature is complete), or stdout,
+ * and verify exits with status 0 if the signature verifies.  Both report how long
+ * they took on stderr.
+ * batch verifies every file listed in the manifest (one per line, each
+ * followed by its signature file, which defaults to the file name with
+ * .sig appended; lines starting with # are ignored), using
+ * ts_verify_batch; it lists the ones that don't verify, and exits with
+ * status 0 only if all of them do.
+ * precompute computes the top layers of the hypertree for the key, and
+ * writes them to precomputed_file (see precompute.h); if sign is handed
+ * that file with -p, it uses it, and so only has to compute the lower
+ * layers.
+ *
+ * The file being signed or verified is memory mapped rather than read in;
+ * signing goes over the message twice (once to compute R, and once to
+ * hash it), and this way both passes run directly over the page cache
+ * (and we tell the kernel we'll be reading it sequentially), rather than
+ * copying a large file onto the heap.  The signature, on the other hand,
+ * is streamed: we write it out as ts_sign produces it, and hand it to
+ * ts_update_verify as we read it
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "tiny_sphincs.h"
+#include "keyfile.h"
+#include "batch_verify.h"
+#include "precompute.h"
+
+#define CHUNK (64*1024)    /* How much signature we handle at a time */
+
+static int random_function( unsigned char *p, size_t len ) {
+    return 0 == getentropy( p, len );
+}
+
+static double now_ms( void ) {
+    struct timespec t;
+    clock_gettime( CLOCK_MONOTONIC, &t );
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/*
+ * A memory mapped file
+ */
+struct mapped {
+    const unsigned char *data;
+    size_t len;
+};
+
+static int map_file( struct mapped *m, const char *filename ) {
+    int fd = open( filename, O_RDONLY );
+    struct stat st;
+    if (fd < 0 || 0 != fstat( fd, &st )) {
+	perror( filename );
+	if (fd >= 0) close( fd );
+	return 0;
+    }
+    m->len = st.st_size;
+    if (m->len == 0) {
+	m->data = (const unsigned char *)"";  /* mmap won't map nothing */
+	close( fd );
+	return 1;
+    }
+    void *p = mmap( 0, m->len, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (p == MAP_FAILED) {
+	perror( filename );
+	return 0;
+    }
+    madvise( p, m->len, MADV_SEQUENTIAL );
+    m->data = p;
+    return 1;
+}
+
+static void unmap_file( struct mapped *m ) {
+    if (m->len > 0) munmap( (void *)m->data, m->len );
+}
+
+/*
+ * Overwrite memory in a way the compiler won't optimize away (as it could
+ * decide no one reads the memory afterwards)
+ */
+static void zeroize( void *p, size_t n ) {
+    volatile unsigned char *q = p;
+    while (n--) {
+	*q++ = 0;
+    }
+}
+
+static int keygen( const char *name, const char *key_filename ) {
+    struct ts_key_file key;
+    memset( &key, 0, sizeof key );
+    key.ps = ts_lookup_parameter_set( name );
+    if (!key.ps) {
+	fprintf( stderr, "Unknown parameter set %s\n", name );
+	return EXIT_FAILURE;
+    }
+    double start = now_ms();
+    if (!ts_gen_key( key.private_key, key.public_key, key.ps,
+		     random_function )) {
+	fprintf( stderr, "Key generation failed\n" );
+	zeroize( &key, sizeof key );
+	return EXIT_FAILURE;
+    }
+    key.have_private_key = 1;
+    double elapsed = now_ms() - start;
+
+    /* The private key is secret; don't let anyone else read it */
+    int fd = open( key_filename, O_WRONLY | O_CREAT | O_EXCL, 0600 );
+    FILE *f = fd < 0 ? 0 : fdopen( fd, "w" );
+    int ok = f && ts_write_key_file( &key, f );
+    if (f && 0 != fclose( f )) ok = 0;
+    zeroize( &key, sizeof key );
+    if (!ok) {
+	perror( key_filename );
+	return EXIT_FAILURE;
+    }
+    fprintf( stderr, "Generated %s key in %.1f ms\n", name, elapsed );
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Where sign writes the signature: to stdout, or to a temporary file next
+ * to the signature file, which is renamed over it only once the whole
+ * signature is written (so a failure never leaves a truncated signature
+ * behind, or destroys the one that was there)
+ */
+struct output {
+    FILE *f;
+    const char *filename;      /* NULL for stdout */
+    char *temp_filename;
+};
+
+static int open_output( struct output *out, const char *filename ) {
+    out->filename = filename;
+    out->temp_filename = 0;
+    if (!filename) {
+	out->f = stdout;
+	return 1;
+    }
+    out->temp_filename = malloc( strlen( filename ) + 8 );
+    if (!out->temp_filename) return 0;
+    sprintf( out->temp_filename, "%s.XXXXXX", filename );
+    int fd = mkstemp( out->temp_filename );
+    if (fd < 0) {
+	perror( filename );
+	free( out->temp_filename );
+	return 0;
+    }
+    /* mkstemp makes it private; a signature isn't */
+    mode_t mask = umask( 0 );
+    umask( mask );
+    fchmod( fd, 0666 & ~mask );
+    out->f = fdopen( fd, "wb" );
+    if (!out->f) {
+	perror( filename );
+	close( fd );
+	unlink( out->temp_filename );
+	free( out->temp_filename );
+	return 0;
+    }
+    return 1;
+}
+
+/* Finish writing; if ok is clear (or the writes failed), discard it */
+static int close_output( struct output *out, int ok ) {
+    if (0 != fflush( out->f )) ok = 0;
+    if (out->filename) {
+	if (0 != fclose( out->f )) ok = 0;
+	if (ok && 0 != rename( out->temp_filename, out->filename )) {
+	    perror( out->filename );
+	    ok = 0;
+	}
+	if (!ok) unlink( out->temp_filename );
+	free( out->temp_filename );
+    }
+    return ok;
+}
+
+/* Set if getentropy failed while we were signing */
+static int random_failed;
+
+static int sign_random_function( unsigned char *p, size_t len ) {
+    if (random_function( p, len )) return 1;
+    random_failed = 1;
+    return 0;
+}
+
+static int sign( const char *key_filename, const char *filename,
+		 const char *sig_filename, const char *precomputed_filename ) {
+    struct ts_key_file key;
+    if (!ts_read_key_file( &key, key_filename )) return EXIT_FAILURE;
+    if (!key.have_private_key) {
+	fprintf( stderr, "%s: no private key\n", key_filename );
+	return EXIT_FAILURE;
+    }
+    struct ts_precomputed pc;
+    memset( &pc, 0, sizeof pc );
+    if (precomputed_filename && !ts_open_precomputed( &pc,
+		    precomputed_filename, key.ps, key.public_key )) {
+	fprintf( stderr, "%s: not a precomputed file for this key\n",
+		         precomputed_filename );
+	zeroize( &key, sizeof key );
+	return EXIT_FAILURE;
+    }
+    struct mapped m;
+    struct output out;
+    if (!map_file( &m, filename )) {
+	zeroize( &key, sizeof key );
+	ts_close_precomputed( &pc );
+	return EXIT_FAILURE;
+    }
+    if (!open_output( &out, sig_filename )) {
+	zeroize( &key, sizeof key );
+	unmap_file( &m );
+	ts_close_precomputed( &pc );
+	return EXIT_FAILURE;
+    }
+
+    /* ts_init_sign doesn't return a status; if getentropy fails, it */
+    /* quietly falls back to deterministic signing, which isn't what */
+    /* we were asked for */
+    double start = now_ms();
+    struct ts_context ctx;
+    random_failed = 0;
+    ts_init_sign( &ctx, m.data, m.len, key.ps, key.private_key,
+		  sign_random_function );
+    const char *error = 0;
+    if (random_failed) {
+	error = "Unable to get randomness for the signature";
+    } else if (precomputed_filename &&
+	       !ts_set_node_cache( &ctx, &pc.cache )) {
+	error = "Unable to use the precomputed file";
+    }
+    double hashed = now_ms();
+
+    static unsigned char buffer[ CHUNK ];
+    size_t total = 0;
+    int ok = !error;
+    while (ok) {
+	unsigned n = ts_sign( buffer, sizeof buffer, &ctx );
+	if (n == 0) break;
+	if (n != fwrite( buffer, 1, n, out.f )) ok = 0;
+	total += n;
+    }
+    double done = now_ms();
+    if (total != ts_size_signature( key.ps )) ok = 0;
+    ok = close_output( &out, ok );
+    zeroize( &ctx, sizeof ctx );
+    zeroize( &key, sizeof key );
+    unmap_file( &m );
+    ts_close_precomputed( &pc );
+
+    if (!ok) {
+	fprintf( stderr, "%s\n", error ? error :
+				    "Error writing the signature" );
+	return EXIT_FAILURE;
+    }
+    fprintf( stderr, "Signed %zu bytes in %.1f ms (%.1f ms hashing the "
+		     "message, %.1f ms generating the signature)\n",
+		     m.len, done - start, hashed - start, done - hashed );
+    return EXIT_SUCCESS;
+}
+
+static int verify( const char *key_filename, const char *filename,
+		   const char *sig_filename ) {
+    struct ts_key_file key;
+    if (!ts_read_key_file( &key, key_filename )) return EXIT_FAILURE;
+    FILE *in = fopen( sig_filename, "rb" );
+    if (!in) {
+	perror( sig_filename );
+	return EXIT_FAILURE;
+    }
+    struct mapped m;
+    if (!map_file( &m, filename )) {
+	fclose( in );
+	return EXIT_FAILURE;
+    }
+
+    double start = now_ms();
+    struct ts_context ctx;
+    ts_init_verify( &ctx, m.data, m.len, key.ps, key.public_key );
+    static unsigned char buffer[ CHUNK ];
+    for (;;) {
+	size_t n = fread( buffer, 1, sizeof buffer, in );
+	if (n == 0) break;
+	if (!ts_update_verify( buffer, n, &ctx )) break;
+    }
+    /* A read error isn't the end of the signature */
+    int read_error = ferror( in );
+    int valid = !read_error && ts_verify( &ctx );
+    double done = now_ms();
+    fclose( in );
+    unmap_file( &m );
+    if (read_error) {
+	fprintf( stderr, "%s: read error\n", sig_filename );
+	return EXIT_FAILURE;
+    }
+
+    fprintf( stderr, "Signature %s (%zu bytes, %.1f ms)\n",
+		     valid ? "verified" : "did NOT verify", m.len,
+		     done - start );
+    return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int batch( const char *key_filename, const char *manifest,
+		  unsigned num_threads ) {
+    struct ts_key_file key;
+    if (!ts_read_key_file( &key, key_filename )) return EXIT_FAILURE;
+    FILE *f = fopen( manifest, "r" );
+    if (!f) {
+	perror( manifest );
+	return EXIT_FAILURE;
+    }
+
+    /* Read in the list of files */
+    struct ts_batch_item *items = 0;
+    unsigned count = 0, allocated = 0;
+    char line[ 2*4096 ];
+    int ok = 1;
+    while (ok && fgets( line, sizeof line, f )) {
+	char *artifact = strtok( line, " \t\r\n" );
+	if (!artifact || artifact[0] == '#') continue;
+	char *signature = strtok( 0, " \t\r\n" );
+	if (count == allocated) {
+	    allocated = 2*allocated + 64;
+	    void *p = realloc( items, allocated * sizeof *items );
+	    if (!p) { ok = 0; break; }
+	    items = p;
+	}
+	struct ts_batch_item *item = &items[count];
+	item->artifact = strdup( artifact );
+	if (signature) {
+	    item->signature = strdup( signature );
+	} else {
+	    char *s = malloc( strlen( artifact ) + 5 );
+	    if (s) sprintf( s, "%s.sig", artifact );
+	    item->signature = s;
+	}
+	item->ps = key.ps;
+	item->public_key = key.public_key;
+	count++;
+	if (!item->artifact || !item->signature) ok = 0;
+    }
+    fclose( f );
+    if (!ok) {
+	fprintf( stderr, "Out of memory\n" );
+	return EXIT_FAILURE;
+    }
+
+    double start = now_ms();
+    unsigned num_valid = ts_verify_batch( items, count, num_threads );
+    double elapsed = now_ms() - start;
+
+    unsigned long long total = 0;
+    for (unsigned i = 0; i < count; i++) {
+	total += items[i].size;
+	switch (items[i].result) {
+	case ts_batch_valid: break;
+	case ts_batch_invalid: printf( "INVALID %s\n", items[i].artifact );
+			       break;
+	default: printf( "ERROR   %s\n", items[i].artifact ); break;
+	}
+	free( (void *)items[i].artifact );
+	free( (void *)items[i].signature );
+    }
+    free( items );
+    fprintf( stderr, "%u of %u files verified; %llu bytes in %.1f ms "
+		     "(%.1f MB/s, %.1f files/s)\n", num_valid, count, total,
+		     elapsed, total / (elapsed > 0 ? elapsed * 1e3 : 1),
+		     count / (elapsed > 0 ? elapsed / 1e3 : 1) );
+    return num_valid == count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int precompute( const char *key_filename, unsigned layers,
+		       const char *precomputed_filename,
+		       unsigned num_threads ) {
+    struct ts_key_file key;
+    if (!ts_read_key_file( &key, key_filename )) return EXIT_FAILURE;
+    if (!key.have_private_key) {
+	fprintf( stderr, "%s: no private key\n", key_filename );
+	return EXIT_FAILURE;
+    }
+    double start = now_ms();
+    int ok = ts_precompute( precomputed_filename, key.private_key, key.ps,
+			    layers, num_threads );
+    double elapsed = now_ms() - start;
+    if (!ok) {
+	zeroize( &key, sizeof key );
+	fprintf( stderr, "Unable to precompute %u layers into %s\n",
+		         layers, precomputed_filename );
+	return EXIT_FAILURE;
+    }
+    size_t len = ts_precomputed_size( key.ps, layers );
+    zeroize( &key, sizeof key );
+    fprintf( stderr, "Precomputed %u layers (%zu bytes) in %.1f ms\n",
+		     layers, len, elapsed );
+    return EXIT_SUCCESS;
+}
+
+static void usage( const char *program ) {
+    fprintf( stderr, "Usage: %s keygen parameter_set key_file\n"
+		     "       %s sign [-p precomputed_file] key_file file "
+		                                      "[signature_file]\n"
+		     "       %s verify key_file file signature_file\n"
+		     "       %s batch key_file manifest [num_threads]\n"
+		     "       %s precompute key_file layers precomputed_file "
+		                                      "[num_threads]\n",
+		     program, program, program, program, program );
+    exit( EXIT_FAILURE );
+}
+
+int main( int argc, char **argv ) {
+    const char *program = argv[0];
+    if (argc < 2) usage( program );
+    const char *command = argv[1];
+    if (0 == strcmp( command, "keygen" ) && argc == 4) {
+	return keygen( argv[2], argv[3] );
+    }
+    if (0 == strcmp( command, "sign" )) {
+	const char *precomputed_filename = 0;
+	if (argc >= 4 && 0 == strcmp( argv[2], "-p" )) {
+	    precomputed_filename = argv[3];
+	    argv += 2; argc -= 2;
+	}
+	if (argc == 4 || argc == 5) {
+	    return sign( argv[2], argv[3], argc == 5 ? argv[4] : 0,
+			 precomputed_filename );
+	}
+    }
+    if (0 == strcmp( command, "verify" ) && argc == 5) {
+	return verify( argv[2], argv[3], argv[4] );
+    }
+    if (0 == strcmp( command, "batch" ) && (argc == 4 || argc == 5)) {
+	return batch( argv[2], argv[3], argc == 5 ? atoi( argv[4] ) :
+					    sysconf( _SC_NPROCESSORS_ONLN ) );
+    }
+    if (0 == strcmp( command, "precompute" ) && (argc == 5 || argc == 6)) {
+	return precompute( argv[2], atoi( argv[3] ), argv[4],
+			   argc == 6 ? atoi( argv[5] ) :
+					    sysconf( _SC_NPROCESSORS_ONLN ) );
+    }
+    usage( program );
+    return EXIT_FAILURE;
+}
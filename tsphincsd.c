@@ -0,0 +1,752 @@
+/*
+ * tsphincsd: a signing/verification daemon built on this package
+ *
+ * Usage: tsphincsd [-w workers] [-c contexts] [-r reseed] socket_path
+ *                  key_file...
+ *
+ * This loads the key files (see keyfile.h; key i is the i-th one on the
+ * command line), listens on a Unix socket, and serves sign and verify
+ * requests.  It's meant as a reference for how to serve this package (and
+ * something you can run as it is), rather than each application writing
+ * its own loop around ts_init_sign/ts_sign.
+ *
+ * The protocol (all lengths are 4 byte big-endian):
+ *   Request:  op (1 byte), key index (1 byte), message length, message
+ *             and, for verify, signature length, signature
+ *             The ops are 'S' (sign), 'V' (verify) and 'M' (metrics; the
+ *             key index and message are ignored)
+ *   Sign:     status (1 byte, 0 = OK), signature length, signature
+ *   Verify:   status (1 byte, 0 = the signature verified, 1 = it didn't)
+ *   Metrics:  status (1 byte, 0), text length, text
+ * A status of 0xff means the request was bad (unknown key or op, a sign
+ * request for a key without a private key, or a message that's too long);
+ * the daemon closes the connection after sending it.  A client may send
+ * requests one after another on a connection; each one is answered before
+ * the next is read.
+ *
+ * How it works:
+ * - The main thread does all the reading: it polls the listening socket
+ *   and the idle connections, and collects each request.  Once it has a
+ *   complete request, it hands it to the worker for that key (so a key is
+ *   always served by the same worker, which keeps its expanded key and
+ *   contexts warm in that worker's cache), and stops reading from that
+ *   connection until the request has been answered.
+ * - Each worker takes all the requests queued for it at once (so a burst
+ *   of requests costs one trip through the lock).  Verifies are done
+ *   immediately (with the key's expanded public key).  Signatures are
+ *   streamed: the worker holds a pool of contexts (pool.h), and produces
+ *   the next chunk of a signature (with ts_sign) only when the client's
+ *   socket can take it.  That way, a slow client doesn't hold up the others
+ *   on that worker, and never has more than a chunk buffered for it.
+ * - Each worker keeps latency statistics, which the 'M' request reports
+ * - SIGINT and SIGTERM are handled by the main thread only (the others
+ *   have them blocked); the handler pokes a pipe the main thread polls.
+ *   On the way out, we stop the workers, and wipe the private keys
+ * - The randomness for the signatures (OptRand) comes from getentropy,
+ *   or, with -r, from a DRBG (see drbg_async.h) that's reseeded from
+ *   getentropy every reseed signatures, in the background.  On Linux,
+ *   getentropy is cheap enough that the DRBG doesn't gain anything; it's
+ *   for systems where the entropy source is slow
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "tiny_sphincs.h"
+#include "pool.h"
+#include "keyfile.h"
+#include "drbg_async.h"
+
+#define MAX_KEYS       256     /* The key index is a byte */
+#define MAX_WORKERS     64
+#define MAX_STREAMS    256     /* Most contexts a worker will have */
+#define CHUNK        16384     /* How much of a signature we generate at */
+                               /* a time */
+#define MAX_MESSAGE  (64UL << 20)  /* Longest message we'll accept */
+
+#define STATUS_OK      0
+#define STATUS_INVALID 1
+#define STATUS_BAD     0xff
+
+struct key {
+    struct ts_key_file file;
+    struct ts_expanded_key expanded;
+};
+
+static struct key keys[ MAX_KEYS ];
+static unsigned num_keys;
+
+/*
+ * A client connection
+ */
+enum conn_state {
+    reading_header,     /* op, key, message length */
+    reading_message,
+    reading_sig_length,
+    reading_sig,
+    busy,               /* A worker has the request */
+};
+
+struct conn {
+    int fd;
+    enum conn_state state;
+    unsigned char header[6];
+    size_t have;              /* Bytes of the current field we have */
+    unsigned char op, key;
+    size_t len_message, len_sig;
+    unsigned char *message, *sig;
+    int failed;               /* Set if we're to close the connection */
+    struct timespec start;    /* When we got the request */
+    struct conn *next;        /* On a worker's queue */
+};
+
+/*
+ * Latency statistics for one operation
+ */
+struct stats {
+    unsigned long count;
+    double total_us, max_us;
+};
+
+enum { OP_SIGN, OP_VERIFY, NUM_OPS };
+
+/*
+ * A signature that's being streamed to a client
+ */
+struct stream {
+    struct conn *c;
+    ts_pool_handle handle;
+    struct ts_context *ctx;
+    unsigned char buffer[ CHUNK ];
+    size_t len, offset;       /* What's in the buffer; what we've sent */
+    int finished;             /* Set once ts_sign has nothing more */
+};
+
+struct worker {
+    pthread_t thread;
+    int started;              /* Set once the thread is running */
+    int wake[2];              /* The main thread pokes this when it */
+                              /* queues something */
+    pthread_mutex_t lock;     /* Protects the queue and the stats */
+    struct conn *queue_head, *queue_tail;
+    struct stats stats[ NUM_OPS ];
+    unsigned long max_batch;  /* Most requests taken at once */
+
+    /* Used only by the worker thread */
+    struct ts_pool pool;
+    void *pool_memory;
+    struct stream *streams;
+    unsigned num_streams;
+    struct conn *pending_head, *pending_tail;  /* Sign requests waiting */
+                              /* for a context */
+};
+
+static struct worker workers[ MAX_WORKERS ];
+static unsigned num_workers = 2;
+static unsigned contexts_per_worker = 16;
+
+static int done_pipe[2];      /* Workers write finished connections here */
+static int signal_pipe[2];    /* The signal handler writes here */
+static volatile sig_atomic_t stop;
+
+static void on_signal( int sig ) {
+    (void)sig;
+    stop = 1;
+    /* Wake up the main thread, in case it's about to poll */
+    int saved_errno = errno;
+    if (write( signal_pipe[1], "", 1 ) < 0) {
+	;  /* The pipe is full, so it's awake anyways */
+    }
+    errno = saved_errno;
+}
+
+/*
+ * Overwrite memory in a way the compiler won't optimize away (as it could
+ * decide no one reads the memory afterwards)
+ */
+static void zeroize( void *p, size_t n ) {
+    volatile unsigned char *q = p;
+    while (n--) {
+	*q++ = 0;
+    }
+}
+
+static void wipe_keys( void ) {
+    zeroize( keys, sizeof keys );
+}
+
+static int entropy_function( unsigned char *p, size_t len ) {
+    return 0 == getentropy( p, len );
+}
+
+static struct ts_drbg_async drbg;
+static unsigned long reseed_interval;     /* 0 if we're not using it */
+
+static int random_function( unsigned char *p, size_t len ) {
+    if (!reseed_interval) return entropy_function( p, len );
+    return ts_drbg_async_generate( &drbg, p, len );
+}
+
+static double elapsed_us( const struct timespec *start ) {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (now.tv_sec - start->tv_sec) * 1e6 +
+	   (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+static void put_u32( unsigned char *p, uint32_t x ) {
+    p[0] = x >> 24; p[1] = x >> 16; p[2] = x >> 8; p[3] = x;
+}
+
+static uint32_t get_u32( const unsigned char *p ) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	   ((uint32_t)p[2] << 8) | p[3];
+}
+
+/*
+ * Write all of a short response to a connection (which, as the client
+ * is waiting for it, has room in its socket buffer); used for everything
+ * except signatures
+ */
+static void send_all( struct conn *c, const void *p, size_t len ) {
+    const unsigned char *q = p;
+    while (len > 0 && !c->failed) {
+	ssize_t k = send( c->fd, q, len, MSG_NOSIGNAL );
+	if (k > 0) {
+	    q += k;
+	    len -= k;
+	} else if (k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+	    struct pollfd pfd = { c->fd, POLLOUT, 0 };
+	    if (poll( &pfd, 1, 1000 ) <= 0) c->failed = 1;
+	} else if (k < 0 && errno == EINTR) {
+	    continue;
+	} else {
+	    c->failed = 1;
+	}
+    }
+}
+
+/*
+ * A worker is done with a request; record how long it took, and hand the
+ * connection back to the main thread
+ */
+static void finish( struct worker *w, struct conn *c, int op ) {
+    if (op < NUM_OPS) {
+	double us = elapsed_us( &c->start );
+	pthread_mutex_lock( &w->lock );
+	struct stats *s = &w->stats[op];
+	s->count++;
+	s->total_us += us;
+	if (us > s->max_us) s->max_us = us;
+	pthread_mutex_unlock( &w->lock );
+    }
+    free( c->message ); c->message = 0;
+    free( c->sig ); c->sig = 0;
+    while (write( done_pipe[1], &c, sizeof c ) < 0 && errno == EINTR)
+	;
+}
+
+static void send_metrics( struct conn *c ) {
+    static const char *names[ NUM_OPS ] = { "sign", "verify" };
+    char text[ 4096 ];
+    size_t len = 0;
+    for (unsigned i = 0; i < num_workers; i++) {
+	struct worker *w = &workers[i];
+	pthread_mutex_lock( &w->lock );
+	for (int op = 0; op < NUM_OPS; op++) {
+	    const struct stats *s = &w->stats[op];
+	    len += snprintf( text + len, sizeof text - len,
+		    "worker %u %s count %lu mean_us %.1f max_us %.1f\n",
+		    i, names[op], s->count,
+		    s->count ? s->total_us / s->count : 0.0, s->max_us );
+	    if (len >= sizeof text) len = sizeof text - 1;
+	}
+	len += snprintf( text + len, sizeof text - len,
+		"worker %u max_batch %lu\n", i, w->max_batch );
+	if (len >= sizeof text) len = sizeof text - 1;
+	pthread_mutex_unlock( &w->lock );
+    }
+    unsigned char header[5];
+    header[0] = STATUS_OK;
+    put_u32( header+1, len );
+    send_all( c, header, sizeof header );
+    send_all( c, text, len );
+}
+
+static void do_verify( struct worker *w, struct conn *c ) {
+    struct key *k = &keys[ c->key ];
+    struct ts_context ctx;
+    ts_init_verify_expanded( &ctx, c->message, c->len_message, &k->expanded );
+    ts_update_verify( c->sig, c->len_sig, &ctx );
+    unsigned char status = ts_verify( &ctx ) ? STATUS_OK : STATUS_INVALID;
+    send_all( c, &status, 1 );
+    finish( w, c, OP_VERIFY );
+}
+
+/*
+ * Try to start streaming a signature; returns 0 if we're out of contexts
+ */
+static int start_sign( struct worker *w, struct conn *c ) {
+    if (w->num_streams == MAX_STREAMS) return 0;
+    ts_pool_handle h = ts_pool_acquire( &w->pool );
+    if (h == TS_POOL_INVALID) return 0;
+
+    struct key *k = &keys[ c->key ];
+    const struct ts_parameter_set *ps = k->file.ps;
+    struct stream *s = &w->streams[ w->num_streams++ ];
+    s->c = c;
+    s->handle = h;
+    s->ctx = ts_init_sign_buffer( ts_pool_context( &w->pool, h ),
+		       w->pool.context_size, c->message, c->len_message,
+		       ps, k->file.private_key, random_function );
+    s->buffer[0] = STATUS_OK;
+    put_u32( s->buffer+1, ts_size_signature( ps ) );
+    s->len = 5;
+    s->offset = 0;
+    s->finished = 0;
+    return 1;
+}
+
+static void end_stream( struct worker *w, unsigned i ) {
+    struct stream *s = &w->streams[i];
+    ts_pool_release( &w->pool, s->handle );
+    finish( w, s->c, OP_SIGN );
+    w->streams[i] = w->streams[ --w->num_streams ];
+}
+
+/*
+ * The client can take more of signature stream i; send what we have
+ * buffered, and once that's gone, generate the next chunk.  Returns 1 if
+ * the stream is still going
+ */
+static int pump( struct worker *w, unsigned i ) {
+    struct stream *s = &w->streams[i];
+    for (;;) {
+	if (s->offset == s->len) {
+	    if (s->finished) return 0;
+	    s->len = ts_sign( s->buffer, CHUNK, s->ctx );
+	    s->offset = 0;
+	    if (s->len < CHUNK) s->finished = 1;
+	    if (s->len == 0) return 0;
+	}
+	ssize_t k = send( s->c->fd, s->buffer + s->offset,
+			  s->len - s->offset, MSG_NOSIGNAL );
+	if (k > 0) {
+	    s->offset += k;
+	} else if (k < 0 && errno == EINTR) {
+	    continue;
+	} else if (k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+	    return 1;    /* Wait for the client to drain it */
+	} else {
+	    s->c->failed = 1;
+	    return 0;
+	}
+    }
+}
+
+static void push( struct conn **head, struct conn **tail, struct conn *c ) {
+    c->next = 0;
+    if (*tail) (*tail)->next = c; else *head = c;
+    *tail = c;
+}
+
+static void *worker_thread( void *arg ) {
+    struct worker *w = arg;
+    struct pollfd *pfd = malloc( (MAX_STREAMS + 1) * sizeof *pfd );
+    if (!pfd) abort();
+
+    for (;;) {
+	pfd[0].fd = w->wake[0];
+	pfd[0].events = POLLIN;
+	for (unsigned i = 0; i < w->num_streams; i++) {
+	    pfd[i+1].fd = w->streams[i].c->fd;
+	    pfd[i+1].events = POLLOUT;
+	}
+	unsigned num_polled = w->num_streams;
+	if (poll( pfd, num_polled + 1, -1 ) < 0) {
+	    if (errno == EINTR) continue;
+	    break;
+	}
+
+	/* Send more of the signatures the clients have room for (going */
+	/* backwards, as end_stream moves the last stream into the hole) */
+	for (unsigned i = num_polled; i-- > 0; ) {
+	    if (pfd[i+1].revents && !pump( w, i )) {
+		end_stream( w, i );
+	    }
+	}
+
+	if (pfd[0].revents) {
+	    char poke[64];
+	    if (read( w->wake[0], poke, sizeof poke ) == 0) break;
+
+	    /* Take everything that's queued, in one go */
+	    pthread_mutex_lock( &w->lock );
+	    struct conn *batch = w->queue_head;
+	    w->queue_head = w->queue_tail = 0;
+	    unsigned long size = 0;
+	    for (struct conn *c = batch; c; c = c->next) size++;
+	    if (size > w->max_batch) w->max_batch = size;
+	    pthread_mutex_unlock( &w->lock );
+
+	    while (batch) {
+		struct conn *c = batch;
+		batch = c->next;
+		switch (c->op) {
+		case 'V': do_verify( w, c ); break;
+		case 'M': send_metrics( c ); finish( w, c, NUM_OPS ); break;
+		case 'S': push( &w->pending_head, &w->pending_tail, c ); break;
+		}
+	    }
+	}
+
+	/* Start the signatures we have contexts for */
+	while (w->pending_head && start_sign( w, w->pending_head )) {
+	    struct conn *c = w->pending_head;
+	    w->pending_head = c->next;
+	    if (!w->pending_head) w->pending_tail = 0;
+	    /* The client is waiting, so there's room for the first chunk */
+	    if (!pump( w, w->num_streams - 1 )) {
+		end_stream( w, w->num_streams - 1 );
+	    }
+	}
+    }
+    free( pfd );
+    return 0;
+}
+
+/*
+ * The main thread's side
+ */
+static void reject( struct conn *c ) {
+    unsigned char status = STATUS_BAD;
+    send_all( c, &status, 1 );
+    c->failed = 1;
+}
+
+/*
+ * We have a complete request; hand it off.  Returns 1 if we did (the
+ * worker owns c now, and we mustn't touch it until it comes back on
+ * done_pipe), 0 if we rejected it
+ */
+static int dispatch( struct conn *c ) {
+    if (c->key >= num_keys && c->op != 'M') {
+	reject( c );
+	return 0;
+    }
+    if (c->op == 'S' && !keys[ c->key ].file.have_private_key) {
+	reject( c );
+	return 0;
+    }
+    struct worker *w = &workers[ c->op == 'M' ? 0 : c->key % num_workers ];
+    c->state = busy;
+    clock_gettime( CLOCK_MONOTONIC, &c->start );
+    pthread_mutex_lock( &w->lock );
+    push( &w->queue_head, &w->queue_tail, c );
+    pthread_mutex_unlock( &w->lock );
+    while (write( w->wake[1], "", 1 ) < 0 && errno == EINTR)
+	;
+    return 1;
+}
+
+/*
+ * What read_request has done with a connection
+ */
+enum read_result {
+    read_close,         /* Close it */
+    read_more,          /* Keep reading from it */
+    read_handed_off,    /* A worker owns it now; don't touch it */
+};
+
+/*
+ * Read what we can of the request on c
+ */
+static enum read_result read_request( struct conn *c ) {
+    for (;;) {
+	unsigned char *dest;
+	size_t want;
+	switch (c->state) {
+	case reading_header:
+	    dest = c->header; want = 6; break;
+	case reading_message:
+	    dest = c->message; want = c->len_message; break;
+	case reading_sig_length:
+	    dest = c->header; want = 4; break;
+	case reading_sig:
+	    dest = c->sig; want = c->len_sig; break;
+	default:
+	    return read_more;
+	}
+	if (c->have < want) {
+	    ssize_t k = read( c->fd, dest + c->have, want - c->have );
+	    if (k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		return read_more;
+	    }
+	    if (k < 0 && errno == EINTR) continue;
+	    if (k <= 0) return read_close;   /* Closed (or broken) */
+	    c->have += k;
+	    if (c->have < want) continue;
+	}
+
+	/* We have the entire field */
+	c->have = 0;
+	switch (c->state) {
+	case reading_header:
+	    c->op = c->header[0];
+	    c->key = c->header[1];
+	    c->len_message = get_u32( c->header+2 );
+	    if ((c->op != 'S' && c->op != 'V' && c->op != 'M') ||
+		    c->len_message > MAX_MESSAGE) {
+		reject( c );
+		return read_close;
+	    }
+	    c->message = malloc( c->len_message ? c->len_message : 1 );
+	    if (!c->message) return read_close;
+	    c->state = reading_message;
+	    break;
+	case reading_message:
+	    if (c->op == 'V') {
+		c->state = reading_sig_length;
+	    } else {
+		return dispatch( c ) ? read_handed_off : read_close;
+	    }
+	    break;
+	case reading_sig_length:
+	    c->len_sig = get_u32( c->header );
+	    if (c->len_sig > MAX_MESSAGE) {
+		reject( c );
+		return read_close;
+	    }
+	    c->sig = malloc( c->len_sig ? c->len_sig : 1 );
+	    if (!c->sig) return read_close;
+	    c->state = reading_sig;
+	    break;
+	case reading_sig:
+	    return dispatch( c ) ? read_handed_off : read_close;
+	default:
+	    return read_more;
+	}
+    }
+}
+
+/* The connections we're reading from (busy ones aren't here) */
+static struct conn **conns;
+static struct pollfd *conn_pfd;   /* Three more than max_conns */
+static size_t num_conns, max_conns;
+
+static int add_conn( struct conn *c ) {
+    if (num_conns == max_conns) {
+	size_t new_max = max_conns ? 2*max_conns : 64;
+	struct conn **new_conns = realloc( conns, new_max * sizeof *conns );
+	if (!new_conns) return 0;
+	conns = new_conns;
+	struct pollfd *new_pfd = realloc( conn_pfd,
+				       (new_max + 3) * sizeof *conn_pfd );
+	if (!new_pfd) return 0;
+	conn_pfd = new_pfd;
+	max_conns = new_max;
+    }
+    c->state = reading_header;
+    c->have = 0;
+    conns[ num_conns++ ] = c;
+    return 1;
+}
+
+static void close_conn( struct conn *c ) {
+    close( c->fd );
+    free( c->message );
+    free( c->sig );
+    free( c );
+}
+
+static int start_workers( void ) {
+    size_t len_memory = contexts_per_worker * ts_pool_slot_size( 0 ) +
+			TS_POOL_ALIGN;
+    for (unsigned i = 0; i < num_workers; i++) {
+	struct worker *w = &workers[i];
+	if (0 != pipe( w->wake )) return 0;
+	fcntl( w->wake[0], F_SETFL, O_NONBLOCK );
+	pthread_mutex_init( &w->lock, 0 );
+	w->pool_memory = malloc( len_memory );
+	w->streams = malloc( MAX_STREAMS * sizeof *w->streams );
+	if (!w->pool_memory || !w->streams ||
+		0 == ts_pool_init( &w->pool, w->pool_memory, len_memory, 0 )) {
+	    return 0;
+	}
+	if (0 != pthread_create( &w->thread, 0, worker_thread, w )) return 0;
+	w->started = 1;
+    }
+    return 1;
+}
+
+/*
+ * Stop the workers (closing the wake pipe tells them to), and wipe the
+ * contexts they were signing with
+ */
+static void stop_workers( void ) {
+    size_t len_memory = contexts_per_worker * ts_pool_slot_size( 0 ) +
+			TS_POOL_ALIGN;
+    for (unsigned i = 0; i < num_workers; i++) {
+	struct worker *w = &workers[i];
+	if (!w->started) continue;
+	close( w->wake[1] );
+	pthread_join( w->thread, 0 );
+	zeroize( w->pool_memory, len_memory );
+	zeroize( w->streams, MAX_STREAMS * sizeof *w->streams );
+	w->started = 0;
+    }
+}
+
+static void usage( const char *program ) {
+    fprintf( stderr, "Usage: %s [-w workers] [-c contexts] [-r reseed] "
+		     "socket_path key_file...\n", program );
+    exit( EXIT_FAILURE );
+}
+
+int main( int argc, char **argv ) {
+    int opt;
+    while ((opt = getopt( argc, argv, "w:c:r:" )) != -1) {
+	switch (opt) {
+	case 'w': num_workers = atoi( optarg ); break;
+	case 'c': contexts_per_worker = atoi( optarg ); break;
+	case 'r': reseed_interval = strtoul( optarg, 0, 10 ); break;
+	default: usage( argv[0] );
+	}
+    }
+    if (num_workers < 1 || num_workers > MAX_WORKERS ||
+	    contexts_per_worker < 1 || contexts_per_worker > MAX_STREAMS) {
+	usage( argv[0] );
+    }
+    if (argc - optind < 2 || argc - optind - 1 > MAX_KEYS) usage( argv[0] );
+    const char *socket_path = argv[optind];
+
+    /* SIGINT and SIGTERM are for the main thread; block them before we */
+    /* start any threads (which inherit the mask), and unblock them here */
+    /* once the handler is in place */
+    sigset_t signals;
+    sigemptyset( &signals );
+    sigaddset( &signals, SIGINT );
+    sigaddset( &signals, SIGTERM );
+    pthread_sigmask( SIG_BLOCK, &signals, 0 );
+
+    ts_init_backends();
+    if (reseed_interval &&
+	    !ts_drbg_async_init( &drbg, entropy_function, reseed_interval,
+				 "tsphincsd", 9 )) {
+	fprintf( stderr, "Unable to seed the DRBG\n" );
+	return EXIT_FAILURE;
+    }
+    atexit( wipe_keys );
+    for (int i = optind + 1; i < argc; i++) {
+	struct key *k = &keys[ num_keys++ ];
+	if (!ts_read_key_file( &k->file, argv[i] )) return EXIT_FAILURE;
+	ts_expand_public_key( &k->expanded, k->file.ps, k->file.public_key );
+    }
+
+    struct sockaddr_un addr;
+    memset( &addr, 0, sizeof addr );
+    addr.sun_family = AF_UNIX;
+    if (strlen( socket_path ) >= sizeof addr.sun_path) {
+	fprintf( stderr, "%s: socket path too long\n", socket_path );
+	return EXIT_FAILURE;
+    }
+    strcpy( addr.sun_path, socket_path );
+    int listener = socket( AF_UNIX, SOCK_STREAM, 0 );
+    unlink( socket_path );
+    if (listener < 0 ||
+	    0 != bind( listener, (struct sockaddr *)&addr, sizeof addr ) ||
+	    0 != listen( listener, 128 )) {
+	perror( socket_path );
+	return EXIT_FAILURE;
+    }
+    fcntl( listener, F_SETFL, O_NONBLOCK );
+
+    signal( SIGPIPE, SIG_IGN );
+    if (0 != pipe( done_pipe ) || 0 != pipe( signal_pipe ) ||
+	    !start_workers()) {
+	fprintf( stderr, "Unable to start the workers\n" );
+	return EXIT_FAILURE;
+    }
+    fcntl( done_pipe[0], F_SETFL, O_NONBLOCK );
+    fcntl( signal_pipe[0], F_SETFL, O_NONBLOCK );
+    fcntl( signal_pipe[1], F_SETFL, O_NONBLOCK );
+
+    struct sigaction sa;
+    memset( &sa, 0, sizeof sa );
+    sa.sa_handler = on_signal;
+    sigaction( SIGINT, &sa, 0 );
+    sigaction( SIGTERM, &sa, 0 );
+    pthread_sigmask( SIG_UNBLOCK, &signals, 0 );
+
+    conn_pfd = malloc( 3 * sizeof *conn_pfd );
+    if (!conn_pfd) return EXIT_FAILURE;
+
+    while (!stop) {
+	struct pollfd *pfd = conn_pfd;
+	pfd[0].fd = listener;   pfd[0].events = POLLIN;
+	pfd[1].fd = done_pipe[0]; pfd[1].events = POLLIN;
+	pfd[2].fd = signal_pipe[0]; pfd[2].events = POLLIN;
+	for (size_t i = 0; i < num_conns; i++) {
+	    pfd[i+3].fd = conns[i]->fd;
+	    pfd[i+3].events = POLLIN;
+	}
+	size_t num_polled = num_conns;
+	if (poll( pfd, num_polled + 3, -1 ) < 0) {
+	    if (errno == EINTR) continue;
+	    break;
+	}
+	if (stop) break;
+
+	/* Read from the connections that have something (going backwards, */
+	/* as we move the last connection into any hole we make) */
+	for (size_t i = num_polled; i-- > 0; ) {
+	    if (!pfd[i+3].revents) continue;
+	    struct conn *c = conns[i];
+	    enum read_result result = read_request( c );
+	    if (result == read_more) continue;
+	    /* Either way, we're no longer reading from it (and if a */
+	    /* worker has it, it may already be done with it) */
+	    conns[i] = conns[ --num_conns ];
+	    if (result == read_close) close_conn( c );
+	}
+
+	/* Connections the workers are done with go back on our list */
+	if (pfd[1].revents) {
+	    struct conn *c;
+	    while (read( done_pipe[0], &c, sizeof c ) == sizeof c) {
+		if (c->failed || !add_conn( c )) {
+		    close_conn( c );
+		}
+	    }
+	}
+
+	/* And new connections */
+	if (pfd[0].revents) {
+	    for (;;) {
+		int fd = accept( listener, 0, 0 );
+		if (fd < 0) break;
+		struct conn *c = calloc( 1, sizeof *c );
+		if (!c) {
+		    close( fd );
+		    continue;
+		}
+		fcntl( fd, F_SETFL, O_NONBLOCK );
+		c->fd = fd;
+		if (!add_conn( c )) close_conn( c );
+	    }
+	}
+    }
+
+    unlink( socket_path );
+    stop_workers();
+    if (reseed_interval) ts_drbg_async_stop( &drbg );
+    return EXIT_SUCCESS;     /* (and wipe_keys runs on the way out) */
+}
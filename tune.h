@@ -61,9 +61,125 @@
  */
 #define TS_SHAKE256_OPT 0
 
+/*
+ * This allows you to build the package for exactly one parameter set.  If
+ * this is 0, the parameter set is selected at runtime (from any of the ones
+ * the above settings allow).  If this is set to one of the TS_PS_xxx values
+ * listed in tiny_sphincs.h (e.g. TS_PS_SHA2_128F_SIMPLE), then only that
+ * parameter set is available, and the parameters (n, k, t, etc) and hash
+ * functions are compile time constants, rather than being looked up in
+ * the ts_parameter_set structure.
+ * Benefit: somewhat faster (the compiler can fold the constants into the
+ *          inner loops, and call the hash functions directly), and a bit
+ *          less code
+ * Cost: you can't use any other parameter set (you'll get a link error if
+ *       you try)
+ * You still need to set the above settings so that they include the
+ * parameter set you select (and for minimal RAM usage, to include just
+ * that parameter set); we'll complain if you don't.
+ * This can also be set from the make command line (FIXED_PARM_SET=...)
+ */
+#if !defined( TS_FIXED_PARM_SET )
+#define TS_FIXED_PARM_SET 0
+#endif
+
+/*
+ * This selects whether we pick the hash implementation at runtime.  If
+ * set, the SHA-256, SHA-512 and Keccak compression functions are called
+ * through a table that ts_init_backends() fills in with the fastest
+ * implementation the CPU supports (currently, that means using the x86
+ * SHA extensions for SHA-256 if present).  If clear, we always use the
+ * portable C versions, and call them directly.
+ * Benefit: faster SHA-2 parameter sets on CPUs with SHA-NI, without
+ *          having to build separate binaries for different CPUs
+ * Cost: a bit more code, and a function pointer call per compression
+ * This makes no sense on a small embedded target; it's meant for hosts
+ * (and it uses pthread_once, so it needs POSIX threads).
+ *
+ * This, and the other host features below, are off by default; the host
+ * builds in the Makefile (test_sphincs, tsphincsd, tsphincs) turn them on
+ * from the command line (see HOST_DFLAGS there)
+ */
+#if !defined( TS_BACKEND_DISPATCH )
+#define TS_BACKEND_DISPATCH 0
+#endif
+
+/*
+ * This selects whether we compute independent hashes four at a time.  In
+ * several places, Sphincs+ needs a lot of hashes that don't depend on each
+ * other (e.g. the leaves of a FORS tree, or the chains of a WOTS public
+ * key); if this is set, we compute those in groups of four, using four
+ * lane versions of the SHA-256 compression function and the Keccak
+ * permutation (which use SIMD instructions, if the compiler and CPU have
+ * them).
+ * Benefit: faster signing (and key generation)
+ * Cost: more code, and more stack space (on the order of a kilobyte; see
+ *       TS_FORS_BATCH below)
+ * Like TS_BACKEND_DISPATCH, this is meant for hosts
+ */
+#if !defined( TS_MULTI_LANE )
+#define TS_MULTI_LANE 0
+#endif
+
+/*
+ * If TS_MULTI_LANE is set, this is the number of FORS leaves we generate
+ * in one batch (which must be a power of two, at least 4).  Larger batches
+ * keep the lanes busier further up the tree; they cost n bytes of stack
+ * per leaf
+ */
+#if !defined( TS_FORS_BATCH )
+#define TS_FORS_BATCH 16
+#endif
+
+/*
+ * This selects whether the signer can be given a node cache (see
+ * ts_set_node_cache), that is, a host side store of the public hypertree
+ * nodes, so that it needn't recompute the authentication paths
+ * Benefit: signing several times faster, once the cache is warm
+ * Cost: a pointer in the context, and a bit more code
+ */
+#if !defined( TS_NODE_CACHE )
+#define TS_NODE_CACHE 0
+#endif
+
+/*
+ * This selects whether the signer can be given a WOTS checkpoint cache
+ * (see wotscache.h), which holds every few values along the chains of the
+ * WOTS keys it has used in the upper hypertree layers.  Unlike the node
+ * cache, these values are secret, so the cache has to live in memory that
+ * is as well protected as the private key
+ * Benefit: WOTS signatures (and leaves) in the cached layers take a few
+ *          hashes per digit, rather than up to 15
+ * Cost: a pointer in the context, and a bit more code
+ */
+#if !defined( TS_WOTS_CACHE )
+#define TS_WOTS_CACHE 0
+#endif
+
+/*
+ * This selects whether parameter sets can be built at runtime (see
+ * ts_make_parameter_set), with whatever n, h, d, k and t you like (within
+ * what the above settings size the context for), and a Winternitz
+ * parameter w of 4, 16 or 256 (the standard parameter sets all have 16).
+ * This has no effect if TS_FIXED_PARM_SET is set
+ * Benefit: you can try out (or deploy) other trade-offs between signing
+ *          time and signature size, e.g. w = 4 signs about twice as
+ *          fast, but its WOTS signatures are twice the size
+ * Cost: up to 2n+2 more bytes in the context (w = 4 has 4n+5 WOTS digits
+ *       rather than 2n+3), and the WOTS chain lengths are no longer
+ *       compile time constants
+ */
+#if !defined( TS_CUSTOM_PARM_SET )
+#define TS_CUSTOM_PARM_SET 0
+#endif
+
 /* Sanity check */
 #if !TS_SUPPORT_SHAKE && !TS_SUPPORT_SHA2
 #error We need to support some hash function (either SHAKE or SHA2 or both)
 #endif
+#if TS_MULTI_LANE && \
+        (TS_FORS_BATCH < 4 || (TS_FORS_BATCH & (TS_FORS_BATCH - 1)) != 0)
+#error TS_FORS_BATCH must be a power of two, at least 4
+#endif
 
 #endif /* TUNE_H_ */
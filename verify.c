@@ -27,19 +27,183 @@ static int my_memcmp( const unsigned char *a, const unsigned char *b,
 /*
  * This starts the signature verification process
  */
-void ts_init_verify( struct ts_context *ctx,
+static void init_verify( struct ts_context *ctx,
                    const void *message, size_t len_message,
                    const struct ts_parameter_set *ps,
                    const unsigned char *public_key ) {
+    ts_init_backends();
+
     ctx->ps = ps;
     ctx->public_key = public_key;
     ctx->state = ts_verify_init;  /* We're waiting for the R in the sig */
     ctx->buffer_offset = 0;
-    ctx->x.verify.message = message;
-    ctx->x.verify.len_message = len_message;
+#if TS_MULTI_LANE
+    ctx->wots_buffer = 0;
+#endif
+    TS_X(ctx)->verify.message = message;
+    TS_X(ctx)->verify.len_message = len_message;
+}
+
+void ts_init_verify( struct ts_context *ctx,
+                   const void *message, size_t len_message,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key ) {
+    init_verify( ctx, message, len_message, ps, public_key );
 
 #if TS_SHA2_OPTIMIZATION
-    if (ps->compute_prehash) ps->compute_prehash( ctx );
+    PS_COMPUTE_PREHASH( ps, ctx );
+#endif
+}
+
+/*
+ * This does the per-public key work that ts_init_verify would do (that
+ * is, the SHA-2 prehash of the public seed) once, and saves the result
+ * (along with a copy of the public key) in the expanded key
+ * For SHAKE parameter sets, there's nothing to precompute (the public
+ * seed and the ADR structure fit within the first Keccak block), so this
+ * is just the copy
+ */
+void ts_expand_public_key( struct ts_expanded_key *key,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key ) {
+    unsigned n = PS_N(ps);
+    memset( key, 0, sizeof *key );
+    key->ps = ps;
+    memcpy( key->public_key, public_key, 2*n );
+
+#if TS_SUPPORT_SHA2 && TS_SHA2_OPTIMIZATION
+    if (PS_SHA2(ps)) {
+	struct ts_context ctx;
+	ctx.ps = ps;
+	ctx.public_key = key->public_key;
+	PS_COMPUTE_PREHASH( ps, &ctx );
+        memcpy( key->prehash_sha256, ctx.prehash_sha256,
+		sizeof key->prehash_sha256 );
+#if TS_SUPPORT_L5 || TS_SUPPORT_L3
+	if (PS_N(ps) > 16) {
+            memcpy( key->prehash_sha512, ctx.prehash_sha512,
+		    sizeof key->prehash_sha512 );
+	}
+#endif
+    }
+#endif
+}
+
+/*
+ * This is ts_init_verify, using an expanded public key (so we needn't
+ * recompute the prehash).  The expanded key needs to remain valid during
+ * the entire verification process
+ */
+void ts_init_verify_expanded( struct ts_context *ctx,
+                   const void *message, size_t len_message,
+                   const struct ts_expanded_key *key ) {
+    init_verify( ctx, message, len_message, key->ps, key->public_key );
+
+#if TS_SUPPORT_SHA2 && TS_SHA2_OPTIMIZATION
+    if (PS_SHA2(key->ps)) {
+        memcpy( ctx->prehash_sha256, key->prehash_sha256,
+		sizeof ctx->prehash_sha256 );
+#if TS_SUPPORT_L5 || TS_SUPPORT_L3
+	if (PS_N(key->ps) > 16) {
+            memcpy( ctx->prehash_sha512, key->prehash_sha512,
+		    sizeof ctx->prehash_sha512 );
+	}
+#endif
+    }
+#endif
+}
+
+/*
+ * This is ts_init_verify, using a caller provided buffer (which may be
+ * smaller than a full ts_context) as the context
+ */
+struct ts_context *ts_init_verify_buffer( void *buffer, size_t len_buffer,
+                   const void *message, size_t len_message,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key ) {
+    struct ts_context *ctx = ts_context_from_buffer( buffer, len_buffer, ps );
+    if (ctx) {
+	ts_init_verify( ctx, message, len_message, ps, public_key );
+    }
+    return ctx;
+}
+
+/*
+ * Have the verifier collect entire WOTS signatures into the caller's
+ * buffer (so that it can complete the chains in parallel lanes)
+ */
+int ts_set_wots_buffer( struct ts_context *ctx,
+                   unsigned char *buffer, size_t len_buffer ) {
+#if TS_MULTI_LANE
+    if (ctx->state != ts_verify_init || ctx->buffer_offset != 0) return 0;
+    if (buffer && len_buffer < ts_wots_buffer_size( ctx->ps )) return 0;
+    ctx->wots_buffer = buffer;
+    return 1;
+#else
+    (void)ctx; (void)buffer; (void)len_buffer;
+    return 0;
+#endif
+}
+
+/*
+ * Step the chains first .. first+count-1 of a WOTS signature (chain i is
+ * at wots + i*n) up to the top, in place.  The digits and the leaf are
+ * the ones ts_set_up_wots_signature placed into the context.
+ * With TS_MULTI_LANE, the chains need differing numbers of steps; we keep
+ * TS_LANES of them in flight, and whenever one reaches the top, we replace
+ * it with the next chain that still needs work
+ */
+void ts_wots_chains_to_top( unsigned char *wots, unsigned first,
+		            unsigned count, struct ts_context *ctx ) {
+    unsigned n = PS_N(ctx->ps);
+    unsigned max = PS_WOTS_MAX(ctx->ps);
+    const unsigned char *digits = TS_X(ctx)->wots.digits;
+#if TS_MULTI_LANE
+    unsigned chain[TS_LANES], step[TS_LANES];
+    unsigned char adr[TS_LANES][ADR_SIZE];
+    unsigned char *out[TS_LANES];
+    const unsigned char *in[TS_LANES];
+    unsigned active = 0, next = first, end = first + count;
+
+    for (;;) {
+	/* Fill the idle lanes */
+	while (active < TS_LANES && next < end) {
+	    if (digits[next] < max) {
+		chain[active] = next;
+		step[active] = digits[next];
+		active++;
+	    }
+	    next++;
+	}
+	if (active == 0) break;  /* Everything is at the top */
+
+	for (unsigned j = 0; j < active; j++) {
+	    ts_set_wots_f_adr(ctx, ctx->auth_path_node, chain[j], step[j]);
+	    memcpy( adr[j], ctx->adr, ADR_SIZE );
+	    out[j] = &wots[chain[j] * n];
+	    in[j] = out[j];
+	}
+	ts_t_lanes( out, in, 1, &adr[0][0], active, ctx );
+
+	/* Retire the chains that just reached the top (moving the last */
+	/* active chain into the freed lane) */
+	for (unsigned j = 0; j < active; ) {
+	    if (++step[j] == max) {
+		active--;
+		chain[j] = chain[active];
+		step[j] = step[active];
+	    } else {
+		j++;
+	    }
+	}
+    }
+#else
+    for (unsigned c = first; c < first + count; c++) {
+        for (unsigned i=digits[c]; i<max; i++) {
+            ts_set_wots_f_adr(ctx, ctx->auth_path_node, c, i);
+            PS_F(ctx->ps)( &wots[c * n], &wots[c * n], ctx );
+        }
+    }
 #endif
 }
 
@@ -60,20 +224,36 @@ static void next_auth_path( struct ts_context *ctx,
     ctx->merkle_level += 1; /* When we're done, we're on to the next level */
                             /* on the next iteration */
     ts_set_merkle_adr(ctx, ctx->auth_path_node, h, typecode);
-    union t_iterator *t = &ctx->small_iter;
-    ctx->ps->init_t( t, ctx );
+    union t_iterator *t = TS_SMALL_ITER(ctx);
+    PS_INIT_T(ctx->ps)( t, ctx );
     if ((ctx->auth_path_node & size_h) != 0) {
 	/* We're at a right-hand node; buffer lies on the left */
- 	ctx->ps->next_t( t, ctx->buffer, ctx );
-	ctx->ps->next_t( t, ctx->auth_path_buffer, ctx );
+ 	PS_NEXT_T(ctx->ps)( t, ctx->buffer, ctx );
+	PS_NEXT_T(ctx->ps)( t, ctx->auth_path_buffer, ctx );
     } else { 
 	/* We're at a left-hand node; buffer lies on the right */
-	ctx->ps->next_t( t, ctx->auth_path_buffer, ctx );
-	ctx->ps->next_t( t, ctx->buffer, ctx );
+	PS_NEXT_T(ctx->ps)( t, ctx->auth_path_buffer, ctx );
+	PS_NEXT_T(ctx->ps)( t, ctx->buffer, ctx );
     }
 	/* Place the result back into auth_path_buffer, which is where */
 	/* the next function will expect it */
-    ctx->ps->final_t( ctx->auth_path_buffer, t, ctx );
+    PS_FINAL_T(ctx->ps)( ctx->auth_path_buffer, t, ctx );
+}
+
+/*
+ * Climb an entire authentication path of height nodes, which lie one
+ * after another at path (as they do within a signature).  As with
+ * next_auth_path, ctx->auth_path_node is where we start, and
+ * auth_path_buffer holds the node there (and, when we're done, the root)
+ */
+void ts_climb_auth_path( const unsigned char *path, unsigned height,
+	                 enum hash_reason typecode, struct ts_context *ctx ) {
+    unsigned n = PS_N(ctx->ps);
+    ctx->merkle_level = 0;
+    for (unsigned i = 0; i < height; i++) {
+	memcpy( ctx->buffer, path + i*n, n );
+	next_auth_path( ctx, typecode );
+    }
 }
 
 /*
@@ -88,11 +268,34 @@ static void set_up_wots_verify_signature(struct ts_context *ctx, unsigned next_l
 
     /* ... and we start hashing the WOTS heads together */
     ts_set_wots_header_adr( next_leaf, ctx );
-    ctx->ps->init_t( &ctx->big_iter, ctx );
+    PS_INIT_T(ctx->ps)( &ctx->big_iter, ctx );
 
     ctx->merkle_level = 0;
 }
 
+/*
+ * We have H_msg of the message (MAX_MESSAGE_HASH bytes); set things up to
+ * read in the FORS trees.  Normally, ts_update_verify does this as soon as
+ * it has R; verify_async.c calls this once its thread has the hash.
+ * message_hash may be TS_X(ctx)->fors.stack
+ */
+void ts_verify_start_fors( struct ts_context *ctx,
+			   unsigned char *message_hash ) {
+    /* Convert the hash into fors_tree leaves and position */
+    /* within the hypertree */
+    ts_convert_message_hash_to_hypertree_position( ctx, message_hash );
+    /* And after that, we'll start inputing the FORS trees */
+    ctx->state = ts_verify_fors_leaf;
+    ctx->fors_tree = 0;
+    ctx->merkle_level = 0;
+    ctx->hypertree_level = 0;
+
+    /* And initialize the iterator that'll hash the FORS roots */
+    /* together */
+    ts_set_fors_root_adr(ctx);
+    PS_INIT_T(ctx->ps)( &ctx->big_iter, ctx );
+}
+
 /*
  * This processes the next M bytes of the signature to verify
  * If this notices a fatal error midway, this returns 0 - in that
@@ -108,7 +311,7 @@ int ts_update_verify( const unsigned char *sig, unsigned m,
 	return 0;
     }
 
-    unsigned n = ctx->ps->n;
+    unsigned n = PS_N(ctx->ps);
     for (;;) {
 	unsigned buffer_offset = ctx->buffer_offset;
 	unsigned remain = n - buffer_offset;
@@ -130,45 +333,32 @@ int ts_update_verify( const unsigned char *sig, unsigned m,
 	    /* buffer has the 'R' value; use it to hash the message */
 	    /* We reuse the fors stack space to hold the expanded */
 	    /* hashed message.  The stack space is larger than we need */
-            ctx->ps->hash_msg( ctx->x.fors.stack, MAX_MESSAGE_HASH,
+            PS_HASH_MSG(ctx->ps)( TS_X(ctx)->fors.stack, MAX_MESSAGE_HASH,
 			  ctx->buffer,
-	        	  ctx->x.verify.message, ctx->x.verify.len_message,
+	        	  TS_X(ctx)->verify.message, TS_X(ctx)->verify.len_message,
 			  ctx );
-            /* Convert the hash into fors_tree leaves and position */
-            /* within the hypertree */
-            ts_convert_message_hash_to_hypertree_position( ctx,
-			                                ctx->x.fors.stack );
-            /* And after that, we'll start inputing the FORS trees */
-            ctx->state = ts_verify_fors_leaf;
-            ctx->fors_tree = 0;
-            ctx->merkle_level = 0;
-            ctx->hypertree_level = 0;
-
-            /* And initialize the iterator that'll hash the FORS roots */
-	    /* together */
-            ts_set_fors_root_adr(ctx);
-            ctx->ps->init_t( &ctx->big_iter, ctx );
+	    ts_verify_start_fors( ctx, TS_X(ctx)->fors.stack );
 	    break;
 	case ts_verify_fors_leaf:     /* We have a FORS leaf */
-	    ctx->auth_path_node = ctx->x.fors.fors_node[ctx->fors_tree];
+	    ctx->auth_path_node = TS_X(ctx)->fors.fors_node[ctx->fors_tree];
             ctx->merkle_level = 0;
             ts_set_fors_leaf_adr(ctx, ctx->auth_path_node );
-            (ctx->ps->f)( ctx->auth_path_buffer, ctx->buffer, ctx );
+            PS_F(ctx->ps)( ctx->auth_path_buffer, ctx->buffer, ctx );
 	    ctx->state = ts_verify_fors;
 	    break;
 	case ts_verify_fors:        /* We have the next hash in a */
 	                            /* FORS authentication path */
 	    next_auth_path( ctx, ADR_TYPE_FORSTREE );
-	    if (ctx->merkle_level == ctx->ps->t) {
+	    if (ctx->merkle_level == PS_T(ctx->ps)) {
 		 /* We hit the top of the FORS tree */
 		
                  /* Add the FORS tree root to the running hash */
-                 ctx->ps->next_t( &ctx->big_iter, ctx->auth_path_buffer, ctx );
+                 PS_NEXT_T(ctx->ps)( &ctx->big_iter, ctx->auth_path_buffer, ctx );
 		 ctx->state = ts_verify_fors_leaf;
                  ctx->fors_tree++;
-		 if (ctx->fors_tree == ctx->ps->k) {
+		 if (ctx->fors_tree == PS_K(ctx->ps)) {
 	             /* We got all the FORS root; get the final hash */
-                     ctx->ps->final_t( ctx->auth_path_buffer, &ctx->big_iter, ctx );
+                     PS_FINAL_T(ctx->ps)( ctx->auth_path_buffer, &ctx->big_iter, ctx );
 		     ctx->fors_tree = 0;
 		     set_up_wots_verify_signature(ctx, ctx->fors_keypair_addr);
 		     break;
@@ -179,37 +369,56 @@ int ts_update_verify( const unsigned char *sig, unsigned m,
 	    /*
              * buffer contains the next digit in a WOTS signature
 	     */
-            int digit = ctx->x.wots.digit++;
+            int digit = TS_X(ctx)->wots.digit++;
+
+#if TS_MULTI_LANE
+	    if (ctx->wots_buffer) {
+		/* Just collect the digit; when we have them all, do the */
+		/* chains in lanes */
+		memcpy( &ctx->wots_buffer[digit * n], ctx->buffer, n );
+		if (digit + 1 != PS_WOTS_LEN(ctx->ps)) break;
+		ts_wots_chains_to_top( ctx->wots_buffer, 0, digit + 1, ctx );
+		for (int i = 0; i <= digit; i++) {
+		    PS_NEXT_T(ctx->ps)(&ctx->big_iter,
+				       &ctx->wots_buffer[i * n], ctx );
+		}
+                PS_FINAL_T(ctx->ps)(ctx->auth_path_buffer, &ctx->big_iter,
+				    ctx );
+	        ctx->state = ts_verify_merkle;
+		break;
+	    }
+#endif
 
 	    /* Step that digit up to the tops of the Winternitz chain */
-            for (int i=ctx->x.wots.digits[digit]; i<15; i++) {
+            for (unsigned i=TS_X(ctx)->wots.digits[digit];
+		 i<PS_WOTS_MAX(ctx->ps); i++) {
                 ts_set_wots_f_adr(ctx, ctx->auth_path_node, digit, i);
-                (ctx->ps->f)( ctx->buffer, ctx->buffer, ctx );
+                PS_F(ctx->ps)( ctx->buffer, ctx->buffer, ctx );
             }
 	    /* And add that digit into the running hash */
-            ctx->ps->next_t(&ctx->big_iter, ctx->buffer, ctx );
+            PS_NEXT_T(ctx->ps)(&ctx->big_iter, ctx->buffer, ctx );
     
-	    int d = ctx->x.wots.digit;
-	    if (d != 2*ctx->ps->n + 3) break;
+	    int d = TS_X(ctx)->wots.digit;
+	    if (d != PS_WOTS_LEN(ctx->ps)) break;
 
 	    /* We've generated all the WOTS digits; finish the running hash */
 	    /* and that's the leaf node; go on to the Merkle authentication path */
-            ctx->ps->final_t(ctx->auth_path_buffer, &ctx->big_iter, ctx );
+            PS_FINAL_T(ctx->ps)(ctx->auth_path_buffer, &ctx->big_iter, ctx );
 	    ctx->state = ts_verify_merkle;
 	    break;
 	    }
 	case ts_verify_merkle:
 	    /* buffer contains the next value from the authentication path */
 	    next_auth_path( ctx, ADR_TYPE_HASHTREE );
-	    if (ctx->merkle_level != ctx->ps->merkle_h) break;
+	    if (ctx->merkle_level != PS_MERKLE_H(ctx->ps)) break;
 
 	    /* We're at the top of the Merkle tree */
 	    ctx->hypertree_level++;
-	    if (ctx->hypertree_level < ctx->ps->d) {
+	    if (ctx->hypertree_level < PS_D(ctx->ps)) {
                 /* Step to the next Merkle tree level */
 		unsigned next_leaf = ctx->tree_address &
-			                      ((1 << ctx->ps->merkle_h)-1);
-		ctx->tree_address >>= ctx->ps->merkle_h;
+			                      ((1 << PS_MERKLE_H(ctx->ps))-1);
+		ctx->tree_address >>= PS_MERKLE_H(ctx->ps);
 		set_up_wots_verify_signature(ctx, next_leaf);
 	    } else {
                 /* We're at the top of the hypertree - did it work? */
@@ -0,0 +1,129 @@
+/*
+ * Streaming verification with H_msg in the background; see verify_async.h
+ *
+ * We collect R ourselves (rather than letting ts_update_verify see it, as
+ * it would hash the message then and there), start a thread that does the
+ * hash on a copy of the context, and stage what arrives after R.  Once
+ * the thread is done, ts_verify_start_fors puts the context into the
+ * state ts_update_verify would have, and we feed it the staged bytes
+ */
+#include <string.h>
+#include "verify_async.h"
+#include "internal.h"
+
+static void *hash_thread( void *arg ) {
+    struct ts_verify_async *av = arg;
+    struct ts_context *ctx = &av->hash_ctx;
+    PS_HASH_MSG(ctx->ps)( av->digest, MAX_MESSAGE_HASH, av->r,
+	       TS_X(ctx)->verify.message, TS_X(ctx)->verify.len_message,
+	       ctx );
+
+    pthread_mutex_lock( &av->lock );
+    av->hash_done = 1;
+    pthread_cond_broadcast( &av->cond );
+    pthread_mutex_unlock( &av->lock );
+    return 0;
+}
+
+void ts_init_verify_async( struct ts_verify_async *av,
+                   const void *message, size_t len_message,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key,
+		   unsigned char *staging, size_t len_staging ) {
+    ts_init_verify( &av->ctx, message, len_message, ps, public_key );
+    av->len_r = 0;
+    av->staging = staging;
+    av->len_staging = staging ? len_staging : 0;
+    av->staged = 0;
+    av->phase = ts_async_need_r;
+    av->hash_done = 0;
+    av->have_thread = 0;
+    pthread_mutex_init( &av->lock, 0 );
+    pthread_cond_init( &av->cond, 0 );
+}
+
+/* We have R; start hashing the message */
+static void start_hash( struct ts_verify_async *av ) {
+    av->hash_ctx = av->ctx;
+    av->phase = ts_async_hashing;
+    av->have_thread = (0 == pthread_create( &av->thread, 0,
+					    hash_thread, av ));
+    if (!av->have_thread) {
+	hash_thread( av );     /* Couldn't; do it ourselves */
+    }
+}
+
+static void wait_for_hash( struct ts_verify_async *av ) {
+    pthread_mutex_lock( &av->lock );
+    while (!av->hash_done) {
+	pthread_cond_wait( &av->cond, &av->lock );
+    }
+    pthread_mutex_unlock( &av->lock );
+}
+
+/* The hash is done; hand it, and what we've staged, to the verifier */
+static int finish_hash( struct ts_verify_async *av ) {
+    if (av->have_thread) {
+	pthread_join( av->thread, 0 );
+	av->have_thread = 0;
+    }
+    av->phase = ts_async_running;
+    ts_verify_start_fors( &av->ctx, av->digest );
+    int ok = av->staged == 0 ? 1 :
+	     ts_update_verify( av->staging, av->staged, &av->ctx );
+    av->staged = 0;
+    return ok;
+}
+
+int ts_update_verify_async( const unsigned char *sig, unsigned m,
+		   struct ts_verify_async *av ) {
+    if (av->phase == ts_async_need_r) {
+	if (av->ctx.state != ts_verify_init) {
+	    /* Not a context we can do anything with */
+	    return ts_update_verify( sig, m, &av->ctx );
+	}
+	unsigned n = PS_N(av->ctx.ps);
+	unsigned take = n - av->len_r;
+	if (take > m) take = m;
+	memcpy( &av->r[av->len_r], sig, take );
+	av->len_r += take;
+	sig += take;
+	m -= take;
+	if (av->len_r < n) return 1;
+	start_hash( av );
+    }
+
+    if (av->phase == ts_async_hashing) {
+	pthread_mutex_lock( &av->lock );
+	int done = av->hash_done;
+	pthread_mutex_unlock( &av->lock );
+	if (!done) {
+	    /* Stage what we can; if that's everything, we're done for */
+	    /* now */
+	    size_t room = av->len_staging - av->staged;
+	    if (room > m) room = m;
+	    if (room > 0) memcpy( &av->staging[av->staged], sig, room );
+	    av->staged += room;
+	    sig += room;
+	    m -= room;
+	    if (m == 0) return 1;
+
+	    /* Otherwise, we have no choice but to wait */
+	    wait_for_hash( av );
+	}
+	if (!finish_hash( av )) return 0;
+    }
+
+    return ts_update_verify( sig, m, &av->ctx );
+}
+
+int ts_verify_async( struct ts_verify_async *av ) {
+    if (av->phase == ts_async_hashing) {
+	wait_for_hash( av );
+	finish_hash( av );
+    }
+    int ok = ts_verify( &av->ctx );
+    pthread_mutex_destroy( &av->lock );
+    pthread_cond_destroy( &av->cond );
+    return ok;
+}
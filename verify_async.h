@@ -0,0 +1,76 @@
+#if !defined( VERIFY_ASYNC_H_ )
+#define VERIFY_ASYNC_H_
+
+/*
+ * Streaming verification, with H_msg done in the background.
+ *
+ * ts_update_verify hashes the message (H_msg) as soon as it has R, the
+ * first n bytes of the signature; for a large message, the call that
+ * completes R doesn't return until that's done, and so (if the signature
+ * is arriving over the network) we're not reading anything while we hash.
+ * This does that hash in its own thread, and holds the signature bytes
+ * that arrive meanwhile in a staging buffer; once the hash is ready, they
+ * are handed to the verifier.  If the staging buffer fills up before the
+ * hash is done, the update call waits for it.
+ *
+ * As with verify_mt.h, this uses POSIX threads, and so is host only
+ */
+
+#include <stddef.h>
+#include <pthread.h>
+#include "tiny_sphincs.h"
+
+struct ts_verify_async {
+    /* The verifier proper; you may call ts_set_wots_buffer on it */
+    /* (before the first ts_update_verify_async) */
+    struct ts_context ctx;
+
+    /* The rest is private */
+    struct ts_context hash_ctx;     /* What the hashing thread uses */
+    unsigned char r[TS_MAX_HASH];   /* The randomizer, as it arrives */
+    unsigned char digest[64];       /* The output of H_msg (at least */
+                                    /* MAX_MESSAGE_HASH bytes) */
+    unsigned len_r;
+    unsigned char *staging;         /* The bytes that arrive while we're */
+    size_t len_staging, staged;     /* hashing */
+    enum {
+	ts_async_need_r,            /* Still waiting for R */
+	ts_async_hashing,           /* The thread is hashing */
+	ts_async_running,           /* The hash has been handed over */
+    } phase;
+    int hash_done;                  /* Set by the thread */
+    int have_thread;                /* Clear if we had to hash in the */
+                                    /* caller's thread instead */
+    pthread_t thread;
+    pthread_mutex_t lock;           /* Protects hash_done */
+    pthread_cond_t cond;
+};
+
+/*
+ * This is ts_init_verify; staging (len_staging bytes) is where we hold
+ * signature bytes while the message is being hashed.  The FORS part of
+ * the signature is a good size (anything larger won't be used for a
+ * while; ts_size_signature(ps) is an upper bound); 0 bytes is allowed
+ * (the update call will just wait for the hash)
+ */
+void ts_init_verify_async( struct ts_verify_async *av,
+                   const void *message, size_t len_message,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key,
+		   unsigned char *staging, size_t len_staging );
+
+/*
+ * This is ts_update_verify.  It doesn't wait for the hash unless the
+ * staging buffer is full
+ */
+int ts_update_verify_async( const unsigned char *sig, unsigned m,
+		   struct ts_verify_async *av );
+
+/*
+ * This is ts_verify; it returns 1 if the signature verified.  This must
+ * be called (even if you've given up on the signature), as it's what
+ * cleans up the hashing thread
+ */
+int ts_verify_async( struct ts_verify_async *av );
+
+#endif /* VERIFY_ASYNC_H_ */
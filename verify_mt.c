@@ -0,0 +1,307 @@
+/*
+ * Multithreaded one-shot verification; see verify_mt.h
+ *
+ * Since the entire signature is in memory, we know where each piece of it
+ * is (from the layout that ts_size_signature describes), and so we needn't
+ * go through it in order.  After hashing the message (which we do exactly
+ * the way the streaming verifier does), the FORS trees don't depend on
+ * each other, so the threads pick them off one at a time.  The hypertree
+ * layers do depend on each other (the WOTS digits of a layer come from the
+ * root of the layer below); within a layer, the threads share out the WOTS
+ * chains, and then we climb the (short) Merkle authentication path
+ */
+#include <string.h>
+#include <pthread.h>
+#include "verify_mt.h"
+#include "pathcache.h"
+#include "internal.h"
+
+#define MAX_THREADS     64
+#define CHAINS_PER_ITEM  8     /* How many WOTS chains a thread takes at */
+                               /* a time */
+#define MAX_LAYERS      64     /* The most hypertree layers we'll use the */
+                               /* path cache with */
+
+enum verify_phase {
+    phase_fors,                /* Each item is a FORS tree */
+    phase_wots,                /* Each item is a few WOTS chains */
+};
+
+struct verify_job {
+    struct ts_context ctx;      /* The state at the start of the phase */
+    enum verify_phase phase;
+    const unsigned char *sig;   /* The part of the signature this phase */
+                                /* works on */
+    unsigned char *nodes;       /* Where the FORS roots/WOTS chains go */
+    unsigned num_items;
+    unsigned next_item;         /* The next one no one has started on */
+    unsigned items_done;
+    unsigned generation;        /* Bumped each time we start a phase */
+    int quit;
+    pthread_mutex_t lock;       /* Protects everything above */
+    pthread_cond_t start;       /* Signalled when a phase starts (or when */
+                                /* we're done) */
+    pthread_cond_t done;        /* Signalled when the last item is done */
+};
+
+static void do_item( struct verify_job *job, struct ts_context *ctx,
+	             unsigned i ) {
+    const struct ts_parameter_set *ps = ctx->ps;
+    unsigned n = PS_N(ps);
+
+    if (job->phase == phase_fors) {
+	/* Compute the root of FORS tree i from its leaf and auth path */
+	unsigned t = PS_T(ps);
+	const unsigned char *tree = job->sig + i * (t+1) * n;
+	ctx->fors_tree = i;
+	ctx->auth_path_node = TS_X(ctx)->fors.fors_node[i];
+	ts_set_fors_leaf_adr( ctx, ctx->auth_path_node );
+	PS_F(ps)( ctx->auth_path_buffer, tree, ctx );
+	ts_climb_auth_path( tree + n, t, ADR_TYPE_FORSTREE, ctx );
+	memcpy( &job->nodes[i*n], ctx->auth_path_buffer, n );
+    } else {
+	/* Step a few of the chains up to the top */
+	unsigned first = i * CHAINS_PER_ITEM;
+	unsigned count = PS_WOTS_LEN(ps) - first;
+	if (count > CHAINS_PER_ITEM) count = CHAINS_PER_ITEM;
+	ts_wots_chains_to_top( job->nodes, first, count, ctx );
+    }
+}
+
+/*
+ * Work on the items of the current phase until there are none left.
+ * This is called (and returns) with the lock held
+ */
+static void work( struct verify_job *job ) {
+    struct ts_context ctx;  /* Our own copy; the hash functions write */
+                            /* into the context */
+    int have_ctx = 0;
+
+    while (job->next_item < job->num_items) {
+	unsigned i = job->next_item++;
+	pthread_mutex_unlock( &job->lock );
+
+	/* job->ctx won't change until our item is done */
+	if (!have_ctx) {
+	    ctx = job->ctx;
+	    have_ctx = 1;
+	}
+	do_item( job, &ctx, i );
+
+	pthread_mutex_lock( &job->lock );
+	if (++job->items_done == job->num_items) {
+	    pthread_cond_signal( &job->done );
+	}
+    }
+}
+
+static void *verify_worker( void *arg ) {
+    struct verify_job *job = arg;
+    unsigned seen = 0;
+
+    pthread_mutex_lock( &job->lock );
+    for (;;) {
+	while (!job->quit && job->generation == seen) {
+	    pthread_cond_wait( &job->start, &job->lock );
+	}
+	if (job->quit) break;
+	seen = job->generation;
+	work( job );
+    }
+    pthread_mutex_unlock( &job->lock );
+    return 0;
+}
+
+/* Hand out num_items items (and work on them ourselves) */
+static void run_phase( struct verify_job *job, enum verify_phase phase,
+	               const unsigned char *sig, unsigned num_items ) {
+    pthread_mutex_lock( &job->lock );
+    job->phase = phase;
+    job->sig = sig;
+    job->num_items = num_items;
+    job->next_item = 0;
+    job->items_done = 0;
+    job->generation++;
+    pthread_cond_broadcast( &job->start );
+    work( job );
+    while (job->items_done < job->num_items) {
+	pthread_cond_wait( &job->done, &job->lock );
+    }
+    pthread_mutex_unlock( &job->lock );
+}
+
+/*
+ * Compute the digests the path cache uses: the digest for layer L covers
+ * the signature from the start of layer L to the end.  We chain them (the
+ * digest for layer L is the hash of layer L's part of the signature,
+ * followed by the digest for layer L+1), so that this is one pass over
+ * the signature
+ */
+static void path_digests( unsigned char digests[][TS_PATH_DIGEST_SIZE],
+	                  const unsigned char *hypertree,
+			  const struct ts_parameter_set *ps ) {
+    unsigned n = PS_N(ps);
+    size_t len_layer = (PS_WOTS_LEN(ps) + PS_MERKLE_H(ps)) * n;
+    for (unsigned layer = PS_D(ps); layer-- > 1; ) {
+	SHA256_CTX sha;
+	ts_SHA256_init( &sha );
+	ts_SHA256_update( &sha, hypertree + layer * len_layer, len_layer );
+	if (layer + 1 < PS_D(ps)) {
+	    ts_SHA256_update( &sha, digests[layer+1], TS_PATH_DIGEST_SIZE );
+	}
+	ts_SHA256_final( digests[layer], &sha );
+    }
+}
+
+int ts_verify_oneshot( const void *message, size_t len_message,
+		const unsigned char *signature, size_t len_signature,
+		const unsigned char *public_key,
+		const struct ts_parameter_set *ps,
+		unsigned num_threads ) {
+    return ts_verify_oneshot_cached( message, len_message,
+		signature, len_signature, public_key, ps, num_threads, 0 );
+}
+
+int ts_verify_oneshot_cached( const void *message, size_t len_message,
+		const unsigned char *signature, size_t len_signature,
+		const unsigned char *public_key,
+		const struct ts_parameter_set *ps,
+		unsigned num_threads,
+		struct ts_path_cache *cache ) {
+    if (!signature || !public_key || !ps) {
+	return 0;
+    }
+    /* The streaming verifier rejects anything too short or too long */
+    if (len_signature != ts_size_signature( ps )) {
+	return 0;
+    }
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS;
+    unsigned n = PS_N(ps);
+    unsigned num_digits = PS_WOTS_LEN(ps);
+    unsigned merkle_h = PS_MERKLE_H(ps);
+
+    struct verify_job job;
+    struct ts_context *ctx = &job.ctx;
+
+    /* Hand R to the streaming verifier; that hashes the message and */
+    /* works out which FORS leaves and hypertree path the signature uses */
+    /* (this also calls ts_init_backends from this thread) */
+    ts_init_verify( ctx, message, len_message, ps, public_key );
+    if (!ts_update_verify( signature, n, ctx )) {
+	return 0;
+    }
+    const unsigned char *sig = signature + n;
+
+    union {
+	unsigned char fors_roots[ TS_MAX_FORS * TS_MAX_HASH ];
+	unsigned char wots[ TS_MAX_WOTS_DIGITS * TS_MAX_HASH ];
+    } nodes;
+    job.generation = 0;
+    job.quit = 0;
+    pthread_mutex_init( &job.lock, 0 );
+    pthread_cond_init( &job.start, 0 );
+    pthread_cond_init( &job.done, 0 );
+
+    /* Start up the other threads (if we can't, we'll just do the work */
+    /* with fewer) */
+    pthread_t threads[ MAX_THREADS ];
+    unsigned started = 0;
+    for (unsigned i = 1; i < num_threads; i++) {
+	if (0 != pthread_create( &threads[started], 0, verify_worker, &job )) {
+	    break;
+	}
+	started++;
+    }
+
+    /* The FORS trees, and then hash their roots together */
+    unsigned k = PS_K(ps), t = PS_T(ps);
+    job.nodes = nodes.fors_roots;
+    run_phase( &job, phase_fors, sig, k );
+    sig += k * (t+1) * n;
+    ts_set_fors_root_adr( ctx );
+    PS_INIT_T(ps)( &ctx->big_iter, ctx );
+    for (unsigned i = 0; i < k; i++) {
+	PS_NEXT_T(ps)( &ctx->big_iter, &nodes.fors_roots[i*n], ctx );
+    }
+    PS_FINAL_T(ps)( ctx->auth_path_buffer, &ctx->big_iter, ctx );
+    ctx->fors_tree = 0;
+
+    /* If we have a path cache, work out the digests of the upper layers */
+    unsigned char digests[MAX_LAYERS][TS_PATH_DIGEST_SIZE];
+    struct ts_path_point points[MAX_LAYERS];
+    if (PS_D(ps) > MAX_LAYERS) cache = 0;
+    if (cache) {
+	path_digests( digests, sig, ps );
+    }
+    int cached = 0;   /* Set if the path cache vouched for the rest */
+
+    /* The hypertree, one layer at a time */
+    unsigned leaf = ctx->fors_keypair_addr;
+    job.nodes = nodes.wots;
+    for (;;) {
+	if (cache && ctx->hypertree_level > 0) {
+	    /* Have we already verified the rest of this signature? */
+	    struct ts_path_point *point = &points[ctx->hypertree_level];
+	    point->layer = ctx->hypertree_level;
+	    point->tree_address = ctx->tree_address;
+	    point->leaf = leaf;
+	    memcpy( point->root, ctx->auth_path_buffer, n );
+	    if (ts_path_cache_check( cache, ps, public_key, point,
+				     digests[ctx->hypertree_level] )) {
+		cached = 1;
+		break;
+	    }
+	}
+
+	/* The WOTS signature of the root below (in auth_path_buffer) */
+	ts_set_up_wots_signature( ctx, leaf );
+	memcpy( nodes.wots, sig, num_digits * n );
+	run_phase( &job, phase_wots, sig,
+		   (num_digits + CHAINS_PER_ITEM - 1) / CHAINS_PER_ITEM );
+	sig += num_digits * n;
+	ts_set_wots_header_adr( leaf, ctx );
+	PS_INIT_T(ps)( &ctx->big_iter, ctx );
+	for (unsigned i = 0; i < num_digits; i++) {
+	    PS_NEXT_T(ps)( &ctx->big_iter, &nodes.wots[i*n], ctx );
+	}
+	PS_FINAL_T(ps)( ctx->auth_path_buffer, &ctx->big_iter, ctx );
+
+	/* And up the Merkle tree */
+	ts_climb_auth_path( sig, merkle_h, ADR_TYPE_HASHTREE, ctx );
+	sig += merkle_h * n;
+
+	ctx->hypertree_level++;
+	if (ctx->hypertree_level == PS_D(ps)) break;
+	leaf = ctx->tree_address & ((1 << merkle_h) - 1);
+	ctx->tree_address >>= merkle_h;
+    }
+
+    pthread_mutex_lock( &job.lock );
+    job.quit = 1;
+    pthread_cond_broadcast( &job.start );
+    pthread_mutex_unlock( &job.lock );
+    for (unsigned i = 0; i < started; i++) {
+	pthread_join( threads[i], 0 );
+    }
+    pthread_cond_destroy( &job.start );
+    pthread_cond_destroy( &job.done );
+    pthread_mutex_destroy( &job.lock );
+
+    /* We're at the top of the hypertree (or the cache told us that */
+    /* we'd get there) - did we get the public root? */
+    if (!cached && 0 != memcmp( CONVERT_PUBLIC_KEY_TO_ROOT( public_key, n ),
+		                ctx->auth_path_buffer, n )) {
+	return 0;
+    }
+
+    /* It verified; remember the upper layers we went through (up to */
+    /* the one the cache already had) */
+    if (cache) {
+	for (unsigned layer = 1; layer < ctx->hypertree_level; layer++) {
+	    ts_path_cache_add( cache, ps, public_key, &points[layer],
+			       digests[layer] );
+	}
+    }
+    return 1;
+}
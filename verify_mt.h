@@ -0,0 +1,45 @@
+#if !defined( VERIFY_MT_H_ )
+#define VERIFY_MT_H_
+
+/*
+ * Multithreaded verification of a signature that's entirely in memory.
+ * As with keygen_mt.h, this is meant for hosts (e.g. update servers that
+ * care about how long each verification takes, and not about RAM); it uses
+ * POSIX threads, and so isn't part of the core package
+ */
+
+#include <stddef.h>
+#include "tiny_sphincs.h"
+
+/*
+ * This verifies the signature (len_signature bytes at signature) of the
+ * message, spreading the work across num_threads threads (including the
+ * calling one; at most 64).  The FORS trees are done in parallel, as are
+ * the WOTS chains within each hypertree layer.
+ * This accepts exactly the signatures that ts_init_verify/
+ * ts_update_verify/ts_verify would.
+ * This returns 1 if the signature verifies, 0 if not
+ */
+int ts_verify_oneshot( const void *message, size_t len_message,
+		const unsigned char *signature, size_t len_signature,
+		const unsigned char *public_key,
+		const struct ts_parameter_set *ps,
+		unsigned num_threads );
+
+/*
+ * This is ts_verify_oneshot, using a cache of hypertree paths that have
+ * already been verified (see pathcache.h); if a signature reaches a point
+ * in the hypertree that the cache has, with the same bytes from there on,
+ * we skip the rest of the hashing.  Signatures that verify are added to
+ * the cache.  cache may be NULL.  This accepts exactly the signatures that
+ * ts_verify_oneshot would
+ */
+struct ts_path_cache;
+int ts_verify_oneshot_cached( const void *message, size_t len_message,
+		const unsigned char *signature, size_t len_signature,
+		const unsigned char *public_key,
+		const struct ts_parameter_set *ps,
+		unsigned num_threads,
+		struct ts_path_cache *cache );
+
+#endif /* VERIFY_MT_H_ */
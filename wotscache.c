@@ -0,0 +1,217 @@
+/*
+ * This is the WOTS checkpoint cache; see wotscache.h for the API
+ *
+ * The cache is an array of fixed size slots, one WOTS key per slot; a key
+ * (layer, tree, leaf) always goes into the slot its hash picks.  Each slot
+ * is a header, followed by the leaf, followed by the checkpoints (chain
+ * after chain).  A slot being filled in is marked as such; while it is,
+ * no one else reads it or takes it over, and so the filling can be done
+ * without holding the lock.  A signer that's partway through a WOTS
+ * signature rechecks the slot each time it copies out a checkpoint, so if
+ * someone else takes it over in the meantime, it just goes back to
+ * computing the chains from the start
+ */
+#include <string.h>
+#include <stdint.h>
+#include "wotscache.h"
+#include "internal.h"
+
+enum slot_state {
+    slot_empty,
+    slot_filling,       /* Someone is computing the checkpoints */
+    slot_ready,
+};
+
+struct slot {
+    uint64_t tree;
+    unsigned leaf;
+    unsigned char layer;
+    unsigned char state;
+};
+
+size_t ts_wots_cache_slot_size( const struct ts_parameter_set *ps,
+		                unsigned interval ) {
+    unsigned max = PS_WOTS_MAX(ps);
+    if (interval < 1 || interval > max) return 0;
+    unsigned n = PS_N(ps);
+    size_t size = sizeof(struct slot) + n +
+	                  (size_t)PS_WOTS_LEN(ps) * (max/interval + 1) * n;
+    /* Keep the slots aligned */
+    size_t align = sizeof(uint64_t);
+    return (size + align - 1) / align * align;
+}
+
+unsigned ts_wots_cache_init( struct ts_wots_cache *cache,
+                   void *memory, size_t len_memory,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key,
+                   unsigned interval, unsigned min_layer,
+                   void (*lock_func)(void *), void (*unlock_func)(void *),
+                   void *lock_arg ) {
+    if (!cache) return 0;
+    memset( cache, 0, sizeof *cache );
+    size_t slot_size = ts_wots_cache_slot_size( ps, interval );
+    if (!memory || slot_size == 0) return 0;
+
+    /* Align the slots */
+    size_t align = sizeof(uint64_t);
+    size_t skip = (align - (uintptr_t)memory % align) % align;
+    if (len_memory < skip) return 0;
+    size_t num_slots = (len_memory - skip) / slot_size;
+    if (num_slots > (unsigned)-1) num_slots = (unsigned)-1;
+    if (num_slots == 0) return 0;
+
+    cache->slots = (unsigned char *)memory + skip;
+    cache->slot_size = slot_size;
+    cache->num_slots = num_slots;
+    cache->interval = interval;
+    cache->min_layer = min_layer;
+    cache->ps = ps;
+    memcpy( cache->public_key, public_key, 2*PS_N(ps) );
+    cache->lock = lock_func;
+    cache->unlock = unlock_func;
+    cache->lock_arg = lock_arg;
+
+    for (unsigned i = 0; i < cache->num_slots; i++) {
+	struct slot *s = (struct slot *)(cache->slots + i*slot_size);
+	s->state = slot_empty;
+    }
+    return cache->num_slots;
+}
+
+void ts_wots_cache_clear( struct ts_wots_cache *cache ) {
+    if (!cache) return;
+    if (cache->slots) {
+	/* Use a volatile pointer, so this isn't optimized away */
+	volatile unsigned char *p = cache->slots;
+	size_t len = (size_t)cache->num_slots * cache->slot_size;
+	while (len--) *p++ = 0;
+    }
+    memset( cache, 0, sizeof *cache );
+}
+
+int ts_set_wots_cache( struct ts_context *ctx,
+		   struct ts_wots_cache *cache ) {
+#if TS_WOTS_CACHE
+    if (ctx->state <= ts_sign_state || ctx->state >= ts_verify_state) {
+	return 0;
+    }
+    if (cache && (cache->num_slots == 0 || cache->ps != ctx->ps ||
+	          0 != memcmp( cache->public_key, ctx->public_key,
+			       2*PS_N(ctx->ps) ))) {
+	return 0;
+    }
+    ctx->wots_cache = cache;
+    return 1;
+#else
+    (void)ctx; (void)cache;
+    return 0;
+#endif
+}
+
+#if TS_WOTS_CACHE
+static void lock( struct ts_wots_cache *cache ) {
+    if (cache->lock) cache->lock( cache->lock_arg );
+}
+
+static void unlock( struct ts_wots_cache *cache ) {
+    if (cache->unlock) cache->unlock( cache->lock_arg );
+}
+
+/* The slot that the current WOTS key goes into, or NULL if we don't */
+/* cache that layer */
+static struct slot *find_slot( struct ts_wots_cache *cache,
+		               const struct ts_context *ctx ) {
+    if (ctx->hypertree_level < cache->min_layer) return 0;
+    uint64_t h = ctx->tree_address ^
+	         ((uint64_t)ctx->hypertree_level << 56) ^
+	         ((uint64_t)ctx->auth_path_node << 24);
+    /* Mix the bits (this is the splitmix64 finalizer) */
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return (struct slot *)(cache->slots + (h % cache->num_slots) *
+		                                  cache->slot_size);
+}
+
+/* Is this slot for the current WOTS key? */
+static int is_ready( const struct slot *s, const struct ts_context *ctx ) {
+    return s->state == slot_ready && s->layer == ctx->hypertree_level &&
+	   s->tree == ctx->tree_address && s->leaf == ctx->auth_path_node;
+}
+
+static unsigned char *slot_leaf( struct slot *s ) {
+    return (unsigned char *)(s + 1);
+}
+
+static unsigned char *slot_checkpoints( struct slot *s, unsigned n ) {
+    return slot_leaf( s ) + n;
+}
+
+void ts_wots_cache_prepare( struct ts_wots_cache *cache,
+		            struct ts_context *ctx ) {
+    struct slot *s = find_slot( cache, ctx );
+    if (!s) return;
+
+    lock( cache );
+    if (is_ready( s, ctx )) {
+	cache->hits++;
+	unlock( cache );
+	return;
+    }
+    cache->misses++;
+    if (s->state == slot_filling) {
+	/* Someone else is filling this slot in; leave it be */
+	unlock( cache );
+	return;
+    }
+    s->layer = ctx->hypertree_level;
+    s->tree = ctx->tree_address;
+    s->leaf = ctx->auth_path_node;
+    s->state = slot_filling;
+    unlock( cache );
+
+    /* No one else will touch the slot while it's marked as being filled */
+    ts_wots_leaf_checkpoints( slot_leaf( s ), ctx->auth_path_node,
+		 slot_checkpoints( s, PS_N(ctx->ps) ), cache->interval, ctx );
+
+    lock( cache );
+    s->state = slot_ready;
+    unlock( cache );
+}
+
+int ts_wots_cache_chain( struct ts_wots_cache *cache, unsigned char *output,
+		         unsigned digit, unsigned value,
+			 struct ts_context *ctx ) {
+    struct slot *s = find_slot( cache, ctx );
+    if (!s) return -1;
+    unsigned n = PS_N(ctx->ps);
+    unsigned per_chain = PS_WOTS_MAX(ctx->ps)/cache->interval + 1;
+    unsigned k = value / cache->interval;
+    int step = -1;
+
+    lock( cache );
+    if (is_ready( s, ctx )) {
+	memcpy( output, slot_checkpoints( s, n ) + (digit*per_chain + k) * n,
+		n );
+	step = k * cache->interval;
+    }
+    unlock( cache );
+    return step;
+}
+
+int ts_wots_cache_leaf( struct ts_wots_cache *cache, unsigned char *output,
+			struct ts_context *ctx ) {
+    struct slot *s = find_slot( cache, ctx );
+    if (!s) return 0;
+    int found = 0;
+
+    lock( cache );
+    if (is_ready( s, ctx )) {
+	memcpy( output, slot_leaf( s ), PS_N(ctx->ps) );
+	found = 1;
+    }
+    unlock( cache );
+    return found;
+}
+#endif
@@ -0,0 +1,98 @@
+#if !defined( WOTSCACHE_H_ )
+#define WOTSCACHE_H_
+
+/*
+ * This is a cache of WOTS chain checkpoints, for signers that sign a lot.
+ *
+ * Each WOTS signature the signer generates takes, for each of its 2n+3
+ * digits, the PRF and then as many F calls as the digit's value (up to
+ * 15); the leaf (the WOTS public key) that the signer computes next takes
+ * the full 15 on every chain (w-1, for parameter sets with a w other than
+ * 16; see TS_CUSTOM_PARM_SET).  Even with a node cache (which takes care of
+ * the authentication paths), that's most of what's left of the work in a
+ * hypertree layer.  The upper layers have few WOTS keys, and they're used
+ * over and over, so this holds, for WOTS keys in the upper layers, the
+ * values at every interval'th step along each chain (and the leaf); a
+ * digit then costs at most interval-1 F calls, and the leaf nothing.  The
+ * first time a key is used, the signer computes all that (which costs
+ * about as much as the leaf did).
+ *
+ * The interval sets the trade-off: each WOTS key takes (2n+3)*(15/interval
+ * + 1) hashes of n bytes (e.g. 2240 bytes for n=16 and interval 4); 1
+ * makes signing in the cached layers nearly free, 15 is the smallest.
+ * Layers below min_layer (the bottom layer is 0, the top d-1) aren't
+ * cached; there are far too many keys down there for a cache to help.
+ * Each (layer, tree, leaf) goes into one slot of the cache (determined by
+ * a hash); a key that maps to a slot that's in use replaces it.
+ *
+ * SECURITY NOTE: these values are secret.  Anyone with the value at step
+ * s of a chain can sign any digit s or higher; in particular, the step 0
+ * values are the WOTS private key.  Keep the cache in memory that's as
+ * well protected as the private key (this is not something to hand to a
+ * host, as you can with the node cache), and call ts_wots_cache_clear
+ * when you're done with it.  Caching these values doesn't change what the
+ * signatures reveal, as the hypertree always signs the same root with the
+ * same WOTS key.
+ *
+ * Like the key cache, the cache lives in memory that the application
+ * provides, and is set up for one private key.  This is meant to be used
+ * this way:
+ *
+ * struct ts_wots_cache cache;
+ * ts_wots_cache_init( &cache, memory, len_memory, ps, public_key,
+ *                     4, d-2, 0, 0, 0 );
+ * ...
+ * ts_init_sign( &ctx, message, len_message, ps, private_key, random );
+ * ts_set_wots_cache( &ctx, &cache );
+ * ... ts_sign ...
+ *
+ * If multiple threads share a cache, pass lock/unlock functions to
+ * ts_wots_cache_init; the lock is held only briefly (to look up an entry,
+ * or to copy out a checkpoint), not while an entry is being filled in
+ */
+
+#include <stddef.h>
+#include "tiny_sphincs.h"
+
+struct ts_wots_cache {
+    unsigned char *slots;
+    size_t slot_size;
+    unsigned num_slots;
+    unsigned interval;      /* We keep every interval'th chain value */
+    unsigned min_layer;     /* The lowest layer we cache */
+    const struct ts_parameter_set *ps;
+    unsigned char public_key[2*TS_MAX_HASH];  /* The key this is for */
+    void (*lock)(void *);
+    void (*unlock)(void *);
+    void *lock_arg;
+    unsigned long hits, misses;  /* Statistics (per WOTS signature) */
+};
+
+/*
+ * The number of bytes of memory the cache uses per WOTS key with this
+ * interval (0 if the interval isn't between 1 and w-1, that is 15)
+ */
+size_t ts_wots_cache_slot_size( const struct ts_parameter_set *ps,
+		                unsigned interval );
+
+/*
+ * Set up a cache in the given memory, for signing with the private key
+ * that goes with this public key.  lock and unlock may be NULL (if the
+ * cache is used by only one thread); if not, they're called with lock_arg.
+ * This returns the number of WOTS keys the cache can hold (0 if the
+ * memory isn't enough for even one, or the interval isn't 1 through w-1)
+ */
+unsigned ts_wots_cache_init( struct ts_wots_cache *cache,
+                   void *memory, size_t len_memory,
+                   const struct ts_parameter_set *ps,
+                   const unsigned char *public_key,
+                   unsigned interval, unsigned min_layer,
+                   void (*lock)(void *), void (*unlock)(void *),
+                   void *lock_arg );
+
+/*
+ * Erase everything in the cache (the memory can then be reused)
+ */
+void ts_wots_cache_clear( struct ts_wots_cache *cache );
+
+#endif /* WOTSCACHE_H_ */